@@ -1,12 +1,53 @@
 #pragma once
 
+#include <stddef.h>
+
 #include <esp_log.h>
 
 #define LOG_TAG_DECLARE(tag) static const char *TAG = tag;
 
+#if defined(CONFIG_RAVEN_LOG_DEFERRED)
+// Deferred logging: the caller only stores the format pointer and a copy of
+// the arguments into a ring buffer. Formatting and printing are done by a
+// low priority task in the other core, so logging can't block the RC task
+// while the UART is busy. If the ring is full, the record is dropped.
+#define LOG_DEFERRED(level, tag, format, ...)                       \
+    do                                                              \
+    {                                                               \
+        if (LOG_LOCAL_LEVEL >= level)                               \
+        {                                                           \
+            log_deferred_printf(level, tag, format, ##__VA_ARGS__); \
+        }                                                           \
+    } while (0)
+
+#define LOG_DEFERRED_BUFFER(level, tag, buf, size)      \
+    do                                                  \
+    {                                                   \
+        if (LOG_LOCAL_LEVEL >= level)                   \
+        {                                               \
+            log_deferred_buffer(level, tag, buf, size); \
+        }                                               \
+    } while (0)
+
+#define LOG_D(tag, format, ...) LOG_DEFERRED(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#define LOG_I(tag, format, ...) LOG_DEFERRED(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define LOG_W(tag, format, ...) LOG_DEFERRED(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+
+#define LOG_BUFFER_D(tag, buf, size) LOG_DEFERRED_BUFFER(ESP_LOG_DEBUG, tag, buf, size)
+#define LOG_BUFFER_I(tag, buf, size) LOG_DEFERRED_BUFFER(ESP_LOG_INFO, tag, buf, size)
+#define LOG_BUFFER_W(tag, buf, size) LOG_DEFERRED_BUFFER(ESP_LOG_WARN, tag, buf, size)
+#else
 #define LOG_D(tag, format, ...) ESP_LOGD(tag, format, ##__VA_ARGS__)
 #define LOG_I(tag, format, ...) ESP_LOGI(tag, format, ##__VA_ARGS__)
 #define LOG_W(tag, format, ...) ESP_LOGW(tag, format, ##__VA_ARGS__)
+
+#define LOG_BUFFER_D(tag, buf, size) ESP_LOG_BUFFER_HEX_LEVEL(tag, buf, size, ESP_LOG_DEBUG)
+#define LOG_BUFFER_I(tag, buf, size) ESP_LOG_BUFFER_HEX_LEVEL(tag, buf, size, ESP_LOG_INFO)
+#define LOG_BUFFER_W(tag, buf, size) ESP_LOG_BUFFER_HEX_LEVEL(tag, buf, size, ESP_LOG_WARN)
+#endif
+
+// Errors are always printed synchronously, since they might be
+// followed by a crash.
 #define LOG_E(tag, format, ...) ESP_LOGE(tag, format, ##__VA_ARGS__)
 #define LOG_F(tag, format, ...)               \
     do                                        \
@@ -15,7 +56,24 @@
         abort();                              \
     } while (0)
 
-#define LOG_BUFFER_D(tag, buf, size) ESP_LOG_BUFFER_HEX_LEVEL(tag, buf, size, ESP_LOG_DEBUG)
-#define LOG_BUFFER_I(tag, buf, size) ESP_LOG_BUFFER_HEX_LEVEL(tag, buf, size, ESP_LOG_INFO)
-#define LOG_BUFFER_W(tag, buf, size) ESP_LOG_BUFFER_HEX_LEVEL(tag, buf, size, ESP_LOG_WARN)
 #define LOG_BUFFER_E(tag, buf, size) ESP_LOG_BUFFER_HEX_LEVEL(tag, buf, size, ESP_LOG_ERROR)
+
+typedef struct log_stats_s
+{
+    unsigned records;    // Records written to the ring
+    unsigned dropped;    // Records dropped because the ring was full
+    unsigned max_used;   // Maximum number of bytes used in the ring
+    unsigned max_cycles; // Maximum CPU cycles spent by a caller storing a record
+} log_stats_t;
+
+// Receives each formatted log line, including the trailing newline
+typedef void (*log_output_f)(const char *line, size_t size, void *user_data);
+
+// Redirects all the log output (deferred or not) to the given function
+// instead of the console UART. Pass NULL to restore the console.
+void log_set_output(log_output_f output, void *user_data);
+
+void log_deferred_init(void);
+void log_deferred_printf(esp_log_level_t level, const char *tag, const char *format, ...) __attribute__((format(printf, 3, 4)));
+void log_deferred_buffer(esp_log_level_t level, const char *tag, const void *buf, size_t size);
+void log_deferred_get_stats(log_stats_t *stats);
@@ -4,15 +4,31 @@
 
 typedef struct p2p_hal_s p2p_hal_t;
 
+typedef struct p2p_hal_channel_stats_s
+{
+    unsigned frames;     // Valid frames received, from any source
+    unsigned p2p_frames; // Frames using our P2P format
+    unsigned bad_frames; // Frames received with errors (e.g. collisions)
+    unsigned busy_us;    // Estimated air time used by all the frames
+} p2p_hal_channel_stats_t;
+
 typedef void (*p2p_hal_callback_f)(p2p_hal_t *p2p_hal, const void *data, size_t size, void *user_data);
 
 typedef struct p2p_hal_s
 {
     p2p_hal_callback_f callback;
     void *user_data;
+    int channel;
+    p2p_hal_channel_stats_t stats; // Since the last call to p2p_hal_read_stats()
 } p2p_hal_t;
 
 void p2p_hal_init(p2p_hal_t *hal, p2p_hal_callback_f callback, void *user_data);
 void p2p_hal_start(p2p_hal_t *hal);
 void p2p_hal_stop(p2p_hal_t *hal);
-void p2p_hal_broadcast(p2p_hal_t *hal, const void *data, size_t size);
\ No newline at end of file
+void p2p_hal_broadcast(p2p_hal_t *hal, const void *data, size_t size);
+// Changing the channel resets the stats
+void p2p_hal_set_channel(p2p_hal_t *hal, int channel);
+int p2p_hal_get_channel(p2p_hal_t *hal);
+// Returns the stats for the current channel since the last call
+// and resets them.
+void p2p_hal_read_stats(p2p_hal_t *hal, p2p_hal_channel_stats_t *stats);
\ No newline at end of file
@@ -1,7 +1,11 @@
 #include <driver/gpio.h>
 
+#include <hal/log.h>
+
 void hal_init(void)
 {
     // Enable ISR for GPIO interrupts (used for DIO lines in Semtech based radios)
     ESP_ERROR_CHECK(gpio_install_isr_service(ESP_INTR_FLAG_IRAM));
+    // Start the task which prints deferred logs
+    log_deferred_init();
 }
\ No newline at end of file
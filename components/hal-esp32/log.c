@@ -0,0 +1,535 @@
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include <xtensa/hal.h>
+
+#include <hal/log.h>
+
+#define LOG_OUTPUT_LINE_SIZE 256
+
+static log_output_f log_output;
+static void *log_output_data;
+// Lines are formatted into a shared buffer under a lock, so logging
+// doesn't need a whole line in the stack of every task.
+static SemaphoreHandle_t log_output_mutex;
+static char log_output_line[LOG_OUTPUT_LINE_SIZE];
+
+static int log_output_vprintf(const char *format, va_list args)
+{
+    xSemaphoreTake(log_output_mutex, portMAX_DELAY);
+    int n = vsnprintf(log_output_line, sizeof(log_output_line), format, args);
+    if (n > 0)
+    {
+        // Truncated lines lose their newline, the host adds it back
+        size_t size = (size_t)n < sizeof(log_output_line) ? (size_t)n : sizeof(log_output_line) - 1;
+        log_output(log_output_line, size, log_output_data);
+    }
+    xSemaphoreGive(log_output_mutex);
+    return n;
+}
+
+void log_set_output(log_output_f output, void *user_data)
+{
+    if (!log_output_mutex)
+    {
+        log_output_mutex = xSemaphoreCreateMutex();
+    }
+    log_output_data = user_data;
+    log_output = output;
+    esp_log_set_vprintf(output ? log_output_vprintf : vprintf);
+}
+
+#if defined(CONFIG_RAVEN_LOG_DEFERRED)
+
+// Must be a power of 2
+#define LOG_RING_SIZE 4096
+#define LOG_RING_MASK (LOG_RING_SIZE - 1)
+// Maximum bytes stored for the arguments of a single record
+#define LOG_MAX_ARGS_SIZE 96
+// Strings are copied into the record, since they might live in the
+// caller's stack. Longer ones are truncated.
+#define LOG_MAX_STRING_ARG 31
+#define LOG_MAX_LINE_SIZE 256
+#define LOG_TASK_STACK_SIZE 3072
+// Run on the core not used by the RC task
+#define LOG_TASK_CORE 0
+#define LOG_TASK_INTERVAL_MS 10
+
+// Formats a single conversion, taking into account '*' width and precision
+#define LOG_FORMAT_ARG(buf, size, spec, stars, star_args, v)     \
+    ((stars) == 0   ? snprintf(buf, size, spec, v)               \
+     : (stars) == 1 ? snprintf(buf, size, spec, star_args[0], v) \
+                    : snprintf(buf, size, spec, star_args[0], star_args[1], v))
+
+enum
+{
+    LOG_RECORD_FREE = 0,
+    LOG_RECORD_WRITING,
+    LOG_RECORD_READY,
+    LOG_RECORD_PADDING,
+};
+
+enum
+{
+    LOG_RECORD_TYPE_PRINTF,
+    LOG_RECORD_TYPE_BUFFER,
+};
+
+// Records are always a multiple of 4 bytes and since the ring size is
+// too, there's always room for at least the size and state at the end
+// of the ring when a record needs to be wrapped.
+typedef struct log_record_s
+{
+    uint16_t size; // Including the header
+    uint8_t state;
+    uint8_t level : 4;
+    uint8_t type : 4;
+    uint32_t timestamp; // ms
+    const char *tag;
+    const char *format; // Acts as the format id
+    uint8_t args[];
+} log_record_t;
+
+static uint8_t log_ring[LOG_RING_SIZE] __attribute__((aligned(4)));
+// Both indexes grow monotonically, masked to access the ring
+static uint32_t log_ring_head;
+static uint32_t log_ring_tail;
+static log_stats_t log_stats;
+static bool log_task_started = false;
+
+static const char *log_args_too_long_format = "(arguments too long) %s";
+
+static log_record_t *log_ring_reserve(size_t size)
+{
+    size = (size + 3) & ~3;
+    uint32_t head = __atomic_load_n(&log_ring_head, __ATOMIC_ACQUIRE);
+    uint32_t new_head;
+    uint32_t padding;
+    do
+    {
+        uint32_t offset = head & LOG_RING_MASK;
+        padding = offset + size > LOG_RING_SIZE ? LOG_RING_SIZE - offset : 0;
+        new_head = head + padding + size;
+        uint32_t used = new_head - __atomic_load_n(&log_ring_tail, __ATOMIC_ACQUIRE);
+        if (used > LOG_RING_SIZE)
+        {
+            __atomic_fetch_add(&log_stats.dropped, 1, __ATOMIC_RELAXED);
+            return NULL;
+        }
+        if (used > log_stats.max_used)
+        {
+            log_stats.max_used = used;
+        }
+    } while (!__atomic_compare_exchange_n(&log_ring_head, &head, new_head, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+    if (padding > 0)
+    {
+        log_record_t *pad = (log_record_t *)&log_ring[head & LOG_RING_MASK];
+        pad->size = padding;
+        __atomic_store_n(&pad->state, LOG_RECORD_PADDING, __ATOMIC_RELEASE);
+    }
+    log_record_t *record = (log_record_t *)&log_ring[(head + padding) & LOG_RING_MASK];
+    record->size = size;
+    record->state = LOG_RECORD_WRITING;
+    __atomic_fetch_add(&log_stats.records, 1, __ATOMIC_RELAXED);
+    return record;
+}
+
+static void log_ring_commit(log_record_t *record, uint32_t started_at)
+{
+    __atomic_store_n(&record->state, LOG_RECORD_READY, __ATOMIC_RELEASE);
+    uint32_t cycles = xthal_get_ccount() - started_at;
+    if (cycles > log_stats.max_cycles)
+    {
+        log_stats.max_cycles = cycles;
+    }
+}
+
+// Returns the size of the conversion starting at format (which points
+// to the character after the '%') and stores its conversion character
+// and wether it uses a 64 bit integer.
+static size_t log_parse_conversion(const char *format, char *conv, bool *wide, unsigned *stars)
+{
+    const char *p = format;
+    *wide = false;
+    *stars = 0;
+    while (*p && strchr("-+ #0123456789.*", *p))
+    {
+        if (*p == '*')
+        {
+            (*stars)++;
+        }
+        p++;
+    }
+    while (*p && strchr("hlzjt", *p))
+    {
+        if (*p == 'l' && p[1] == 'l')
+        {
+            *wide = true;
+        }
+        p++;
+    }
+    *conv = *p;
+    return *p ? p - format + 1 : p - format;
+}
+
+// Copies the arguments into buf, returns the number of bytes used or -1
+// if they don't fit.
+static int log_pack_args(uint8_t *buf, size_t size, const char *format, va_list ap)
+{
+    uint8_t *ptr = buf;
+    uint8_t *end = buf + size;
+    for (const char *p = format; *p; p++)
+    {
+        if (*p != '%')
+        {
+            continue;
+        }
+        if (p[1] == '%')
+        {
+            p++;
+            continue;
+        }
+        char conv;
+        bool wide;
+        unsigned stars;
+        p += log_parse_conversion(p + 1, &conv, &wide, &stars);
+        for (unsigned ii = 0; ii < stars; ii++)
+        {
+            int v = va_arg(ap, int);
+            if (ptr + sizeof(v) > end)
+            {
+                return -1;
+            }
+            memcpy(ptr, &v, sizeof(v));
+            ptr += sizeof(v);
+        }
+        switch (conv)
+        {
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        {
+            double v = va_arg(ap, double);
+            if (ptr + sizeof(v) > end)
+            {
+                return -1;
+            }
+            memcpy(ptr, &v, sizeof(v));
+            ptr += sizeof(v);
+            break;
+        }
+        case 's':
+        {
+            const char *s = va_arg(ap, const char *);
+            size_t len = s ? strnlen(s, LOG_MAX_STRING_ARG) : 0;
+            if (ptr + len + 1 > end)
+            {
+                return -1;
+            }
+            memcpy(ptr, s, len);
+            ptr[len] = '\0';
+            ptr += len + 1;
+            break;
+        }
+        case 'p':
+        {
+            void *v = va_arg(ap, void *);
+            if (ptr + sizeof(v) > end)
+            {
+                return -1;
+            }
+            memcpy(ptr, &v, sizeof(v));
+            ptr += sizeof(v);
+            break;
+        }
+        case '\0':
+            // Malformed format, p already points to the last character
+            break;
+        default:
+            if (wide)
+            {
+                long long v = va_arg(ap, long long);
+                if (ptr + sizeof(v) > end)
+                {
+                    return -1;
+                }
+                memcpy(ptr, &v, sizeof(v));
+                ptr += sizeof(v);
+            }
+            else
+            {
+                // int and long are the same size in the ESP32
+                int v = va_arg(ap, int);
+                if (ptr + sizeof(v) > end)
+                {
+                    return -1;
+                }
+                memcpy(ptr, &v, sizeof(v));
+                ptr += sizeof(v);
+            }
+            break;
+        }
+    }
+    return ptr - buf;
+}
+
+void log_deferred_printf(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    uint32_t started_at = xthal_get_ccount();
+    uint8_t args[LOG_MAX_ARGS_SIZE];
+    va_list ap;
+    va_start(ap, format);
+    int n = log_pack_args(args, sizeof(args), format, ap);
+    va_end(ap);
+    if (n < 0)
+    {
+        // Arguments don't fit, log the format string instead
+        size_t len = strnlen(format, LOG_MAX_STRING_ARG);
+        memcpy(args, format, len);
+        args[len] = '\0';
+        n = len + 1;
+        format = log_args_too_long_format;
+    }
+    log_record_t *record = log_ring_reserve(sizeof(*record) + n);
+    if (record)
+    {
+        record->level = level;
+        record->type = LOG_RECORD_TYPE_PRINTF;
+        record->timestamp = esp_log_timestamp();
+        record->tag = tag;
+        record->format = format;
+        memcpy(record->args, args, n);
+        log_ring_commit(record, started_at);
+    }
+}
+
+void log_deferred_buffer(esp_log_level_t level, const char *tag, const void *buf, size_t size)
+{
+    uint32_t started_at = xthal_get_ccount();
+    // Store the size in the first byte
+    size = size < LOG_MAX_ARGS_SIZE ? size : LOG_MAX_ARGS_SIZE;
+    log_record_t *record = log_ring_reserve(sizeof(*record) + 1 + size);
+    if (record)
+    {
+        record->level = level;
+        record->type = LOG_RECORD_TYPE_BUFFER;
+        record->timestamp = esp_log_timestamp();
+        record->tag = tag;
+        record->format = NULL;
+        record->args[0] = size;
+        memcpy(&record->args[1], buf, size);
+        log_ring_commit(record, started_at);
+    }
+}
+
+static void log_format_record(const log_record_t *record, char *line, size_t size)
+{
+    const uint8_t *arg = record->args;
+    size_t pos = 0;
+    char spec[16];
+    for (const char *p = record->format; *p && pos < size - 1; p++)
+    {
+        if (*p != '%')
+        {
+            line[pos++] = *p;
+            continue;
+        }
+        if (p[1] == '%')
+        {
+            line[pos++] = '%';
+            p++;
+            continue;
+        }
+        char conv;
+        bool wide;
+        unsigned stars;
+        size_t spec_size = log_parse_conversion(p + 1, &conv, &wide, &stars) + 1;
+        if (conv == '\0' || spec_size >= sizeof(spec))
+        {
+            break;
+        }
+        memcpy(spec, p, spec_size);
+        spec[spec_size] = '\0';
+        p += spec_size - 1;
+        int star_args[2] = {0, 0};
+        for (unsigned ii = 0; ii < stars && ii < 2; ii++)
+        {
+            memcpy(&star_args[ii], arg, sizeof(int));
+            arg += sizeof(int);
+        }
+        int n;
+        switch (conv)
+        {
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        {
+            double v;
+            memcpy(&v, arg, sizeof(v));
+            arg += sizeof(v);
+            n = LOG_FORMAT_ARG(&line[pos], size - pos, spec, stars, star_args, v);
+            break;
+        }
+        case 's':
+        {
+            const char *v = (const char *)arg;
+            arg += strlen(v) + 1;
+            n = LOG_FORMAT_ARG(&line[pos], size - pos, spec, stars, star_args, v);
+            break;
+        }
+        case 'p':
+        {
+            void *v;
+            memcpy(&v, arg, sizeof(v));
+            arg += sizeof(v);
+            n = snprintf(&line[pos], size - pos, spec, v);
+            break;
+        }
+        default:
+            if (wide)
+            {
+                long long v;
+                memcpy(&v, arg, sizeof(v));
+                arg += sizeof(v);
+                n = LOG_FORMAT_ARG(&line[pos], size - pos, spec, stars, star_args, v);
+            }
+            else
+            {
+                int v;
+                memcpy(&v, arg, sizeof(v));
+                arg += sizeof(v);
+                n = LOG_FORMAT_ARG(&line[pos], size - pos, spec, stars, star_args, v);
+            }
+            break;
+        }
+        if (n > 0)
+        {
+            pos += n;
+            if (pos >= size)
+            {
+                pos = size - 1;
+            }
+        }
+    }
+    line[pos] = '\0';
+}
+
+static char log_level_letter(esp_log_level_t level)
+{
+    switch (level)
+    {
+    case ESP_LOG_ERROR:
+        return 'E';
+    case ESP_LOG_WARN:
+        return 'W';
+    case ESP_LOG_INFO:
+        return 'I';
+    case ESP_LOG_DEBUG:
+        return 'D';
+    default:
+        return 'V';
+    }
+}
+
+static void log_print_record(const log_record_t *record)
+{
+    static char line[LOG_MAX_LINE_SIZE];
+    esp_log_level_t level = record->level;
+    char letter = log_level_letter(level);
+    if (record->type == LOG_RECORD_TYPE_BUFFER)
+    {
+        // Same format used by ESP_LOG_BUFFER_HEX_LEVEL(), with the record timestamp
+        size_t size = record->args[0];
+        const uint8_t *data = &record->args[1];
+        for (size_t ii = 0; ii < size; ii += 16)
+        {
+            size_t pos = 0;
+            for (size_t jj = ii; jj < size && jj < ii + 16; jj++)
+            {
+                pos += snprintf(&line[pos], sizeof(line) - pos, "%02x ", data[jj]);
+            }
+            esp_log_write(level, record->tag, "%c (%u) %s: %s\n", letter, (unsigned)record->timestamp, record->tag, line);
+        }
+        return;
+    }
+    log_format_record(record, line, sizeof(line));
+    esp_log_write(level, record->tag, "%c (%u) %s: %s\n", letter, (unsigned)record->timestamp, record->tag, line);
+}
+
+static void log_task(void *arg)
+{
+    unsigned reported_dropped = 0;
+    for (;;)
+    {
+        uint32_t tail = log_ring_tail;
+        while (tail != __atomic_load_n(&log_ring_head, __ATOMIC_ACQUIRE))
+        {
+            log_record_t *record = (log_record_t *)&log_ring[tail & LOG_RING_MASK];
+            uint8_t state = __atomic_load_n(&record->state, __ATOMIC_ACQUIRE);
+            if (state != LOG_RECORD_READY && state != LOG_RECORD_PADDING)
+            {
+                // Still being written
+                break;
+            }
+            uint16_t size = record->size;
+            if (state == LOG_RECORD_READY)
+            {
+                log_print_record(record);
+            }
+            // Clear the memory, so stale data is never seen as a valid state
+            memset(record, 0, size);
+            tail += size;
+            __atomic_store_n(&log_ring_tail, tail, __ATOMIC_RELEASE);
+        }
+        unsigned dropped = __atomic_load_n(&log_stats.dropped, __ATOMIC_RELAXED);
+        if (dropped != reported_dropped)
+        {
+            esp_log_write(ESP_LOG_WARN, "Log", "W (%u) Log: %u records dropped\n", (unsigned)esp_log_timestamp(), dropped - reported_dropped);
+            reported_dropped = dropped;
+        }
+        vTaskDelay(LOG_TASK_INTERVAL_MS / portTICK_PERIOD_MS);
+    }
+}
+
+void log_deferred_init(void)
+{
+    if (!log_task_started)
+    {
+        // Use the lowest priority, so printing the logs never delays any
+        // other task.
+        xTaskCreatePinnedToCore(log_task, "LOG", LOG_TASK_STACK_SIZE, NULL, tskIDLE_PRIORITY, NULL, LOG_TASK_CORE);
+        log_task_started = true;
+    }
+}
+
+void log_deferred_get_stats(log_stats_t *stats)
+{
+    *stats = log_stats;
+}
+
+#else
+
+void log_deferred_init(void)
+{
+}
+
+void log_deferred_get_stats(log_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
+
+#endif
@@ -9,7 +9,16 @@
 
 #include <hal/p2p.h>
 
-#define P2P_WIFI_CHANNEL 14
+// Channel used until p2p_hal_set_channel() is called. Unlike 12-14,
+// channel 1 is available everywhere.
+#define P2P_WIFI_DEFAULT_CHANNEL 1
+#define P2P_WIFI_MAX_CHANNEL 14
+
+// Preamble and header time assumed for each frame
+#define P2P_FRAME_OVERHEAD_US 100
+// Frame control used by our frames, see p2p_hal_broadcast()
+#define P2P_FRAME_CTRL_0 0x58
+#define P2P_FRAME_CTRL_1 0x00
 
 #define RAW_WIFI_DATA_SIZE 32
 #define RAW_WIFI_CHECKSUM_SIZE 4 // Received after the actual payload
@@ -37,6 +46,65 @@ extern esp_err_t esp_wifi_80211_tx(wifi_interface_t ifx, const void *buffer, int
 
 // Unfortunately esp_wifi_set_promiscuous_rx_cb only accepts a function, no additional data pointer
 static p2p_hal_t *active_hal = NULL;
+static bool wifi_started = false;
+
+static unsigned p2p_hal_frame_rate_kbps(const wifi_pkt_rx_ctrl_t *rx_ctrl)
+{
+    static const uint16_t ht_rates[] = {6500, 13000, 19500, 26000, 39000, 52000, 58500, 65000};
+    if (rx_ctrl->sig_mode != 0)
+    {
+        return ht_rates[rx_ctrl->mcs % (sizeof(ht_rates) / sizeof(ht_rates[0]))];
+    }
+    switch (rx_ctrl->rate)
+    {
+    case 0x00:
+        return 1000;
+    case 0x01:
+    case 0x05:
+        return 2000;
+    case 0x02:
+    case 0x06:
+        return 5500;
+    case 0x03:
+    case 0x07:
+        return 11000;
+    case 0x08:
+        return 48000;
+    case 0x09:
+        return 24000;
+    case 0x0A:
+        return 12000;
+    case 0x0B:
+        return 6000;
+    case 0x0C:
+        return 54000;
+    case 0x0D:
+        return 36000;
+    case 0x0E:
+        return 18000;
+    case 0x0F:
+        return 9000;
+    }
+    // LR mode (which we use) and unknown rates. Assume the
+    // slowest LR rate, so we don't underestimate congestion.
+    return 250;
+}
+
+static void p2p_hal_update_stats(p2p_hal_t *hal, const wifi_promiscuous_pkt_t *ppkt)
+{
+    if (ppkt->rx_ctrl.rx_state != 0)
+    {
+        __atomic_fetch_add(&hal->stats.bad_frames, 1, __ATOMIC_SEQ_CST);
+        return;
+    }
+    unsigned air_time = P2P_FRAME_OVERHEAD_US + (ppkt->rx_ctrl.sig_len * 8 * 1000) / p2p_hal_frame_rate_kbps(&ppkt->rx_ctrl);
+    __atomic_fetch_add(&hal->stats.frames, 1, __ATOMIC_SEQ_CST);
+    __atomic_fetch_add(&hal->stats.busy_us, air_time, __ATOMIC_SEQ_CST);
+    if (ppkt->rx_ctrl.sig_len > 2 && ppkt->payload[0] == P2P_FRAME_CTRL_0 && ppkt->payload[1] == P2P_FRAME_CTRL_1)
+    {
+        __atomic_fetch_add(&hal->stats.p2p_frames, 1, __ATOMIC_SEQ_CST);
+    }
+}
 
 static void promiscuous_rx_packet_handler(void *buff, wifi_promiscuous_pkt_type_t type)
 {
@@ -46,6 +114,15 @@ static void promiscuous_rx_packet_handler(void *buff, wifi_promiscuous_pkt_type_
 
     const wifi_promiscuous_pkt_t *ppkt = (wifi_promiscuous_pkt_t *)buff;
 
+    if (active_hal)
+    {
+        p2p_hal_update_stats(active_hal, ppkt);
+    }
+    if (ppkt->rx_ctrl.rx_state != 0)
+    {
+        return;
+    }
+
 #if 0
     const wifi_ieee80211_packet_t *ipkt = (wifi_ieee80211_packet_t *)ppkt->payload;
     const wifi_ieee80211_mac_hdr_t *hdr = &ipkt->hdr;
@@ -87,6 +164,8 @@ void p2p_hal_init(p2p_hal_t *hal, p2p_hal_callback_f callback, void *user_data)
 
     hal->callback = callback;
     hal->user_data = user_data;
+    hal->channel = P2P_WIFI_DEFAULT_CHANNEL;
+    memset(&hal->stats, 0, sizeof(hal->stats));
     active_hal = hal;
     ESP_ERROR_CHECK(esp_event_loop_init(NULL, NULL));
     tcpip_adapter_init();
@@ -98,7 +177,7 @@ void p2p_hal_init(p2p_hal_t *hal, p2p_hal_callback_f callback, void *user_data)
     wifi_country_t cc = {
         .cc = "XXX",
         .schan = 1,
-        .nchan = P2P_WIFI_CHANNEL,
+        .nchan = P2P_WIFI_MAX_CHANNEL,
         .policy = WIFI_COUNTRY_POLICY_MANUAL,
     };
     ESP_ERROR_CHECK(esp_wifi_set_country(&cc));
@@ -111,24 +190,58 @@ void p2p_hal_init(p2p_hal_t *hal, p2p_hal_callback_f callback, void *user_data)
 void p2p_hal_start(p2p_hal_t *hal)
 {
     ESP_ERROR_CHECK(esp_wifi_start());
+    // Include frames with errors, they're counted in the stats
+    wifi_promiscuous_filter_t filter = {
+        .filter_mask = WIFI_PROMIS_FILTER_MASK_ALL,
+    };
+    ESP_ERROR_CHECK(esp_wifi_set_promiscuous_filter(&filter));
     ESP_ERROR_CHECK(esp_wifi_set_promiscuous(true));
     ESP_ERROR_CHECK(esp_wifi_set_promiscuous_rx_cb(promiscuous_rx_packet_handler));
-    ESP_ERROR_CHECK(esp_wifi_set_channel(P2P_WIFI_CHANNEL, WIFI_SECOND_CHAN_NONE));
+    ESP_ERROR_CHECK(esp_wifi_set_channel(hal->channel, WIFI_SECOND_CHAN_NONE));
+    wifi_started = true;
 }
 
 void p2p_hal_stop(p2p_hal_t *hal)
 {
+    wifi_started = false;
     ESP_ERROR_CHECK(esp_wifi_stop());
 }
 
+void p2p_hal_set_channel(p2p_hal_t *hal, int channel)
+{
+    if (channel != hal->channel)
+    {
+        hal->channel = channel;
+        if (wifi_started)
+        {
+            ESP_ERROR_CHECK(esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE));
+        }
+    }
+    memset(&hal->stats, 0, sizeof(hal->stats));
+}
+
+int p2p_hal_get_channel(p2p_hal_t *hal)
+{
+    return hal->channel;
+}
+
+void p2p_hal_read_stats(p2p_hal_t *hal, p2p_hal_channel_stats_t *stats)
+{
+    // Stats are updated from the WiFi task
+    stats->frames = __atomic_exchange_n(&hal->stats.frames, 0, __ATOMIC_SEQ_CST);
+    stats->p2p_frames = __atomic_exchange_n(&hal->stats.p2p_frames, 0, __ATOMIC_SEQ_CST);
+    stats->bad_frames = __atomic_exchange_n(&hal->stats.bad_frames, 0, __ATOMIC_SEQ_CST);
+    stats->busy_us = __atomic_exchange_n(&hal->stats.busy_us, 0, __ATOMIC_SEQ_CST);
+}
+
 void p2p_hal_broadcast(p2p_hal_t *p2p_hal, const void *data, size_t size)
 {
     uint8_t buf[512 + RAW_WIFI_DATA_SIZE];
     // 0-1: Frame control
     // the API won't let us send valid packets, so we send a DATA
     // type packet in the reserved range bits
-    buf[0] = 0x58;
-    buf[1] = 0x00;
+    buf[0] = P2P_FRAME_CTRL_0;
+    buf[1] = P2P_FRAME_CTRL_1;
     // 2-3: Duration
     buf[2] = buf[3] = 0x00;
     // 4-9: Destination addr (broadcast = all 0xff)
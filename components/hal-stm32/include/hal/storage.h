@@ -6,3 +6,31 @@ typedef struct hal_storage_s
 {
     uint8_t ns;
 } hal_storage_t;
+
+// Counters are reset on each boot. Times are measured with the cycle
+// counter, since the F1 loses SysTick ticks while erasing the flash.
+typedef struct hal_storage_stats_s
+{
+    unsigned used;               // Bytes used in the flash, including superseded records
+    unsigned capacity;           // Size of the storage region in bytes
+    unsigned writes;             // Records written by the callers
+    unsigned commits;            // Commits done by the callers
+    unsigned compactions;        // Operations that erased at least one block
+    unsigned idle_compactions;   // Compactions triggered by hal_storage_compact_step()
+    unsigned erases;             // Blocks erased
+    unsigned max_block_erases;   // Erases of the most erased block
+    unsigned compact_steps;      // Calls to hal_storage_compact_step() that wrote to the flash
+    uint32_t max_step_us;        // Longest step that didn't compact
+    uint32_t last_compaction_us; // Duration of the last operation that compacted
+    uint32_t max_compaction_us;  // Longest operation that compacted
+} hal_storage_stats_t;
+
+// wldb compacts its log from inside the write that finds it full, so
+// the pause lands wherever that write happens. Once a write leaves
+// little room before that happens, a compaction becomes pending and
+// each call to hal_storage_compact_step() writes a small filler record,
+// which takes a single flash program. The step that fills the log
+// triggers the compaction, so it must be called only when a pause of
+// a few erases is acceptable. Returns true while a compaction is pending.
+bool hal_storage_compact_step(void);
+void hal_storage_get_stats(hal_storage_stats_t *stats);
@@ -2,6 +2,9 @@
 #include <stdint.h>
 #include <string.h>
 
+#include <libopencm3/cm3/dwt.h>
+#include <libopencm3/stm32/rcc.h>
+
 #include <wldb.h>
 
 #include <hal/log.h>
@@ -21,7 +24,40 @@ LOG_TAG_DECLARE("HAL.Storage");
 #define KEY_SIZE_MAX 8
 #define WLDB_RET_TO_HAL(ret) (ret < 0 ? ret : HAL_ERR_NONE)
 
+#define BLOCK_COUNT ((size_t)(&__storage_end - &__storage_start) / CONFIG_BLOCK_SIZE)
+#define BLOCK_COUNT_MAX 16
+
+// A compaction becomes pending when a write leaves less than this
+// before wldb has to compact on its own, assuming it keeps a block
+// erased for that. It's enough for the settings changed in a flight.
+// storage_sim.py shows no compactions in flight with it, for about
+// 30% more erases than letting wldb compact on its own.
+#define COMPACT_MIN_FREE 512
+// Size of the value of each filler record. Writing it takes a single
+// program of about 1ms on the F1.
+#define COMPACT_FILLER_SIZE 32
+
+// wldb doesn't expose its log nor its compactions, so we look at the
+// flash itself: a compaction always erases at least one block, which
+// makes its used size go down. The used size of a block is the offset
+// after its last programmed word.
 static wldb_t db;
+static hal_storage_stats_t stats;
+static uint16_t block_used[BLOCK_COUNT_MAX];
+static uint16_t block_erases[BLOCK_COUNT_MAX];
+static bool cycles_available;
+
+// Filler records go to namespace 0, which no storage_t uses. The same
+// key is overwritten on every step, so only one of them is live.
+static hal_storage_t compact_storage = {.ns = 0};
+static const char compact_key[] = "gc";
+
+static struct
+{
+    bool pending;
+    unsigned steps_left;     // Steps before giving up if no compaction happens
+    unsigned compacted_used; // Used bytes right after the last compaction
+} compact;
 
 extern uint8_t __storage_start;
 extern uint8_t __storage_end;
@@ -37,6 +73,87 @@ static size_t hal_storage_format_key(hal_storage_t *s, const void *key, size_t k
     return key_size + 1;
 }
 
+static uint32_t hal_storage_cycles_now(void)
+{
+    return cycles_available ? dwt_read_cycle_counter() : 0;
+}
+
+static uint32_t hal_storage_elapsed_us(uint32_t started)
+{
+    return (hal_storage_cycles_now() - started) / (rcc_ahb_frequency / 1000000);
+}
+
+static uint16_t hal_storage_block_used(unsigned block)
+{
+    const uint32_t *start = (const uint32_t *)(&__storage_start + block * CONFIG_BLOCK_SIZE);
+    const uint32_t *p = start + CONFIG_BLOCK_SIZE / sizeof(*p);
+    while (p > start && p[-1] == 0xFFFFFFFF)
+    {
+        p--;
+    }
+    return (p - start) * sizeof(*p);
+}
+
+// Scans the blocks after an operation that took elapsed_us, counting
+// the erased ones. Returns true iff the operation compacted.
+static bool hal_storage_update_blocks(uint32_t elapsed_us)
+{
+    unsigned used = 0;
+    unsigned erased = 0;
+    for (unsigned ii = 0; ii < BLOCK_COUNT; ii++)
+    {
+        uint16_t u = hal_storage_block_used(ii);
+        if (u < block_used[ii])
+        {
+            erased++;
+            block_erases[ii]++;
+            if (block_erases[ii] > stats.max_block_erases)
+            {
+                stats.max_block_erases = block_erases[ii];
+            }
+        }
+        block_used[ii] = u;
+        used += u;
+    }
+    stats.used = used;
+    if (erased == 0)
+    {
+        return false;
+    }
+    stats.compactions++;
+    stats.erases += erased;
+    stats.last_compaction_us = elapsed_us;
+    if (elapsed_us > stats.max_compaction_us)
+    {
+        stats.max_compaction_us = elapsed_us;
+    }
+    compact.pending = false;
+    compact.compacted_used = used;
+    LOG_I(TAG, "Compaction erased %u blocks in %uus, %u/%u bytes used, %u compactions so far",
+          erased, (unsigned)elapsed_us, used, stats.capacity, stats.compactions);
+    return true;
+}
+
+// Called after the callers write. A compaction only becomes pending
+// again once they've written something since the last one, otherwise
+// a compaction that didn't free enough would be repeated forever.
+static void hal_storage_update_pending(void)
+{
+    if (compact.pending)
+    {
+        return;
+    }
+    unsigned erased = stats.capacity - stats.used;
+    if (erased < COMPACT_MIN_FREE + CONFIG_BLOCK_SIZE && stats.used > compact.compacted_used)
+    {
+        compact.pending = true;
+        // Filler records take more than COMPACT_FILLER_SIZE bytes in
+        // the flash, so this is enough to fill the log
+        compact.steps_left = (stats.capacity - stats.used) / COMPACT_FILLER_SIZE + 1;
+        LOG_D(TAG, "%u/%u bytes used, compaction pending", stats.used, stats.capacity);
+    }
+}
+
 hal_err_t hal_storage_init(hal_storage_t *s, uint8_t ns)
 {
     static bool db_is_initialized = false;
@@ -48,6 +165,14 @@ hal_err_t hal_storage_init(hal_storage_t *s, uint8_t ns)
             return ret;
         }
         db_is_initialized = true;
+        if (BLOCK_COUNT > BLOCK_COUNT_MAX)
+        {
+            LOG_F(TAG, "Block count %u > %d", (unsigned)BLOCK_COUNT, BLOCK_COUNT_MAX);
+        }
+        stats.capacity = &__storage_end - &__storage_start;
+        cycles_available = dwt_enable_cycle_counter();
+        hal_storage_update_blocks(0);
+        hal_storage_update_pending();
     }
     s->ns = ns;
     return HAL_ERR_NONE;
@@ -69,7 +194,11 @@ hal_err_t hal_storage_set_blob(hal_storage_t *s, const void *key, size_t key_siz
 {
     uint8_t wkey[KEY_SIZE_MAX];
     size_t ks = hal_storage_format_key(s, key, key_size, wkey);
+    uint32_t started = hal_storage_cycles_now();
     int ret = wldb_set(&db, wkey, ks, buf, size);
+    stats.writes++;
+    hal_storage_update_blocks(hal_storage_elapsed_us(started));
+    hal_storage_update_pending();
     return WLDB_RET_TO_HAL(ret);
 }
 
@@ -77,6 +206,64 @@ hal_err_t hal_storage_commit(hal_storage_t *s)
 {
     (void)s;
 
+    uint32_t started = hal_storage_cycles_now();
     int ret = wldb_commit(&db);
+    stats.commits++;
+    hal_storage_update_blocks(hal_storage_elapsed_us(started));
+    hal_storage_update_pending();
+    LOG_I(TAG, "%u/%u bytes used (%u%%), %u writes, %u commits, %u compactions (%u at idle), %u blocks erased",
+          stats.used, stats.capacity, (stats.used * 100) / stats.capacity, stats.writes, stats.commits,
+          stats.compactions, stats.idle_compactions, stats.erases);
     return WLDB_RET_TO_HAL(ret);
 }
+
+bool hal_storage_compact_step(void)
+{
+    if (!compact.pending)
+    {
+        return false;
+    }
+    if (compact.steps_left == 0)
+    {
+        LOG_W(TAG, "No compaction after filling the storage, giving up");
+        compact.pending = false;
+        return false;
+    }
+    compact.steps_left--;
+
+    uint8_t wkey[KEY_SIZE_MAX];
+    size_t ks = hal_storage_format_key(&compact_storage, compact_key, sizeof(compact_key) - 1, wkey);
+    uint32_t filler[COMPACT_FILLER_SIZE / sizeof(uint32_t)] = {0};
+    // Change the value on every step, in case wldb skips writes that
+    // don't change anything
+    filler[0] = stats.compact_steps;
+
+    uint32_t started = hal_storage_cycles_now();
+    int ret = wldb_set(&db, wkey, ks, filler, sizeof(filler));
+    if (ret >= 0)
+    {
+        ret = wldb_commit(&db);
+    }
+    uint32_t elapsed_us = hal_storage_elapsed_us(started);
+    stats.compact_steps++;
+    if (hal_storage_update_blocks(elapsed_us))
+    {
+        stats.idle_compactions++;
+        LOG_I(TAG, "Idle compaction done, %u steps so far, longest %uus", stats.compact_steps, (unsigned)stats.max_step_us);
+    }
+    else if (elapsed_us > stats.max_step_us)
+    {
+        stats.max_step_us = elapsed_us;
+    }
+    if (ret < 0)
+    {
+        LOG_W(TAG, "Compaction step failed: %d", ret);
+        compact.pending = false;
+    }
+    return compact.pending;
+}
+
+void hal_storage_get_stats(hal_storage_stats_t *s)
+{
+    *s = stats;
+}
@@ -0,0 +1,217 @@
+#!/usr/bin/env python
+
+# Simulates the STM32 storage flash to compare letting wldb compact
+# from the write that finds its log full against the idle compaction
+# done by hal_storage_compact_step(). It reports the worst pause seen
+# by a write while flying, the time taken by the bounded steps and the
+# wear of each policy.
+#
+# wldb isn't modelled exactly, since only its get/set/commit API is
+# visible from the HAL. The flash is a circular log of blocks that
+# always keeps a spare erased block. When moving to a new block would
+# use the spare, the oldest block is compacted by copying its live
+# records to the head and erasing it. The idle policy and its
+# threshold (COMPACT_MIN_FREE) match storage.c, keep them in sync.
+
+from __future__ import print_function
+from __future__ import division
+
+import argparse
+import random
+
+# STM32F1 medium density timings, from the datasheet
+PAGE_SIZE = 1024
+PAGE_ERASE_US = 20000
+HALF_WORD_PROGRAM_US = 52.5
+
+RECORD_HEADER_SIZE = 8
+COMPACT_FILLER_SIZE = 32
+COMPACT_KEY = (0, b'gc')
+
+
+def record_size(key, size):
+    total = RECORD_HEADER_SIZE + 1 + len(key[1]) + size
+    return (total + 3) & ~3
+
+
+def program_us(size):
+    return (size // 2) * HALF_WORD_PROGRAM_US
+
+
+class Flash(object):
+
+    def __init__(self, block_size, block_count):
+        self.block_size = block_size
+        self.block_count = block_count
+        self.capacity = block_size * block_count
+        self.used = [0] * block_count
+        self.records = [[] for _ in range(block_count)]
+        self.erases = [0] * block_count
+        self.head = 0
+        # Blocks in the log, oldest first
+        self.log = [0]
+        # Latest (block, index) for each key
+        self.live = {}
+        self.compactions = 0
+
+    def total_used(self):
+        return sum(self.used)
+
+    def erase_us(self):
+        return (self.block_size // PAGE_SIZE) * PAGE_ERASE_US
+
+    def append(self, key, size):
+        # Returns the time spent, including any compaction it triggered
+        elapsed = 0
+        rs = record_size(key, size)
+        while self.used[self.head] + rs > self.block_size:
+            elapsed += self.next_block()
+        self.program(self.head, key, size)
+        return elapsed + program_us(rs)
+
+    def program(self, block, key, size):
+        self.records[block].append((key, size))
+        self.live[key] = (block, len(self.records[block]) - 1)
+        self.used[block] += record_size(key, size)
+
+    def next_block(self):
+        self.head = (self.head + 1) % self.block_count
+        self.log.append(self.head)
+        if len(self.log) < self.block_count:
+            return 0
+        # Only the spare block was left, compact the oldest one into it
+        oldest = self.log.pop(0)
+        elapsed = 0
+        for ii, (key, size) in enumerate(self.records[oldest]):
+            if self.live.get(key) == (oldest, ii):
+                self.program(self.head, key, size)
+                elapsed += program_us(record_size(key, size))
+        self.records[oldest] = []
+        self.used[oldest] = 0
+        self.erases[oldest] += 1
+        self.compactions += 1
+        return elapsed + self.erase_us()
+
+
+class IdleCompactor(object):
+    # Mirrors hal_storage_update_pending() and hal_storage_compact_step()
+
+    def __init__(self, flash, min_free):
+        self.flash = flash
+        self.min_free = min_free
+        self.pending = False
+        self.steps_left = 0
+        self.compacted_used = 0
+        self.steps = 0
+        self.max_step_us = 0
+        self.max_compaction_us = 0
+
+    def update_pending(self):
+        used = self.flash.total_used()
+        if self.pending:
+            return
+        # wldb keeps a block erased for its compactions
+        free = self.flash.capacity - used - self.flash.block_size
+        if free < self.min_free and used > self.compacted_used:
+            self.pending = True
+            self.steps_left = (self.flash.capacity - used) // COMPACT_FILLER_SIZE + 1
+
+    def compacted(self):
+        self.pending = False
+        self.compacted_used = self.flash.total_used()
+
+    def step(self):
+        if not self.pending:
+            return False
+        if self.steps_left == 0:
+            self.pending = False
+            return False
+        self.steps_left -= 1
+        before = self.flash.compactions
+        elapsed = self.flash.append(COMPACT_KEY, COMPACT_FILLER_SIZE)
+        self.steps += 1
+        if self.flash.compactions != before:
+            self.max_compaction_us = max(self.max_compaction_us, elapsed)
+            self.compacted()
+        else:
+            self.max_step_us = max(self.max_step_us, elapsed)
+        return self.pending
+
+
+def simulate(rnd, idle, min_free, args):
+    flash = Flash(args.block_size, args.block_count)
+    compactor = IdleCompactor(flash, min_free) if idle else None
+    keys = [(1 + rnd.randrange(2), bytes(bytearray([ii]))) for ii in range(args.keys)]
+    sizes = dict((k, rnd.choice((1, 2, 4, 4, 16, 32, 64))) for k in keys)
+    # Write every key once, like the first boot
+    for key in keys:
+        flash.append(key, sizes[key])
+    writes = len(keys)
+    max_flight_pause_us = 0
+    flight_pauses = 0
+    for _ in range(args.flights):
+        # Settings changed on the ground, then during the flight
+        for flying in (False, True):
+            for _ in range(rnd.randrange(args.writes_per_flight + 1)):
+                key = rnd.choice(keys)
+                before = flash.compactions
+                elapsed = flash.append(key, sizes[key])
+                writes += 1
+                if compactor:
+                    if flash.compactions != before:
+                        compactor.compacted()
+                    compactor.update_pending()
+                if flying and flash.compactions != before:
+                    flight_pauses += 1
+                    max_flight_pause_us = max(max_flight_pause_us, elapsed)
+            if compactor and not flying:
+                # Idle after landing and before taking off
+                while compactor.step():
+                    pass
+    return {
+        'writes': writes,
+        'compactions': flash.compactions,
+        'erases': sum(flash.erases),
+        'max_block_erases': max(flash.erases),
+        'flight_pauses': flight_pauses,
+        'max_flight_pause_us': max_flight_pause_us,
+        'steps': compactor.steps if compactor else 0,
+        'max_step_us': compactor.max_step_us if compactor else 0,
+        'max_compaction_us': compactor.max_compaction_us if compactor else 0,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--block-size', type=int, default=2048, help='wldb block size (CONFIG_BLOCK_SIZE)')
+    parser.add_argument('--block-count', type=int, default=4, help='Blocks in the storage region')
+    parser.add_argument('--keys', type=int, default=40, help='Distinct keys stored')
+    parser.add_argument('--flights', type=int, default=200, help='Flights per trial')
+    parser.add_argument('--writes-per-flight', type=int, default=6, help='Maximum writes on the ground and in flight')
+    parser.add_argument('--min-free', default='256,512,1024', help='Idle compaction thresholds to simulate, in bytes')
+    parser.add_argument('--trials', type=int, default=20)
+    parser.add_argument('--seed', type=int, default=0)
+    args = parser.parse_args()
+
+    rnd = random.Random(args.seed)
+    policies = [('on write', False, 0)]
+    policies.extend(('idle %s' % v, True, int(v)) for v in args.min_free.split(','))
+    print('%-10s %9s %13s %15s %13s %11s %14s %10s' % ('policy', 'erases/1k', 'max blk erase',
+                                                       'flight pauses', 'max pause ms', 'steps/1k',
+                                                       'max step us', 'idle gc ms'))
+    for name, idle, min_free in policies:
+        results = [simulate(rnd, idle, min_free, args) for _ in range(args.trials)]
+        writes = sum(r['writes'] for r in results)
+        print('%-10s %9.1f %13d %15d %13.1f %11.1f %14.1f %10.1f' % (
+            name,
+            sum(r['erases'] for r in results) * 1000 / writes,
+            max(r['max_block_erases'] for r in results),
+            sum(r['flight_pauses'] for r in results),
+            max(r['max_flight_pause_us'] for r in results) / 1000,
+            sum(r['steps'] for r in results) * 1000 / writes,
+            max(r['max_step_us'] for r in results),
+            max(r['max_compaction_us'] for r in results) / 1000))
+
+
+if __name__ == '__main__':
+    main()
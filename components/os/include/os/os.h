@@ -2,6 +2,7 @@
 
 #if defined(USE_FREERTOS_SOURCE)
 #include <FreeRTOS.h>
+#include <queue.h>
 #include <task.h>
 // IRAM_ATTR is only defined for ESP32
 #define IRAM_ATTR
@@ -12,6 +13,7 @@
 #define xTaskCreatePinnedToCore(c, n, ss, p, pr, h, cid) xTaskCreate(c, n, ss, p, pr, h)
 #else
 #include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
 #include <freertos/task.h>
 // FreeRTOS 8 in ESP32 accepts no argument on portYIELD_FROM_ISR(),
 // so we wrap it in an if
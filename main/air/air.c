@@ -3,6 +3,8 @@
 
 #include <hal/rand.h>
 
+#include "target.h"
+
 #include "config/config.h"
 
 #include "platform/system.h"
@@ -131,6 +133,10 @@ void air_bind_packet_prepare(air_bind_packet_t *packet)
     {
         packet->info.capabilities |= AIR_CAP_BATTERY;
     }
+#if defined(USE_RADIO_SX127X)
+    packet->info.capabilities |= AIR_CAP_VARIABLE_LENGTH_FRAMES;
+#endif
+    packet->info.capabilities |= AIR_CAP_ORTHOGONAL_HOPPING;
     // No antenna nor true diversity supported yet
     packet->info.channels = RC_CHANNELS_NUM;
     memcpy(packet->prefix, RAVEN_EXPLICIT_PKT_MARKER, RAVEN_EXPLICIT_PKT_MARKER_LEN);
@@ -159,6 +165,23 @@ void air_bind_packet_get_pairing(const air_bind_packet_t *packet, air_pairing_t
     pairing->key = packet->key;
 }
 
+void air_bind_hello_packet_prepare(air_bind_hello_packet_t *packet)
+{
+    packet->version = AIR_PROTOCOL_VERSION;
+    memcpy(packet->prefix, RAVEN_EXPLICIT_PKT_MARKER, RAVEN_EXPLICIT_PKT_MARKER_LEN);
+    packet->crc = crc8_dvb_s2_bytes(&packet->version, sizeof(*packet) - offsetof(air_bind_hello_packet_t, version) - 1);
+}
+
+bool air_bind_hello_packet_validate(air_bind_hello_packet_t *packet)
+{
+    if (memcmp(packet->prefix, RAVEN_EXPLICIT_PKT_MARKER, RAVEN_EXPLICIT_PKT_MARKER_LEN) != 0)
+    {
+        return false;
+    }
+    uint8_t crc = crc8_dvb_s2_bytes(&packet->version, sizeof(*packet) - offsetof(air_bind_hello_packet_t, version) - 1);
+    return crc == packet->crc;
+}
+
 static uint8_t air_packet_crc(const void *packet, size_t size, air_key_t key)
 {
     uint8_t crc = crc8_dvb_s2_bytes(&key, sizeof(key));
@@ -185,7 +208,61 @@ bool air_rx_packet_validate(air_rx_packet_t *packet, air_key_t key)
     return packet->crc == air_packet_crc(packet, sizeof(*packet), key);
 }
 
-uint8_t air_sync_word(air_key_t key)
+static uint8_t air_frame_ext_crc(const air_frame_ext_t *ext, size_t size, uint8_t packet_crc, air_key_t key)
+{
+    uint8_t crc = crc8_dvb_s2_bytes(&key, sizeof(key));
+    crc = crc8_dvb_s2(crc, packet_crc);
+    return crc8_dvb_s2_bytes_from(crc, ext->data, size);
+}
+
+void air_frame_ext_prepare(air_frame_ext_t *ext, size_t size, uint8_t packet_crc, air_key_t key)
 {
-    return crc8_dvb_s2_bytes(&key, sizeof(key));
+    ASSERT(size <= AIR_MAX_FRAME_EXT_SIZE);
+    ext->data[size] = air_frame_ext_crc(ext, size, packet_crc, key);
+}
+
+bool air_frame_ext_validate(const air_frame_ext_t *ext, size_t size, uint8_t packet_crc, air_key_t key)
+{
+    return size <= AIR_MAX_FRAME_EXT_SIZE && ext->data[size] == air_frame_ext_crc(ext, size, packet_crc, key);
+}
+
+uint32_t air_key_derive(air_key_t key, uint32_t salt)
+{
+    // Finalizer from MurmurHash3, every input bit affects every output bit
+    uint32_t h = key ^ salt;
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+static bool air_sync_word_is_valid(uint8_t sw)
+{
+    // 0 doesn't work with LoRa, 0x34 is reserved for LoRaWAN and
+    // 0x12 is the default, so it's used by most other LoRa devices.
+    return sw != 0 && sw != 0x34 && sw != 0x12;
+}
+
+uint8_t air_sync_word(air_key_t key, bool orthogonal)
+{
+    if (!orthogonal)
+    {
+        // Note that this is the same value used as the CRC seed for the
+        // packets, so packets from a foreign link with the same sync word
+        // will also pass the CRC check.
+        return crc8_dvb_s2_bytes(&key, sizeof(key));
+    }
+    for (uint32_t salt = AIR_KEY_SALT_SYNC_WORD;; salt++)
+    {
+        uint32_t h = air_key_derive(key, salt);
+        for (int ii = 0; ii < 4; ii++, h >>= 8)
+        {
+            if (air_sync_word_is_valid(h & 0xff))
+            {
+                return h & 0xff;
+            }
+        }
+    }
 }
\ No newline at end of file
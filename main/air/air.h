@@ -10,6 +10,7 @@
 #define AIR_MAX_PACKET_SIZE 64
 #define AIR_BIND_PACKET_INTERVAL_MS 500
 #define AIR_BIND_PACKET_EXPIRATION_MS 2000
+#define AIR_BIND_HELLO_INTERVAL_MS 40
 #define AIR_PROTOCOL_VERSION 1
 #define AIR_MAX_NAME_LENGTH 32
 #define AIR_ADDR_LENGTH 6
@@ -36,6 +37,10 @@ typedef enum
     AIR_CAP_FREQUENCY_868MHZ = 1 << 5,
     AIR_CAP_FREQUENCY_915MHZ = 1 << 6,
 
+    // Protocol
+    AIR_CAP_VARIABLE_LENGTH_FRAMES = 1 << 8, // Supports variable length frames in LoRa modes
+    AIR_CAP_ORTHOGONAL_HOPPING = 1 << 9,     // Supports orthogonal hop sequences and independent sync words
+
     AIR_CAP_P2P_2_4GHZ = 1 << 15,      // 2.4ghz unrestricted
     AIR_CAP_P2P_2_4GHZ_WIFI = 1 << 16, // 2.4ghz but restricted to valid raw WiFi packets
     AIR_CAP_P2P_FLARM = 1 << 17,       // flarm support
@@ -83,6 +88,20 @@ typedef struct air_bind_packet_s
 
 _Static_assert(AIR_BIND_PACKET_SIZE == AIR_MAX_PACKET_SIZE, "bind_packet_t incorrect size");
 
+// Compact packet exchanged before the full air_bind_packet_t. The TX sends
+// them in all its bands and the RX answers with another hello, then both
+// continue with full bind packets in the TX band.
+typedef struct air_bind_hello_packet_s
+{
+    char prefix[3];
+    uint8_t version; // Highest supported protocol version
+    air_addr_t addr; // Node address
+    air_key_t key;   // Pairing key
+    uint8_t role;    // air_role_e
+    uint8_t band;    // air_band_e used by the TX for the rest of the bind
+    uint8_t crc;     // DVB S2 CRC
+} PACKED air_bind_hello_packet_t;
+
 typedef struct air_pairing_s
 {
     air_addr_t addr;
@@ -128,6 +147,34 @@ typedef struct air_rx_packet_s
 
 _Static_assert(sizeof(air_rx_packet_t) == 5, "invalid air_rx_packet_t size");
 
+// Variable length frames append up to AIR_MAX_FRAME_EXT_SIZE bytes of stream
+// data after a regular packet, followed by a CRC seeded with the packet one.
+// They're only used when both ends support AIR_CAP_VARIABLE_LENGTH_FRAMES, since
+// the radio needs to send the frame length over the air.
+#define AIR_MAX_FRAME_EXT_SIZE 48
+#define AIR_FRAME_EXT_OVERHEAD 1 // CRC
+
+typedef struct air_frame_ext_s
+{
+    uint8_t data[AIR_MAX_FRAME_EXT_SIZE + AIR_FRAME_EXT_OVERHEAD]; // Stream data, then CRC
+} PACKED air_frame_ext_t;
+
+typedef struct air_tx_ext_packet_s
+{
+    air_tx_packet_t pkt;
+    air_frame_ext_t ext;
+} PACKED air_tx_ext_packet_t;
+
+_Static_assert(sizeof(air_tx_ext_packet_t) <= AIR_MAX_PACKET_SIZE, "air_tx_ext_packet_t too big");
+
+typedef struct air_rx_ext_packet_s
+{
+    air_rx_packet_t pkt;
+    air_frame_ext_t ext;
+} PACKED air_rx_ext_packet_t;
+
+_Static_assert(sizeof(air_rx_ext_packet_t) <= AIR_MAX_PACKET_SIZE, "air_rx_ext_packet_t too big");
+
 void air_addr_format(const air_addr_t *addr, char *buf, size_t bufsize);
 bool air_addr_equals(const air_addr_t *addr1, const air_addr_t *addr2);
 // Returns true iff addr is not all zeros
@@ -141,6 +188,8 @@ void air_bind_packet_prepare(air_bind_packet_t *packet);
 bool air_bind_packet_validate(air_bind_packet_t *packet);
 void air_bind_packet_cpy(air_bind_packet_t *dst, const air_bind_packet_t *src);
 void air_bind_packet_get_pairing(const air_bind_packet_t *packet, air_pairing_t *pairing);
+void air_bind_hello_packet_prepare(air_bind_hello_packet_t *packet);
+bool air_bind_hello_packet_validate(air_bind_hello_packet_t *packet);
 
 void air_bind_req(uint64_t uuid, const char *name, uint8_t *buf, size_t *bufsize);
 void air_bind_accept(uint64_t uuid, const char *name, uint8_t *buf, size_t *bufsize);
@@ -151,5 +200,17 @@ void air_tx_packet_prepare(air_tx_packet_t *packet, air_key_t key);
 bool air_tx_packet_validate(air_tx_packet_t *packet, air_key_t key);
 void air_rx_packet_prepare(air_rx_packet_t *packet, air_key_t key);
 bool air_rx_packet_validate(air_rx_packet_t *packet, air_key_t key);
-
-uint8_t air_sync_word(air_key_t key);
+// size is the number of data bytes in the extension, without the CRC
+void air_frame_ext_prepare(air_frame_ext_t *ext, size_t size, uint8_t packet_crc, air_key_t key);
+bool air_frame_ext_validate(const air_frame_ext_t *ext, size_t size, uint8_t packet_crc, air_key_t key);
+
+#define AIR_KEY_SALT_SYNC_WORD 0x53594e43 // "SYNC"
+#define AIR_KEY_SALT_HOPPING 0x484f5053   // "HOPS"
+
+// Derives a well mixed 32 bit value from the key. Use a different
+// salt for each parameter, so they're independent from each other.
+uint32_t air_key_derive(air_key_t key, uint32_t salt);
+// If orthogonal is true, the sync word is independent from the CRC
+// seed used by the packets and never uses the sync words reserved
+// for LoRaWAN nor the default one. See AIR_CAP_ORTHOGONAL_HOPPING.
+uint8_t air_sync_word(air_key_t key, bool orthogonal);
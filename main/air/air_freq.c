@@ -4,27 +4,62 @@
 
 #include "util/macros.h"
 
-#define FREQ_HOPPING_STEP (1e6f / 8) // 0.125mhz
-#define MAX_OFFSET (23 * 2)          // in 0.125mhz steps, so 64/8 = 8Mhz up/down
+_Static_assert(AIR_FREQ_ORTHOGONAL_CHANNEL_COUNT > AIR_NUM_HOPPING_FREQS, "not enough orthogonal channels");
+_Static_assert((AIR_FREQ_ORTHOGONAL_CHANNEL_COUNT / 2) * AIR_FREQ_ORTHOGONAL_CHANNEL_STEPS <= AIR_FREQ_MAX_OFFSET, "orthogonal channels out of range");
 
 static const char *TAG = "Air.Freq";
 
-void air_freq_table_init(air_freq_table_t *tbl, air_key_t key, unsigned long base_freq)
+static int air_freq_legacy_offset(uint32_t *lfsr)
 {
-    LOG_D(TAG, "Calculating freq table with key %lu, base %lu", (unsigned long)key, base_freq);
+    uint32_t b = ((*lfsr >> 0) ^ (*lfsr >> 2) ^ (*lfsr >> 3) ^ (*lfsr >> 5)) & 1;
+    *lfsr = (*lfsr >> 1) | (b << 15);
+    return (int64_t)*lfsr % (AIR_FREQ_MAX_OFFSET * 2) - AIR_FREQ_MAX_OFFSET;
+}
+
+// Hop ii uses channel (slope * ii + intercept) mod AIR_FREQ_ORTHOGONAL_CHANNEL_COUNT.
+// Since the channel count is prime and bigger than AIR_NUM_HOPPING_FREQS,
+// the channels in a sequence never repeat. Two sequences with different
+// slopes use the same channel at most once between two wraps of the
+// sequences, so at most twice per cycle of AIR_NUM_HOPPING_FREQS hops
+// when the wrap of one falls in the middle of the other's cycle. Keys
+// with the same slope (1 in AIR_FREQ_ORTHOGONAL_CHANNEL_COUNT - 1 pairs)
+// don't get any guarantee: depending on how they're aligned they either
+// never collide or collide on every hop until the next wrap. See
+// air_freq_sim.py for the numbers.
+void air_freq_orthogonal_channels(air_key_t key, uint8_t channels[AIR_NUM_HOPPING_FREQS])
+{
+    uint32_t h = air_key_derive(key, AIR_KEY_SALT_HOPPING);
+    uint32_t slope = 1 + h % (AIR_FREQ_ORTHOGONAL_CHANNEL_COUNT - 1);
+    uint32_t intercept = (h / (AIR_FREQ_ORTHOGONAL_CHANNEL_COUNT - 1)) % AIR_FREQ_ORTHOGONAL_CHANNEL_COUNT;
+    for (unsigned ii = 0; ii < AIR_NUM_HOPPING_FREQS; ii++)
+    {
+        channels[ii] = (slope * ii + intercept) % AIR_FREQ_ORTHOGONAL_CHANNEL_COUNT;
+    }
+}
+
+int air_freq_orthogonal_channel_offset(unsigned channel)
+{
+    return ((int)channel - AIR_FREQ_ORTHOGONAL_CHANNEL_COUNT / 2) * AIR_FREQ_ORTHOGONAL_CHANNEL_STEPS;
+}
+
+void air_freq_table_init(air_freq_table_t *tbl, air_key_t key, unsigned long base_freq, bool orthogonal)
+{
+    LOG_D(TAG, "Calculating %s freq table with key %lu, base %lu",
+          orthogonal ? "orthogonal" : "legacy", (unsigned long)key, base_freq);
     uint32_t lfsr = key;
-    uint32_t b;
+    uint8_t channels[AIR_NUM_HOPPING_FREQS];
+    air_freq_orthogonal_channels(key, channels);
     for (unsigned ii = 0; ii < ARRAY_COUNT(tbl->freqs); ii++)
     {
-        b = ((lfsr >> 0) ^ (lfsr >> 2) ^ (lfsr >> 3) ^ (lfsr >> 5)) & 1;
-        lfsr = (lfsr >> 1) | (b << 15);
+        int offset = orthogonal ? air_freq_orthogonal_channel_offset(channels[ii]) : air_freq_legacy_offset(&lfsr);
 #if defined(CONFIG_RAVEN_DISABLE_FREQ_HOPPING)
+        UNUSED(offset);
         tbl->freqs[ii] = base_freq;
 #else
-        tbl->freqs[ii] = base_freq + (((int64_t)lfsr % (MAX_OFFSET * 2) - MAX_OFFSET)) * FREQ_HOPPING_STEP;
+        tbl->freqs[ii] = base_freq + offset * (float)AIR_FREQ_HOPPING_STEP;
 #endif
         LOG_D(TAG, "Freq %d = %lu", ii, tbl->freqs[ii]);
         tbl->abs_errors[ii] = 0;
         tbl->last_errors[ii] = 0;
     }
-}
\ No newline at end of file
+}
@@ -1,9 +1,19 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "air/air.h"
 
+#define AIR_FREQ_HOPPING_STEP 125000 // 0.125mhz
+#define AIR_FREQ_MAX_OFFSET (23 * 2) // in 0.125mhz steps, so 64/8 = 8Mhz up/down
+
+// Orthogonal hopping uses a grid of non overlapping 500khz channels
+// spanning the same range as the legacy sequences. The number of
+// channels must be prime and bigger than AIR_NUM_HOPPING_FREQS.
+#define AIR_FREQ_ORTHOGONAL_CHANNEL_COUNT 23
+#define AIR_FREQ_ORTHOGONAL_CHANNEL_STEPS 4 // in AIR_FREQ_HOPPING_STEP units
+
 typedef struct air_freq_table_s
 {
     unsigned long freqs[AIR_NUM_HOPPING_FREQS];
@@ -11,4 +21,11 @@ typedef struct air_freq_table_s
     int last_errors[AIR_NUM_HOPPING_FREQS];
 } air_freq_table_t;
 
-void air_freq_table_init(air_freq_table_t *tbl, air_key_t key, unsigned long base_freq);
+// Use orthogonal = true only when both ends support AIR_CAP_ORTHOGONAL_HOPPING,
+// since the resulting table is not compatible with the legacy one.
+void air_freq_table_init(air_freq_table_t *tbl, air_key_t key, unsigned long base_freq, bool orthogonal);
+// Stores the orthogonal channel used by each hop with the given key,
+// from 0 to AIR_FREQ_ORTHOGONAL_CHANNEL_COUNT - 1.
+void air_freq_orthogonal_channels(air_key_t key, uint8_t channels[AIR_NUM_HOPPING_FREQS]);
+// Offset of the given orthogonal channel, in AIR_FREQ_HOPPING_STEP units
+int air_freq_orthogonal_channel_offset(unsigned channel);
@@ -0,0 +1,223 @@
+#!/usr/bin/env python
+
+# Simulates N independent links sharing a band and reports the per-link
+# packet loss caused by collisions between them, for both the legacy
+# and the orthogonal (AIR_CAP_ORTHOGONAL_HOPPING) hop sequences. It also
+# counts the foreign packets that would be demodulated because they use
+# the same sync word and how many of those would pass the CRC check.
+# For the orthogonal sequences, it reports the links sharing their slope
+# with another link, which get no collision guarantee, and the worst case
+# number of collisions per cycle between two sequences.
+#
+# The hop tables and sync words are computed with the same algorithms
+# used by air_freq.c and air.c, keep them in sync.
+
+from __future__ import print_function
+from __future__ import division
+
+import argparse
+import random
+import struct
+
+AIR_NUM_HOPPING_FREQS = 16
+FREQ_HOPPING_STEP = 125000
+MAX_OFFSET = 23 * 2
+ORTHOGONAL_CHANNEL_COUNT = 23
+ORTHOGONAL_CHANNEL_STEPS = 4
+AIR_KEY_SALT_SYNC_WORD = 0x53594e43
+AIR_KEY_SALT_HOPPING = 0x484f5053
+
+MASK32 = 0xffffffff
+
+def crc8_dvb_s2(crc, data):
+    crc ^= data
+    for _ in range(8):
+        if crc & 0x80:
+            crc = ((crc << 1) ^ 0xD5) & 0xff
+        else:
+            crc = (crc << 1) & 0xff
+    return crc
+
+def crc8_dvb_s2_key(key):
+    crc = 0
+    for b in bytearray(struct.pack('<I', key)):
+        crc = crc8_dvb_s2(crc, b)
+    return crc
+
+def air_key_derive(key, salt):
+    h = (key ^ salt) & MASK32
+    h ^= h >> 16
+    h = (h * 0x85ebca6b) & MASK32
+    h ^= h >> 13
+    h = (h * 0xc2b2ae35) & MASK32
+    h ^= h >> 16
+    return h
+
+def air_sync_word(key, orthogonal):
+    if not orthogonal:
+        return crc8_dvb_s2_key(key)
+    salt = AIR_KEY_SALT_SYNC_WORD
+    while True:
+        h = air_key_derive(key, salt)
+        for _ in range(4):
+            sw = h & 0xff
+            if sw not in (0, 0x34, 0x12):
+                return sw
+            h >>= 8
+        salt = (salt + 1) & MASK32
+
+def air_freq_slope_intercept(key):
+    h = air_key_derive(key, AIR_KEY_SALT_HOPPING)
+    slope = 1 + h % (ORTHOGONAL_CHANNEL_COUNT - 1)
+    intercept = (h // (ORTHOGONAL_CHANNEL_COUNT - 1)) % ORTHOGONAL_CHANNEL_COUNT
+    return slope, intercept
+
+def air_freq_offsets(key, orthogonal):
+    offsets = []
+    lfsr = key
+    slope, intercept = air_freq_slope_intercept(key)
+    for ii in range(AIR_NUM_HOPPING_FREQS):
+        if orthogonal:
+            channel = (slope * ii + intercept) % ORTHOGONAL_CHANNEL_COUNT
+            offsets.append((channel - ORTHOGONAL_CHANNEL_COUNT // 2) * ORTHOGONAL_CHANNEL_STEPS)
+        else:
+            b = ((lfsr >> 0) ^ (lfsr >> 2) ^ (lfsr >> 3) ^ (lfsr >> 5)) & 1
+            lfsr = ((lfsr >> 1) | (b << 15)) & MASK32
+            offsets.append(lfsr % (MAX_OFFSET * 2) - MAX_OFFSET)
+    return offsets
+
+class Link(object):
+    def __init__(self, rnd, orthogonal, args):
+        self.key = rnd.getrandbits(32)
+        self.sync_word = air_sync_word(self.key, orthogonal)
+        # Packets are always validated with crc8(key) as the seed
+        self.crc_seed = crc8_dvb_s2_key(self.key)
+        self.offsets = air_freq_offsets(self.key, orthogonal)
+        self.slope = air_freq_slope_intercept(self.key)[0] if orthogonal else None
+        ppm = rnd.uniform(-args.ppm, args.ppm)
+        self.cycle = args.cycle_ms * 1000 * (1 + ppm / 1e6)
+        self.phase = rnd.uniform(0, self.cycle)
+        self.first_seq = rnd.randrange(AIR_NUM_HOPPING_FREQS)
+
+    def packet(self, k):
+        start = self.phase + k * self.cycle
+        offset = self.offsets[(self.first_seq + k) % AIR_NUM_HOPPING_FREQS]
+        return start, offset
+
+def simulate(rnd, count, orthogonal, args):
+    links = [Link(rnd, orthogonal, args) for _ in range(count)]
+    airtime = args.airtime_ms * 1000
+    # Offsets closer than this (in FREQ_HOPPING_STEP units) overlap
+    overlap_steps = args.bw_khz * 1000 / FREQ_HOPPING_STEP
+    duration = args.duration * 1e6
+    results = []
+    for link in links:
+        cycles = int(duration // link.cycle)
+        lost = sync_matches = false_accepts = 0
+        for k in range(cycles):
+            start, offset = link.packet(k)
+            collided = False
+            for other in links:
+                if other is link:
+                    continue
+                # Packets from the other link that might fall in this cycle
+                first = int((start - other.phase) // other.cycle)
+                for ok in (first, first + 1):
+                    if ok < 0:
+                        continue
+                    ostart, ooffset = other.packet(ok)
+                    if abs(ooffset - offset) >= overlap_steps:
+                        continue
+                    if ostart < start + airtime and start < ostart + airtime:
+                        collided = True
+                    elif start + airtime <= ostart < start + link.cycle:
+                        # Received while listening for our next packet
+                        if other.sync_word == link.sync_word:
+                            sync_matches += 1
+                            if other.crc_seed == link.crc_seed:
+                                false_accepts += 1
+            if collided:
+                lost += 1
+        same_slope = link.slope is not None and any(
+            other is not link and other.slope == link.slope for other in links)
+        results.append(dict(loss=lost / max(cycles, 1), same_slope=same_slope,
+                            sync_matches=sync_matches, false_accepts=false_accepts))
+    return results
+
+def worst_case_collisions():
+    # Collisions per cycle between two orthogonal sequences for every
+    # slope pair, intercept difference and hop alignment. Returns the
+    # worst case for different and equal slopes, plus the fraction of
+    # alignments where sequences with equal slopes collide on at least
+    # half of the hops.
+    count = ORTHOGONAL_CHANNEL_COUNT
+    hops = AIR_NUM_HOPPING_FREQS
+    worst = {False: 0, True: 0}
+    equal_total = equal_bad = 0
+    for a in range(1, count):
+        for c in range(1, count):
+            same = a == c
+            for intercept in range(count):
+                for shift in range(hops):
+                    collisions = 0
+                    for ii in range(hops):
+                        jj = (ii + shift) % hops
+                        if (a * ii) % count == (c * jj + intercept) % count:
+                            collisions += 1
+                    worst[same] = max(worst[same], collisions)
+                    if same:
+                        equal_total += 1
+                        if collisions * 2 >= hops:
+                            equal_bad += 1
+    return worst[False], worst[True], equal_bad / equal_total
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--links', default='2,4,8,12,16',
+                        help='Comma separated list with the number of links to simulate')
+    parser.add_argument('--cycle-ms', type=float, default=20,
+                        help='Time between packets in each link (AIR_MODE_2 is 20ms)')
+    parser.add_argument('--airtime-ms', type=float, default=12,
+                        help='Time the channel is busy per cycle (uplink + downlink)')
+    parser.add_argument('--bw-khz', type=float, default=500,
+                        help='Signal bandwidth, closer frequencies collide')
+    parser.add_argument('--ppm', type=float, default=20,
+                        help='Maximum clock error of each link, in ppm')
+    parser.add_argument('--duration', type=float, default=30,
+                        help='Simulated time per trial, in seconds')
+    parser.add_argument('--trials', type=int, default=5,
+                        help='Number of random key sets per link count')
+    parser.add_argument('--seed', type=int, default=0)
+    args = parser.parse_args()
+    rnd = random.Random(args.seed)
+    minutes = args.duration * args.trials / 60
+    print('%5s %-10s %9s %9s %11s %15s %12s %12s' % ('links', 'hopping', 'avg loss', 'max loss',
+                                                     'same slope', 'same slope loss',
+                                                     'sync/min', 'accepts/min'))
+    for count in [int(v) for v in args.links.split(',')]:
+        for orthogonal in (False, True):
+            results = []
+            for _ in range(args.trials):
+                results.extend(simulate(rnd, count, orthogonal, args))
+            avg_loss = sum(r['loss'] for r in results) / len(results)
+            max_loss = max(r['loss'] for r in results)
+            # Links sharing their slope with another one, orthogonal only
+            same = [r for r in results if r['same_slope']]
+            same_ratio = len(same) / len(results)
+            same_loss = sum(r['loss'] for r in same) / len(same) if same else 0
+            # Per link averages
+            sync_matches = sum(r['sync_matches'] for r in results) / count / minutes
+            false_accepts = sum(r['false_accepts'] for r in results) / count / minutes
+            print('%5d %-10s %8.2f%% %8.2f%% %10.2f%% %14.2f%% %12.2f %12.2f' % (
+                count, 'orthogonal' if orthogonal else 'legacy',
+                avg_loss * 100, max_loss * 100, same_ratio * 100, same_loss * 100,
+                sync_matches, false_accepts))
+    different, equal, equal_bad = worst_case_collisions()
+    print()
+    print('Orthogonal worst case per %d hop cycle: %d collisions with different slopes, '
+          '%d with equal slopes' % (AIR_NUM_HOPPING_FREQS, different, equal))
+    print('Equal slopes (1 in %d key pairs) collide on at least half of the hops in '
+          '%.2f%% of the alignments' % (ORTHOGONAL_CHANNEL_COUNT - 1, equal_bad * 100))
+
+if __name__ == '__main__':
+    main()
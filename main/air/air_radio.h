@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "air/air_mode.h"
@@ -31,21 +32,53 @@ bool air_radio_should_switch_to_longer_mode(air_radio_t *radio, air_mode_e curre
 unsigned air_radio_confirmations_required_for_switching_modes(air_radio_t *radio, air_mode_e current, air_mode_e to);
 void air_radio_set_mode(air_radio_t *radio, air_mode_e mode);
 
+// Variable length frames (see AIR_CAP_VARIABLE_LENGTH_FRAMES) are applied
+// on the next call to air_radio_set_mode().
+void air_radio_set_variable_length_frames(air_radio_t *radio, bool enabled);
+// Maximum extension size (including AIR_FRAME_EXT_OVERHEAD) for a frame in
+// the current mode. Zero means the mode doesn't support variable length frames.
+size_t air_radio_frame_ext_max_size(air_radio_t *radio);
+// Additional air time required for extending a frame of base_size bytes
+// by ext_size bytes in the current mode.
+time_micros_t air_radio_frame_ext_time(air_radio_t *radio, size_t base_size, size_t ext_size);
+
 void air_radio_set_bind_mode(air_radio_t *radio);
+// Bind mode uses the explicit header, so hellos and full bind packets can
+// share it. Firmware older than the hellos only sends and receives full
+// bind packets with the implicit header, which this switches to.
+void air_radio_set_bind_legacy_format(air_radio_t *radio, bool legacy);
 void air_radio_set_powertest_mode(air_radio_t *radio);
+// Configures the radio for measuring the noise floor with the same
+// bandwidth used by the LoRa modes. Use air_radio_current_rssi()
+// after air_radio_start_rx() to read it.
+void air_radio_set_survey_mode(air_radio_t *radio);
 
 bool air_radio_is_tx_done(air_radio_t *radio);
 bool air_radio_is_rx_done(air_radio_t *radio);
 bool air_radio_is_rx_in_progress(air_radio_t *radio);
 
+// Channel activity detection. Returns false if the current mode doesn't
+// support it. Otherwise, air_radio_is_cad_done() returns true once the
+// detection is finished and the radio is left idle.
+bool air_radio_start_cad(air_radio_t *radio);
+bool air_radio_is_cad_done(air_radio_t *radio, bool *detected);
+// Maximum time between the end of a CAD and the start of the next one that
+// still detects any packet preamble with enough time left to receive it.
+time_micros_t air_radio_cad_interval(air_radio_t *radio);
+
 void air_radio_set_payload_size(air_radio_t *radio, size_t size);
 size_t air_radio_read(air_radio_t *radio, void *buf, size_t size);
 void air_radio_send(air_radio_t *radio, const void *buf, size_t size);
 
 int air_radio_rssi(air_radio_t *radio, int *snr, int *lq);
+int air_radio_current_rssi(air_radio_t *radio);
 
 typedef void (*air_radio_callback_t)(air_radio_t *radio, air_radio_callback_reason_e reason, void *data);
 void air_radio_set_callback(air_radio_t *radio, air_radio_callback_t callback, void *callback_data);
+// Blocks the calling task until the radio fires an interrupt or the
+// timeout expires. Interrupts fired since the previous call from the
+// same task make it return immediately. Only one task can wait.
+void air_radio_wait_for_irq(air_radio_t *radio, time_ticks_t timeout);
 
 void air_radio_sleep(air_radio_t *radio);
 void air_radio_shutdown(air_radio_t *radio);
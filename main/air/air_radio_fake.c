@@ -1,3 +1,5 @@
+#include <hal/rand.h>
+
 #include "target.h"
 
 #include "air/air.h"
@@ -56,14 +58,36 @@ void air_radio_set_mode(air_radio_t *radio, air_mode_e mode)
 {
 }
 
+void air_radio_set_variable_length_frames(air_radio_t *radio, bool enabled)
+{
+}
+
+size_t air_radio_frame_ext_max_size(air_radio_t *radio)
+{
+    return 0;
+}
+
+time_micros_t air_radio_frame_ext_time(air_radio_t *radio, size_t base_size, size_t ext_size)
+{
+    return 0;
+}
+
 void air_radio_set_bind_mode(air_radio_t *radio)
 {
 }
 
+void air_radio_set_bind_legacy_format(air_radio_t *radio, bool legacy)
+{
+}
+
 void air_radio_set_powertest_mode(air_radio_t *radio)
 {
 }
 
+void air_radio_set_survey_mode(air_radio_t *radio)
+{
+}
+
 bool air_radio_is_tx_done(air_radio_t *radio)
 {
     return true;
@@ -79,6 +103,21 @@ bool air_radio_is_rx_in_progress(air_radio_t *radio)
     return false;
 }
 
+bool air_radio_start_cad(air_radio_t *radio)
+{
+    return false;
+}
+
+bool air_radio_is_cad_done(air_radio_t *radio, bool *detected)
+{
+    return false;
+}
+
+time_micros_t air_radio_cad_interval(air_radio_t *radio)
+{
+    return 0;
+}
+
 void air_radio_set_payload_size(air_radio_t *radio, size_t size)
 {
 }
@@ -97,10 +136,22 @@ int air_radio_rssi(air_radio_t *radio, int *snr, int *lq)
     return 0;
 }
 
+int air_radio_current_rssi(air_radio_t *radio)
+{
+    // Noise floor with a few dB of jitter, so the survey
+    // has something to accumulate.
+    return -120 + (int)(hal_rand_u32() % 6);
+}
+
 void air_radio_set_callback(air_radio_t *radio, air_radio_callback_t callback, void *callback_data)
 {
 }
 
+void air_radio_wait_for_irq(air_radio_t *radio, time_ticks_t timeout)
+{
+    vTaskDelay(timeout);
+}
+
 void air_radio_sleep(air_radio_t *radio)
 {
 }
@@ -1,3 +1,5 @@
+#include <hal/log.h>
+
 #include "target.h"
 
 #include "air/air.h"
@@ -12,9 +14,19 @@
 
 #if defined(USE_RADIO_SX127X)
 
+#if defined(AIR_DEBUG_AIRTIME)
+static const char *TAG = "Air.Radio";
+static void air_radio_sx127x_debug_airtime(void);
+#endif
+
 void air_radio_init(air_radio_t *radio)
 {
     sx127x_init(&radio->sx127x);
+    radio->variable_length_frames = false;
+    radio->frame_ext_max_size = 0;
+#if defined(AIR_DEBUG_AIRTIME)
+    air_radio_sx127x_debug_airtime();
+#endif
 }
 
 void air_radio_set_tx_power(air_radio_t *radio, int dBm)
@@ -47,12 +59,90 @@ void air_radio_start_rx(air_radio_t *radio)
     sx127x_enable_continous_rx(&radio->sx127x);
 }
 
-static void air_radio_sx127x_set_lora_mode_parameters(air_radio_t *radio)
+static sx127x_lora_header_e air_radio_sx127x_lora_header(air_radio_t *radio)
+{
+    // Both ends know the size of each packet, so we use the implicit
+    // header and save its symbols on every packet. Variable length
+    // frames need the packet size to be sent over the air, so they
+    // require the explicit header.
+    return radio->variable_length_frames ? SX127X_LORA_HEADER_EXPLICIT : SX127X_LORA_HEADER_IMPLICIT;
+}
+
+static void air_radio_sx127x_lora_mode_airtime_params(air_mode_e mode, sx127x_lora_header_e header, sx127x_lora_airtime_params_t *params)
+{
+    // The LoRa CRC is disabled in all modes, since the key seeded CRC
+    // in the air packets already covers both the header and the payload.
+    params->signal_bw = SX127X_LORA_SIGNAL_BW_500;
+    params->header = header;
+    params->preamble_length = 6;
+    params->crc = false;
+    switch (mode)
+    {
+    case AIR_MODE_1:
+        UNREACHABLE();
+        break;
+    case AIR_MODE_2:
+        params->sf = 7;
+        params->coding_rate = SX127X_LORA_CODING_RATE_4_6;
+        break;
+    case AIR_MODE_3:
+        params->sf = 8;
+        params->coding_rate = SX127X_LORA_CODING_RATE_4_6;
+        break;
+    case AIR_MODE_4:
+        params->sf = 9;
+        params->coding_rate = SX127X_LORA_CODING_RATE_4_6;
+        break;
+    case AIR_MODE_5:
+        params->sf = 10;
+        params->coding_rate = SX127X_LORA_CODING_RATE_4_8;
+        break;
+    }
+}
+
+static void air_radio_sx127x_set_lora_mode_parameters(air_radio_t *radio, air_mode_e mode)
 {
+    sx127x_lora_airtime_params_t params;
+    air_radio_sx127x_lora_mode_airtime_params(mode, air_radio_sx127x_lora_header(radio), &params);
     sx127x_set_op_mode(&radio->sx127x, SX127X_OP_MODE_LORA);
-    sx127x_set_lora_signal_bw(&radio->sx127x, SX127X_LORA_SIGNAL_BW_500);
-    sx127x_set_lora_header_mode(&radio->sx127x, SX127X_LORA_HEADER_IMPLICIT);
-    sx127x_set_lora_crc(&radio->sx127x, false);
+    sx127x_set_lora_signal_bw(&radio->sx127x, params.signal_bw);
+    sx127x_set_lora_header_mode(&radio->sx127x, params.header);
+    sx127x_set_lora_crc(&radio->sx127x, params.crc);
+    sx127x_set_lora_preamble_length(&radio->sx127x, params.preamble_length);
+    sx127x_set_lora_spreading_factor(&radio->sx127x, params.sf);
+    sx127x_set_lora_coding_rate(&radio->sx127x, params.coding_rate);
+}
+
+static time_micros_t air_radio_sx127x_lora_cycle_airtime(air_mode_e mode, sx127x_lora_header_e header)
+{
+    // Time on air for an uplink packet followed by a downlink one
+    sx127x_lora_airtime_params_t params;
+    air_radio_sx127x_lora_mode_airtime_params(mode, header, &params);
+    return sx127x_lora_calculate_time_on_air(&params, sizeof(air_tx_packet_t)) +
+           sx127x_lora_calculate_time_on_air(&params, sizeof(air_rx_packet_t));
+}
+
+static void air_radio_sx127x_update_frame_ext_max_size(air_radio_t *radio, air_mode_e mode)
+{
+    radio->frame_ext_max_size = 0;
+    if (!radio->variable_length_frames || mode == AIR_MODE_1)
+    {
+        // FSK packets have a fixed size
+        return;
+    }
+    // Allow cycles with extended frames in both directions to take up to
+    // twice the regular cycle time.
+    time_micros_t budget = air_radio_cycle_time(radio, mode);
+    for (size_t ii = AIR_FRAME_EXT_OVERHEAD; ii <= AIR_MAX_FRAME_EXT_SIZE + AIR_FRAME_EXT_OVERHEAD; ii++)
+    {
+        time_micros_t t = air_radio_frame_ext_time(radio, sizeof(air_tx_packet_t), ii) +
+                          air_radio_frame_ext_time(radio, sizeof(air_rx_packet_t), ii);
+        if (t > budget)
+        {
+            break;
+        }
+        radio->frame_ext_max_size = ii;
+    }
 }
 
 bool air_radio_should_switch_to_faster_mode(air_radio_t *radio, air_mode_e current, air_mode_e faster, int telemetry_id, telemetry_t *t)
@@ -127,30 +217,33 @@ void air_radio_set_mode(air_radio_t *radio, air_mode_e mode)
         sx127x_set_fsk_preamble_length(&radio->sx127x, 5);
         break;
     case AIR_MODE_2:
-        air_radio_sx127x_set_lora_mode_parameters(radio);
-        sx127x_set_lora_preamble_length(&radio->sx127x, 6);
-        sx127x_set_lora_spreading_factor(&radio->sx127x, 7);
-        sx127x_set_lora_coding_rate(&radio->sx127x, SX127X_LORA_CODING_RATE_4_6);
-        break;
     case AIR_MODE_3:
-        air_radio_sx127x_set_lora_mode_parameters(radio);
-        sx127x_set_lora_preamble_length(&radio->sx127x, 6);
-        sx127x_set_lora_spreading_factor(&radio->sx127x, 8);
-        sx127x_set_lora_coding_rate(&radio->sx127x, SX127X_LORA_CODING_RATE_4_6);
-        break;
     case AIR_MODE_4:
-        air_radio_sx127x_set_lora_mode_parameters(radio);
-        sx127x_set_lora_preamble_length(&radio->sx127x, 6);
-        sx127x_set_lora_spreading_factor(&radio->sx127x, 9);
-        sx127x_set_lora_coding_rate(&radio->sx127x, SX127X_LORA_CODING_RATE_4_6);
-        break;
     case AIR_MODE_5:
-        air_radio_sx127x_set_lora_mode_parameters(radio);
-        sx127x_set_lora_preamble_length(&radio->sx127x, 6);
-        sx127x_set_lora_spreading_factor(&radio->sx127x, 10);
-        sx127x_set_lora_coding_rate(&radio->sx127x, SX127X_LORA_CODING_RATE_4_8);
+        air_radio_sx127x_set_lora_mode_parameters(radio, mode);
         break;
     }
+    air_radio_sx127x_update_frame_ext_max_size(radio, mode);
+}
+
+void air_radio_set_variable_length_frames(air_radio_t *radio, bool enabled)
+{
+    radio->variable_length_frames = enabled;
+}
+
+size_t air_radio_frame_ext_max_size(air_radio_t *radio)
+{
+    return radio->frame_ext_max_size;
+}
+
+time_micros_t air_radio_frame_ext_time(air_radio_t *radio, size_t base_size, size_t ext_size)
+{
+    if (radio->sx127x.state.op_mode != SX127X_OP_MODE_LORA || ext_size == 0)
+    {
+        return 0;
+    }
+    return sx127x_lora_time_on_air(&radio->sx127x, base_size + ext_size) -
+           sx127x_lora_time_on_air(&radio->sx127x, base_size);
 }
 
 void air_radio_set_bind_mode(air_radio_t *radio)
@@ -160,6 +253,14 @@ void air_radio_set_bind_mode(air_radio_t *radio)
     sx127x_set_tx_power(&radio->sx127x, 1);
     sx127x_set_sync_word(&radio->sx127x, SX127X_SYNC_WORD_DEFAULT);
     sx127x_set_payload_size(&radio->sx127x, sizeof(air_bind_packet_t));
+    air_radio_set_bind_legacy_format(radio, false);
+}
+
+void air_radio_set_bind_legacy_format(air_radio_t *radio, bool legacy)
+{
+    // Bind uses packets of different sizes (hello and full bind
+    // packets), so it requires the explicit header.
+    sx127x_set_lora_header_mode(&radio->sx127x, legacy ? SX127X_LORA_HEADER_IMPLICIT : SX127X_LORA_HEADER_EXPLICIT);
 }
 
 void air_radio_set_powertest_mode(air_radio_t *radio)
@@ -169,6 +270,11 @@ void air_radio_set_powertest_mode(air_radio_t *radio)
     sx127x_set_lora_signal_bw(&radio->sx127x, SX127X_LORA_SIGNAL_BW_250);
 }
 
+void air_radio_set_survey_mode(air_radio_t *radio)
+{
+    air_radio_set_mode(radio, AIR_MODE_2);
+}
+
 bool air_radio_is_tx_done(air_radio_t *radio)
 {
     return sx127x_is_tx_done(&radio->sx127x);
@@ -184,6 +290,29 @@ bool air_radio_is_rx_in_progress(air_radio_t *radio)
     return sx127x_is_rx_in_progress(&radio->sx127x);
 }
 
+bool air_radio_start_cad(air_radio_t *radio)
+{
+    return sx127x_start_cad(&radio->sx127x);
+}
+
+bool air_radio_is_cad_done(air_radio_t *radio, bool *detected)
+{
+    return sx127x_is_cad_done(&radio->sx127x, detected);
+}
+
+time_micros_t air_radio_cad_interval(air_radio_t *radio)
+{
+    if (radio->sx127x.state.op_mode != SX127X_OP_MODE_LORA)
+    {
+        return 0;
+    }
+    // The preamble takes preamble_length + 4.25 symbols and each CAD takes
+    // ~2. A preamble starting right after a CAD started must be detected by
+    // the next one with at least 4 symbols left to synchronize in RX mode.
+    int symbols = MAX(radio->sx127x.state.lora.preamble_length - 4, 1);
+    return symbols * sx127x_lora_symbol_time(&radio->sx127x);
+}
+
 void air_radio_set_payload_size(air_radio_t *radio, size_t size)
 {
     sx127x_set_payload_size(&radio->sx127x, size);
@@ -204,11 +333,21 @@ int air_radio_rssi(air_radio_t *radio, int *snr, int *lq)
     return sx127x_rssi(&radio->sx127x, snr, lq);
 }
 
+int air_radio_current_rssi(air_radio_t *radio)
+{
+    return sx127x_current_rssi(&radio->sx127x);
+}
+
 void air_radio_set_callback(air_radio_t *radio, air_radio_callback_t callback, void *callback_data)
 {
     sx127x_set_callback(&radio->sx127x, callback, callback_data);
 }
 
+void air_radio_wait_for_irq(air_radio_t *radio, time_ticks_t timeout)
+{
+    sx127x_wait_for_irq(&radio->sx127x, timeout);
+}
+
 void air_radio_sleep(air_radio_t *radio)
 {
     sx127x_sleep(&radio->sx127x);
@@ -219,25 +358,62 @@ void air_radio_shutdown(air_radio_t *radio)
     sx127x_shutdown(&radio->sx127x);
 }
 
-time_micros_t air_radio_cycle_time(air_radio_t *radio, air_mode_e mode)
+static time_micros_t air_radio_sx127x_explicit_header_time(air_mode_e mode)
 {
-    UNUSED(radio);
+    // Additional time required by sending both the uplink and the
+    // downlink packets with an explicit header, which adds 20 bits
+    // to each one.
+    if (mode == AIR_MODE_1)
+    {
+        return 0;
+    }
+    return air_radio_sx127x_lora_cycle_airtime(mode, SX127X_LORA_HEADER_EXPLICIT) -
+           air_radio_sx127x_lora_cycle_airtime(mode, SX127X_LORA_HEADER_IMPLICIT);
+}
+
+#if defined(AIR_DEBUG_AIRTIME)
+static void air_radio_sx127x_debug_airtime(void)
+{
+    for (air_mode_e mode = AIR_MODE_2; mode <= AIR_MODE_5; mode++)
+    {
+        sx127x_lora_airtime_params_t params;
+        air_radio_sx127x_lora_mode_airtime_params(mode, SX127X_LORA_HEADER_IMPLICIT, &params);
+        time_micros_t implicit = air_radio_sx127x_lora_cycle_airtime(mode, SX127X_LORA_HEADER_IMPLICIT);
+        time_micros_t explicit = air_radio_sx127x_lora_cycle_airtime(mode, SX127X_LORA_HEADER_EXPLICIT);
+        LOG_I(TAG, "Mode %d (SF%d): %u us airtime per cycle with implicit header, %u us with explicit header (%u us saved)",
+              mode, params.sf, (unsigned)implicit, (unsigned)explicit, (unsigned)(explicit - implicit));
+    }
+}
+#endif
 
+time_micros_t air_radio_cycle_time(air_radio_t *radio, air_mode_e mode)
+{
+    time_micros_t cycle_time = 0;
     switch (mode)
     {
     case AIR_MODE_1:
-        return MILLIS_TO_MICROS(6.666);
+        cycle_time = MILLIS_TO_MICROS(6.666);
+        break;
     case AIR_MODE_2:
-        return MILLIS_TO_MICROS(20);
+        cycle_time = MILLIS_TO_MICROS(20);
+        break;
     case AIR_MODE_3:
-        return MILLIS_TO_MICROS(33);
+        cycle_time = MILLIS_TO_MICROS(33);
+        break;
     case AIR_MODE_4:
-        return MILLIS_TO_MICROS(66);
+        cycle_time = MILLIS_TO_MICROS(66);
+        break;
     case AIR_MODE_5:
-        return MILLIS_TO_MICROS(115);
+        cycle_time = MILLIS_TO_MICROS(115);
+        break;
+    default:
+        UNREACHABLE();
     }
-    UNREACHABLE();
-    return 0;
+    if (radio->variable_length_frames)
+    {
+        cycle_time += air_radio_sx127x_explicit_header_time(mode);
+    }
+    return cycle_time;
 }
 
 time_micros_t air_radio_tx_failsafe_interval(air_radio_t *radio, air_mode_e mode)
@@ -1,8 +1,13 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
+
 #include "io/sx127x.h"
 
 typedef struct air_radio_s
 {
     sx127x_t sx127x;
+    bool variable_length_frames;
+    size_t frame_ext_max_size;
 } air_radio_t;
\ No newline at end of file
@@ -195,20 +195,14 @@ void air_stream_init(air_stream_t *s, air_stream_channel_f channel, air_stream_t
     s->user = user;
     s->input_in_sync = false;
     s->input_seq = 0;
+    s->input_bytes = 0;
+    s->output_bytes = 0;
     RING_BUFFER_INIT(&s->input_buf, uint8_t, AIR_STREAM_INPUT_BUFFER_CAPACITY);
     RING_BUFFER_INIT(&s->output_buf, uint8_t, AIR_STREAM_OUTPUT_BUFFER_CAPACITY);
 }
 
-void air_stream_feed_input(air_stream_t *s, unsigned seq, const void *data, size_t size, time_micros_t now)
+static void air_stream_feed_input_bytes(air_stream_t *s, const void *data, size_t size, time_micros_t now)
 {
-    if (++s->input_seq != seq)
-    {
-        LOG_D(TAG, "Resetting air stream sequency at %u", seq);
-        s->input_in_sync = false;
-        s->input_seq = seq;
-        ring_buffer_empty(&s->input_buf);
-    }
-
     const uint8_t *buf = data;
     for (size_t ii = 0; ii < size; ii++)
     {
@@ -227,6 +221,29 @@ void air_stream_feed_input(air_stream_t *s, unsigned seq, const void *data, size
             continue;
         }
         ring_buffer_push(&s->input_buf, &c);
+        s->input_bytes++;
+    }
+}
+
+void air_stream_feed_input(air_stream_t *s, unsigned seq, const void *data, size_t size, time_micros_t now)
+{
+    air_stream_feed_input_ext(s, seq, data, size, NULL, 0, now);
+}
+
+void air_stream_feed_input_ext(air_stream_t *s, unsigned seq, const void *data, size_t size, const void *ext_data, size_t ext_size, time_micros_t now)
+{
+    if (++s->input_seq != seq)
+    {
+        LOG_D(TAG, "Resetting air stream sequency at %u", seq);
+        s->input_in_sync = false;
+        s->input_seq = seq;
+        ring_buffer_empty(&s->input_buf);
+    }
+
+    air_stream_feed_input_bytes(s, data, size, now);
+    if (ext_size > 0)
+    {
+        air_stream_feed_input_bytes(s, ext_data, ext_size, now);
     }
 }
 
@@ -346,5 +363,13 @@ void air_stream_reset_output(air_stream_t *s)
 
 bool air_stream_pop_output(air_stream_t *s, uint8_t *c)
 {
-    return ring_buffer_pop(&s->output_buf, c);
+    if (ring_buffer_pop(&s->output_buf, c))
+    {
+        if (*c != AIR_DATA_START_STOP)
+        {
+            s->output_bytes++;
+        }
+        return true;
+    }
+    return false;
 }
\ No newline at end of file
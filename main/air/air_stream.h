@@ -34,6 +34,8 @@ typedef struct air_stream_s
     void *user;
     bool input_in_sync;                // Wether the input data stream is synchronized
     unsigned input_seq : AIR_SEQ_BITS; // Input sequence number
+    unsigned input_bytes;              // Payload bytes received, for throughput stats
+    unsigned output_bytes;             // Payload bytes sent, for throughput stats
     RING_BUFFER_DECLARE(input_buf, uint8_t, AIR_STREAM_INPUT_BUFFER_CAPACITY);
     RING_BUFFER_DECLARE(output_buf, uint8_t, AIR_STREAM_OUTPUT_BUFFER_CAPACITY);
 } air_stream_t;
@@ -43,6 +45,9 @@ void air_stream_init(air_stream_t *s, air_stream_channel_f channel, air_stream_t
 // Add data received from the air. Returns true iff the data didn't cause a reset
 // in the stream.
 void air_stream_feed_input(air_stream_t *s, unsigned seq, const void *data, size_t size, time_micros_t now);
+// Same as air_stream_feed_input(), but for variable length frames. ext_data
+// is fed right after data as part of the same sequence number.
+void air_stream_feed_input_ext(air_stream_t *s, unsigned seq, const void *data, size_t size, const void *ext_data, size_t ext_size, time_micros_t now);
 
 // Add data to be stream to the air
 size_t air_stream_feed_output_channel(air_stream_t *s, unsigned ch, unsigned val);
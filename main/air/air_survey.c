@@ -0,0 +1,215 @@
+#include <limits.h>
+
+#include <hal/log.h>
+
+#include "air/air_radio.h"
+
+#include "util/macros.h"
+
+#include "air_survey.h"
+
+// Time for the PLL to lock and the RSSI to settle after tuning
+#define AIR_SURVEY_STEP_SETTLE_US 300
+// Total time spent in each step, including the settle time
+#define AIR_SURVEY_STEP_DWELL_US 1500
+// After this many sweeps the average becomes a moving average,
+// so the survey keeps tracking changes in the noise.
+#define AIR_SURVEY_MAX_AVG_SWEEPS 16
+// Number of random keys to evaluate when generating a key
+#define AIR_SURVEY_KEY_CANDIDATES 256
+
+static const char *TAG = "Air.Survey";
+
+static struct
+{
+    air_radio_t *radio;
+    air_band_e band;
+    unsigned long base_freq;
+    unsigned sweeps;
+    time_micros_t sweep_started_at;
+    time_micros_t sweep_time;
+    struct
+    {
+        unsigned index;
+        time_micros_t started_at;
+        int32_t sum;
+        unsigned samples;
+        int peak;
+    } step;
+    air_survey_step_t steps[AIR_SURVEY_STEP_COUNT];
+} survey;
+
+static unsigned long air_survey_step_freq(unsigned step)
+{
+    return survey.base_freq + ((int)step - AIR_FREQ_MAX_OFFSET) * AIR_FREQ_HOPPING_STEP;
+}
+
+static void air_survey_tune(time_micros_t now)
+{
+    air_radio_set_frequency(survey.radio, air_survey_step_freq(survey.step.index), 0);
+    air_radio_start_rx(survey.radio);
+    survey.step.started_at = now;
+    survey.step.sum = 0;
+    survey.step.samples = 0;
+    survey.step.peak = INT_MIN;
+}
+
+static void air_survey_finish_step(void)
+{
+    air_survey_step_t *data = &survey.steps[survey.step.index];
+    int avg_x16 = (survey.step.sum * 16) / (int32_t)survey.step.samples;
+    if (survey.sweeps == 0)
+    {
+        data->avg_x16 = avg_x16;
+        data->peak = survey.step.peak;
+    }
+    else
+    {
+        int n = MIN(survey.sweeps + 1, AIR_SURVEY_MAX_AVG_SWEEPS);
+        data->avg_x16 += (avg_x16 - data->avg_x16) / n;
+        data->peak = MAX(data->peak, survey.step.peak);
+    }
+}
+
+void air_survey_start(air_radio_t *radio, air_band_e band)
+{
+    if (band != survey.band)
+    {
+        // Results from a different band are useless
+        survey.sweeps = 0;
+        survey.sweep_time = 0;
+    }
+    survey.radio = radio;
+    survey.band = band;
+    survey.base_freq = air_band_frequency(band);
+    LOG_I(TAG, "Starting survey at %lu Hz +- %lu Hz", survey.base_freq,
+          (unsigned long)AIR_FREQ_MAX_OFFSET * AIR_FREQ_HOPPING_STEP);
+    air_radio_sleep(radio);
+    air_radio_calibrate(radio, survey.base_freq);
+    air_radio_set_survey_mode(radio);
+    survey.step.index = 0;
+    survey.sweep_started_at = time_micros_now();
+    air_survey_tune(survey.sweep_started_at);
+}
+
+void air_survey_update(time_micros_t now)
+{
+    if (!survey.radio || now < survey.step.started_at + AIR_SURVEY_STEP_SETTLE_US)
+    {
+        return;
+    }
+    int rssi = air_radio_current_rssi(survey.radio);
+    survey.step.sum += rssi;
+    survey.step.samples++;
+    survey.step.peak = MAX(survey.step.peak, rssi);
+    if (now < survey.step.started_at + AIR_SURVEY_STEP_DWELL_US)
+    {
+        return;
+    }
+    air_survey_finish_step();
+    if (++survey.step.index == AIR_SURVEY_STEP_COUNT)
+    {
+        survey.sweeps++;
+        survey.sweep_time = now - survey.sweep_started_at;
+        LOG_I(TAG, "Sweep %u done in %ums (%u steps/s)", survey.sweeps,
+              (unsigned)(survey.sweep_time / 1000),
+              (unsigned)(AIR_SURVEY_STEP_COUNT * 1000000ull / survey.sweep_time));
+        survey.step.index = 0;
+        survey.sweep_started_at = now;
+    }
+    air_survey_tune(now);
+}
+
+void air_survey_stop(void)
+{
+    if (survey.radio)
+    {
+        air_radio_sleep(survey.radio);
+        survey.radio = NULL;
+        LOG_I(TAG, "Survey stopped after %u sweeps", survey.sweeps);
+    }
+}
+
+bool air_survey_is_running(void)
+{
+    return survey.radio != NULL;
+}
+
+unsigned air_survey_get_sweep_count(void)
+{
+    return survey.sweeps;
+}
+
+time_micros_t air_survey_get_sweep_time(void)
+{
+    return survey.sweep_time;
+}
+
+bool air_survey_get_step(unsigned step, unsigned long *freq, air_survey_step_t *data)
+{
+    if (step >= AIR_SURVEY_STEP_COUNT || survey.sweeps == 0)
+    {
+        return false;
+    }
+    if (freq)
+    {
+        *freq = air_survey_step_freq(step);
+    }
+    if (data)
+    {
+        *data = survey.steps[step];
+    }
+    return true;
+}
+
+// Returns the noise of an orthogonal channel in 1/16 dBm, as the worst
+// step it overlaps. Peaks are weighted in, since bursty interferers
+// cause packet loss even if the average noise is low.
+static int air_survey_channel_noise(unsigned channel)
+{
+    int center = AIR_FREQ_MAX_OFFSET + air_freq_orthogonal_channel_offset(channel);
+    int half = AIR_FREQ_ORTHOGONAL_CHANNEL_STEPS / 2;
+    int noise = INT_MIN;
+    for (int ii = MAX(center - half, 0); ii <= MIN(center + half, AIR_SURVEY_STEP_COUNT - 1); ii++)
+    {
+        const air_survey_step_t *step = &survey.steps[ii];
+        noise = MAX(noise, step->avg_x16 + (step->peak * 16 - step->avg_x16) / 4);
+    }
+    return noise;
+}
+
+bool air_survey_generate_key(air_band_e band, air_key_t *key)
+{
+    if (survey.sweeps == 0 || band != survey.band)
+    {
+        return false;
+    }
+    int noise[AIR_FREQ_ORTHOGONAL_CHANNEL_COUNT];
+    for (unsigned ii = 0; ii < ARRAY_COUNT(noise); ii++)
+    {
+        noise[ii] = air_survey_channel_noise(ii);
+    }
+    int32_t best_cost = INT32_MAX;
+    int32_t total_cost = 0;
+    uint8_t channels[AIR_NUM_HOPPING_FREQS];
+    for (int ii = 0; ii < AIR_SURVEY_KEY_CANDIDATES; ii++)
+    {
+        air_key_t candidate = air_key_generate();
+        air_freq_orthogonal_channels(candidate, channels);
+        int32_t cost = 0;
+        for (int jj = 0; jj < ARRAY_COUNT(channels); jj++)
+        {
+            cost += noise[channels[jj]];
+        }
+        total_cost += cost / AIR_SURVEY_KEY_CANDIDATES;
+        if (cost < best_cost)
+        {
+            best_cost = cost;
+            *key = candidate;
+        }
+    }
+    LOG_I(TAG, "Generated key using %u sweeps, avg noise %d dBm (random key: %d dBm)",
+          survey.sweeps, (int)(best_cost / (16 * AIR_NUM_HOPPING_FREQS)),
+          (int)(total_cost / (16 * AIR_NUM_HOPPING_FREQS)));
+    return true;
+}
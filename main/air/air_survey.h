@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "air/air.h"
+#include "air/air_band.h"
+#include "air/air_freq.h"
+
+#include "util/time.h"
+
+typedef struct air_radio_s air_radio_t;
+
+// The survey sweeps the whole hopping range in AIR_FREQ_HOPPING_STEP steps
+#define AIR_SURVEY_STEP_COUNT (AIR_FREQ_MAX_OFFSET * 2 + 1)
+
+typedef struct air_survey_step_s
+{
+    int16_t avg_x16; // Average noise in 1/16 dBm
+    int16_t peak;    // Peak noise in dBm
+} air_survey_step_t;
+
+// Spectrum survey: measures the noise floor across the hopping range of
+// the band. Results are kept until a survey is started in a different
+// band, so they can be used by air_survey_generate_key() when binding.
+void air_survey_start(air_radio_t *radio, air_band_e band);
+// Must be called as often as possible while the survey is running. It
+// never blocks, each call takes at most one RSSI sample.
+void air_survey_update(time_micros_t now);
+void air_survey_stop(void);
+bool air_survey_is_running(void);
+
+// Returns the number of completed sweeps, zero if there are no results
+unsigned air_survey_get_sweep_count(void);
+// Duration of the last complete sweep
+time_micros_t air_survey_get_sweep_time(void);
+// Returns false if step is out of range or there are no results
+bool air_survey_get_step(unsigned step, unsigned long *freq, air_survey_step_t *data);
+
+// If there are survey results for the given band, generates a new key
+// whose orthogonal hop sequence (see AIR_CAP_ORTHOGONAL_HOPPING) avoids
+// the noisiest channels and returns true. Since the hop sequence is
+// derived from the key, both ends use the clean channels without any
+// additional data in the pairing. Otherwise, returns false.
+bool air_survey_generate_key(air_band_e band, air_key_t *key);
@@ -0,0 +1,161 @@
+#!/usr/bin/env python
+
+# Simulates a TX driving N RXs with output_air_multi.c and reports, for
+# each RX, the achieved update rate, the number of times the hopping
+# lost sync (the RX started hopping in reverse) and failsafes, and the
+# fraction of packets that reached air_stream without resetting it.
+#
+# The RX model mirrors the deadline and hopping logic in input_air.c,
+# as well as the seq step detection in input_air_stream_seq(), keep
+# them in sync.
+
+from __future__ import print_function
+from __future__ import division
+
+import argparse
+import random
+
+AIR_SEQ_COUNT = 16
+MAX_LOST_PACKETS_JUMPING_FORWARD = AIR_SEQ_COUNT // 2
+CYCLE_TIME_WAIT_FACTOR = 0.10
+SEQ_STEP_WINDOW = 8
+
+# Cycle time and TX failsafe interval per mode, in microseconds
+MODES = {
+    1: (6666, 250000),
+    2: (20000, 300000),
+    3: (33000, 400000),
+    4: (66000, 500000),
+    5: (115000, 700000),
+}
+
+def gcd(a, b):
+    while b:
+        a, b = b, a % b
+    return a
+
+class RX(object):
+    def __init__(self, rnd, cycle, args):
+        ppm = rnd.uniform(-args.ppm, args.ppm)
+        self.cycle = cycle * (1 + ppm / 1e6)
+        self.tx_seq = 0
+        self.lost = 0
+        self.freq_index = 0
+        self.deadline = float('inf')
+        self.step = 1
+        self.step_gcd = 0
+        self.packets = 0
+        self.stream_seq = 0
+        self.stream_input_seq = 0
+        self.received = 0
+        self.stream_ok = 0
+        self.resyncs = 0
+        self.failsafes = 0
+        self.last_packet_at = None
+
+    def freq_at(self):
+        if self.lost > MAX_LOST_PACKETS_JUMPING_FORWARD:
+            decrease = (self.lost - MAX_LOST_PACKETS_JUMPING_FORWARD) // 4
+            return (self.tx_seq + MAX_LOST_PACKETS_JUMPING_FORWARD - decrease) % AIR_SEQ_COUNT
+        return (self.tx_seq + 1 + self.lost) % AIR_SEQ_COUNT
+
+    def advance(self, now):
+        while self.deadline < now:
+            self.lost += 1
+            if self.lost == MAX_LOST_PACKETS_JUMPING_FORWARD + 1:
+                self.resyncs += 1
+            expected = self.deadline + self.cycle
+            self.deadline = expected + self.cycle * CYCLE_TIME_WAIT_FACTOR
+            self.freq_index = self.freq_at()
+
+    def next_stream_seq(self, seq):
+        gap = (seq - self.tx_seq) % AIR_SEQ_COUNT
+        if gap != self.lost + 1:
+            self.stream_seq = (self.stream_seq + 2) % AIR_SEQ_COUNT
+            return self.stream_seq
+        self.step_gcd = gcd(self.step_gcd, gap)
+        self.packets += 1
+        if self.packets == SEQ_STEP_WINDOW:
+            self.step = self.step_gcd
+            self.step_gcd = 0
+            self.packets = 0
+        self.stream_seq = (self.stream_seq + (1 if gap == self.step else 2)) % AIR_SEQ_COUNT
+        return self.stream_seq
+
+    def receive(self, now, seq, fs_interval):
+        self.advance(now)
+        if self.freq_index != seq:
+            return
+        if self.last_packet_at is not None and now - self.last_packet_at > fs_interval:
+            self.failsafes += 1
+        self.last_packet_at = now
+        self.received += 1
+        stream_seq = self.next_stream_seq(seq)
+        # air_stream resets unless the seq is the next one
+        self.stream_input_seq = (self.stream_input_seq + 1) % AIR_SEQ_COUNT
+        if self.stream_input_seq == stream_seq:
+            self.stream_ok += 1
+        self.stream_input_seq = stream_seq
+        self.tx_seq = seq
+        self.lost = 0
+        self.deadline = now + self.cycle * (1 + CYCLE_TIME_WAIT_FACTOR)
+        self.freq_index = self.freq_at()
+
+def simulate(rnd, count, mode, args):
+    cycle, fs_interval = MODES[mode]
+    rxs = [RX(rnd, cycle, args) for _ in range(count)]
+    seqs = [0] * count
+    duration = args.duration * 1e6
+    slots = int(duration // cycle)
+    for slot in range(slots):
+        ii = slot % count
+        # Slots are scheduled from the ideal frame start, so jitter doesn't accumulate
+        now = slot * cycle + rnd.uniform(0, args.jitter_us)
+        if rnd.random() >= args.loss:
+            rxs[ii].receive(now, seqs[ii], fs_interval)
+        seqs[ii] = (seqs[ii] + count) % AIR_SEQ_COUNT
+    results = []
+    for rx in rxs:
+        rx.advance(duration)
+        results.append(dict(rate=rx.received / args.duration,
+                            resyncs=rx.resyncs, failsafes=rx.failsafes,
+                            stream=rx.stream_ok / max(rx.received, 1)))
+    return results
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--rxs', default='1,2,3,4',
+                        help='Comma separated list with the number of RXs to simulate')
+    parser.add_argument('--modes', default='1,2,3,4,5',
+                        help='Comma separated list with the air modes to simulate')
+    parser.add_argument('--loss', type=float, default=0.05,
+                        help='Probability of losing each packet')
+    parser.add_argument('--jitter-us', type=float, default=500,
+                        help='Maximum delay of each packet from its slot start')
+    parser.add_argument('--ppm', type=float, default=20,
+                        help='Maximum clock error of each RX, in ppm')
+    parser.add_argument('--duration', type=float, default=60,
+                        help='Simulated time per trial, in seconds')
+    parser.add_argument('--trials', type=int, default=3)
+    parser.add_argument('--seed', type=int, default=0)
+    args = parser.parse_args()
+    rnd = random.Random(args.seed)
+    minutes = args.duration / 60
+    print('%4s %3s %9s %9s %11s %9s %8s' % ('mode', 'rxs', 'expected', 'achieved',
+                                           'resyncs/min', 'fs/min', 'stream'))
+    for mode in [int(v) for v in args.modes.split(',')]:
+        for count in [int(v) for v in args.rxs.split(',')]:
+            results = []
+            for _ in range(args.trials):
+                results.extend(simulate(rnd, count, mode, args))
+            n = len(results)
+            expected = 1e6 / (MODES[mode][0] * count) * (1 - args.loss)
+            print('%4d %3d %7.1fHz %7.1fHz %11.2f %9.2f %7.2f%%' % (
+                mode, count, expected,
+                sum(r['rate'] for r in results) / n,
+                sum(r['resyncs'] for r in results) / n / minutes,
+                sum(r['failsafes'] for r in results) / n / minutes,
+                sum(r['stream'] for r in results) / n * 100))
+
+if __name__ == '__main__':
+    main()
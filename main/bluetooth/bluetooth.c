@@ -18,6 +18,8 @@
 #include "msp/msp.h"
 #include "msp/msp_serial.h"
 
+#include "platform/boot.h"
+
 #include "util/macros.h"
 #include "util/version.h"
 
@@ -369,6 +371,7 @@ static esp_err_t bluetooth_init(rc_t *rc)
 void task_bluetooh(void *arg)
 {
     rc_t *rc = arg;
+    boot_wait_for_deferred_init();
     ESP_ERROR_CHECK(bluetooth_init(rc));
 
     for (;;)
@@ -15,6 +15,10 @@
 #include <esp_gatt_common_api.h>
 #include <esp_gatts_api.h>
 
+#include "target.h"
+
+#include "platform/coex.h"
+
 #include "util/macros.h"
 
 #include "bluetooth_hal.h"
@@ -23,6 +27,8 @@ static const char *TAG = "Bluetooth.HAL";
 
 #define GATT_SERVER_CONN_INVALID 0xff
 #define GATT_SERVER_HANDLE_INVALID 0xffff
+// Air time at 1Mbps plus the link layer overhead for each packet
+#define GATT_SERVER_NOTIFY_TIME_US(size) (300 + (size)*8)
 
 #define GATTS_DEMO_CHAR_VAL_LEN_MAX 0x40
 
@@ -999,6 +1005,14 @@ esp_err_t gatt_server_notify_char(gatt_server_t *server, gatt_server_char_t *chr
     uint16_t subscribers[GATT_SERVER_MAX_CONNECTIONS];
     size_t count;
     gatt_server_get_subscribers(server, service, chr, subscribers, &count);
+#if defined(USE_COEX)
+    if (count > 0)
+    {
+        // The controller sends the notification at the next connection
+        // event, but the host stack and VHCI traffic happen right away.
+        coex_wait_for_quiet_window(GATT_SERVER_NOTIFY_TIME_US(size * count));
+    }
+#endif
     for (int ii = 0; ii < count; ii++)
     {
         esp_err_t ret = esp_ble_gatts_send_indicate(service->state.gatt_if, subscribers[ii], chr->state.handle, size, (uint8_t *)data, false);
@@ -351,6 +351,41 @@ bool config_get_paired_rx_at(air_pairing_t *pairing, int idx)
     return false;
 }
 
+int config_get_recent_paired_rxs(air_pairing_t *pairings, int size)
+{
+    int count = 0;
+#if defined(USE_TX_SUPPORT)
+    // Selection sort by seq, we only need the first few
+    uint8_t prev_seq = 0;
+    while (count < size)
+    {
+        int idx = -1;
+        for (int ii = 0; ii < ARRAY_COUNT(tx_config.paired_rxs); ii++)
+        {
+            config_paired_rx_t *rx = &tx_config.paired_rxs[ii];
+            if (!config_paired_rx_is_valid(rx) || (count > 0 && rx->seq >= prev_seq))
+            {
+                continue;
+            }
+            if (idx == -1 || rx->seq > tx_config.paired_rxs[idx].seq)
+            {
+                idx = ii;
+            }
+        }
+        if (idx < 0)
+        {
+            break;
+        }
+        air_pairing_cpy(&pairings[count++], &tx_config.paired_rxs[idx].pairing);
+        prev_seq = tx_config.paired_rxs[idx].seq;
+    }
+#else
+    UNUSED(pairings);
+    UNUSED(size);
+#endif
+    return count;
+}
+
 bool config_remove_paired_rx_at(int idx)
 {
 #if defined(USE_TX_SUPPORT)
@@ -158,6 +158,9 @@ rc_mode_e config_get_rc_mode(void);
 bool config_get_paired_rx(air_pairing_t *pairing, const air_addr_t *addr);
 void config_add_paired_rx(const air_pairing_t *pairing);
 bool config_get_paired_rx_at(air_pairing_t *pairing, int idx);
+// Copies up to size pairings, starting with the most recently used one.
+// Returns the number of pairings copied.
+int config_get_recent_paired_rxs(air_pairing_t *pairings, int size);
 bool config_remove_paired_rx_at(int idx);
 
 bool config_get_paired_tx(air_pairing_t *pairing);
@@ -13,6 +13,10 @@
 
 #include "msp/msp_serial.h"
 
+#if defined(USE_MULTI_RX)
+#include "output/output_air_multi.h"
+#endif
+
 #include "platform/system.h"
 
 #include "ui/screen.h"
@@ -363,6 +367,10 @@ static const char *tx_input_table[] = {
 #endif
 static const char *air_rf_power_table[] = {"Auto", "1mw", "10mw", "25mw", "50mw", "100mw"};
 _Static_assert(ARRAY_COUNT(air_rf_power_table) == AIR_RF_POWER_LAST - AIR_RF_POWER_FIRST + 1, "air_rf_power_table invalid");
+#if defined(USE_MULTI_RX)
+// Index + 1 is the number of RXs to drive
+static const char *tx_multi_rx_table[] = {"Off", "2 Receivers", "3 Receivers"};
+#endif
 // Keep in sync with config_air_mode_e
 static const char *config_air_modes_table[] = {
     "1-5 (9-150Hz)",
@@ -457,6 +465,9 @@ static const setting_t settings[] = {
     GPIO_USER_SETTING(SETTING_KEY_TX_TX_GPIO, "TX Pin", FOLDER_ID_TX, TX_DEFAULT_GPIO_IDX),
     GPIO_USER_SETTING(SETTING_KEY_TX_RX_GPIO, "RX Pin", FOLDER_ID_TX, RX_DEFAULT_GPIO_IDX),
 #endif
+#if defined(USE_MULTI_RX)
+    U8_MAP_SETTING(SETTING_KEY_TX_MULTI_RX, "Multi RX", 0, FOLDER_ID_TX, tx_multi_rx_table, 0),
+#endif
 #endif
 
 #if defined(USE_RX_SUPPORT)
@@ -563,10 +574,13 @@ static const setting_t settings[] = {
     FOLDER(SETTING_KEY_DIAGNOSTICS, "Diagnostics", FOLDER_ID_DIAGNOSTICS, FOLDER_ID_ROOT, NULL),
     CMD_SETTING(SETTING_KEY_DIAGNOSTICS_FREQUENCIES, "Frequencies", FOLDER_ID_DIAGNOSTICS, 0, 0),
     CMD_SETTING(SETTING_KEY_DIAGNOSTICS_DEBUG_INFO, "Debug Info", FOLDER_ID_DIAGNOSTICS, 0, 0),
+    BOOL_SETTING(SETTING_KEY_DIAGNOSTICS_SPECTRUM_SURVEY, "Spectrum Survey", SETTING_FLAG_EPHEMERAL, FOLDER_ID_DIAGNOSTICS, false),
 
 #if defined(USE_DEVELOPER_MENU)
     FOLDER(SETTING_KEY_DEVELOPER, "Developer Options", FOLDER_ID_DEVELOPER, FOLDER_ID_DIAGNOSTICS, NULL),
     BOOL_SETTING(SETTING_KEY_DEVELOPER_REMOTE_DEBUGGING, "Remote Debugging", 0, FOLDER_ID_DEVELOPER, false),
+    BOOL_SETTING(SETTING_KEY_DEVELOPER_RADIO_COEX, "Radio Coexistence", 0, FOLDER_ID_DEVELOPER, true),
+    BOOL_SETTING(SETTING_KEY_DEVELOPER_SERIAL_RMP, "Serial RMP", 0, FOLDER_ID_DEVELOPER, false),
     CMD_SETTING(SETTING_KEY_DEVELOPER_REBOOT, "Reboot", FOLDER_ID_DEVELOPER, 0, 0),
 #endif
 };
@@ -583,7 +597,17 @@ typedef struct settings_listener_s
     void *user_data;
 } settings_listener_t;
 
-static settings_listener_t listeners[4];
+// Listeners registered by main, rc, ui and settings_rmp
+#define SETTINGS_FIXED_LISTENER_COUNT 4
+// Each open output registers its own listener. With USE_MULTI_RX the
+// wrapper and every RX it drives are open at the same time.
+#if defined(USE_MULTI_RX)
+#define SETTINGS_OUTPUT_LISTENER_COUNT (1 + OUTPUT_AIR_MULTI_MAX_RX)
+#else
+#define SETTINGS_OUTPUT_LISTENER_COUNT 1
+#endif
+
+static settings_listener_t listeners[SETTINGS_FIXED_LISTENER_COUNT + SETTINGS_OUTPUT_LISTENER_COUNT];
 static storage_t storage;
 
 static void map_setting_keys(settings_view_t *view, setting_key_t keys[], int size)
@@ -14,12 +14,17 @@ typedef uint16_t setting_key_t;
 #define SETTING_STRING_MAX_LENGTH 32
 #define SETTING_STRING_BUFFER_SIZE (SETTING_STRING_MAX_LENGTH + 1)
 #define SETTING_NAME_BUFFER_SIZE SETTING_STRING_BUFFER_SIZE
-#define SETTING_STATIC_COUNT 15
+#define SETTING_STATIC_COUNT 16
 #if defined(USE_TX_SUPPORT)
+#if defined(USE_MULTI_RX)
+#define SETTING_TX_MULTI_RX_COUNT 1
+#else
+#define SETTING_TX_MULTI_RX_COUNT 0
+#endif
 #if defined(USE_GPIO_REMAP)
-#define SETTING_TX_FOLDER_COUNT 6
+#define SETTING_TX_FOLDER_COUNT (6 + SETTING_TX_MULTI_RX_COUNT)
 #else
-#define SETTING_TX_FOLDER_COUNT 4
+#define SETTING_TX_FOLDER_COUNT (4 + SETTING_TX_MULTI_RX_COUNT)
 #endif
 #define SETTING_TX_RECEIVERS_COUNT (1 + (5 * CONFIG_MAX_PAIRED_RX))
 #else
@@ -54,7 +59,7 @@ typedef uint16_t setting_key_t;
 #define SETTING_SCREEN_FOLDER_COUNT 0
 #endif
 #if defined(USE_DEVELOPER_MENU)
-#define SETTING_DEVELOPER_FOLDER_COUNT 3
+#define SETTING_DEVELOPER_FOLDER_COUNT 5
 #else
 #define SETTING_DEVELOPER_FOLDER_COUNT 0
 #endif
@@ -100,6 +105,9 @@ typedef enum
 #define SETTING_KEY_TX_TX_GPIO _SKE(FOLDER_ID_TX, 5)
 #define SETTING_KEY_TX_RX_GPIO _SKE(FOLDER_ID_TX, 6)
 #endif
+#if defined(USE_MULTI_RX)
+#define SETTING_KEY_TX_MULTI_RX _SKE(FOLDER_ID_TX, 7)
+#endif
 
 #define SETTING_KEY_RX _SK_FOLDER(FOLDER_ID_RX)
 #define SETTING_KEY_RX_SUPPORTED_MODES _SKE(FOLDER_ID_RX, 1)
@@ -162,10 +170,13 @@ typedef enum
 #define SETTING_KEY_DIAGNOSTICS _SK_FOLDER(FOLDER_ID_DIAGNOSTICS)
 #define SETTING_KEY_DIAGNOSTICS_FREQUENCIES _SKE(FOLDER_ID_DIAGNOSTICS, 1)
 #define SETTING_KEY_DIAGNOSTICS_DEBUG_INFO _SKE(FOLDER_ID_DIAGNOSTICS, 2)
+#define SETTING_KEY_DIAGNOSTICS_SPECTRUM_SURVEY _SKE(FOLDER_ID_DIAGNOSTICS, 3)
 
 #define SETTING_KEY_DEVELOPER _SK_FOLDER(FOLDER_ID_DEVELOPER)
 #define SETTING_KEY_DEVELOPER_REMOTE_DEBUGGING _SKE(FOLDER_ID_DEVELOPER, 1)
 #define SETTING_KEY_DEVELOPER_REBOOT _SKE(FOLDER_ID_DEVELOPER, 2)
+#define SETTING_KEY_DEVELOPER_RADIO_COEX _SKE(FOLDER_ID_DEVELOPER, 3)
+#define SETTING_KEY_DEVELOPER_SERIAL_RMP _SKE(FOLDER_ID_DEVELOPER, 4)
 
 #define SETTING_IS(setting, k) (setting->key == k)
 #define SETTING_IS_FROM_FOLDER(setting, d) (_SK_GET_FOLDER(setting->key) == d)
@@ -4,12 +4,48 @@
 
 #include "rmp/rmp.h"
 
+#include "util/crc.h"
 #include "util/stringutil.h"
+#include "util/time.h"
 
 #include "settings_rmp.h"
 
+// Maximum number of peers subscribed at the same time
+#define SETTINGS_RMP_MAX_SUBSCRIPTIONS 4
+// Minimum time between notifications to the same subscriber. Changes
+// during this interval are coalesced into a single notification.
+#define SETTINGS_RMP_NOTIFY_INTERVAL MILLIS_TO_TICKS(100)
+#define SETTINGS_RMP_CHANGED_WORDS ((SETTING_COUNT + 31) / 32)
+
 static const char *TAG = "Settings.RMP";
 
+typedef struct settings_rmp_subscription_s
+{
+    air_addr_t addr;
+    uint8_t port; // Port the subscriber listens on
+    settings_rmp_view_t view;
+    time_ticks_t expires_at;
+    time_ticks_t next_notify_at;
+    uint32_t pending[SETTINGS_RMP_CHANGED_WORDS]; // Changed settings not notified yet, by global index
+    // View state as last seen by the subscriber
+    uint16_t settings_count;
+    uint8_t view_crc;
+    bool is_visible;
+    // Stats, logged when the subscription ends
+    unsigned changes; // Changes to settings in the view, coalesced between notifications
+    unsigned notifications;
+} settings_rmp_subscription_t;
+
+static struct
+{
+    rmp_t *rmp;
+    const rmp_port_t *port;
+    // Settings changed since the last update, by global index. Written from
+    // the settings listener, which can run in any task.
+    uint32_t changed[SETTINGS_RMP_CHANGED_WORDS];
+    settings_rmp_subscription_t subscriptions[SETTINGS_RMP_MAX_SUBSCRIPTIONS];
+} settings_rmp;
+
 static bool settings_rmp_requires_auth(void)
 {
     return true;
@@ -73,6 +109,115 @@ static void settings_rmp_send_setting(rmp_t *rmp, rmp_req_t *req, settings_rmp_m
     req->resp(req->resp_data, resp, settings_rmp_msg_size(resp));
 }
 
+static void settings_rmp_subscription_get_view(const settings_rmp_subscription_t *sub, settings_view_t *view)
+{
+    settings_view_get_folder_view(view, sub->view.id, sub->view.folder_id, sub->view.recursive);
+}
+
+static void settings_rmp_subscription_reset(settings_rmp_subscription_t *sub, const settings_rmp_view_t *v)
+{
+    settings_view_t view;
+    sub->view = *v;
+    memset(sub->pending, 0, sizeof(sub->pending));
+    settings_rmp_subscription_get_view(sub, &view);
+    sub->settings_count = view.count;
+    sub->view_crc = crc8_dvb_s2_bytes(view.indexes, view.count);
+    sub->is_visible = settings_is_folder_visible(v->id, v->folder_id);
+}
+
+static void settings_rmp_subscription_end(settings_rmp_subscription_t *sub)
+{
+    LOG_I(TAG, "Subscription to folder %d ended: %u changes, %u notifications",
+          (int)sub->view.folder_id, sub->changes, sub->notifications);
+    memset(sub, 0, sizeof(*sub));
+}
+
+static bool settings_rmp_subscribe(const rmp_msg_t *msg, const settings_rmp_view_t *v)
+{
+    time_ticks_t now = time_ticks_now();
+    settings_rmp_subscription_t *sub = NULL;
+    for (int ii = 0; ii < ARRAY_COUNT(settings_rmp.subscriptions); ii++)
+    {
+        settings_rmp_subscription_t *s = &settings_rmp.subscriptions[ii];
+        if (air_addr_equals(&s->addr, &msg->src))
+        {
+            sub = s;
+            break;
+        }
+        if (!sub && !air_addr_is_valid(&s->addr))
+        {
+            sub = s;
+        }
+    }
+    if (!sub)
+    {
+        LOG_W(TAG, "No room for more subscriptions");
+        return false;
+    }
+    if (!air_addr_equals(&sub->addr, &msg->src))
+    {
+        air_addr_cpy(&sub->addr, &msg->src);
+        settings_rmp_subscription_reset(sub, v);
+    }
+    else if (memcmp(&sub->view, v, sizeof(*v)) != 0)
+    {
+        // Moved to another folder
+        settings_rmp_subscription_reset(sub, v);
+    }
+    sub->port = msg->src_port;
+    sub->expires_at = now + MILLIS_TO_TICKS(SETTINGS_RMP_SUBSCRIPTION_LEASE_MS);
+    return true;
+}
+
+static void settings_rmp_subscription_notify(settings_rmp_subscription_t *sub, time_ticks_t now)
+{
+    settings_view_t view;
+    settings_rmp_msg_t msg;
+    settings_rmp_subscription_get_view(sub, &view);
+    uint32_t changed = 0;
+    for (int ii = 0; ii < view.count; ii++)
+    {
+        unsigned idx = view.indexes[ii];
+        if (sub->pending[idx / 32] & (1u << (idx % 32)))
+        {
+            changed |= 1u << MIN(ii, SETTINGS_RMP_NOTIFY_MAX_INDEX);
+            sub->changes++;
+        }
+    }
+    memset(sub->pending, 0, sizeof(sub->pending));
+    uint8_t view_crc = crc8_dvb_s2_bytes(view.indexes, view.count);
+    bool is_visible = settings_is_folder_visible(sub->view.id, sub->view.folder_id);
+    if (view_crc != sub->view_crc)
+    {
+        // Some settings were shown or hidden, reload all of them
+        changed = UINT32_MAX;
+    }
+    if (changed == 0 && view.count == sub->settings_count && is_visible == sub->is_visible)
+    {
+        // Nothing the subscriber can see changed
+        return;
+    }
+    sub->settings_count = view.count;
+    sub->view_crc = view_crc;
+    sub->is_visible = is_visible;
+    msg.code = SETTINGS_RMP_NOTIFY;
+    msg.notify.view = sub->view;
+    msg.notify.is_visible = is_visible;
+    msg.notify.settings_count = view.count;
+    msg.notify.changed = changed;
+    rmp_send(settings_rmp.rmp, settings_rmp.port, &sub->addr, sub->port, &msg, settings_rmp_msg_size(&msg));
+    sub->notifications++;
+    sub->next_notify_at = now + SETTINGS_RMP_NOTIFY_INTERVAL;
+}
+
+static void settings_rmp_setting_changed(const setting_t *setting, void *user_data)
+{
+    UNUSED(user_data);
+
+    unsigned idx = setting - settings_get_setting_at(0);
+    __atomic_fetch_or(&settings_rmp.changed[idx / 32], 1u << (idx % 32), __ATOMIC_RELAXED);
+}
+
 static void settings_rmp_handler(rmp_t *rmp, rmp_req_t *req, void *user_data)
 {
     if (settings_rmp_msg_is_valid(req->msg))
@@ -148,10 +293,25 @@ static void settings_rmp_handler(rmp_t *rmp, rmp_req_t *req, void *user_data)
             }
             settings_rmp_send_setting(rmp, req, &resp, &view, setting, SETTINGS_RMP_WRITE);
             break;
+        case SETTINGS_RMP_SUBSCRIBE_REQ:
+            if (settings_rmp_requires_auth() && !req->is_authenticated)
+            {
+                break;
+            }
+            if (settings_rmp_subscribe(req->msg, &msg->subscribe_req.view))
+            {
+                resp.code = SETTINGS_RMP_SUBSCRIBE;
+                resp.subscribe.view = msg->subscribe_req.view;
+                resp.subscribe.lease_ms = SETTINGS_RMP_SUBSCRIPTION_LEASE_MS;
+                req->resp(req->resp_data, &resp, settings_rmp_msg_size(&resp));
+            }
+            break;
         // Responses, not handled here
         case SETTINGS_RMP_EHLO:
         case SETTINGS_RMP_READ:
         case SETTINGS_RMP_WRITE:
+        case SETTINGS_RMP_SUBSCRIBE:
+        case SETTINGS_RMP_NOTIFY:
             break;
         }
     }
@@ -159,7 +319,46 @@ static void settings_rmp_handler(rmp_t *rmp, rmp_req_t *req, void *user_data)
 
 void settings_rmp_init(rmp_t *rmp)
 {
-    rmp_open_port(rmp, RMP_PORT_SETTINGS, settings_rmp_handler, NULL);
+    settings_rmp.rmp = rmp;
+    settings_rmp.port = rmp_open_port(rmp, RMP_PORT_SETTINGS, settings_rmp_handler, NULL);
+    settings_add_listener(settings_rmp_setting_changed, NULL);
+}
+
+void settings_rmp_update(void)
+{
+    if (!settings_rmp.port)
+    {
+        return;
+    }
+    time_ticks_t now = time_ticks_now();
+    uint32_t changed[SETTINGS_RMP_CHANGED_WORDS];
+    for (int ii = 0; ii < ARRAY_COUNT(changed); ii++)
+    {
+        changed[ii] = __atomic_exchange_n(&settings_rmp.changed[ii], 0, __ATOMIC_RELAXED);
+    }
+    for (int ii = 0; ii < ARRAY_COUNT(settings_rmp.subscriptions); ii++)
+    {
+        settings_rmp_subscription_t *sub = &settings_rmp.subscriptions[ii];
+        if (!air_addr_is_valid(&sub->addr))
+        {
+            continue;
+        }
+        if (sub->expires_at < now)
+        {
+            settings_rmp_subscription_end(sub);
+            continue;
+        }
+        bool has_pending = false;
+        for (int jj = 0; jj < ARRAY_COUNT(changed); jj++)
+        {
+            sub->pending[jj] |= changed[jj];
+            has_pending |= sub->pending[jj] != 0;
+        }
+        if (has_pending && now >= sub->next_notify_at)
+        {
+            settings_rmp_subscription_notify(sub, now);
+        }
+    }
 }
 
 bool settings_rmp_msg_is_valid(const rmp_msg_t *msg)
@@ -192,6 +391,12 @@ size_t settings_rmp_msg_size(const settings_rmp_msg_t *msg)
     case SETTINGS_RMP_WRITE:
         // TODO: Optimize
         return 1 + sizeof(settings_rmp_setting_t);
+    case SETTINGS_RMP_SUBSCRIBE_REQ:
+        return 1 + sizeof(settings_rmp_subscribe_req_t);
+    case SETTINGS_RMP_SUBSCRIBE:
+        return 1 + sizeof(settings_rmp_subscribe_t);
+    case SETTINGS_RMP_NOTIFY:
+        return 1 + sizeof(settings_rmp_notify_t);
     }
     return 0;
 }
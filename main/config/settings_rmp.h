@@ -23,8 +23,19 @@ typedef enum
     SETTINGS_RMP_READ,
     SETTINGS_RMP_WRITE_REQ,
     SETTINGS_RMP_WRITE,
+    SETTINGS_RMP_SUBSCRIBE_REQ,
+    SETTINGS_RMP_SUBSCRIBE,
+    SETTINGS_RMP_NOTIFY,
 } settings_rmp_code_e;
 
+// Subscriptions must be renewed before the lease (returned in the
+// SUBSCRIBE response) expires. A new subscription from the same peer
+// replaces the previous one.
+#define SETTINGS_RMP_SUBSCRIPTION_LEASE_MS 3000
+// Changes to settings in the NOTIFY changed mask at this index or higher
+// set the last bit.
+#define SETTINGS_RMP_NOTIFY_MAX_INDEX 31
+
 typedef struct settings_rmp_view_s
 {
     uint8_t id;
@@ -64,6 +75,28 @@ typedef struct settings_rmp_write_req_s
     uint8_t payload[SETTING_RMP_SETTING_MAX_PAYLOAD_SIZE];
 } PACKED settings_rmp_write_req_t;
 
+typedef struct settings_rmp_subscribe_req_s
+{
+    settings_rmp_view_t view;
+} PACKED settings_rmp_subscribe_req_t;
+
+typedef struct settings_rmp_subscribe_s
+{
+    settings_rmp_view_t view;
+    uint16_t lease_ms; // Time before the subscription expires
+} PACKED settings_rmp_subscribe_t;
+
+// Sent to subscribers when some setting in the view changes. Changes are
+// coalesced, so a notification might cover several changes. Settings with
+// SETTING_FLAG_DYNAMIC change without notifications and must be polled.
+typedef struct settings_rmp_notify_s
+{
+    settings_rmp_view_t view;
+    uint8_t is_visible;      // Wether the subscribed folder is still visible
+    uint16_t settings_count; // If it changed, the client must reload the whole view
+    uint32_t changed;        // Bit n set iff the setting at index n changed
+} PACKED settings_rmp_notify_t;
+
 typedef struct settings_rmp_setting_s
 {
     settings_rmp_view_t view;
@@ -90,10 +123,15 @@ typedef struct settings_rmp_msg_s
         settings_rmp_read_req_t read_req;
         settings_rmp_write_req_t write_req;
         settings_rmp_setting_t setting;
+        settings_rmp_subscribe_req_t subscribe_req;
+        settings_rmp_subscribe_t subscribe;
+        settings_rmp_notify_t notify;
     };
 } PACKED settings_rmp_msg_t;
 
 void settings_rmp_init(rmp_t *rmp);
+// Sends the pending change notifications to the subscribers
+void settings_rmp_update(void);
 bool settings_rmp_msg_is_valid(const rmp_msg_t *msg);
 size_t settings_rmp_msg_size(const settings_rmp_msg_t *msg);
 
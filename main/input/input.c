@@ -32,6 +32,19 @@ bool input_update(input_t *input, time_micros_t now)
     return updated;
 }
 
+time_micros_t input_next_update_at(input_t *input, time_micros_t now)
+{
+    if (!input || !input->is_open)
+    {
+        return TIME_MICROS_MAX;
+    }
+    if (!input->vtable.next_update_at)
+    {
+        return now;
+    }
+    return input->vtable.next_update_at(input, now);
+}
+
 void input_close(input_t *input, void *config)
 {
     if (input && input->is_open && input->vtable.close)
@@ -19,6 +19,10 @@ typedef struct input_vtable_s
     // Returns true iff new data was acquired
     bool (*update)(void *input, rc_data_t *data, time_micros_t now);
     void (*close)(void *input, void *config);
+    // Optional. Returns the time by which update() must be called again,
+    // assuming radio interrupts wake up the RC task earlier. Inputs
+    // without it are updated continuously.
+    time_micros_t (*next_update_at)(void *input, time_micros_t now);
 } input_vtable_t;
 
 typedef struct msp_transport_s msp_transport_t;
@@ -36,4 +40,7 @@ typedef struct input_s
 bool input_open(rc_data_t *data, input_t *input, void *config);
 // Returns true iff new data was acquired
 bool input_update(input_t *input, time_micros_t now);
+// Returns the time by which input_update() must be called again,
+// now if the input needs to be updated continuously.
+time_micros_t input_next_update_at(input_t *input, time_micros_t now);
 void input_close(input_t *input, void *config);
\ No newline at end of file
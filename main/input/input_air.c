@@ -5,6 +5,8 @@
 
 #include "config/config.h"
 
+#include "platform/coex.h"
+
 #include "rc/rc_data.h"
 
 #include "input_air.h"
@@ -13,6 +15,12 @@
 #define CYCLE_TIME_WAIT_FACTOR 0.10f // Wait an extra 10% of the cycle time to decide we've lost a packet
 // Maximum number of lost packets to continue jumping forward
 #define MAX_LOST_PACKETS_JUMPING_FORWARD (AIR_SEQ_COUNT / 2)
+// Packets used to learn the TX seq step
+#define INPUT_AIR_SEQ_STEP_WINDOW 8
+// Time without valid packets before we start listening with a duty cycle
+#define POWER_SAVE_AFTER_US SECS_TO_MICROS(30)
+// The radio sleeps for this many times the listen window in power save
+#define POWER_SAVE_SLEEP_FACTOR 4
 
 // Telemetry values fed to the output before an MSP reply, to avoid filling
 // all the stream with big MSP responses.
@@ -46,6 +54,10 @@ static void input_air_update_air_mode(input_air_t *input_air)
     air_radio_set_mode(radio, input_air->air_mode);
     air_cmd_switch_mode_ack_reset(&input_air->switch_air_mode);
     input_air->cycle_time = air_radio_cycle_time(radio, input_air->air_mode);
+    input_air->frame_ext.max_size = air_radio_frame_ext_max_size(radio);
+    input_air->frame_ext.uplink_time = air_radio_frame_ext_time(radio, sizeof(air_tx_packet_t), input_air->frame_ext.max_size);
+    input_air->frame_ext.downlink_time = air_radio_frame_ext_time(radio, sizeof(air_rx_packet_t), input_air->frame_ext.max_size);
+    input_air->frame_ext.granted = false;
     failsafe_set_max_interval(&input_air->input.failsafe, air_radio_rx_failsafe_interval(radio, input_air->air_mode));
     input_air->reset_rssi = true;
 }
@@ -54,11 +66,13 @@ static void input_air_start(input_air_t *input_air)
 {
     air_radio_t *radio = input_air->air_config.radio;
     unsigned long center_freq = air_band_frequency(input_air->air_config.band);
+    bool orthogonal = input_air->air.pairing_info.capabilities & AIR_CAP_ORTHOGONAL_HOPPING;
     air_radio_calibrate(radio, center_freq);
-    air_radio_set_sync_word(radio, air_sync_word(input_air->air.pairing.key));
-    air_freq_table_init(&input_air->air.freq_table, input_air->air.pairing.key, center_freq);
+    air_radio_set_sync_word(radio, air_sync_word(input_air->air.pairing.key, orthogonal));
+    air_freq_table_init(&input_air->air.freq_table, input_air->air.pairing.key, center_freq, orthogonal);
     // TODO: RX used 17dBm fixed power
     air_radio_set_tx_power(radio, 17);
+    air_radio_set_variable_length_frames(radio, input_air->frame_ext.enabled);
     input_air_update_air_mode(input_air);
     air_radio_sleep(radio);
     air_radio_set_payload_size(radio, sizeof(air_tx_packet_t));
@@ -203,17 +217,20 @@ static size_t input_air_feed_stream(input_air_t *input_air, rc_data_t *data, tim
 
 static void input_air_send_response(input_air_t *input_air, rc_data_t *data, time_micros_t now)
 {
-    air_rx_packet_t out_pkt = {
-        .seq = input_air->seq++,
-        .tx_seq = input_air->tx_seq,
-        .data = {AIR_DATA_START_STOP, AIR_DATA_START_STOP, AIR_DATA_START_STOP},
+    air_rx_ext_packet_t frame = {
+        .pkt = {
+            .seq = input_air->seq++,
+            .tx_seq = input_air->tx_seq,
+            .data = {AIR_DATA_START_STOP, AIR_DATA_START_STOP, AIR_DATA_START_STOP},
+        },
     };
+    air_rx_packet_t *out_pkt = &frame.pkt;
 
     if (input_air_feed_stream_ack(input_air) == 0)
     {
         // Only send non-ACK data if we have no ACK to send
         size_t count = air_stream_output_count(&input_air->air_stream);
-        while (count < sizeof(out_pkt.data))
+        while (count < sizeof(out_pkt->data))
         {
             size_t n = input_air_feed_stream(input_air, data, now);
             if (n == 0)
@@ -226,17 +243,72 @@ static void input_air_send_response(input_air_t *input_air, rc_data_t *data, tim
     size_t p = 0;
     uint8_t c;
     // Check if we have buffered data to send
-    while (p < sizeof(out_pkt.data) && air_stream_pop_output(&input_air->air_stream, &c))
+    while (p < sizeof(out_pkt->data) && air_stream_pop_output(&input_air->air_stream, &c))
     {
-        out_pkt.data[p++] = c;
+        out_pkt->data[p++] = c;
     }
     // XXX: Reset the LoRa modem before sending. Otherwise sometimes we don't
     // get the TX done interrupt.
     air_radio_sleep(input_air->air_config.radio);
-    air_rx_packet_prepare(&out_pkt, input_air->air.pairing.key);
-    //LOG_BUFFER_I("RADIO-OUT", &out_pkt, sizeof(out_pkt));
+    air_rx_packet_prepare(out_pkt, input_air->air.pairing.key);
+    size_t size = sizeof(*out_pkt);
+    // The TX only leaves time for an extended frame when the uplink one
+    // was also extended. Only use it if there's buffered data left.
+    if (input_air->frame_ext.granted && air_stream_output_count(&input_air->air_stream) > 0)
+    {
+        size_t ext_size = 0;
+        while (ext_size < input_air->frame_ext.max_size - AIR_FRAME_EXT_OVERHEAD &&
+               air_stream_pop_output(&input_air->air_stream, &c))
+        {
+            frame.ext.data[ext_size++] = c;
+        }
+        air_frame_ext_prepare(&frame.ext, ext_size, out_pkt->crc, input_air->air.pairing.key);
+        size += ext_size + AIR_FRAME_EXT_OVERHEAD;
+    }
+    //LOG_BUFFER_I("RADIO-OUT", &frame, size);
     input_air->air_state = AIR_INPUT_STATE_TX;
-    air_radio_send(input_air->air_config.radio, &out_pkt, sizeof(out_pkt));
+    air_radio_send(input_air->air_config.radio, &frame, size);
+}
+
+static unsigned input_air_seq_gcd(unsigned a, unsigned b)
+{
+    while (b)
+    {
+        unsigned t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Returns the seq to feed to air_stream for a packet with the given
+// seq. Must be called before updating tx_seq. The step is learnt as the
+// GCD of the gaps between consecutive packets, since any loss makes the
+// gap a multiple of the step. A gap that doesn't match the step skips a
+// stream seq, so the stream resets exactly like it would with a lost
+// packet on a dedicated link.
+static unsigned input_air_stream_seq(input_air_t *input_air, unsigned seq)
+{
+    unsigned gap = (seq - input_air->tx_seq) % AIR_SEQ_COUNT;
+    if (gap != input_air->consecutive_lost_packets + 1)
+    {
+        // Not the packet we expected (first one or the TX restarted)
+        input_air->seq_step.stream_seq += 2;
+        return input_air->seq_step.stream_seq;
+    }
+    input_air->seq_step.step_gcd = input_air_seq_gcd(input_air->seq_step.step_gcd, gap);
+    if (++input_air->seq_step.packets == INPUT_AIR_SEQ_STEP_WINDOW)
+    {
+        if (input_air->seq_step.step_gcd != input_air->seq_step.step)
+        {
+            LOG_I(TAG, "TX seq step changed from %u to %u", input_air->seq_step.step, input_air->seq_step.step_gcd);
+            input_air->seq_step.step = input_air->seq_step.step_gcd;
+        }
+        input_air->seq_step.step_gcd = 0;
+        input_air->seq_step.packets = 0;
+    }
+    input_air->seq_step.stream_seq += gap == input_air->seq_step.step ? 1 : 2;
+    return input_air->seq_step.stream_seq;
 }
 
 static unsigned input_air_next_expected_tx_seq(input_air_t *input_air)
@@ -281,14 +353,119 @@ static bool input_air_prepare_next_receive(input_air_t *input_air)
     return false;
 }
 
-static inline bool input_air_receive(input_air_t *input_air, air_tx_packet_t *pkt)
+static void input_air_power_save_sleep(input_air_t *input_air, time_micros_t now)
+{
+    air_radio_sleep(input_air->air_config.radio);
+    input_air->power_save.listening = false;
+    input_air->power_save.scanning = false;
+    input_air->power_save.period_started_at = now;
+    input_air->power_save.next_change_at = now + input_air->power_save.listen_interval * POWER_SAVE_SLEEP_FACTOR;
+}
+
+static void input_air_power_save_enter(input_air_t *input_air, time_micros_t now)
+{
+    // The TX switches to the longest mode in FS and hops over all the
+    // frequencies, so listening on a single one for a full hopping
+    // sequence is enough to receive a packet if the TX is transmitting.
+    time_micros_t listen_interval = AIR_NUM_HOPPING_FREQS * input_air->cycle_time * (1 + CYCLE_TIME_WAIT_FACTOR);
+    input_air->power_save.active = true;
+    input_air->power_save.listen_interval = listen_interval;
+    input_air->power_save.cad_interval = air_radio_cad_interval(input_air->air_config.radio);
+    LOG_I(TAG, "Entering power save, reacquisition within %u ms",
+          (unsigned)((listen_interval * (1 + POWER_SAVE_SLEEP_FACTOR)) / 1000));
+    input_air_power_save_sleep(input_air, now);
+}
+
+static void input_air_power_save_exit(input_air_t *input_air, time_micros_t now)
+{
+    input_air->power_save.active = false;
+    input_air->power_save.last_reacquisition = now - input_air->power_save.period_started_at;
+    LOG_I(TAG, "Leaving power save, link reacquired after %u ms",
+          (unsigned)(input_air->power_save.last_reacquisition / 1000));
+}
+
+static void input_air_power_save_update_scan(input_air_t *input_air, time_micros_t now)
+{
+    air_radio_t *radio = input_air->air_config.radio;
+    bool detected;
+    if (input_air->power_save.next_cad_at == TIME_MICROS_MAX)
+    {
+        if (air_radio_is_cad_done(radio, &detected))
+        {
+            if (detected)
+            {
+                // Stay in RX until the end of the window to receive the packet
+                input_air->power_save.scanning = false;
+                air_radio_start_rx(radio);
+                return;
+            }
+            air_radio_sleep(radio);
+            input_air->power_save.next_cad_at = now + input_air->power_save.cad_interval;
+        }
+    }
+    else if (now >= input_air->power_save.next_cad_at)
+    {
+        air_radio_start_cad(radio);
+        input_air->power_save.next_cad_at = TIME_MICROS_MAX;
+    }
+}
+
+// Returns true iff the radio is sleeping
+static bool input_air_power_save_update(input_air_t *input_air, time_micros_t now)
+{
+    if (now < input_air->power_save.next_change_at)
+    {
+        if (input_air->power_save.scanning)
+        {
+            input_air_power_save_update_scan(input_air, now);
+        }
+        return !input_air->power_save.listening;
+    }
+    if (input_air->power_save.listening)
+    {
+        input_air_power_save_sleep(input_air, now);
+        return true;
+    }
+    // Listen on a different frequency on every period, in case
+    // the previous one had interference.
+    input_air->power_save.listening = true;
+    input_air->power_save.next_change_at = now + input_air->power_save.listen_interval;
+    input_air_update_air_frequency(input_air, (input_air->freq_index + 1) % AIR_NUM_HOPPING_FREQS);
+    if (input_air->power_save.cad_interval > 0)
+    {
+        // Scan with CAD instead of staying in RX during the whole window
+        air_radio_sleep(input_air->air_config.radio);
+        input_air->power_save.scanning = true;
+        input_air->power_save.next_cad_at = now;
+    }
+    return false;
+}
+
+static bool input_air_validate_frame(input_air_t *input_air, air_tx_ext_packet_t *frame, size_t size, size_t *ext_size)
+{
+    air_key_t key = input_air->air.pairing.key;
+    if (size < sizeof(frame->pkt) || !air_tx_packet_validate(&frame->pkt, key))
+    {
+        return false;
+    }
+    if (size > sizeof(frame->pkt))
+    {
+        *ext_size = size - sizeof(frame->pkt) - AIR_FRAME_EXT_OVERHEAD;
+        return air_frame_ext_validate(&frame->ext, *ext_size, frame->pkt.crc, key);
+    }
+    *ext_size = 0;
+    return true;
+}
+
+static inline bool input_air_receive(input_air_t *input_air, air_tx_ext_packet_t *frame, size_t *ext_size)
 {
     air_radio_t *radio = input_air->air_config.radio;
     if (air_radio_is_rx_done(radio))
     {
-        size_t read_size = air_radio_read(radio, pkt, sizeof(*pkt));
-        //LOG_BUFFER_I("RADIO-IN", pkt, read_size);
-        if (read_size != sizeof(*pkt) || !air_tx_packet_validate(pkt, input_air->air.pairing.key))
+        size_t size = input_air->frame_ext.max_size > 0 ? sizeof(*frame) : sizeof(frame->pkt);
+        size_t read_size = air_radio_read(radio, frame, size);
+        //LOG_BUFFER_I("RADIO-IN", frame, read_size);
+        if (!input_air_validate_frame(input_air, frame, read_size, ext_size))
         {
             LOG_W(TAG, "Got invalid frame");
             // Reading the FIFO puts the module in IDLE state because we need
@@ -297,6 +474,7 @@ static inline bool input_air_receive(input_air_t *input_air, air_tx_packet_t *pk
             air_radio_start_rx(radio);
             return false;
         }
+        input_air->frame_ext.granted = read_size > sizeof(frame->pkt);
         return true;
     }
     return false;
@@ -322,12 +500,20 @@ static bool input_air_open(void *input, void *config)
         return false;
     }
     input_air->air_mode = input_air->air_mode_longest;
+    input_air->frame_ext.enabled = input_air->air.pairing_info.capabilities & AIR_CAP_VARIABLE_LENGTH_FRAMES;
 
     input_air_start(input_air);
     input_air->seq = 0;
     input_air->consecutive_lost_packets = 0;
     input_air->telemetry_fed_index = 0;
     input_air->reset_rssi = true;
+    input_air->last_packet_at = time_micros_now();
+    input_air->power_save.active = false;
+    input_air->power_save.last_reacquisition = 0;
+    input_air->seq_step.step = 1;
+    input_air->seq_step.step_gcd = 0;
+    input_air->seq_step.packets = 0;
+    input_air->seq_step.stream_seq = 0;
     air_stream_init(&input_air->air_stream, input_air_stream_channel_decoded,
                     input_air_stream_telemetry_decoded, input_air_stream_cmd_decoded, input);
     msp_air_init(&input_air->msp_air, &input_air->air_stream, input_air_msp_before_feed, input_air);
@@ -338,7 +524,9 @@ static bool input_air_open(void *input, void *config)
 static bool input_air_update(void *input, rc_data_t *data, time_micros_t now)
 {
     input_air_t *input_air = input;
-    air_tx_packet_t in_pkt;
+    air_tx_ext_packet_t frame;
+    air_tx_packet_t *in_pkt = &frame.pkt;
+    size_t ext_size;
     int rssi, snr, lq;
     bool updated = false;
     air_radio_t *radio = input_air->air_config.radio;
@@ -355,17 +543,45 @@ static bool input_air_update(void *input, rc_data_t *data, time_micros_t now)
                 input_air_update_air_mode(input_air);
             }
             air_io_invalidate_rssi(&input_air->air, now);
+            if (!input_air->power_save.active && now - input_air->last_packet_at > POWER_SAVE_AFTER_US)
+            {
+                input_air_power_save_enter(input_air, now);
+            }
+        }
+
+        if (input_air->power_save.active && input_air_power_save_update(input_air, now))
+        {
+            break;
         }
 
-        if (input_air_receive(input_air, &in_pkt))
+        if (input_air_receive(input_air, &frame, &ext_size))
         {
+            if (input_air->power_save.active)
+            {
+                input_air_power_save_exit(input_air, now);
+            }
+#if defined(USE_COEX)
+            if (input_air->consecutive_lost_packets == 0)
+            {
+                coex_air_slot_started(input_air->next_packet_expected_at, now);
+            }
+#endif
             input_air->last_packet_at = now;
             input_air->next_packet_expected_at = now + input_air->cycle_time;
+            if (input_air->frame_ext.granted)
+            {
+                // The TX delays the next frame to leave time for our extended one
+                input_air->next_packet_expected_at += input_air->frame_ext.downlink_time;
+            }
             input_air->next_packet_deadline = input_air->next_packet_expected_at + input_air->cycle_time * CYCLE_TIME_WAIT_FACTOR;
             input_air->next_packet_deadline_extended = false;
             input_air->consecutive_lost_packets = 0;
+#if defined(USE_COEX)
+            coex_air_slot_scheduled(input_air->next_packet_expected_at);
+#endif
             input_air->rx_success++;
-            input_air->tx_seq = in_pkt.seq;
+            unsigned stream_seq = input_air_stream_seq(input_air, in_pkt->seq);
+            input_air->tx_seq = in_pkt->seq;
 
             rssi = air_radio_rssi(radio, &snr, &lq);
             int last_error = air_radio_frequency_error(radio);
@@ -388,19 +604,20 @@ static bool input_air_update(void *input, rc_data_t *data, time_micros_t now)
             failsafe_reset_interval(&input_air->input.failsafe, now);
             air_io_on_frame(&input_air->air, now);
             updated = true;
-            rc_data_update_channel(data, 0, AIR_TO_CHANNEL_INPUT(in_pkt.ch0), now);
-            rc_data_update_channel(data, 1, AIR_TO_CHANNEL_INPUT(in_pkt.ch1), now);
-            rc_data_update_channel(data, 2, AIR_TO_CHANNEL_INPUT(in_pkt.ch2), now);
-            rc_data_update_channel(data, 3, AIR_TO_CHANNEL_INPUT(in_pkt.ch3), now);
+            rc_data_update_channel(data, 0, AIR_TO_CHANNEL_INPUT(in_pkt->ch0), now);
+            rc_data_update_channel(data, 1, AIR_TO_CHANNEL_INPUT(in_pkt->ch1), now);
+            rc_data_update_channel(data, 2, AIR_TO_CHANNEL_INPUT(in_pkt->ch2), now);
+            rc_data_update_channel(data, 3, AIR_TO_CHANNEL_INPUT(in_pkt->ch3), now);
 
-            air_stream_feed_input(&input_air->air_stream, in_pkt.seq, in_pkt.data, sizeof(in_pkt.data), now);
+            air_stream_feed_input_ext(&input_air->air_stream, stream_seq, in_pkt->data, sizeof(in_pkt->data), frame.ext.data, ext_size, now);
             break;
         }
-        if (now > input_air->next_packet_deadline)
+        if (now > input_air->next_packet_deadline && !input_air->power_save.active)
         {
             if (!input_air->next_packet_deadline_extended && air_radio_is_rx_in_progress(radio))
             {
-                input_air->next_packet_deadline += input_air->cycle_time * CYCLE_TIME_WAIT_FACTOR;
+                // Extended frames might take longer to be received
+                input_air->next_packet_deadline += input_air->cycle_time * CYCLE_TIME_WAIT_FACTOR + input_air->frame_ext.uplink_time;
                 input_air->next_packet_deadline_extended = true;
                 break;
             }
@@ -410,9 +627,16 @@ static bool input_air_update(void *input, rc_data_t *data, time_micros_t now)
             input_air->next_packet_expected_at = now + input_air->cycle_time;
             input_air->next_packet_deadline = input_air->next_packet_expected_at + input_air->cycle_time * CYCLE_TIME_WAIT_FACTOR;
             input_air->next_packet_deadline_extended = false;
-            LOG_W(TAG, "invalid or lost frame, %u consecutive, %f%% error rate",
-                  input_air->consecutive_lost_packets,
-                  (input_air->rx_errors * 100.0) / (input_air->rx_errors + input_air->rx_success));
+#if defined(USE_COEX)
+            coex_air_slot_scheduled(input_air->next_packet_expected_at);
+#endif
+            if (input_air->consecutive_lost_packets >= input_air->seq_step.step)
+            {
+                // Otherwise it's just a slot for another RX
+                LOG_W(TAG, "invalid or lost frame, %u consecutive, %f%% error rate",
+                      input_air->consecutive_lost_packets,
+                      (input_air->rx_errors * 100.0) / (input_air->rx_errors + input_air->rx_success));
+            }
 
             // Don't send downlink telemetry for now. Don't sleep nor interrupt the RX here
             // if the frequency doesn't change, since we might be in the middle of receiving
@@ -437,10 +661,29 @@ static bool input_air_update(void *input, rc_data_t *data, time_micros_t now)
     return updated;
 }
 
+static time_micros_t input_air_next_update_at(void *input, time_micros_t now)
+{
+    input_air_t *input_air = input;
+    if (input_air->power_save.active)
+    {
+        time_micros_t next = input_air->power_save.next_change_at;
+        if (input_air->power_save.scanning)
+        {
+            next = MIN(next, input_air->power_save.next_cad_at);
+        }
+        return next;
+    }
+    // Sent and received packets are signaled by the radio interrupt,
+    // which wakes up the RC task. Otherwise, the packet is considered
+    // lost at the deadline.
+    return input_air->next_packet_deadline;
+}
+
 static void input_air_close(void *input, void *config)
 {
     LOG_I(TAG, "Close");
     input_air_t *input_air = input;
+    air_radio_set_variable_length_frames(input_air->air_config.radio, false);
     air_radio_sleep(input_air->air_config.radio);
 }
 
@@ -451,6 +694,7 @@ void input_air_init(input_air_t *input, air_addr_t addr, air_config_t *air_confi
         .open = input_air_open,
         .update = input_air_update,
         .close = input_air_close,
+        .next_update_at = input_air_next_update_at,
     };
     // Note that the air_stream is not initialized yet, but we won't
     // send anything until it's bound.
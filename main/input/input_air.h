@@ -37,6 +37,35 @@ typedef struct input_air_s
     bool next_packet_deadline_extended;
     bool reset_rssi;
     unsigned freq_index;
+    struct
+    {
+        bool enabled;                // Both ends support variable length frames
+        bool granted;                // Last uplink frame was extended, so we can extend ours
+        size_t max_size;             // Maximum frame extension in the current mode
+        time_micros_t uplink_time;   // Additional air time for a fully extended uplink frame
+        time_micros_t downlink_time; // Additional air time for a fully extended downlink frame
+    } frame_ext;
+    struct
+    {
+        bool active;                      // Listening with a duty cycle after a prolonged link loss
+        bool listening;                   // Radio is listening during the current duty cycle
+        bool scanning;                    // Listening via CAD, RX is only enabled after detecting a preamble
+        time_micros_t listen_interval;    // Listen window, covers a full hopping sequence
+        time_micros_t cad_interval;       // Time between CADs, zero if the radio doesn't support them
+        time_micros_t next_cad_at;        // Time to start the next CAD
+        time_micros_t period_started_at;  // Start of the current sleep + listen period
+        time_micros_t next_change_at;     // Time to start or stop listening
+        time_micros_t last_reacquisition; // Time from the start of the period until the link was reacquired
+    } power_save;
+    // A TX driving several RXs advances the seq once per slot of its
+    // frame (see output_air_multi.h), so our packets arrive every step.
+    struct
+    {
+        unsigned step;                      // Seq increment between our packets, 1 for a dedicated TX
+        unsigned step_gcd;                  // GCD of the seq gaps in the current window
+        unsigned packets;                   // Packets in the current window
+        unsigned stream_seq : AIR_SEQ_BITS; // Seq fed to air_stream, advances once per step
+    } seq_step;
 
     msp_air_t msp_air;
     rmp_air_t rmp_air;
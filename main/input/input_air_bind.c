@@ -10,8 +10,18 @@
 
 static const char *TAG = "Input.Air.Bind";
 
-// Switch band every 2 seconds unless we're seing a TX in bind mode
+// Stay on a band for 2 seconds once we've seen a TX in bind mode
 #define BAND_SWITCH_INTERVAL_US MILLIS_TO_MICROS(2000)
+// The TX sends a hello on each one of its bands every AIR_BIND_HELLO_INTERVAL_MS,
+// so a full rotation over all possible bands is enough to know there's no TX
+// in the band we're scanning.
+#define BAND_SCAN_INTERVAL_US MILLIS_TO_MICROS(AIR_BIND_HELLO_INTERVAL_MS * (AIR_BAND_MAX - AIR_BAND_MIN + 1) + 20)
+// TXs without hellos send a legacy bind packet every AIR_BIND_PACKET_INTERVAL_MS.
+// We alternate full rounds over the bands looking for hellos with rounds
+// looking for those, so we can bind with older TXs too.
+#define BAND_SCAN_LEGACY_INTERVAL_US MILLIS_TO_MICROS(AIR_BIND_PACKET_INTERVAL_MS + 50)
+// Time to wait before responding, so the TX has time to switch to RX
+#define RESPONSE_DELAY_US MILLIS_TO_MICROS(3)
 
 enum
 {
@@ -19,6 +29,18 @@ enum
     AIR_INPUT_BIND_STATE_TX,
 };
 
+static int input_air_bind_band_index(input_air_bind_t *input, air_band_e band)
+{
+    for (int ii = 0;; ii++)
+    {
+        air_band_e b = air_band_mask_get_band(input->air_config.bands, ii);
+        if (b == band || b == AIR_BAND_INVALID)
+        {
+            return b == band ? ii : -1;
+        }
+    }
+}
+
 static bool input_air_bind_update_band(input_air_bind_t *input)
 {
     air_band_e band = air_band_mask_get_band(input->air_config.bands, input->band_index);
@@ -38,6 +60,53 @@ static bool input_air_bind_update_band(input_air_bind_t *input)
     return true;
 }
 
+static void input_air_bind_start_scan(input_air_bind_t *input, time_micros_t now)
+{
+    if (input->cad.enabled)
+    {
+        // Scan with CAD and only enable RX once we see some activity
+        input->cad.scanning = true;
+        input->cad.next_at = now;
+        input->cad.band_since = now;
+        input->cad.count = 0;
+    }
+    else
+    {
+        air_radio_start_rx(input->air_config.radio);
+    }
+    input->switch_band_at = now + (input->legacy ? BAND_SCAN_LEGACY_INTERVAL_US : BAND_SCAN_INTERVAL_US);
+}
+
+// Returns true iff the radio is still scanning
+static bool input_air_bind_update_scan(input_air_bind_t *input, time_micros_t now)
+{
+    air_radio_t *radio = input->air_config.radio;
+    bool detected;
+    if (air_radio_is_cad_done(radio, &detected))
+    {
+        input->cad.count++;
+        if (detected)
+        {
+            LOG_I(TAG, "Activity detected at %lu MHz after %u ms (%u scans)",
+                  air_band_frequency(input->air_config.band) / 1000000,
+                  (unsigned)((now - input->cad.band_since) / 1000), input->cad.count);
+            // Stay in RX on this band to receive the bind packet
+            input->cad.scanning = false;
+            input->switch_band_at = now + BAND_SWITCH_INTERVAL_US;
+            air_radio_start_rx(radio);
+            return false;
+        }
+        input->cad.next_at = now + input->cad.interval;
+        air_radio_sleep(radio);
+    }
+    else if (now >= input->cad.next_at)
+    {
+        air_radio_start_cad(radio);
+        input->cad.next_at = TIME_MICROS_MAX;
+    }
+    return true;
+}
+
 static bool input_air_bind_open(void *data, void *config)
 {
     LOG_I(TAG, "Open");
@@ -49,21 +118,43 @@ static bool input_air_bind_open(void *data, void *config)
     input->bind_accepted = false;
     input->bind_confirmation_sent = false;
     input->bind_completed = false;
+    input->hello_band = AIR_BAND_INVALID;
+    input->legacy = false;
+    input->started_at = time_micros_now();
     input->band_index = 0;
-    input->switch_band_at = time_micros_now() + BAND_SWITCH_INTERVAL_US;
     if (!input_air_bind_update_band(input))
     {
         LOG_W(TAG, "No air bands supported");
         return false;
     }
-    air_radio_start_rx(input->air_config.radio);
+    input->cad.interval = air_radio_cad_interval(input->air_config.radio);
+    input->cad.enabled = input->cad.interval > 0;
+    input_air_bind_start_scan(input, time_micros_now());
     led_mode_add(LED_MODE_BIND);
     return true;
 }
 
+static void input_air_bind_send_hello(input_air_bind_t *input)
+{
+    air_bind_hello_packet_t hello = {
+        .addr = input->air.addr,
+        .key = input->hello_key,
+        .role = AIR_ROLE_RX_AWAITING_CONFIRMATION,
+        .band = input->hello_band,
+    };
+    air_bind_hello_packet_prepare(&hello);
+    input->state = AIR_INPUT_BIND_STATE_TX;
+    air_radio_send(input->air_config.radio, &hello, sizeof(hello));
+}
+
 static void input_air_bind_send_response(void *data, time_micros_t now)
 {
     input_air_bind_t *input = data;
+    if (input->hello_band != AIR_BAND_INVALID)
+    {
+        input_air_bind_send_hello(input);
+        return;
+    }
     air_role_e role = AIR_ROLE_RX_AWAITING_CONFIRMATION;
     if (input->bind_accepted)
     {
@@ -92,21 +183,43 @@ static bool input_air_bind_update(void *data, rc_data_t *rc_data, time_micros_t
 {
     input_air_bind_t *input = data;
     air_radio_t *radio = input->air_config.radio;
-    air_bind_packet_t pkt;
+    union {
+        air_bind_packet_t pkt;
+        air_bind_hello_packet_t hello;
+    } buf;
     switch (input->state)
     {
     case AIR_INPUT_BIND_STATE_RX:
         led_mode_set(LED_MODE_BIND_WITH_REQUEST, input->bind_packet_expires > now);
+        if (input->cad.scanning && input_air_bind_update_scan(input, now) && now <= input->switch_band_at)
+        {
+            break;
+        }
         if (air_radio_is_rx_done(radio))
         {
-            size_t n = air_radio_read(radio, &pkt, sizeof(pkt));
-            if (n == sizeof(pkt) && air_bind_packet_validate(&pkt) && pkt.role == AIR_ROLE_TX)
+            size_t n = air_radio_read(radio, &buf, sizeof(buf));
+            if (n == sizeof(buf.hello) && air_bind_hello_packet_validate(&buf.hello) && buf.hello.role == AIR_ROLE_TX)
             {
-                LOG_I(TAG, "Got bind request");
-                air_bind_packet_cpy(&input->bind_packet, &pkt);
+                int band_index = input_air_bind_band_index(input, buf.hello.band);
+                if (band_index >= 0)
+                {
+                    if (input->hello_band == AIR_BAND_INVALID)
+                    {
+                        LOG_I(TAG, "Got hello after %u ms", (unsigned)((now - input->started_at) / 1000));
+                    }
+                    // Answer in this band, then move to the TX band to get the details
+                    input->hello_band = buf.hello.band;
+                    input->hello_key = buf.hello.key;
+                    input->bind_packet_expires = now + MILLIS_TO_MICROS(AIR_BIND_PACKET_EXPIRATION_MS);
+                    input->send_response_at = now + RESPONSE_DELAY_US;
+                }
+            }
+            else if (n == sizeof(buf.pkt) && air_bind_packet_validate(&buf.pkt) && buf.pkt.role == AIR_ROLE_TX)
+            {
+                LOG_I(TAG, "Got bind request after %u ms", (unsigned)((now - input->started_at) / 1000));
+                air_bind_packet_cpy(&input->bind_packet, &buf.pkt);
                 input->bind_packet_expires = now + MILLIS_TO_MICROS(AIR_BIND_PACKET_EXPIRATION_MS);
-                // Wait 10ms to send a response
-                input->send_response_at = now + MILLIS_TO_MICROS(10);
+                input->send_response_at = now + RESPONSE_DELAY_US;
             }
             // Not actually required since now we always send
             // a response, but if we change that in the future
@@ -125,11 +238,25 @@ static bool input_air_bind_update(void *data, rc_data_t *rc_data, time_micros_t
             if (now > input->bind_packet_expires)
             {
                 // Packet has expired, switch bands
+                if (input->cad.scanning)
+                {
+                    LOG_D(TAG, "No activity at %lu MHz, %u scans", air_band_frequency(input->air_config.band) / 1000000, input->cad.count);
+                }
+                air_radio_sleep(radio);
                 input->band_index++;
+                if (air_band_mask_get_band(input->air_config.bands, input->band_index) == AIR_BAND_INVALID)
+                {
+                    // Round finished, switch between hellos and legacy bind packets
+                    input->legacy = !input->legacy;
+                    air_radio_set_bind_legacy_format(radio, input->legacy);
+                }
                 input_air_bind_update_band(input);
-                air_radio_start_rx(radio);
+                input_air_bind_start_scan(input, now);
+            }
+            else
+            {
+                input->switch_band_at = now + BAND_SWITCH_INTERVAL_US;
             }
-            input->switch_band_at = now + BAND_SWITCH_INTERVAL_US;
         }
         break;
     case AIR_INPUT_BIND_STATE_TX:
@@ -146,6 +273,19 @@ static bool input_air_bind_update(void *data, rc_data_t *rc_data, time_micros_t
                 // Finished transmitting an informative packet to the TX,
                 // continue in bind mode.
                 air_radio_sleep(radio);
+                if (input->hello_band != AIR_BAND_INVALID)
+                {
+                    // Hello answered, the full bind packet will arrive
+                    // in the TX band.
+                    if (input->hello_band != input->air_config.band)
+                    {
+                        input->band_index = input_air_bind_band_index(input, input->hello_band);
+                        input_air_bind_update_band(input);
+                    }
+                    input->hello_band = AIR_BAND_INVALID;
+                    input->cad.scanning = false;
+                    input->switch_band_at = now + BAND_SWITCH_INTERVAL_US;
+                }
                 air_radio_start_rx(radio);
                 input->state = AIR_INPUT_BIND_STATE_RX;
             }
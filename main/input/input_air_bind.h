@@ -24,6 +24,19 @@ typedef struct input_air_bind_s
     bool bind_completed;
     int band_index; // for multiple band support
     time_micros_t switch_band_at;
+    time_micros_t started_at; // Time when bind mode was started
+    air_band_e hello_band;    // TX band from the last hello, pending a response
+    air_key_t hello_key;      // Key from the last hello, echoed in the response
+    bool legacy;              // Scanning for TXs without hellos, see air_radio_set_bind_legacy_format()
+    struct
+    {
+        bool enabled;             // Radio supports CAD in bind mode
+        bool scanning;            // Waiting for a CAD to finish, not in RX
+        time_micros_t next_at;    // Time to start the next CAD
+        time_micros_t interval;   // Interval between CADs
+        time_micros_t band_since; // Time when the scan on the current band started
+        unsigned count;           // CADs performed on the current band
+    } cad;
 } input_air_bind_t;
 
 void input_air_bind_init(input_air_bind_t *input_air_bind, air_addr_t addr, air_config_t *air_config);
\ No newline at end of file
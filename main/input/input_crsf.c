@@ -759,10 +759,15 @@ static void input_crsf_rmp_handler(rmp_t *rmp, rmp_req_t *req, void *user_data)
         input_crsf_send_setting_frame(input, setting, device_addr);
         break;
     }
+    // The Lua script polls the settings, so we never subscribe
+    case SETTINGS_RMP_SUBSCRIBE:
+    case SETTINGS_RMP_NOTIFY:
+        break;
     // Requests, not handled here:
     case SETTINGS_RMP_HELO:
     case SETTINGS_RMP_READ_REQ:
     case SETTINGS_RMP_WRITE_REQ:
+    case SETTINGS_RMP_SUBSCRIBE_REQ:
         break;
     }
 }
@@ -921,6 +926,21 @@ static void input_crsf_close(void *input, void *config)
     serial_port_destroy(&input_crsf->serial_port);
 }
 
+static time_micros_t input_crsf_next_update_at(void *input, time_micros_t now)
+{
+    input_crsf_t *input_crsf = input;
+    unsigned frame_interval = input_crsf_frame_interval_us(input_crsf);
+    if (frame_interval == 0 || input_crsf->last_byte_at > 0)
+    {
+        // Detecting the baud rate or receiving a frame
+        return now;
+    }
+    time_micros_t next = MIN(input_crsf->next_resp_frame, input_crsf->enable_rx_deadline);
+    // Frames arrive with a fixed period. Wake up halfway through it,
+    // so the next one is decoded and answered in time.
+    return MIN(next, input_crsf->last_frame_recv + frame_interval / 2);
+}
+
 void input_crsf_init(input_crsf_t *input)
 {
     input->serial_port = NULL;
@@ -928,6 +948,7 @@ void input_crsf_init(input_crsf_t *input)
         .open = input_crsf_open,
         .update = input_crsf_update,
         .close = input_crsf_close,
+        .next_update_at = input_crsf_next_update_at,
     };
     RING_BUFFER_INIT(&input->scheduled, crsf_frame_t, CRSF_INPUT_FRAME_QUEUE_SIZE);
 }
@@ -39,3 +39,8 @@ bool io_is_half_duplex(io_t *io)
 {
     return io_get_flags(io) & IO_FLAG_HALF_DUPLEX;
 }
+
+bool io_is_busy(io_t *io)
+{
+    return io_get_flags(io) & IO_FLAG_BUSY;
+}
@@ -15,6 +15,7 @@
 typedef enum
 {
     IO_FLAG_HALF_DUPLEX = 1 << 0,
+    IO_FLAG_BUSY = 1 << 1, // Half duplex line in use, writing now would collide
 } io_flags_t;
 
 typedef int (*io_read_f)(void *data, void *buf, size_t size, time_ticks_t timeout);
@@ -35,3 +36,4 @@ int io_write(io_t *io, const void *buf, size_t size);
 
 io_flags_t io_get_flags(io_t *io);
 bool io_is_half_duplex(io_t *io);
+bool io_is_busy(io_t *io);
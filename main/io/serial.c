@@ -11,9 +11,14 @@ void serial_port_destroy(serial_port_t **port)
 
 io_flags_t serial_port_io_flags(serial_port_t *port)
 {
+    io_flags_t flags = 0;
     if (serial_port_is_half_duplex(port))
     {
-        return IO_FLAG_HALF_DUPLEX;
+        flags |= IO_FLAG_HALF_DUPLEX;
+        if (serial_port_is_busy(port))
+        {
+            flags |= IO_FLAG_BUSY;
+        }
     }
-    return 0;
+    return flags;
 }
\ No newline at end of file
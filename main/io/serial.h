@@ -35,6 +35,15 @@ typedef enum
 
 typedef void (*serial_byte_callback_f)(const serial_port_t *port, uint8_t b, void *user_data);
 
+typedef struct serial_half_duplex_stats_s
+{
+    unsigned turnarounds;       // Switches from TX to RX
+    unsigned collisions;        // Writes started while the other end was transmitting
+    unsigned rx_enable_us;      // Last time spent switching the pin to RX in the TX done ISR
+    unsigned max_rx_enable_us;  // Maximum value seen in rx_enable_us
+    unsigned response_us;       // Last time from TX done until the other end replied
+} serial_half_duplex_stats_t;
+
 typedef struct serial_port_config_s
 {
     int baud_rate;
@@ -51,6 +60,10 @@ typedef struct serial_port_config_s
 } serial_port_config_t;
 
 serial_port_t *serial_port_open(const serial_port_config_t *config);
+// Opens the port used by the console (connected to the USB bridge on
+// most boards), ignoring the pins in config. The logs must be redirected
+// with log_set_output() before using it.
+serial_port_t *serial_port_open_console(const serial_port_config_t *config);
 int serial_port_read(serial_port_t *port, void *buf, size_t size, time_ticks_t timeout);
 bool serial_port_begin_write(serial_port_t *port);
 bool serial_port_end_write(serial_port_t *port);
@@ -61,6 +74,11 @@ void serial_port_close(serial_port_t *port);
 bool serial_port_is_half_duplex(const serial_port_t *port);
 serial_half_duplex_mode_e serial_port_half_duplex_mode(const serial_port_t *port);
 void serial_port_set_half_duplex_mode(serial_port_t *port, serial_half_duplex_mode_e mode);
+// Returns true iff the port is half duplex and either we're still
+// transmitting or the other end is in the middle of a transmission.
+// Writing while the port is busy will cause a collision.
+bool serial_port_is_busy(const serial_port_t *port);
+void serial_port_get_half_duplex_stats(const serial_port_t *port, serial_half_duplex_stats_t *stats);
 void serial_port_destroy(serial_port_t **port);
 
 io_flags_t serial_port_io_flags(serial_port_t *port);
@@ -1,10 +1,400 @@
+#include <assert.h>
 #include <string.h>
 
+#include <hal/log.h>
+
+#include <os/os.h>
+
+#if defined(USE_STORAGE_WORKER)
+#include <freertos/semphr.h>
+#endif
+
+#include "target.h"
+
+#if defined(USE_COEX)
+#include "platform/coex.h"
+#endif
+
+#include "util/macros.h"
+
 #include "storage.h"
 
+static const char *TAG = "Storage";
+
+typedef struct storage_stats_s
+{
+    unsigned writes;             // Blobs written to the flash
+    unsigned commits;            // Commits written to the flash
+    unsigned coalesced;          // Writes that replaced a pending write to the same key
+    unsigned waits;              // Times a caller had to wait for a free request slot
+    time_micros_t max_write_us;  // Worst case time spent writing a blob
+    time_micros_t max_commit_us; // Worst case time spent in a commit
+    time_micros_t max_caller_us; // Worst case time a caller was blocked by a write or commit
+} storage_stats_t;
+
+static storage_stats_t storage_stats;
+
+static void storage_update_max(time_micros_t *max, time_micros_t elapsed, const char *what)
+{
+    if (elapsed > *max)
+    {
+        *max = elapsed;
+        LOG_D(TAG, "New worst case %s time: %uus", what, (unsigned)elapsed);
+    }
+}
+
+// Waits until the flash operation can run without delaying an air slot,
+// using the worst case time seen so far as the estimate.
+static void storage_wait_for_quiet_window(time_micros_t estimate)
+{
+#if defined(USE_COEX)
+    coex_wait_for_quiet_window(estimate);
+#else
+    UNUSED(estimate);
+#endif
+}
+
+static void storage_log_stats(void)
+{
+    LOG_I(TAG, "%u writes, %u commits, %u coalesced, %u waits, max write %uus, commit %uus, caller %uus",
+          storage_stats.writes, storage_stats.commits, storage_stats.coalesced, storage_stats.waits,
+          (unsigned)storage_stats.max_write_us, (unsigned)storage_stats.max_commit_us,
+          (unsigned)storage_stats.max_caller_us);
+}
+
+static bool storage_hal_write(storage_t *storage, const void *key, size_t key_size, const void *buf, size_t size)
+{
+    storage_wait_for_quiet_window(storage_stats.max_write_us);
+    time_micros_t start = time_micros_now();
+    hal_err_t err = hal_storage_set_blob(&storage->hal, key, key_size, buf, size);
+    storage_stats.writes++;
+    storage_update_max(&storage_stats.max_write_us, time_micros_now() - start, "write");
+    if (err != HAL_ERR_NONE)
+    {
+        LOG_E(TAG, "Writing blob with %u bytes key failed: %d", (unsigned)key_size, err);
+        return false;
+    }
+    return true;
+}
+
+static bool storage_hal_commit(storage_t *storage)
+{
+    storage_wait_for_quiet_window(storage_stats.max_commit_us);
+    time_micros_t start = time_micros_now();
+    hal_err_t err = hal_storage_commit(&storage->hal);
+    storage_stats.commits++;
+    storage_update_max(&storage_stats.max_commit_us, time_micros_now() - start, "commit");
+    if (err != HAL_ERR_NONE)
+    {
+        LOG_E(TAG, "Commit failed: %d", err);
+        return false;
+    }
+    storage_log_stats();
+    return true;
+}
+
+#if defined(USE_STORAGE_WORKER)
+
+// Keys are at most 8 bytes (see config.c and settings.c), while the
+// biggest value is a config_air_info_blob_t. Bigger values are written
+// synchronously.
+#define STORAGE_KEY_SIZE_MAX 8
+#define STORAGE_VALUE_SIZE_MAX 64
+#define STORAGE_REQ_COUNT 16
+#define STORAGE_WORKER_STACK_SIZE 4096
+#define STORAGE_WORKER_PRIORITY 1
+#define STORAGE_WORKER_CORE 0
+
+typedef enum
+{
+    STORAGE_REQ_NONE,
+    STORAGE_REQ_WRITE,
+    STORAGE_REQ_COMMIT,
+} storage_req_type_e;
+
+typedef struct storage_req_s
+{
+    storage_req_type_e type;
+    storage_t *storage;
+    uint32_t seq;                          // Requests are processed in seq order
+    bool in_progress;                      // Being processed by the worker, can't be modified
+    uint8_t key[STORAGE_KEY_SIZE_MAX];     // Only for STORAGE_REQ_WRITE
+    uint8_t key_size;                      // Only for STORAGE_REQ_WRITE
+    uint8_t value[STORAGE_VALUE_SIZE_MAX]; // Only for STORAGE_REQ_WRITE
+    uint8_t value_size;                    // Only for STORAGE_REQ_WRITE, 0 means the key is deleted
+    storage_commit_f callback;             // Only for STORAGE_REQ_COMMIT
+    void *user_data;                       // Only for STORAGE_REQ_COMMIT
+} storage_req_t;
+
+static struct
+{
+    storage_req_t reqs[STORAGE_REQ_COUNT];
+    uint32_t next_seq;
+    SemaphoreHandle_t mutex;
+    TaskHandle_t task;
+} worker;
+
+static void storage_worker_lock(void)
+{
+    xSemaphoreTake(worker.mutex, portMAX_DELAY);
+}
+
+static void storage_worker_unlock(void)
+{
+    xSemaphoreGive(worker.mutex);
+}
+
+// Returns the oldest request and marks it as in progress. Must be
+// called with the lock held.
+static storage_req_t *storage_worker_next_req(void)
+{
+    storage_req_t *next = NULL;
+    for (int ii = 0; ii < ARRAY_COUNT(worker.reqs); ii++)
+    {
+        storage_req_t *req = &worker.reqs[ii];
+        if (req->type != STORAGE_REQ_NONE && (!next || req->seq < next->seq))
+        {
+            next = req;
+        }
+    }
+    if (next)
+    {
+        next->in_progress = true;
+    }
+    return next;
+}
+
+static void storage_worker_task(void *arg)
+{
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        for (;;)
+        {
+            storage_worker_lock();
+            storage_req_t *req = storage_worker_next_req();
+            storage_worker_unlock();
+            if (!req)
+            {
+                break;
+            }
+            // No other task can modify the request while it's in
+            // progress, so we can do the flash I/O without the lock.
+            switch (req->type)
+            {
+            case STORAGE_REQ_NONE:
+                break;
+            case STORAGE_REQ_WRITE:
+                storage_hal_write(req->storage, req->key, req->key_size, req->value, req->value_size);
+                break;
+            case STORAGE_REQ_COMMIT:
+            {
+                bool ok = storage_hal_commit(req->storage);
+                if (req->callback)
+                {
+                    req->callback(req->storage, ok, req->user_data);
+                }
+                break;
+            }
+            }
+            storage_worker_lock();
+            req->type = STORAGE_REQ_NONE;
+            req->in_progress = false;
+            storage_worker_unlock();
+        }
+    }
+}
+
+static void storage_worker_init(void)
+{
+    if (worker.task)
+    {
+        return;
+    }
+    worker.mutex = xSemaphoreCreateMutex();
+    assert(worker.mutex);
+    CREATE_TASK(storage_worker_task, "STORAGE", STORAGE_WORKER_STACK_SIZE, NULL, STORAGE_WORKER_PRIORITY, &worker.task, STORAGE_WORKER_CORE);
+}
+
+// Returns the newest write request for the given key. Must be called
+// with the lock held.
+static storage_req_t *storage_worker_find_write(storage_t *storage, const void *key, size_t key_size)
+{
+    storage_req_t *found = NULL;
+    for (int ii = 0; ii < ARRAY_COUNT(worker.reqs); ii++)
+    {
+        storage_req_t *req = &worker.reqs[ii];
+        if (req->type == STORAGE_REQ_WRITE && req->storage == storage && req->key_size == key_size &&
+            memcmp(req->key, key, key_size) == 0 && (!found || req->seq > found->seq))
+        {
+            found = req;
+        }
+    }
+    return found;
+}
+
+// Allocates a new request, waiting for the worker to free one if
+// they're all in use. Must be called with the lock held.
+static storage_req_t *storage_worker_alloc_req(storage_t *storage, storage_req_type_e type)
+{
+    for (;;)
+    {
+        for (int ii = 0; ii < ARRAY_COUNT(worker.reqs); ii++)
+        {
+            storage_req_t *req = &worker.reqs[ii];
+            if (req->type == STORAGE_REQ_NONE)
+            {
+                req->type = type;
+                req->storage = storage;
+                req->seq = worker.next_seq++;
+                return req;
+            }
+        }
+        // This should only happen when lots of keys are changed at
+        // once (e.g. renumbering all the paired RXs).
+        storage_stats.waits++;
+        storage_worker_unlock();
+        xTaskNotifyGive(worker.task);
+        vTaskDelay(1);
+        storage_worker_lock();
+    }
+}
+
+static void storage_write(storage_t *storage, const void *key, size_t key_size, const void *buf, size_t size)
+{
+    if (key_size > STORAGE_KEY_SIZE_MAX || size > STORAGE_VALUE_SIZE_MAX)
+    {
+        LOG_W(TAG, "Blob with %u bytes key and %u bytes value is too big for the worker, writing it synchronously",
+              (unsigned)key_size, (unsigned)size);
+        // Make sure it's written after any queued write for the same key
+        storage_flush();
+        storage_hal_write(storage, key, key_size, buf, size);
+        return;
+    }
+    time_micros_t start = time_micros_now();
+    storage_worker_lock();
+    storage_req_t *req = storage_worker_find_write(storage, key, key_size);
+    if (req && !req->in_progress)
+    {
+        storage_stats.coalesced++;
+    }
+    else
+    {
+        // Writes are not sent to the worker until the next commit,
+        // so writes to the same key can be coalesced.
+        req = storage_worker_alloc_req(storage, STORAGE_REQ_WRITE);
+        req->key_size = key_size;
+        memcpy(req->key, key, key_size);
+    }
+    req->value_size = size;
+    if (size > 0)
+    {
+        memcpy(req->value, buf, size);
+    }
+    storage_worker_unlock();
+    storage_update_max(&storage_stats.max_caller_us, time_micros_now() - start, "caller");
+}
+
+static hal_err_t storage_read(storage_t *storage, const void *key, size_t key_size, void *buf, size_t *size, bool *found)
+{
+    hal_err_t err = HAL_ERR_NONE;
+    storage_worker_lock();
+    storage_req_t *req = storage_worker_find_write(storage, key, key_size);
+    if (req)
+    {
+        // Return the queued value, since it's newer than the one in the flash
+        bool fits = req->value_size > 0 && req->value_size <= *size;
+        if (fits)
+        {
+            memcpy(buf, req->value, req->value_size);
+            *size = req->value_size;
+        }
+        if (found)
+        {
+            *found = fits;
+        }
+    }
+    storage_worker_unlock();
+    if (!req)
+    {
+        err = hal_storage_get_blob(&storage->hal, key, key_size, buf, size, found);
+    }
+    return err;
+}
+
+void storage_commit_cb(storage_t *storage, storage_commit_f callback, void *user_data)
+{
+    time_micros_t start = time_micros_now();
+    storage_worker_lock();
+    storage_req_t *req = storage_worker_alloc_req(storage, STORAGE_REQ_COMMIT);
+    req->callback = callback;
+    req->user_data = user_data;
+    storage_worker_unlock();
+    xTaskNotifyGive(worker.task);
+    storage_update_max(&storage_stats.max_caller_us, time_micros_now() - start, "caller");
+}
+
+void storage_flush(void)
+{
+    if (!worker.task || xTaskGetCurrentTaskHandle() == worker.task)
+    {
+        return;
+    }
+    for (;;)
+    {
+        bool pending = false;
+        storage_worker_lock();
+        for (int ii = 0; ii < ARRAY_COUNT(worker.reqs); ii++)
+        {
+            pending |= worker.reqs[ii].type != STORAGE_REQ_NONE;
+        }
+        storage_worker_unlock();
+        if (!pending)
+        {
+            break;
+        }
+        xTaskNotifyGive(worker.task);
+        vTaskDelay(1);
+    }
+}
+
+#else
+
+static void storage_write(storage_t *storage, const void *key, size_t key_size, const void *buf, size_t size)
+{
+    time_micros_t start = time_micros_now();
+    storage_hal_write(storage, key, key_size, buf, size);
+    storage_update_max(&storage_stats.max_caller_us, time_micros_now() - start, "caller");
+}
+
+static hal_err_t storage_read(storage_t *storage, const void *key, size_t key_size, void *buf, size_t *size, bool *found)
+{
+    return hal_storage_get_blob(&storage->hal, key, key_size, buf, size, found);
+}
+
+void storage_commit_cb(storage_t *storage, storage_commit_f callback, void *user_data)
+{
+    time_micros_t start = time_micros_now();
+    bool ok = storage_hal_commit(storage);
+    storage_update_max(&storage_stats.max_caller_us, time_micros_now() - start, "caller");
+    if (callback)
+    {
+        callback(storage, ok, user_data);
+    }
+}
+
+void storage_flush(void)
+{
+}
+
+#endif
+
 void storage_init(storage_t *storage, storage_namespace_e ns)
 {
     HAL_ERR_ASSERT_OK(hal_storage_init(&storage->hal, (uint8_t)ns));
+#if defined(USE_STORAGE_WORKER)
+    storage_worker_init();
+#endif
 }
 
 bool storage_get_bool(storage_t *storage, const void *key, size_t key_size, bool *v)
@@ -45,7 +435,7 @@ bool storage_get_i32(storage_t *storage, const void *key, size_t key_size, int32
 bool storage_get_str(storage_t *storage, const void *key, size_t key_size, char *buf, size_t *size)
 {
     bool found;
-    HAL_ERR_ASSERT_OK(hal_storage_get_blob(&storage->hal, key, key_size, buf, size, &found));
+    HAL_ERR_ASSERT_OK(storage_read(storage, key, key_size, buf, size, &found));
     if (found)
     {
         // Make sure the string is null-terminated
@@ -60,7 +450,7 @@ bool storage_get_str(storage_t *storage, const void *key, size_t key_size, char
 bool storage_get_blob(storage_t *storage, const void *key, size_t key_size, void *buf, size_t *size)
 {
     bool found;
-    HAL_ERR_ASSERT_OK(hal_storage_get_blob(&storage->hal, key, key_size, buf, size, &found));
+    HAL_ERR_ASSERT_OK(storage_read(storage, key, key_size, buf, size, &found));
     return found;
 }
 
@@ -68,43 +458,43 @@ bool storage_get_sized_blob(storage_t *storage, const void *key, size_t key_size
 {
     size_t blob_size = size;
     bool found;
-    HAL_ERR_ASSERT_OK(hal_storage_get_blob(&storage->hal, key, key_size, buf, &blob_size, &found));
+    HAL_ERR_ASSERT_OK(storage_read(storage, key, key_size, buf, &blob_size, &found));
     return found && blob_size == size;
 }
 
 void storage_set_bool(storage_t *storage, const void *key, size_t key_size, bool v)
 {
-    hal_storage_set_blob(&storage->hal, key, key_size, &v, sizeof(v));
+    storage_write(storage, key, key_size, &v, sizeof(v));
 }
 
 void storage_set_u8(storage_t *storage, const void *key, size_t key_size, uint8_t v)
 {
-    hal_storage_set_blob(&storage->hal, key, key_size, &v, sizeof(v));
+    storage_write(storage, key, key_size, &v, sizeof(v));
 }
 
 void storage_set_i8(storage_t *storage, const void *key, size_t key_size, int8_t v)
 {
-    hal_storage_set_blob(&storage->hal, key, key_size, &v, sizeof(v));
+    storage_write(storage, key, key_size, &v, sizeof(v));
 }
 
 void storage_set_u16(storage_t *storage, const void *key, size_t key_size, uint16_t v)
 {
-    hal_storage_set_blob(&storage->hal, key, key_size, &v, sizeof(v));
+    storage_write(storage, key, key_size, &v, sizeof(v));
 }
 
 void storage_set_i16(storage_t *storage, const void *key, size_t key_size, int16_t v)
 {
-    hal_storage_set_blob(&storage->hal, key, key_size, &v, sizeof(v));
+    storage_write(storage, key, key_size, &v, sizeof(v));
 }
 
 void storage_set_u32(storage_t *storage, const void *key, size_t key_size, uint32_t v)
 {
-    hal_storage_set_blob(&storage->hal, key, key_size, &v, sizeof(v));
+    storage_write(storage, key, key_size, &v, sizeof(v));
 }
 
 void storage_set_i32(storage_t *storage, const void *key, size_t key_size, int32_t v)
 {
-    hal_storage_set_blob(&storage->hal, key, key_size, &v, sizeof(v));
+    storage_write(storage, key, key_size, &v, sizeof(v));
 }
 
 void storage_set_str(storage_t *storage, const void *key, size_t key_size, const char *s)
@@ -113,15 +503,22 @@ void storage_set_str(storage_t *storage, const void *key, size_t key_size, const
     {
         s = "";
     }
-    hal_storage_set_blob(&storage->hal, key, key_size, s, strlen(s) + 1);
+    storage_write(storage, key, key_size, s, strlen(s) + 1);
 }
 
 void storage_set_blob(storage_t *storage, const void *key, size_t key_size, const void *buf, size_t size)
 {
-    hal_storage_set_blob(&storage->hal, key, key_size, buf, size);
+    storage_write(storage, key, key_size, buf, size);
 }
 
 void storage_commit(storage_t *storage)
 {
-    HAL_ERR_ASSERT_OK(hal_storage_commit(&storage->hal));
-}
\ No newline at end of file
+    storage_commit_cb(storage, NULL, NULL);
+}
+
+#if defined(USE_STORAGE_IDLE_COMPACTION)
+bool storage_compact_step(void)
+{
+    return hal_storage_compact_step();
+}
+#endif
@@ -6,10 +6,13 @@
 
 #include <hal/storage.h>
 
+#include "util/time.h"
+
 typedef enum
 {
     STORAGE_NS_CONFIG = 1,
     STORAGE_NS_SETTINGS = 2,
+    STORAGE_NS_BENCHMARK = 3,
 } storage_namespace_e;
 
 typedef struct storage_s
@@ -17,6 +20,10 @@ typedef struct storage_s
     hal_storage_t hal;
 } storage_t;
 
+// Called once a commit has been written to the flash. When
+// USE_STORAGE_WORKER is defined it runs in the storage worker task.
+typedef void (*storage_commit_f)(storage_t *storage, bool ok, void *user_data);
+
 void storage_init(storage_t *storage, storage_namespace_e ns);
 
 bool storage_get_bool(storage_t *storage, const void *key, size_t key_size, bool *v);
@@ -41,4 +48,22 @@ void storage_set_i32(storage_t *storage, const void *key, size_t key_size, int32
 void storage_set_str(storage_t *storage, const void *key, size_t key_size, const char *s);
 void storage_set_blob(storage_t *storage, const void *key, size_t key_size, const void *buf, size_t size);
 
+// When USE_STORAGE_WORKER is defined, writes and commits are queued
+// and performed by a background task that owns all the flash I/O, so
+// callers never block on a flash erase. Reads see the queued writes.
+// Note that on ESP32 a flash write or erase disables the cache on both
+// CPUs, so it still stalls the RC task if it overlaps an air slot. The
+// worker starts each flash operation in a quiet window between slots
+// when USE_COEX is defined, and the remaining stalls show up in the
+// slot jitter logged by the coex scheduler.
 void storage_commit(storage_t *storage);
+void storage_commit_cb(storage_t *storage, storage_commit_f callback, void *user_data);
+// Blocks until all queued writes and commits have been written to the flash
+void storage_flush(void);
+
+#if defined(USE_STORAGE_IDLE_COMPACTION)
+// Runs one bounded step of a pending flash compaction. The step that
+// finally compacts erases blocks, so call it only while idle. Returns
+// true while a compaction is pending.
+bool storage_compact_step(void);
+#endif
@@ -72,6 +72,7 @@
 #define REG_LORA_RX_NB_BYTES 0x13
 #define REG_LORA_PKT_SNR_VALUE 0x19
 #define REG_LORA_PKT_RSSI_VALUE 0x1a
+#define REG_LORA_RSSI_VALUE 0x1b
 #define REG_LORA_MODEM_CONFIG_1 0x1d
 #define REG_LORA_MODEM_CONFIG_2 0x1e
 #define REG_LORA_PREAMBLE_MSB 0x20
@@ -96,6 +97,7 @@
 #define MODE_TX 0x03
 #define MODE_RX_CONTINUOUS 0x05
 // #define MODE_RX_SINGLE 0x06 // Unused, only valid in LoRa mode
+#define MODE_CAD 0x07 // Only valid in LoRa mode
 
 // PA config
 #define PA_BOOST 0x80
@@ -111,6 +113,8 @@
 #define IRQ_LORA_TX_DONE_MASK (1 << 3)
 #define IRQ_LORA_RX_DONE_MASK (1 << 6)
 #define IRQ_LORA_VALID_HEADER (1 << 6)
+#define IRQ_LORA_CAD_DONE_MASK (1 << 2)
+#define IRQ_LORA_CAD_DETECTED_MASK (1 << 0)
 
 // Page 46, table 18 indicates the DIO0 values,
 // page 92 indicates that DIO0 is in the most
@@ -118,6 +122,7 @@
 #define DIO0_BIT_OFFSET 6
 #define DIO0_LORA_RX_DONE (0 << DIO0_BIT_OFFSET)
 #define DIO0_LORA_TX_DONE (1 << DIO0_BIT_OFFSET)
+#define DIO0_LORA_CAD_DONE (2 << DIO0_BIT_OFFSET)
 #define DIO0_LORA_NONE (3 << DIO0_BIT_OFFSET)
 
 // Page 69, Table 30 (packet mode, we don't use continous mode)
@@ -141,6 +146,7 @@ enum
 {
     DIO0_TRIGGER_RX_DONE = 1,
     DIO0_TRIGGER_TX_DONE,
+    DIO0_TRIGGER_CAD_DONE,
 };
 
 enum
@@ -167,7 +173,8 @@ static bool sx127x_mode_is_tx(uint8_t mode)
 
 static bool sx127x_mode_is_rx(uint8_t mode)
 {
-    return (mode | MODE_LORA) == (MODE_LORA | MODE_RX_CONTINUOUS);
+    return (mode | MODE_LORA) == (MODE_LORA | MODE_RX_CONTINUOUS) ||
+           mode == (MODE_LORA | MODE_CAD);
 }
 
 static uint8_t sx127x_read_reg(sx127x_t *sx127x, uint8_t addr)
@@ -264,6 +271,14 @@ static void sx127x_callback_task(void *arg)
                 callback((air_radio_t *)sx127x, AIR_RADIO_CALLBACK_REASON_TX_DONE, sx127x->state.callback_data);
             }
             break;
+        case DIO0_TRIGGER_CAD_DONE:
+            sx127x->state.cad_done = true;
+            break;
+        }
+        TaskHandle_t irq_task = sx127x->state.irq_task;
+        if (irq_task)
+        {
+            xTaskNotifyGive(irq_task);
         }
     }
 }
@@ -338,6 +353,7 @@ void sx127x_init(sx127x_t *sx127x)
 
     sx127x->state.tx_done = false;
     sx127x->state.rx_done = false;
+    sx127x->state.cad_done = false;
     sx127x->state.fsk.freq = 0;
     sx127x->state.lora.freq = 0;
     sx127x->state.lora.ppm_correction = 0;
@@ -359,6 +375,7 @@ void sx127x_init(sx127x_t *sx127x)
     sx127x->state.fsk.payload_length = 0;
     sx127x->state.lora.payload_length = 0;
     sx127x->state.callback = NULL;
+    sx127x->state.irq_task = NULL;
 
     sx127x->state.mode = sx127x_read_reg(sx127x, REG_OP_MODE);
     if (sx127x->state.mode & MODE_LORA)
@@ -657,6 +674,12 @@ size_t sx127x_read(sx127x_t *sx127x, void *buf, size_t size)
         ptr = data;
         ptr_size = FEC_ENCODED_SIZE(size);
     }
+    if (sx127x->state.op_mode == SX127X_OP_MODE_LORA && sx127x->state.lora.header == SX127X_LORA_HEADER_EXPLICIT)
+    {
+        // With explicit header, the packet size is sent over the air
+        size = MIN(size, sx127x_read_reg(sx127x, REG_LORA_RX_NB_BYTES));
+        ptr_size = size;
+    }
     HAL_ERR_ASSERT_OK(hal_spi_device_transmit(&sx127x->state.spi, 0, REG_FIFO, NULL, ptr_size, ptr, 0));
     sx127x->state.rx_done = false;
 
@@ -710,6 +733,43 @@ bool sx127x_is_rx_done(sx127x_t *sx127x)
     return sx127x->state.rx_done;
 }
 
+bool sx127x_start_cad(sx127x_t *sx127x)
+{
+    if (sx127x->state.op_mode != SX127X_OP_MODE_LORA)
+    {
+        // CAD is only available in LoRa mode
+        return false;
+    }
+    sx127x_prepare_write(sx127x);
+    sx127x->state.cad_done = false;
+    sx127x->state.dio0_trigger = DIO0_TRIGGER_CAD_DONE;
+    sx127x_write_reg(sx127x, REG_LORA_IRQ_FLAGS, IRQ_LORA_CAD_DONE_MASK | IRQ_LORA_CAD_DETECTED_MASK);
+    sx127x_write_reg(sx127x, REG_DIO_MAPPING_1, DIO0_LORA_CAD_DONE);
+    // The chip goes back to standby after the detection finishes
+    sx127x_set_mode(sx127x, MODE_LORA | MODE_CAD);
+    return true;
+}
+
+bool sx127x_is_cad_done(sx127x_t *sx127x, bool *detected)
+{
+    if (!sx127x->state.cad_done)
+    {
+        return false;
+    }
+    // The chip is already in standby, this updates state.mode
+    // and the RX/TX switch.
+    sx127x_idle(sx127x);
+    sx127x->state.cad_done = false;
+    sx127x->state.dio0_trigger = 0;
+    uint8_t flags = sx127x_read_reg(sx127x, REG_LORA_IRQ_FLAGS);
+    sx127x_write_reg(sx127x, REG_LORA_IRQ_FLAGS, IRQ_LORA_CAD_DONE_MASK | IRQ_LORA_CAD_DETECTED_MASK);
+    if (detected)
+    {
+        *detected = flags & IRQ_LORA_CAD_DETECTED_MASK;
+    }
+    return true;
+}
+
 bool sx127x_is_rx_in_progress(sx127x_t *sx127x)
 {
     switch (sx127x->state.op_mode)
@@ -722,6 +782,15 @@ bool sx127x_is_rx_in_progress(sx127x_t *sx127x)
     return false;
 }
 
+void sx127x_wait_for_irq(sx127x_t *sx127x, time_ticks_t timeout)
+{
+    // The task stays registered after returning, so interrupts fired
+    // while it was busy are pending in its notification and the next
+    // call returns right away instead of missing them.
+    sx127x->state.irq_task = xTaskGetCurrentTaskHandle();
+    ulTaskNotifyTake(pdTRUE, timeout);
+}
+
 void sx127x_set_callback(sx127x_t *sx127x, air_radio_callback_t callback, void *callback_data)
 {
     sx127x->state.callback = callback;
@@ -872,6 +941,19 @@ int sx127x_rssi(sx127x_t *sx127x, int *snr, int *lq)
     return rssi_value;
 }
 
+int sx127x_current_rssi(sx127x_t *sx127x)
+{
+    switch (sx127x->state.op_mode)
+    {
+    case SX127X_OP_MODE_FSK:
+        return sx127x_read_reg(sx127x, REG_FSK_RSSI_VALUE) / -2;
+    case SX127X_OP_MODE_LORA:
+        // Page 87, 5.5.5: RSSI (dBm) = -157 + Rssi (HF) or -164 + Rssi (LF)
+        return sx127x_lora_min_rssi(sx127x) + sx127x_read_reg(sx127x, REG_LORA_RSSI_VALUE);
+    }
+    return 0;
+}
+
 void sx127x_shutdown(sx127x_t *sx127x)
 {
     sx127x_idle(sx127x);
@@ -1171,6 +1253,7 @@ void sx127x_set_lora_coding_rate(sx127x_t *sx127x, sx127x_lora_coding_rate_e rat
     uint8_t reg = sx127x_read_reg(sx127x, REG_LORA_MODEM_CONFIG_1);
     reg = (reg & 0xf1) | (rate << 1);
     sx127x_write_reg(sx127x, REG_LORA_MODEM_CONFIG_1, reg);
+    sx127x->state.lora.coding_rate = rate;
 }
 
 void sx127x_set_lora_preamble_length(sx127x_t *sx127x, long length)
@@ -1179,6 +1262,7 @@ void sx127x_set_lora_preamble_length(sx127x_t *sx127x, long length)
 
     sx127x_write_reg(sx127x, REG_LORA_PREAMBLE_MSB, (uint8_t)(length >> 8));
     sx127x_write_reg(sx127x, REG_LORA_PREAMBLE_LSB, (uint8_t)(length >> 0));
+    sx127x->state.lora.preamble_length = length;
 }
 
 void sx127x_set_lora_crc(sx127x_t *sx127x, bool crc)
@@ -1195,6 +1279,7 @@ void sx127x_set_lora_crc(sx127x_t *sx127x, bool crc)
         reg &= 0xfb;
     }
     sx127x_write_reg(sx127x, REG_LORA_MODEM_CONFIG_2, reg);
+    sx127x->state.lora.crc = crc;
 }
 
 void sx127x_set_lora_header_mode(sx127x_t *sx127x, sx127x_lora_header_e mode)
@@ -1210,6 +1295,7 @@ void sx127x_set_lora_header_mode(sx127x_t *sx127x, sx127x_lora_header_e mode)
         break;
     }
     sx127x_write_reg(sx127x, REG_LORA_MODEM_CONFIG_1, reg);
+    sx127x->state.lora.header = mode;
 }
 
 int sx127x_lora_min_rssi(sx127x_t *sx127x)
@@ -1224,6 +1310,44 @@ int sx127x_lora_min_rssi(sx127x_t *sx127x)
     return -164;
 }
 
+time_micros_t sx127x_lora_calculate_time_on_air(const sx127x_lora_airtime_params_t *params, size_t size)
+{
+    // Page 31, 4.1.1.7. Note that we never enable LowDataRateOptimize, so
+    // DE is always zero.
+    int sf = params->sf;
+    float bw = sx127x_get_lora_signal_bw_khz(NULL, params->signal_bw) * 1000;
+    float symbol_us = (1 << sf) * 1e6f / bw;
+    int ih = params->header == SX127X_LORA_HEADER_IMPLICIT ? 1 : 0;
+    int crc = params->crc ? 1 : 0;
+    int bits = 8 * size - 4 * sf + 28 + 16 * crc - 20 * ih;
+    int payload_symbols = 8;
+    if (bits > 0)
+    {
+        payload_symbols += ((bits + (4 * sf) - 1) / (4 * sf)) * (params->coding_rate + 4);
+    }
+    float preamble_symbols = params->preamble_length + 4.25f;
+    return lrintf((preamble_symbols + payload_symbols) * symbol_us);
+}
+
+time_micros_t sx127x_lora_symbol_time(sx127x_t *sx127x)
+{
+    float bw = sx127x_get_lora_signal_bw_khz(sx127x, sx127x->state.lora.signal_bw) * 1000;
+    return lrintf((1 << sx127x->state.lora.sf) * 1e6f / bw);
+}
+
+time_micros_t sx127x_lora_time_on_air(sx127x_t *sx127x, size_t size)
+{
+    sx127x_lora_airtime_params_t params = {
+        .sf = sx127x->state.lora.sf,
+        .signal_bw = sx127x->state.lora.signal_bw,
+        .coding_rate = sx127x->state.lora.coding_rate,
+        .header = sx127x->state.lora.header,
+        .preamble_length = sx127x->state.lora.preamble_length,
+        .crc = sx127x->state.lora.crc,
+    };
+    return sx127x_lora_calculate_time_on_air(&params, size);
+}
+
 // #pragma endregion
 
 #endif
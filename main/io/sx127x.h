@@ -53,6 +53,16 @@ typedef enum
     SX127X_LORA_CODING_RATE_4_8 = 4,
 } sx127x_lora_coding_rate_e;
 
+typedef struct sx127x_lora_airtime_params_s
+{
+    int sf;
+    sx127x_lora_signal_bw_e signal_bw;
+    sx127x_lora_coding_rate_e coding_rate;
+    sx127x_lora_header_e header;
+    uint16_t preamble_length;
+    bool crc;
+} sx127x_lora_airtime_params_t;
+
 #if 0
 // See page 82, table 32. Frequencies marked * are for SX1279
 typedef enum {
@@ -92,14 +102,20 @@ typedef struct sx127x_s
             uint8_t payload_length;
             uint8_t ppm_correction;
             sx127x_lora_signal_bw_e signal_bw;
+            sx127x_lora_coding_rate_e coding_rate;
+            sx127x_lora_header_e header;
             uint8_t bw_workaround;
+            uint16_t preamble_length;
+            bool crc;
             int sf;
         } lora;
         bool rx_done;
         bool tx_done;
+        bool cad_done;
         int dio0_trigger;
         void *callback;
         void *callback_data;
+        void *irq_task; // TaskHandle_t notified on every interrupt, see sx127x_wait_for_irq()
     } state;
 } sx127x_t;
 
@@ -122,14 +138,24 @@ void sx127x_enable_continous_rx(sx127x_t *sx127x);
 bool sx127x_is_tx_done(sx127x_t *sx127x);
 bool sx127x_is_rx_done(sx127x_t *sx127x);
 bool sx127x_is_rx_in_progress(sx127x_t *sx127x);
+// Channel activity detection, only available in LoRa mode. Returns
+// false if CAD can't be started in the current mode.
+bool sx127x_start_cad(sx127x_t *sx127x);
+// Returns true when the CAD has finished, storing wether a LoRa
+// preamble was detected in detected.
+bool sx127x_is_cad_done(sx127x_t *sx127x, bool *detected);
 
 void sx127x_set_callback(sx127x_t *sx127x, air_radio_callback_t callback, void *data);
+void sx127x_wait_for_irq(sx127x_t *sx127x, time_ticks_t timeout);
 
 int sx127x_frequency_error(sx127x_t *sx127x);
 
 int sx127x_rx_sensitivity(sx127x_t *sx127x);
 // SNR is multiplied by 4
 int sx127x_rssi(sx127x_t *sx127x, int *snr, int *lq);
+// Current RSSI in dBm, regardless of any packet being received. Used
+// to measure the noise floor. The radio must be in RX mode.
+int sx127x_current_rssi(sx127x_t *sx127x);
 
 void sx127x_idle(sx127x_t *sx127x);
 void sx127x_sleep(sx127x_t *sx127x);
@@ -151,3 +177,10 @@ void sx127x_set_lora_preamble_length(sx127x_t *sx127x, long length);
 void sx127x_set_lora_crc(sx127x_t *sx127x, bool crc);
 void sx127x_set_lora_header_mode(sx127x_t *sx127x, sx127x_lora_header_e mode);
 int sx127x_lora_min_rssi(sx127x_t *sx127x);
+time_micros_t sx127x_lora_symbol_time(sx127x_t *sx127x);
+// Returns the time on air for a packet of the given size using the current
+// LoRa parameters.
+time_micros_t sx127x_lora_time_on_air(sx127x_t *sx127x, size_t size);
+// Same as sx127x_lora_time_on_air() but using the given parameters, so it
+// can be used without changing the radio configuration.
+time_micros_t sx127x_lora_calculate_time_on_air(const sx127x_lora_airtime_params_t *params, size_t size);
@@ -24,6 +24,12 @@
 #include "config/settings.h"
 #include "config/settings_rmp.h"
 
+#if defined(USE_RMP_SERIAL)
+#include "io/serial.h"
+#endif
+#if defined(USE_STORAGE_IDLE_COMPACTION)
+#include "io/storage.h"
+#endif
 #include "io/sx127x.h"
 
 #if defined(USE_OTA)
@@ -34,12 +40,23 @@
 #include "p2p/p2p.h"
 #endif
 
+#if defined(USE_BENCHMARK)
+#include "platform/benchmark.h"
+#endif
+#include "platform/boot.h"
+#if defined(USE_COEX)
+#include "platform/coex.h"
+#endif
+#include "platform/power.h"
 #include "platform/system.h"
 
 #include "rc/rc.h"
 #include "rc/rc_data.h"
 
 #include "rmp/rmp.h"
+#if defined(USE_RMP_SERIAL)
+#include "rmp/rmp_serial.h"
+#endif
 
 #include "ui/led.h"
 #include "ui/ui.h"
@@ -47,10 +64,16 @@
 #include "util/macros.h"
 #include "util/time.h"
 
-#if defined(CONFIG_RAVEN_USE_PWM_OUTPUTS)
+#if defined(CONFIG_RAVEN_USE_PWM_OUTPUTS) || defined(USE_BENCHMARK)
 static const char *TAG = "Main";
 #endif
 
+// Maximum time the RC task blocks, so changes requested by other
+// tasks (e.g. starting bind) are picked up quickly.
+#define RC_TASK_MAX_WAIT_US MILLIS_TO_MICROS(20)
+// Time to wake up and bring the CPU back to full speed before a deadline
+#define RC_TASK_WAKE_MARGIN_US 200
+
 static air_radio_t radio = {
 #if defined(USE_RADIO_SX127X)
     .sx127x.spi_bus = SX127X_SPI_BUS,
@@ -79,12 +102,18 @@ static rmp_t rmp;
 #if defined(USE_P2P)
 static p2p_t p2p;
 #endif
+#if defined(USE_RMP_SERIAL)
+static rmp_serial_t rmp_serial;
+#endif
 static ui_t ui;
 
 static void shutdown(void)
 {
     air_radio_shutdown(&radio);
-    ui_shutdown(&ui);
+    if (boot_phase_is_done(BOOT_PHASE_UI))
+    {
+        ui_shutdown(&ui);
+    }
     system_shutdown();
 }
 
@@ -130,6 +159,12 @@ static void setting_changed(const setting_t *setting, void *user_data)
     {
         system_reboot();
     }
+#if defined(USE_COEX)
+    if (SETTING_IS(setting, SETTING_KEY_DEVELOPER_RADIO_COEX))
+    {
+        coex_set_enabled(settings_get_key_bool(SETTING_KEY_DEVELOPER_RADIO_COEX));
+    }
+#endif
 #endif
 
     if (SETTING_IS(setting, SETTING_KEY_POWER_OFF))
@@ -170,6 +205,10 @@ void task_ui(void *arg)
 {
     UNUSED(arg);
 
+    boot_wait_for_deferred_init();
+    ui_screen_init(&ui);
+    boot_phase_done(BOOT_PHASE_UI);
+
     if (ui_screen_is_available(&ui))
     {
         ui_screen_splash(&ui);
@@ -189,16 +228,67 @@ void task_rmp(void *arg)
 #if defined(USE_P2P)
     if (should_start_p2p())
     {
+        // Messages received from the RC link are queued meanwhile
+        boot_wait_for_deferred_init();
+        p2p_init(&p2p, &rmp);
         p2p_start(&p2p);
     }
 #endif
     for (;;)
     {
         rmp_update(&rmp);
-        vTaskDelay(10 / portTICK_PERIOD_MS);
+        settings_rmp_update();
+#if defined(USE_P2P)
+        p2p_update(&p2p);
+#endif
+#if defined(USE_COEX)
+        coex_update();
+#endif
+#if defined(USE_STORAGE_IDLE_COMPACTION)
+        // The step that compacts stalls the CPU for several erases,
+        // only do it while nothing is being controlled over the link
+        if (rc_is_failsafe_active(&rc, NULL))
+        {
+            storage_compact_step();
+        }
+#endif
     }
 }
 
+#if defined(USE_RMP_SERIAL)
+static void rmp_serial_log_output(const char *line, size_t size, void *user_data)
+{
+    rmp_serial_log(user_data, line, size);
+}
+
+void task_rmp_serial(void *arg)
+{
+    for (;;)
+    {
+        rmp_serial_update(arg);
+    }
+}
+
+static void rmp_serial_start(void)
+{
+    serial_port_config_t config = {
+        .baud_rate = RMP_SERIAL_BAUD_RATE,
+        .tx_buffer_size = RMP_SERIAL_TX_BUFFER_SIZE,
+        .rx_buffer_size = RMP_SERIAL_RX_WINDOW,
+        .parity = SERIAL_PARITY_DISABLE,
+        .stop_bits = SERIAL_STOP_BITS_1,
+    };
+    serial_port_t *port = serial_port_open_console(&config);
+    io_t io = SERIAL_IO(port);
+    rmp_serial_init(&rmp_serial, &rmp, &io);
+    rmp_serial_set_telemetry(&rmp_serial, &rc.data);
+    // From now on logs are only sent in frames. Anything written to
+    // the console before this point is skipped by the host.
+    log_set_output(rmp_serial_log_output, &rmp_serial);
+    CREATE_TASK(task_rmp_serial, "RMP-SERIAL", RMP_TASK_STACK_SIZE, &rmp_serial, 2, NULL, 0);
+}
+#endif
+
 void task_rc_update(void *arg)
 {
     UNUSED(arg);
@@ -206,31 +296,83 @@ void task_rc_update(void *arg)
     // Initialize the radio here so its interrupts
     // are fired in the same CPU as this task.
     air_radio_init(&radio);
+    boot_phase_done(BOOT_PHASE_RADIO);
     // Enable the WDT for this task
     hal_wd_add_task(NULL);
+    power_lock_acquire(POWER_LOCK_RADIO);
     for (;;)
     {
         rc_update(&rc);
         hal_wd_feed();
+        time_micros_t now = time_micros_now();
+        time_micros_t next = MIN(rc_next_update_at(&rc, now), now + RC_TASK_MAX_WAIT_US);
+        if (next > now + RC_TASK_WAKE_MARGIN_US)
+        {
+            // Blocking for n ticks wakes up after (n - 1, n] ticks, so
+            // this never oversleeps. The rest of the wait is spent
+            // polling with the CPU at full speed.
+            time_ticks_t ticks = MILLIS_TO_TICKS((next - now - RC_TASK_WAKE_MARGIN_US) / 1000);
+            if (ticks > 0)
+            {
+                // Nothing to do until the next radio window or interrupt,
+                // let the CPU scale down meanwhile.
+                power_lock_release(POWER_LOCK_RADIO);
+                air_radio_wait_for_irq(&radio, ticks);
+                power_lock_acquire(POWER_LOCK_RADIO);
+            }
+        }
     }
 }
 
 void app_main(void)
 {
     hal_init();
+    power_init();
+    boot_phase_done(BOOT_PHASE_HAL);
 
-#if defined(USE_OTA)
-    ota_init();
+#if defined(USE_BENCHMARK)
+    if (!benchmark_run())
+    {
+        LOG_E(TAG, "Benchmarks regressed, see above");
+    }
 #endif
 
     config_init();
     settings_add_listener(setting_changed, NULL);
+#if defined(USE_COEX) && defined(USE_DEVELOPER_MENU)
+    coex_set_enabled(settings_get_key_bool(SETTING_KEY_DEVELOPER_RADIO_COEX));
+#endif
+    boot_phase_done(BOOT_PHASE_CONFIG);
 
+    // Bring up the RC path first, so we get a working link as soon as
+    // possible (e.g. after a reset in flight). The screen, P2P and
+    // Bluetooth are initialized by their own tasks once the link is live.
     air_addr_t addr = config_get_addr();
     rmp_init(&rmp, &addr);
 
+    rc_init(&rc, &radio, &rmp);
+
+    // LEDs must be ready before the RC task starts, since entering
+    // bind mode sets the LED mode. Only the screen is deferred.
+    raven_ui_init();
+
+    CREATE_TASK(task_rc_update, "RC", RC_TASK_STACK_SIZE, NULL, 1, NULL, 1);
+    boot_phase_done(BOOT_PHASE_RC);
+
+#if defined(USE_OTA)
+    ota_init();
+#endif
+
     settings_rmp_init(&rmp);
 
+#if defined(USE_RMP_SERIAL) && defined(USE_DEVELOPER_MENU)
+    // Only applied at boot, since the console is lost once enabled
+    if (settings_get_key_bool(SETTING_KEY_DEVELOPER_SERIAL_RMP))
+    {
+        rmp_serial_start();
+    }
+#endif
+
 #if defined(USE_IDF_WMONITOR)
     if (settings_get_key_bool(SETTING_KEY_DEVELOPER_REMOTE_DEBUGGING))
     {
@@ -243,24 +385,10 @@ void app_main(void)
     }
 #endif
 
-#if defined(USE_P2P)
-    if (should_start_p2p())
-    {
-        p2p_init(&p2p, &rmp);
-    }
-#endif
-
-    rc_init(&rc, &radio, &rmp);
-
-    raven_ui_init();
-
-    CREATE_TASK(task_rc_update, "RC", RC_TASK_STACK_SIZE, NULL, 1, NULL, 1);
-
 #if defined(USE_BLUETOOTH)
     CREATE_TASK(task_bluetooh, "BLUETOOTH", 4096, &rc, 2, NULL, 0);
 #endif
 
     CREATE_TASK(task_rmp, "RMP", RMP_TASK_STACK_SIZE, NULL, 2, NULL, 0);
-    // Start updating the UI after everything else is set up, since it queries other subsystems
     CREATE_TASK(task_ui, "UI", UI_TASK_STACK_SIZE, NULL, 1, NULL, 0);
 }
@@ -4,6 +4,8 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "target/buffer_profile.h"
+
 #include "util/ringbuffer.h"
 
 // MSP codes we use
@@ -20,10 +22,12 @@
 #define MSP_MISC 114
 #define MSP_SET_TX_INFO 186
 #define MSP_SET_RAW_RC 200
+#define MSP_MULTIPLE_MSP 230
 
 // This is the maximum payload size we accept. MSP doesn't have
-// an upper boundary on payload sizes.
-#define MSP_MAX_PAYLOAD_SIZE 512
+// an upper boundary on payload sizes. It depends on the buffer
+// profile, see target/buffer_profile.h.
+#define MSP_MAX_PAYLOAD_SIZE BUFFER_MSP_MAX_PAYLOAD_SIZE
 
 typedef enum
 {
@@ -364,6 +364,12 @@ static int msp_serial_write(void *transport, msp_direction_e direction, uint16_t
         {
             return MSP_BUSY;
         }
+        // Response might be longer than our estimate, don't
+        // write while it's still being received.
+        if (io_is_busy(&serial->io))
+        {
+            return MSP_BUSY;
+        }
     }
 
     if (cmd <= 254)
@@ -18,6 +18,9 @@ static const char *TAG = "Output";
 #define OUTPUT_FC_MSP_UPDATE_INTERVAL SECS_TO_MICROS(5)
 #define OUTPUT_FC_MSP_SLOW_UPDATE_INTERVAL SECS_TO_MICROS(10)
 #define OUTPUT_FC_MSP_FAST_UPDATE_INTERVAL MILLIS_TO_MICROS(500)
+// Minimum time between MSP_SET_TX_INFO polls triggered by link quality
+// changes, so a fluctuating LQ doesn't flood the FC UART.
+#define OUTPUT_FC_MSP_TX_INFO_MIN_INTERVAL MILLIS_TO_MICROS(100)
 #define MSP_SEND_REQ(output, req) MSP_SEND_REQ_PAYLOAD(output, req, NULL, 0)
 #define MSP_SEND_REQ_PAYLOAD(output, req, payload, payload_size) OUTPUT_MSP_SEND_REQ_PAYLOAD(output, req, payload, payload_size, output_msp_callback)
 
@@ -27,6 +30,12 @@ static const char *TAG = "Output";
 #define FW_VARIANT_INAV FW_VARIANT_CONST('I', 'N', 'A', 'V')
 #define FW_VARIANT_BF FW_VARIANT_CONST('B', 'T', 'F', 'L')
 
+#define OUTPUT_MSP_POLL_STATS_INTERVAL SECS_TO_MICROS(30)
+#define OUTPUT_RC_LATENCY_STATS_INTERVAL SECS_TO_MICROS(10)
+#define OUTPUT_SERIAL_STATS_INTERVAL SECS_TO_MICROS(30)
+
+_Static_assert(TELEMETRY_DOWNLINK_COUNT <= 32, "output_msp_poll_t.telemetry can't hold all downlink telemetry");
+
 static void telemetry_updated_callback(void *data, telemetry_downlink_id_e id, telemetry_val_t *val)
 {
     output_t *output = data;
@@ -42,6 +51,12 @@ static void telemetry_updated_callback(void *data, telemetry_downlink_id_e id, t
         telemetry->val = *val;
     }
     data_state_update(&telemetry->data_state, changed, now);
+    uint32_t bit = 1u << TELEMETRY_DOWNLINK_GET_IDX(id);
+    output->poll_response.updated |= bit;
+    if (changed)
+    {
+        output->poll_response.changed |= bit;
+    }
 }
 
 static void telemetry_calculate_callback(void *data, telemetry_downlink_id_e id)
@@ -118,6 +133,7 @@ static void output_msp_configure_poll(output_t *output, uint16_t cmd, time_micro
         {
             output->fc.polls[ii].interval = interval;
             output->fc.polls[ii].next_poll = 0;
+            output->fc.polls[ii].current_interval = 0;
             return;
         }
     }
@@ -129,6 +145,8 @@ static void output_msp_configure_poll(output_t *output, uint16_t cmd, time_micro
             output->fc.polls[ii].cmd = cmd;
             output->fc.polls[ii].interval = interval;
             output->fc.polls[ii].next_poll = 0;
+            output->fc.polls[ii].current_interval = 0;
+            output->fc.polls[ii].telemetry = 0;
             return;
         }
     }
@@ -181,6 +199,9 @@ static void output_msp_configure_polling(output_t *output)
 static void output_msp_callback(msp_conn_t *conn, uint16_t cmd, const void *payload, int size, void *callback_data)
 {
     output_t *output = callback_data;
+    output_msp_poll_t *poll = output_msp_poll_find(output->fc.polls, OUTPUT_FC_MAX_NUM_POLLS, cmd);
+    bool changed = false;
+    output_msp_poll_response_begin(output);
     switch (cmd)
     {
     case MSP_FC_VARIANT:
@@ -224,6 +245,7 @@ static void output_msp_callback(msp_conn_t *conn, uint16_t cmd, const void *payl
             // MSP based FCs return 0 to mean disabled, non-zero to indicate
             // that the channel number (from 1) is the RSSI channel.
             uint8_t fc_rssi_channel = *((const uint8_t *)payload);
+            changed = fc_rssi_channel != output->fc.rssi.channel + 1;
             if (fc_rssi_channel > 0)
             {
                 output->fc.rssi.channel = fc_rssi_channel - 1;
@@ -245,11 +267,19 @@ static void output_msp_callback(msp_conn_t *conn, uint16_t cmd, const void *payl
         }
         break;
     case MSP_SET_TX_INFO:
+        // Setters get an empty response, so there's nothing to compare.
+        // Keep the base rate, since the FC expires MSP RSSI values that
+        // are not refreshed.
+        changed = true;
         break;
     default:
         LOG_W(TAG, "Got a callback for unexpected MSP cmd %u", cmd);
         break;
     }
+    if (poll)
+    {
+        output_msp_poll_response_end(output, poll, changed);
+    }
 }
 
 static void output_msp_poll(output_t *output, time_micros_t now)
@@ -272,35 +302,45 @@ static void output_msp_poll(output_t *output, time_micros_t now)
 
     for (int ii = 0; ii < OUTPUT_FC_MAX_NUM_POLLS; ii++)
     {
-        time_micros_t interval = output->fc.polls[ii].interval;
-        if (interval == 0)
+        output_msp_poll_t *poll = &output->fc.polls[ii];
+        if (poll->interval > 0 && poll->cmd == MSP_SET_TX_INFO)
         {
-            // Note we don't break because we might support polls that can be
-            // enabled or disabled depending on other polls (e.g. GPS features)
-            continue;
+            int8_t lq = TELEMETRY_GET_I8(output->rc_data, TELEMETRY_ID_RX_LINK_QUALITY);
+            if (lq != output->fc.last_tx_info_lq)
+            {
+                // Make sure the FC sees link quality changes quickly,
+                // but never poll faster than the minimum interval.
+                time_micros_t next_poll = MAX(poll->last_poll + OUTPUT_FC_MSP_TX_INFO_MIN_INTERVAL, now);
+                poll->next_poll = MIN(poll->next_poll, next_poll);
+                output->fc.last_tx_info_lq = lq;
+            }
         }
-        if (output->fc.polls[ii].next_poll < now)
+        // Note we don't break on disabled polls because we might support polls
+        // that can be enabled or disabled depending on other polls (e.g. GPS features)
+        if (output_msp_poll_is_due(output, poll, now))
         {
             size_t size = 0;
             const void *payload = NULL;
             // Possible payloads
             uint8_t u8;
-            uint16_t cmd = output->fc.polls[ii].cmd;
-            switch (cmd)
+            int8_t lq;
+            switch (poll->cmd)
             {
             case MSP_SET_TX_INFO:
                 // RSSI is a single byte in the [0, 255] range
-                u8 = TELEMETRY_GET_I8(output->rc_data, TELEMETRY_ID_RX_LINK_QUALITY) * (255.0f / 100);
+                lq = TELEMETRY_GET_I8(output->rc_data, TELEMETRY_ID_RX_LINK_QUALITY);
+                u8 = lq * (255.0f / 100);
                 payload = &u8;
                 size = sizeof(u8);
                 break;
             }
-            if (MSP_SEND_REQ_PAYLOAD(output, cmd, payload, size) > 0)
+            if (MSP_SEND_REQ_PAYLOAD(output, poll->cmd, payload, size) > 0)
             {
-                output->fc.polls[ii].next_poll = now + interval;
+                output_msp_poll_sent(poll, now);
             }
         }
     }
+    output_msp_polls_log_stats(output->fc.polls, OUTPUT_FC_MAX_NUM_POLLS, &output->fc.poll_stats_since, now);
 }
 
 static void output_configure_rssi(output_t *output)
@@ -352,6 +392,9 @@ bool output_open(rc_data_t *data, output_t *output, void *config)
             output->max_rc_update_interval = FREQ_TO_MICROS(5);
             output->next_rc_update_no_earlier_than = 0;
             output->next_rc_update_no_later_than = TIME_MICROS_MAX;
+            output->rc_frame.size = 0;
+            memset(&output->rc_latency, 0, sizeof(output->rc_latency));
+            output->serial_stats_since = 0;
             is_open = output->is_open = output->vtable.open(output, config);
             if (is_open)
             {
@@ -362,6 +405,73 @@ bool output_open(rc_data_t *data, output_t *output, void *config)
     return is_open;
 }
 
+static time_micros_t output_rc_data_since(output_t *output)
+{
+    time_micros_t since = 0;
+    for (unsigned ii = 0; ii < output->rc_data->channels_num; ii++)
+    {
+        time_micros_t dirty_since = output->rc_data->channels[ii].data_state.dirty_since;
+        if (dirty_since > 0 && (since == 0 || dirty_since < since))
+        {
+            since = dirty_since;
+        }
+    }
+    return since;
+}
+
+static void output_encode_rc(output_t *output)
+{
+    output->rc_frame.size = output->vtable.encode_rc(output, output->rc_data, output->rc_frame.buf, sizeof(output->rc_frame.buf));
+    output->rc_frame.data_since = output_rc_data_since(output);
+}
+
+static void output_rc_latency_update(output_t *output, time_micros_t now)
+{
+    if (output->rc_frame.data_since > 0 && now > output->rc_frame.data_since)
+    {
+        time_micros_t latency = now - output->rc_frame.data_since;
+        if (output->rc_latency.count == 0 || latency < output->rc_latency.min)
+        {
+            output->rc_latency.min = latency;
+        }
+        if (latency > output->rc_latency.max)
+        {
+            output->rc_latency.max = latency;
+        }
+        output->rc_latency.sum += latency;
+        output->rc_latency.count++;
+    }
+    if (output->rc_latency.since == 0)
+    {
+        output->rc_latency.since = now;
+    }
+    else if (now > output->rc_latency.since + OUTPUT_RC_LATENCY_STATS_INTERVAL)
+    {
+        if (output->rc_latency.count > 0)
+        {
+            LOG_I(TAG, "RC latency: min %uus, avg %uus, max %uus (%u frames)",
+                  (unsigned)output->rc_latency.min, (unsigned)(output->rc_latency.sum / output->rc_latency.count),
+                  (unsigned)output->rc_latency.max, output->rc_latency.count);
+        }
+        memset(&output->rc_latency, 0, sizeof(output->rc_latency));
+        output->rc_latency.since = now;
+    }
+}
+
+const void *output_get_rc_frame(output_t *output, size_t *size)
+{
+    if (output->rc_frame.size == 0)
+    {
+        output_encode_rc(output);
+    }
+    output_rc_latency_update(output, time_micros_now());
+    *size = output->rc_frame.size;
+    // Consumed, the next send will either use data which arrived
+    // in the meantime or encode the frame again.
+    output->rc_frame.size = 0;
+    return output->rc_frame.buf;
+}
+
 bool output_update(output_t *output, bool input_was_updated, time_micros_t now)
 {
     bool updated = false;
@@ -375,10 +485,16 @@ bool output_update(output_t *output, bool input_was_updated, time_micros_t now)
         bool can_update_via_max_interval = now > output->next_rc_update_no_later_than &&
                                            !failsafe_is_active(output->rc_data->failsafe.input);
         bool can_update_via_new_data = input_was_updated || rc_data_has_dirty_channels(output->rc_data);
+        // Encode the frame as soon as new data arrives, even if we can't send
+        // it yet due to min_rc_update_interval, so sending it just requires
+        // starting the write.
+        bool encode_rc = can_update_via_new_data && output->vtable.encode_rc;
         if (can_update_already && (can_update_via_max_interval || can_update_via_new_data))
         {
             update_rc = true;
-
+        }
+        if (update_rc || encode_rc)
+        {
             if (output->fc.rssi.channel >= 0 && output->fc.rssi.channel < RC_CHANNELS_NUM)
             {
                 rssi_channel = &output->rc_data->channels[output->fc.rssi.channel];
@@ -387,6 +503,10 @@ bool output_update(output_t *output, bool input_was_updated, time_micros_t now)
                 rssi_channel->value = RC_CHANNEL_VALUE_FROM_PERCENTAGE(lq);
             }
         }
+        if (encode_rc)
+        {
+            output_encode_rc(output);
+        }
         updated = output->vtable.update(output, output->rc_data, update_rc, now);
         if (updated && update_rc)
         {
@@ -408,6 +528,11 @@ bool output_update(output_t *output, bool input_was_updated, time_micros_t now)
         }
         failsafe_update(&output->failsafe, time_micros_now());
 
+        if (output->serial_port)
+        {
+            output_serial_log_stats(output->serial_port, &output->serial_stats_since, now);
+        }
+
         // Read MSP transport responses (if any)
         if (msp_io_is_connected(&output->msp))
         {
@@ -423,6 +548,152 @@ bool output_update(output_t *output, bool input_was_updated, time_micros_t now)
     return updated;
 }
 
+bool output_msp_poll_is_due(output_t *output, output_msp_poll_t *poll, time_micros_t now)
+{
+    if (poll->interval == 0)
+    {
+        return false;
+    }
+    if (poll->current_interval == 0)
+    {
+        poll->current_interval = poll->interval;
+    }
+    if (poll->next_poll >= now)
+    {
+        return false;
+    }
+    // If the downlink hasn't sent the values from the previous response
+    // yet, polling again won't get them to the other end any sooner. Wait
+    // until they've been drained, but never for longer than the maximum
+    // backoff in case there's no downlink consuming them.
+    if (poll->last_poll + poll->interval * OUTPUT_MSP_POLL_MAX_BACKOFF >= now)
+    {
+        for (int ii = 0; ii < TELEMETRY_DOWNLINK_COUNT; ii++)
+        {
+            if ((poll->telemetry & (1u << ii)) && data_state_is_dirty(&output->rc_data->telemetry_downlink[ii].data_state))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void output_msp_poll_sent(output_msp_poll_t *poll, time_micros_t now)
+{
+    poll->last_poll = now;
+    poll->next_poll = now + poll->current_interval;
+}
+
+output_msp_poll_t *output_msp_poll_find(output_msp_poll_t *polls, size_t count, uint16_t cmd)
+{
+    for (size_t ii = 0; ii < count; ii++)
+    {
+        if (polls[ii].interval > 0 && polls[ii].cmd == cmd)
+        {
+            return &polls[ii];
+        }
+    }
+    return NULL;
+}
+
+void output_msp_poll_response_begin(output_t *output)
+{
+    output->poll_response.updated = 0;
+    output->poll_response.changed = 0;
+}
+
+void output_msp_poll_response_end(output_t *output, output_msp_poll_t *poll, bool changed)
+{
+    poll->telemetry |= output->poll_response.updated;
+    poll->count++;
+    if (changed || output->poll_response.changed)
+    {
+        // Values are moving, poll at the base rate
+        poll->current_interval = poll->interval;
+    }
+    else
+    {
+        // Nothing changed, back off exponentially
+        poll->current_interval = MIN(poll->current_interval * 2, poll->interval * OUTPUT_MSP_POLL_MAX_BACKOFF);
+    }
+}
+
+void output_msp_polls_log_stats(output_msp_poll_t *polls, size_t count, time_micros_t *since, time_micros_t now)
+{
+    if (*since == 0)
+    {
+        *since = now;
+        return;
+    }
+    if (now < *since + OUTPUT_MSP_POLL_STATS_INTERVAL)
+    {
+        return;
+    }
+    unsigned elapsed_ms = (now - *since) / 1000;
+    for (size_t ii = 0; ii < count; ii++)
+    {
+        output_msp_poll_t *poll = &polls[ii];
+        if (poll->interval == 0)
+        {
+            continue;
+        }
+        LOG_D(TAG, "MSP poll %u: %u responses in %u ms (base interval %u ms, current %u ms)",
+              poll->cmd, poll->count, elapsed_ms,
+              (unsigned)(poll->interval / 1000), (unsigned)(poll->current_interval / 1000));
+        poll->count = 0;
+    }
+    *since = now;
+}
+
+bool output_msp_fc_supports_multiple(output_t *output)
+{
+    // MSP_MULTIPLE_MSP was introduced in Betaflight 4.0
+    return output_msp_fc_is_at_least(output, FW_VARIANT_BF, 4, 0, 0);
+}
+
+time_micros_t output_next_update_at(output_t *output, time_micros_t now)
+{
+    if (!output || !output->is_open)
+    {
+        return TIME_MICROS_MAX;
+    }
+    if (!output->vtable.next_update_at)
+    {
+        return now;
+    }
+    time_micros_t next = output->vtable.next_update_at(output, now);
+    if (!OUTPUT_HAS_FLAG(output, OUTPUT_FLAG_REMOTE))
+    {
+        // New channel data is sent once the minimum interval has passed,
+        // otherwise the last values are repeated after the maximum one.
+        if (rc_data_has_dirty_channels(output->rc_data))
+        {
+            next = MIN(next, output->next_rc_update_no_earlier_than);
+        }
+        if (!failsafe_is_active(output->rc_data->failsafe.input))
+        {
+            next = MIN(next, output->next_rc_update_no_later_than);
+        }
+        if (msp_io_is_connected(&output->msp))
+        {
+            if (output->fc.fw_version_is_pending)
+            {
+                return now;
+            }
+            next = MIN(next, output->fc.next_fw_update);
+            for (int ii = 0; ii < OUTPUT_FC_MAX_NUM_POLLS; ii++)
+            {
+                if (output->fc.polls[ii].interval > 0)
+                {
+                    next = MIN(next, output->fc.polls[ii].next_poll);
+                }
+            }
+        }
+    }
+    return next;
+}
+
 void output_close(output_t *output, void *config)
 {
     if (output && output->is_open && output->vtable.close)
@@ -432,3 +703,25 @@ void output_close(output_t *output, void *config)
         settings_remove_listener(output_setting_changed, output);
     }
 }
+
+void output_serial_log_stats(serial_port_t *port, time_micros_t *since, time_micros_t now)
+{
+    if (!port || !serial_port_is_half_duplex(port))
+    {
+        return;
+    }
+    if (*since == 0)
+    {
+        *since = now;
+        return;
+    }
+    if (now < *since + OUTPUT_SERIAL_STATS_INTERVAL)
+    {
+        return;
+    }
+    serial_half_duplex_stats_t stats;
+    serial_port_get_half_duplex_stats(port, &stats);
+    LOG_D(TAG, "Half duplex: %u turnarounds, %u collisions, RX enable %uus (max %uus), response %uus",
+          stats.turnarounds, stats.collisions, stats.rx_enable_us, stats.max_rx_enable_us, stats.response_us);
+    *since = now;
+}
@@ -27,6 +27,16 @@ typedef struct output_vtable_s
     // Returns wheter the RC data update was sent to the FC
     bool (*update)(void *output, rc_data_t *data, bool update_control, time_micros_t now);
     void (*close)(void *output, void *config);
+    // Optional. Encodes the RC data into buf, ready to be written to the
+    // serial port. Returns the frame size. If provided, it's called as soon
+    // as new channel data arrives, so update() only needs to write the frame
+    // obtained via output_get_rc_frame().
+    size_t (*encode_rc)(void *output, rc_data_t *data, void *buf, size_t size);
+    // Optional. Returns the time by which update() must be called again,
+    // assuming radio interrupts wake up the RC task earlier. RC updates
+    // and MSP polls are accounted for by output_next_update_at(). Outputs
+    // without it are updated continuously.
+    time_micros_t (*next_update_at)(void *output, time_micros_t now);
 } output_vtable_t;
 
 #define OUTPUT_TELEMETRY_UPDATE(output, id, v) ((output_t *)output)->telemetry_updated(output, id, v)
@@ -99,14 +109,25 @@ typedef struct output_vtable_s
 
 // Used for polling MSP-capable endpoints for e.g. configuration settings
 // which might affect other telemetry or stuff that's only available via
-// MSP (like the craft name).
+// MSP (like the craft name). The effective interval adapts between
+// interval and interval * OUTPUT_MSP_POLL_MAX_BACKOFF, growing while the
+// responses don't change any value and while the downlink hasn't sent the
+// telemetry from the previous response yet.
 typedef struct output_msp_poll_s
 {
     uint16_t cmd;
-    time_micros_t interval;
+    time_micros_t interval;         // Base interval, zero means disabled
     time_micros_t next_poll;
+    time_micros_t current_interval; // Adapted interval, zero until the first poll
+    time_micros_t last_poll;
+    uint32_t telemetry;             // Downlink telemetry updated by the responses, by index
+    unsigned count;                 // Responses since the last stats report
 } output_msp_poll_t;
 
+#define OUTPUT_MSP_POLL_MAX_BACKOFF 8
+// Big enough for a CRSF RC frame or a fully escaped FPort
+// control frame followed by a telemetry request.
+#define OUTPUT_RC_FRAME_SIZE_MAX 96
 #define OUTPUT_FC_MAX_NUM_POLLS 10
 
 typedef struct output_fc_s
@@ -121,6 +142,8 @@ typedef struct output_fc_s
         int8_t channel;
     } rssi;
     output_msp_poll_t polls[OUTPUT_FC_MAX_NUM_POLLS];
+    time_micros_t poll_stats_since;
+    int8_t last_tx_info_lq;
 } output_fc_t;
 
 typedef struct setting_s setting_t;
@@ -142,6 +165,29 @@ typedef struct output_s
     telemetry_downlink_f telemetry_calculate;
     msp_io_t msp;
     output_fc_t fc;
+    struct
+    {
+        uint32_t updated; // Downlink telemetry updated by the response being handled, by index
+        uint32_t changed; // Subset of updated whose value changed
+    } poll_response;
+    // Pre-encoded RC frame, see output_vtable_t.encode_rc
+    struct
+    {
+        uint8_t buf[OUTPUT_RC_FRAME_SIZE_MAX];
+        size_t size;              // Zero when there's no pending frame
+        time_micros_t data_since; // Oldest channel update in the frame
+    } rc_frame;
+    // Time from the channel data arriving until its frame starts
+    // being written to the FC
+    struct
+    {
+        time_micros_t min;
+        time_micros_t max;
+        time_micros_t sum;
+        unsigned count;
+        time_micros_t since;
+    } rc_latency;
+    time_micros_t serial_stats_since;
     time_micros_t min_rc_update_interval;
     time_micros_t max_rc_update_interval;
     time_micros_t next_rc_update_no_earlier_than;
@@ -155,4 +201,31 @@ bool output_open(rc_data_t *data, output_t *output, void *config);
 // input_was_updated will be true iff the input returned new data
 // during this cycle.
 bool output_update(output_t *output, bool input_was_updated, time_micros_t now);
+// Returns the time by which output_update() must be called again,
+// now if the output needs to be updated continuously.
+time_micros_t output_next_update_at(output_t *output, time_micros_t now);
 void output_close(output_t *output, void *config);
+
+// Returns the frame for the current RC data, encoding it if there's no
+// pre-encoded one. Must be called right before writing the frame, since
+// it also tracks the RC latency. Only valid for outputs with encode_rc.
+const void *output_get_rc_frame(output_t *output, size_t *size);
+
+// Adaptive MSP polling, shared by all MSP capable outputs.
+// Returns true iff the poll should be sent now.
+bool output_msp_poll_is_due(output_t *output, output_msp_poll_t *poll, time_micros_t now);
+void output_msp_poll_sent(output_msp_poll_t *poll, time_micros_t now);
+// Returns the poll in the table for the given cmd or NULL
+output_msp_poll_t *output_msp_poll_find(output_msp_poll_t *polls, size_t count, uint16_t cmd);
+// Must bracket the handling of a poll response, so the poll interval
+// can be adapted to how often the values change. changed indicates
+// if the response changed any value not tracked as telemetry.
+void output_msp_poll_response_begin(output_t *output);
+void output_msp_poll_response_end(output_t *output, output_msp_poll_t *poll, bool changed);
+// Logs the achieved poll rates and resets the counters
+void output_msp_polls_log_stats(output_msp_poll_t *polls, size_t count, time_micros_t *since, time_micros_t now);
+// Returns true iff the FC supports MSP_MULTIPLE_MSP for batching requests
+bool output_msp_fc_supports_multiple(output_t *output);
+// Logs the stats for half duplex ports periodically. Called
+// automatically for output_t.serial_port.
+void output_serial_log_stats(serial_port_t *port, time_micros_t *since, time_micros_t now);
@@ -4,6 +4,8 @@
 
 #include "config/config.h"
 
+#include "platform/coex.h"
+
 #include "output_air.h"
 
 #define CHANNEL_TO_AIR_OUTPUT(ch) RC_CHANNEL_ENCODE_TO_BITS(ch, AIR_CHANNEL_BITS)
@@ -16,7 +18,25 @@ static time_micros_t cycle_begin;
 static time_micros_t cycle_end;
 #endif
 
+#ifdef AIR_DEBUG_THROUGHPUT
+static time_micros_t throughput_since;
+static unsigned throughput_frames;
+static unsigned throughput_ext_frames;
+static unsigned throughput_output_bytes;
+static unsigned throughput_input_bytes;
+static unsigned throughput_suppressed;
+#define THROUGHPUT_REPORT_INTERVAL_US SECS_TO_MICROS(5)
+#endif
+
 #define MODE_SWITCH_WAIT_INTERVAL_US MILLIS_TO_MICROS(1000)
+// Time to keep sending extended frames after an MSP request, so the
+// RX can use them to send the response.
+#define FRAME_EXT_RESPONSE_WINDOW_US MILLIS_TO_MICROS(500)
+// Switch to the longest mode when channels don't change for this time,
+// to reduce the packet rate (and power) while the radio sits idle.
+#define IDLE_AFTER_US SECS_TO_MICROS(30)
+// Changes smaller than this are considered stick noise
+#define IDLE_CHANNEL_TOLERANCE 8
 
 typedef enum
 {
@@ -57,7 +77,18 @@ static void output_air_update_mode(output_air_t *output_air)
     output_air->air_modes.faster = air_mode_faster(air_mode, output_air->air_modes.common);
     output_air->air_modes.longer = air_mode_longer(air_mode, output_air->air_modes.common);
     output_air->cycle_time = air_radio_cycle_time(radio, air_mode);
+    output_air->frame_ext.max_size = air_radio_frame_ext_max_size(radio);
+    output_air->frame_ext.downlink_time = air_radio_frame_ext_time(radio, sizeof(air_rx_packet_t), output_air->frame_ext.max_size);
     output_air_invalidate_mode_sw(output_air);
+    if (output_air->idle.left_at > 0 && air_mode == output_air->idle.restore_mode)
+    {
+        LOG_I(TAG, "Restored mode %d %u ms after leaving idle", air_mode,
+              (unsigned)((time_micros_now() - output_air->idle.left_at) / 1000));
+        output_air->idle.left_at = 0;
+    }
+#ifdef AIR_DEBUG_THROUGHPUT
+    throughput_since = 0;
+#endif
     failsafe_set_max_interval(&output_air->output.failsafe, air_radio_tx_failsafe_interval(radio, air_mode));
 }
 
@@ -70,6 +101,43 @@ static void output_air_update_frequency(output_air_t *output_air, unsigned freq_
     }
 }
 
+// When sharing the radio, the seq advances once per slot in the frame
+// rather than once per packet. The RX sees the slots for other outputs
+// as lost packets and hops once per slot too, so it stays in sync even
+// when it misses our packets.
+static unsigned output_air_seq_step(output_air_t *output_air)
+{
+    return output_air->tdma.slots > 0 ? output_air->tdma.slots : 1;
+}
+
+// Schedules our next slot, keeping the slots aligned to the frame. If
+// we missed whole frames, their seqs are skipped too, since the RX
+// hopped over them.
+static void output_air_tdma_schedule_next_slot(output_air_t *output_air, time_micros_t now)
+{
+    time_micros_t frame_time = output_air->cycle_time * output_air->tdma.slots;
+    while (now >= output_air->next_packet + frame_time)
+    {
+        output_air->next_packet += frame_time;
+        output_air->seq += output_air->tdma.slots;
+    }
+    output_air->next_packet += frame_time;
+}
+
+static void output_air_claim_radio(output_air_t *output_air)
+{
+    air_radio_t *radio = output_air->air_config.radio;
+    bool orthogonal = output_air->air.pairing_info.capabilities & AIR_CAP_ORTHOGONAL_HOPPING;
+    *output_air->tdma.owner = output_air;
+    air_radio_sleep(radio);
+    air_radio_set_variable_length_frames(radio, false);
+    air_radio_set_mode(radio, output_air->air_modes.current);
+    air_radio_set_sync_word(radio, air_sync_word(output_air->air.pairing.key, orthogonal));
+    air_radio_set_callback(radio, output_air_radio_callback, output_air);
+    // Force retuning, the previous slot used another hop table
+    output_air->freq_index = 0xFF;
+}
+
 static void output_air_start_switch_air_mode(output_air_t *output_air)
 {
     air_mode_e requested = output_air->air_modes.sw.requested;
@@ -106,12 +174,14 @@ static void output_air_start(output_air_t *output_air)
 {
     air_radio_t *radio = output_air->air_config.radio;
     unsigned long center_freq = air_band_frequency(output_air->air_config.band);
+    bool orthogonal = output_air->air.pairing_info.capabilities & AIR_CAP_ORTHOGONAL_HOPPING;
     air_radio_calibrate(radio, center_freq);
+    air_radio_set_variable_length_frames(radio, output_air->frame_ext.enabled);
     output_air_update_mode(output_air);
     air_radio_set_tx_power(radio, output_air->tx_power);
     output_air->tx_power = -1;
-    air_radio_set_sync_word(radio, air_sync_word(output_air->air.pairing.key));
-    air_freq_table_init(&output_air->air.freq_table, output_air->air.pairing.key, center_freq);
+    air_radio_set_sync_word(radio, air_sync_word(output_air->air.pairing.key, orthogonal));
+    air_freq_table_init(&output_air->air.freq_table, output_air->air.pairing.key, center_freq, orthogonal);
     output_air->freq_index = 0xFF;
     output_air_update_frequency(output_air, 0);
     air_radio_set_callback(radio, output_air_radio_callback, output_air);
@@ -159,7 +229,8 @@ static void output_air_stream_telemetry_decoded(void *user, int telemetry_id, co
                 output_air_start_switch_air_mode(output_air);
             }
         }
-        else if (air_mode_is_valid(output_air->air_modes.faster) &&
+        else if (!output_air->idle.active &&
+                 air_mode_is_valid(output_air->air_modes.faster) &&
                  air_radio_should_switch_to_faster_mode(output_air->air_config.radio,
                                                         output_air->air_modes.current,
                                                         output_air->air_modes.faster,
@@ -232,6 +303,61 @@ static void output_air_stream_cmd_decoded(void *user, air_cmd_e cmd, const void
     }
 }
 
+static void output_air_request_mode(output_air_t *output_air, air_mode_e mode)
+{
+    if (mode != output_air->air_modes.current && !air_cmd_switch_mode_ack_in_progress(&output_air->air_modes.sw.ack))
+    {
+        output_air->air_modes.sw.requested = mode;
+        output_air_start_switch_air_mode(output_air);
+    }
+}
+
+static void output_air_update_idle(output_air_t *output_air, rc_data_t *data, time_micros_t now)
+{
+    // There's no arming state in the link, so we consider the aircraft
+    // idle when no channel (including the arm switch) moves for a while.
+    bool changed = false;
+    for (unsigned ii = 0; ii < data->channels_num; ii++)
+    {
+        int delta = (int)data->channels[ii].value - output_air->idle.channels[ii];
+        if (delta > IDLE_CHANNEL_TOLERANCE || delta < -IDLE_CHANNEL_TOLERANCE)
+        {
+            output_air->idle.channels[ii] = data->channels[ii].value;
+            changed = true;
+        }
+    }
+    if (changed)
+    {
+        output_air->idle.changed_at = now;
+        if (output_air->idle.active)
+        {
+            LOG_I(TAG, "Leaving idle, restoring mode %d", output_air->idle.restore_mode);
+            output_air->idle.active = false;
+            if (output_air->idle.restore_mode != output_air->air_modes.current)
+            {
+                output_air->idle.left_at = now;
+                output_air_request_mode(output_air, output_air->idle.restore_mode);
+            }
+        }
+        return;
+    }
+    if (!output_air->idle.active && now - output_air->idle.changed_at > IDLE_AFTER_US)
+    {
+        LOG_I(TAG, "Channels idle, switching to mode %d", output_air->air_modes.longest);
+        output_air->idle.active = true;
+        output_air->idle.restore_mode = output_air->air_modes.current;
+        output_air->idle.left_at = 0;
+        output_air_request_mode(output_air, output_air->air_modes.longest);
+    }
+}
+
+static unsigned output_air_seq_to_send(output_air_t *output_air, unsigned cur_seq, size_t count)
+{
+    // Same as AIR_SEQ_TO_SEND_UPLINK(), taking the seq step into account
+    unsigned packets = (count + AIR_UPLINK_DATA_BYTES - 1) / AIR_UPLINK_DATA_BYTES;
+    return (cur_seq + packets * output_air_seq_step(output_air)) % AIR_SEQ_COUNT;
+}
+
 static size_t output_air_feed_stream(output_air_t *output_air, rc_data_t *data, unsigned cur_seq, time_micros_t now, size_t *count)
 {
     control_channel_t *dch = NULL;
@@ -279,14 +405,14 @@ static size_t output_air_feed_stream(output_air_t *output_air, rc_data_t *data,
     {
         size_t n = air_stream_feed_output_channel(&output_air->air_stream, dchn, dch->value);
         *count += n;
-        data_state_sent(&dch->data_state, AIR_SEQ_TO_SEND_UPLINK(cur_seq, *count), now);
+        data_state_sent(&dch->data_state, output_air_seq_to_send(output_air, cur_seq, *count), now);
         return n;
     }
     if (dt)
     {
         size_t n = air_stream_feed_output_uplink_telemetry(&output_air->air_stream, dt, TELEMETRY_UPLINK_ID(dtidx));
         *count += n;
-        data_state_sent(&dt->data_state, AIR_SEQ_TO_SEND_UPLINK(cur_seq, *count), now);
+        data_state_sent(&dt->data_state, output_air_seq_to_send(output_air, cur_seq, *count), now);
         return n;
     }
     // No data to send
@@ -299,8 +425,57 @@ static void output_air_msp_before_feed(msp_air_t *msp_air, size_t size, void *us
     // request, to prevent uplink starvation when too may MSP requests come
     output_air_t *output_air = user_data;
     output_air->force_stream_feed = true;
+    output_air->frame_ext.until = time_micros_now() + FRAME_EXT_RESPONSE_WINDOW_US;
+}
+
+static bool output_air_should_extend_frame(output_air_t *output_air, time_micros_t now)
+{
+    if (output_air->frame_ext.max_size == 0 || output_air->tdma.slots > 0)
+    {
+        // Extended frames would overflow into the next slot
+        return false;
+    }
+    // Extend the frame if there's more data than what fits in a regular
+    // packet, if we're waiting for a response or if the RX filled its
+    // last extended frame (so it probably has more data to send).
+    return air_stream_output_count(&output_air->air_stream) > 0 ||
+           now < output_air->frame_ext.until ||
+           output_air->frame_ext.downlink_busy;
 }
 
+#ifdef AIR_DEBUG_THROUGHPUT
+static void output_air_debug_throughput(output_air_t *output_air, bool extended, time_micros_t now)
+{
+    air_stream_t *s = &output_air->air_stream;
+    if (throughput_since == 0)
+    {
+        throughput_since = now;
+        throughput_frames = 0;
+        throughput_ext_frames = 0;
+        throughput_output_bytes = s->output_bytes;
+        throughput_input_bytes = s->input_bytes;
+        throughput_suppressed = output_air->output.rc_data->filter.suppressed;
+    }
+    throughput_frames++;
+    if (extended)
+    {
+        throughput_ext_frames++;
+    }
+    time_micros_t elapsed = now - throughput_since;
+    if (elapsed >= THROUGHPUT_REPORT_INTERVAL_US)
+    {
+        float secs = elapsed / 1e6f;
+        LOG_I(TAG, "Mode %d: %.1f B/s uplink, %.1f B/s downlink, %u/%u extended frames, %u channel updates suppressed",
+              output_air->air_modes.current,
+              (s->output_bytes - throughput_output_bytes) / secs,
+              (s->input_bytes - throughput_input_bytes) / secs,
+              throughput_ext_frames, throughput_frames,
+              output_air->output.rc_data->filter.suppressed - throughput_suppressed);
+        throughput_since = 0;
+    }
+}
+#endif
+
 static void output_air_send_control_packet(output_air_t *output_air, rc_data_t *data, time_micros_t now)
 {
     if (output_air->tx_power >= 0)
@@ -334,6 +509,10 @@ static void output_air_send_control_packet(output_air_t *output_air, rc_data_t *
         LOG_I(TAG, "Switch to mode %d for seq %u", output_air->air_modes.current, output_air->seq);
         output_air_update_mode(output_air);
     }
+    if (output_air->tdma.slots > 0)
+    {
+        output_air_tdma_schedule_next_slot(output_air, now);
+    }
     output_air_update_frequency(output_air, output_air->seq);
     air_io_on_frame(&output_air->air, now);
     if (output_air->expecting_downlink_packet)
@@ -341,7 +520,10 @@ static void output_air_send_control_packet(output_air_t *output_air, rc_data_t *
         LOG_D(TAG, "Missing or invalid downlink packet");
         output_air_stop_ack(output_air, data);
     }
-    output_air->next_packet = now + output_air->cycle_time;
+    if (output_air->tdma.slots == 0)
+    {
+        output_air->next_packet = now + output_air->cycle_time;
+    }
     output_air->expecting_downlink_packet = true;
     // If the input is in failsafe mode, connection with the control side was
     // lost (e.g. cable to the radio was broken?), so we stop sending control
@@ -351,17 +533,22 @@ static void output_air_send_control_packet(output_air_t *output_air, rc_data_t *
     {
         return;
     }
+    output_air_update_idle(output_air, data, now);
     unsigned cur_seq = output_air->seq;
-    air_tx_packet_t pkt = {
-        .seq = output_air->seq++,
-        .ch0 = CHANNEL_TO_AIR_OUTPUT(data->channels[0].value),
-        .ch1 = CHANNEL_TO_AIR_OUTPUT(data->channels[1].value),
-        .ch2 = CHANNEL_TO_AIR_OUTPUT(data->channels[2].value),
-        .ch3 = CHANNEL_TO_AIR_OUTPUT(data->channels[3].value),
-        // We might have no data to send. This leaves the data
-        // stream ready to accept data.
-        .data = {AIR_DATA_START_STOP, AIR_DATA_START_STOP},
+    output_air->seq += output_air_seq_step(output_air);
+    air_tx_ext_packet_t frame = {
+        .pkt = {
+            .seq = cur_seq,
+            .ch0 = CHANNEL_TO_AIR_OUTPUT(data->channels[0].value),
+            .ch1 = CHANNEL_TO_AIR_OUTPUT(data->channels[1].value),
+            .ch2 = CHANNEL_TO_AIR_OUTPUT(data->channels[2].value),
+            .ch3 = CHANNEL_TO_AIR_OUTPUT(data->channels[3].value),
+            // We might have no data to send. This leaves the data
+            // stream ready to accept data.
+            .data = {AIR_DATA_START_STOP, AIR_DATA_START_STOP},
+        },
     };
+    air_tx_packet_t *pkt = &frame.pkt;
     // Check if we need to generate some data for other channels/telemetry
     size_t count = air_stream_output_count(&output_air->air_stream);
     if (output_air->force_stream_feed)
@@ -369,7 +556,7 @@ static void output_air_send_control_packet(output_air_t *output_air, rc_data_t *
         output_air->force_stream_feed = false;
         output_air_feed_stream(output_air, data, cur_seq, now, &count);
     }
-    while (count < sizeof(pkt.data))
+    while (count < sizeof(pkt->data))
     {
         size_t n = output_air_feed_stream(output_air, data, cur_seq, now, &count);
         if (n == 0)
@@ -381,27 +568,60 @@ static void output_air_send_control_packet(output_air_t *output_air, rc_data_t *
     size_t p = 0;
     uint8_t c;
     // Check if we have buffered data to send
-    while (p < sizeof(pkt.data) && air_stream_pop_output(&output_air->air_stream, &c))
+    while (p < sizeof(pkt->data) && air_stream_pop_output(&output_air->air_stream, &c))
+    {
+        pkt->data[p++] = c;
+    }
+    air_tx_packet_prepare(pkt, output_air->air.pairing.key);
+    size_t size = sizeof(*pkt);
+    bool extended = output_air_should_extend_frame(output_air, now);
+    if (extended)
     {
-        pkt.data[p++] = c;
+        size_t ext_size = 0;
+        while (ext_size < output_air->frame_ext.max_size - AIR_FRAME_EXT_OVERHEAD &&
+               air_stream_pop_output(&output_air->air_stream, &c))
+        {
+            frame.ext.data[ext_size++] = c;
+        }
+        air_frame_ext_prepare(&frame.ext, ext_size, pkt->crc, output_air->air.pairing.key);
+        size += ext_size + AIR_FRAME_EXT_OVERHEAD;
+        // Leave time for the additional uplink data and for an extended
+        // downlink frame, which the RX is allowed to send since we extended
+        // this frame.
+        output_air->next_packet += air_radio_frame_ext_time(output_air->air_config.radio, sizeof(*pkt), ext_size + AIR_FRAME_EXT_OVERHEAD) +
+                                   output_air->frame_ext.downlink_time;
     }
-    air_tx_packet_prepare(&pkt, output_air->air.pairing.key);
-    air_radio_send(output_air->air_config.radio, &pkt, sizeof(pkt));
-    //LOG_BUFFER_I("RADIO-OUT", &pkt, sizeof(pkt));
+    output_air->frame_ext.downlink_busy = false;
+#ifdef AIR_DEBUG_THROUGHPUT
+    output_air_debug_throughput(output_air, extended, now);
+#endif
+    air_radio_send(output_air->air_config.radio, &frame, size);
+    //LOG_BUFFER_I("RADIO-OUT", &frame, size);
 }
 
 static void output_air_recv_packet(output_air_t *output_air, rc_data_t *data, time_micros_t now)
 {
     air_radio_t *radio = output_air->air_config.radio;
-    air_rx_packet_t in_pkt;
+    air_rx_ext_packet_t frame;
+    air_rx_packet_t *in_pkt = &frame.pkt;
     int rssi, snr, lq;
 
-    if (air_radio_read(radio, &in_pkt, sizeof(in_pkt)) == sizeof(in_pkt))
+    size_t read_size = output_air->frame_ext.max_size > 0 ? sizeof(frame) : sizeof(*in_pkt);
+    size_t size = air_radio_read(radio, &frame, read_size);
+    if (size >= sizeof(*in_pkt))
     {
-        //LOG_BUFFER_I("RADIO-IN", &in_pkt, sizeof(in_pkt));
-        if (air_rx_packet_validate(&in_pkt, output_air->air.pairing.key))
+        //LOG_BUFFER_I("RADIO-IN", &frame, size);
+        bool valid = air_rx_packet_validate(in_pkt, output_air->air.pairing.key);
+        size_t ext_size = 0;
+        if (valid && size > sizeof(*in_pkt))
+        {
+            ext_size = size - sizeof(*in_pkt) - AIR_FRAME_EXT_OVERHEAD;
+            valid = air_frame_ext_validate(&frame.ext, ext_size, in_pkt->crc, output_air->air.pairing.key);
+        }
+        if (valid)
         {
-            air_stream_feed_input(&output_air->air_stream, in_pkt.seq, in_pkt.data, sizeof(in_pkt.data), now);
+            output_air->frame_ext.downlink_busy = ext_size > 0 && ext_size + AIR_FRAME_EXT_OVERHEAD >= output_air->frame_ext.max_size;
+            air_stream_feed_input_ext(&output_air->air_stream, in_pkt->seq, in_pkt->data, sizeof(in_pkt->data), frame.ext.data, ext_size, now);
             rssi = air_radio_rssi(radio, &snr, &lq);
             air_io_update_rssi(&output_air->air, rssi, snr, lq, now);
             output_air->consecutive_downlink_lost_packets = 0;
@@ -413,11 +633,11 @@ static void output_air_recv_packet(output_air_t *output_air, rc_data_t *data, ti
             // XXX: This only works when ALL cycles have both uplink and downlink stages
             for (int ii = 0; ii < ARRAY_COUNT(data->channels); ii++)
             {
-                data_state_update_ack_received(&data->channels[ii].data_state, in_pkt.tx_seq);
+                data_state_update_ack_received(&data->channels[ii].data_state, in_pkt->tx_seq);
             }
             for (int ii = 0; ii < ARRAY_COUNT(data->telemetry_uplink); ii++)
             {
-                data_state_update_ack_received(&data->telemetry_uplink[ii].data_state, in_pkt.tx_seq);
+                data_state_update_ack_received(&data->telemetry_uplink[ii].data_state, in_pkt->tx_seq);
             }
         }
         else
@@ -457,9 +677,23 @@ static bool output_air_open(void *output, void *config)
     output_air_config_t *config_air = config;
     output_air->tx_power = config_air->tx_power;
     output_air->seq = 0;
+    output_air->frame_ext.enabled = output_air->air.pairing_info.capabilities & AIR_CAP_VARIABLE_LENGTH_FRAMES;
+    output_air->frame_ext.until = 0;
+    output_air->frame_ext.downlink_busy = false;
+    output_air->idle.active = false;
+    // Start from the current values, so opening doesn't count as a change
+    rc_data_t *data = output_air->output.rc_data;
+    for (unsigned ii = 0; ii < ARRAY_COUNT(output_air->idle.channels); ii++)
+    {
+        output_air->idle.channels[ii] = data->channels[ii].value;
+    }
+    output_air->idle.changed_at = time_micros_now();
+    output_air->idle.left_at = 0;
     output_air->force_stream_feed = false;
     output_air->next_packet = 0;
     output_air->state = OUTPUT_AIR_STATE_IDLE;
+    output_air->tdma.slots = 0;
+    output_air->tdma.owner = NULL;
     output_air_start(output_air);
     air_stream_init(&output_air->air_stream, NULL,
                     output_air_stream_telemetry_decoded, output_air_stream_cmd_decoded, output);
@@ -476,14 +710,36 @@ static bool output_air_update(void *output, rc_data_t *data, bool update_rc, tim
     // else and start transmitting.
     if (now > output_air->next_packet)
     {
+#if defined(USE_COEX)
+        coex_air_slot_started(output_air->next_packet, now);
+#endif
+        if (output_air->tdma.slots > 0)
+        {
+            output_air_claim_radio(output_air);
+        }
         output_air->state = OUTPUT_AIR_STATE_TX;
         output_air_send_control_packet(output_air, data, now);
+#if defined(USE_COEX)
+        time_micros_t next_slot = output_air->next_packet;
+        if (output_air->tdma.slots > 0)
+        {
+            // The next slot belongs to another output
+            next_slot -= output_air->cycle_time * (output_air->tdma.slots - 1);
+        }
+        coex_air_slot_scheduled(next_slot);
+#endif
 #ifdef AIR_DEBUG_CYCLE_TIME
         printf("CYCLE %llu\n", cycle_end - cycle_begin);
         cycle_begin = now;
 #endif
     }
 
+    if (output_air->tdma.slots > 0 && *output_air->tdma.owner != output_air)
+    {
+        // Another output is using the radio, our slot is over
+        output_air->state = OUTPUT_AIR_STATE_IDLE;
+    }
+
     switch ((output_air_state_e)output_air->state)
     {
     case OUTPUT_AIR_STATE_IDLE:
@@ -521,12 +777,31 @@ static bool output_air_update(void *output, rc_data_t *data, bool update_rc, tim
     return false;
 }
 
+static time_micros_t output_air_next_update_at(void *output, time_micros_t now)
+{
+    output_air_t *output_air = output;
+    switch ((output_air_state_e)output_air->state)
+    {
+    case OUTPUT_AIR_STATE_TX_DONE:
+    case OUTPUT_AIR_STATE_RX_DONE:
+        return now;
+    case OUTPUT_AIR_STATE_IDLE:
+    case OUTPUT_AIR_STATE_TX:
+    case OUTPUT_AIR_STATE_RX:
+        break;
+    }
+    // TX_DONE and RX_DONE are set from the radio interrupt, which
+    // wakes up the RC task before the next packet is due.
+    return output_air->next_packet;
+}
+
 static void output_air_close(void *output, void *config)
 {
     LOG_I(TAG, "Close");
     output_air_t *output_air = output;
     air_radio_t *radio = output_air->air_config.radio;
     air_radio_set_callback(radio, NULL, NULL);
+    air_radio_set_variable_length_frames(radio, false);
     air_radio_sleep(radio);
 }
 
@@ -538,6 +813,7 @@ void output_air_init(output_air_t *output, air_addr_t addr, air_config_t *air_co
         .open = output_air_open,
         .update = output_air_update,
         .close = output_air_close,
+        .next_update_at = output_air_next_update_at,
     };
     rmp_air_init(&output->rmp_air, rmp, &addr, &output->air_stream);
     air_io_init(&output->air, addr, NULL, &output->rmp_air);
@@ -547,3 +823,10 @@ void output_air_set_tx_power(output_air_t *output, int tx_power)
 {
     output->tx_power = tx_power;
 }
+
+void output_air_start_tdma(output_air_t *output, unsigned slots, time_micros_t first_slot_at, output_air_t **owner)
+{
+    output->tdma.slots = slots;
+    output->tdma.owner = owner;
+    output->next_packet = first_slot_at;
+}
@@ -38,6 +38,22 @@ typedef struct output_air_s
             time_micros_t to_longer_scheduled_at;
         } sw; // Mode switching
     } air_modes;
+    struct
+    {
+        bool enabled;                // Both ends support variable length frames
+        size_t max_size;             // Maximum frame extension in the current mode
+        time_micros_t downlink_time; // Air time reserved for an extended downlink frame
+        time_micros_t until;         // Keep extending frames until this time, waiting for responses
+        bool downlink_busy;          // The RX filled its last extended frame
+    } frame_ext;
+    struct
+    {
+        bool active;                        // Channels have been static for a while, using the longest mode
+        uint16_t channels[RC_CHANNELS_NUM]; // Channel values at the last change
+        time_micros_t changed_at;           // Last time a channel changed
+        air_mode_e restore_mode;            // Mode to restore when the channels change again
+        time_micros_t left_at;              // Time when we left idle, while restoring the mode
+    } idle;
     bool force_stream_feed;
     time_micros_t last_downlink_packet_at;
     time_micros_t cycle_time;
@@ -49,6 +65,12 @@ typedef struct output_air_s
     bool expecting_downlink_packet;
     unsigned consecutive_downlink_lost_packets;
     int tx_power;
+    // Used when several outputs share the radio, see output_air_multi.h
+    struct
+    {
+        unsigned slots;              // Slots in each frame, zero when this output owns the radio
+        struct output_air_s **owner; // Output currently configuring the radio
+    } tdma;
 
     msp_air_t msp_air;
     rmp_air_t rmp_air;
@@ -56,4 +78,8 @@ typedef struct output_air_s
 
 void output_air_init(output_air_t *output, air_addr_t addr, air_config_t *air_config, rmp_t *rmp);
 
-void output_air_set_tx_power(output_air_t *output, int tx_power);
\ No newline at end of file
+void output_air_set_tx_power(output_air_t *output, int tx_power);
+// Makes an open output share the radio with others in a TDMA frame of
+// slots cycles, sending its first packet at first_slot_at. The radio
+// is reconfigured for this output at the start of each of its slots.
+void output_air_start_tdma(output_air_t *output, unsigned slots, time_micros_t first_slot_at, output_air_t **owner);
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include <hal/log.h>
 
 #include "air/air_radio.h"
+#include "air/air_survey.h"
 
 #include "ui/led.h"
 
@@ -8,25 +9,138 @@
 
 static const char *TAG = "Output.Air.Bind";
 
+// RXs running firmware without hellos need a full bind packet with the
+// implicit header (see air_radio_set_bind_legacy_format()). One is sent
+// at the old bind interval, between hellos, and we listen for a response
+// long enough for them to answer (they wait 10ms before responding).
+#define LEGACY_RESPONSE_WINDOW_US MILLIS_TO_MICROS(100)
+
 static bool output_air_bind_open(void *data, void *config)
 {
     LOG_I(TAG, "Start bind");
     output_air_bind_t *output = data;
     output->next_bind_offer = 0;
-    output->binding_key = air_key_generate();
+    if (!air_survey_generate_key(output->air_config.band, &output->binding_key))
+    {
+        output->binding_key = air_key_generate();
+    }
     output->has_bind_response = false;
     output->bind_packet_expires = 0;
+    output->hello_band_index = 0;
+    output->rx_found = false;
+    output->legacy = false;
+    output->rx_legacy = false;
+    output->started_at = time_micros_now();
+    output->next_legacy_offer = output->started_at;
     air_radio_set_bind_mode(output->air_config.radio);
     air_radio_set_frequency(output->air_config.radio, air_band_frequency(output->air_config.band), 0);
     led_mode_add(LED_MODE_BIND);
     return true;
 }
 
+static void output_air_bind_send_hello(output_air_bind_t *output)
+{
+    // Interleave hellos across all the supported bands, so the RX can
+    // find us while scanning with a short dwell time on each band.
+    air_band_e band = air_band_mask_get_band(output->air_config.bands, output->hello_band_index++);
+    if (band == AIR_BAND_INVALID)
+    {
+        output->hello_band_index = 1;
+        band = air_band_mask_get_band(output->air_config.bands, 0);
+    }
+    if (output->legacy)
+    {
+        air_radio_set_bind_legacy_format(output->air_config.radio, false);
+        output->legacy = false;
+    }
+    air_bind_hello_packet_t hello = {
+        .addr = output->air.addr,
+        .key = output->binding_key,
+        .role = AIR_ROLE_TX,
+        .band = output->air_config.band,
+    };
+    air_bind_hello_packet_prepare(&hello);
+    air_radio_set_frequency(output->air_config.radio, air_band_frequency(band), 0);
+    air_radio_send(output->air_config.radio, &hello, sizeof(hello));
+}
+
+static void output_air_bind_send_packet(output_air_bind_t *output, bool legacy)
+{
+    air_bind_packet_t bind_packet = {
+        .addr = output->air.addr,
+        .key = output->binding_key,
+        .role = AIR_ROLE_TX,
+    };
+    bind_packet.info.modes = output->air_config.modes;
+
+    const char *name = rc_data_get_pilot_name(output->output.rc_data);
+    memset(bind_packet.name, 0, sizeof(bind_packet.name));
+    if (name)
+    {
+        strlcpy(bind_packet.name, name, sizeof(bind_packet.name));
+    }
+    air_bind_packet_prepare(&bind_packet);
+    LOG_I(TAG, "Sending bind packet%s", legacy ? " (legacy)" : "");
+    if (output->legacy != legacy)
+    {
+        air_radio_set_bind_legacy_format(output->air_config.radio, legacy);
+        output->legacy = legacy;
+    }
+    air_radio_set_frequency(output->air_config.radio, air_band_frequency(output->air_config.band), 0);
+    air_radio_send(output->air_config.radio, &bind_packet, sizeof(bind_packet));
+}
+
+static void output_air_bind_recv(output_air_bind_t *output, time_micros_t now)
+{
+    union {
+        air_bind_hello_packet_t hello;
+        air_bind_packet_t pkt;
+    } buf;
+    size_t n = air_radio_read(output->air_config.radio, &buf, sizeof(buf));
+    if (n == sizeof(buf.hello) && air_bind_hello_packet_validate(&buf.hello) &&
+        buf.hello.key == output->binding_key && buf.hello.role != AIR_ROLE_TX)
+    {
+        if (!output->rx_found)
+        {
+            LOG_I(TAG, "RX answered hello after %u ms", (unsigned)((now - output->started_at) / 1000));
+            output->rx_found = true;
+            output->rx_legacy = false;
+            // Send the full packet right away
+            output->next_bind_offer = now;
+        }
+        output->rx_found_until = now + MILLIS_TO_MICROS(AIR_BIND_PACKET_EXPIRATION_MS);
+        return;
+    }
+    air_bind_packet_t *bind_resp = &output->bind_resp;
+    if (n == sizeof(*bind_resp) && air_bind_packet_validate(&buf.pkt) && buf.pkt.key == output->binding_key)
+    {
+        // Got a response from the RX. It might be informing that the RX
+        // is awaiting confirmation from the user or confirming the bind.
+        air_bind_packet_cpy(bind_resp, &buf.pkt);
+        LOG_I(TAG, "Got bind response (accepted: %s) after %u ms", bind_resp->role == AIR_ROLE_RX ? "Y" : "N",
+              (unsigned)((now - output->started_at) / 1000));
+        output->bind_packet_expires = now + MILLIS_TO_MICROS(AIR_BIND_PACKET_EXPIRATION_MS);
+        output->rx_found_until = output->bind_packet_expires;
+        output->has_bind_response = true;
+        if (!output->rx_found)
+        {
+            // Answer to a legacy bind packet, the RX doesn't know about hellos
+            output->rx_found = true;
+            output->rx_legacy = output->legacy;
+        }
+    }
+}
+
 static bool output_air_bind_update(void *data, rc_data_t *rc_data, bool update_rc, time_micros_t now)
 {
     output_air_bind_t *output = data;
     air_radio_t *radio = output->air_config.radio;
     led_mode_set(LED_MODE_BIND_WITH_REQUEST, output->bind_packet_expires > now);
+    if (output->rx_found && now > output->rx_found_until)
+    {
+        LOG_I(TAG, "Lost RX, sending hellos again");
+        output->rx_found = false;
+    }
     if (output->next_bind_offer < now)
     {
         if (!air_radio_is_tx_done(radio))
@@ -35,23 +149,22 @@ static bool output_air_bind_update(void *data, rc_data_t *rc_data, bool update_r
         }
         output->is_listening = false;
 
-        air_bind_packet_t bind_packet = {
-            .addr = output->air.addr,
-            .key = output->binding_key,
-            .role = AIR_ROLE_TX,
-        };
-        bind_packet.info.modes = output->air_config.modes;
-
-        const char *name = rc_data_get_pilot_name(output->output.rc_data);
-        memset(bind_packet.name, 0, sizeof(bind_packet.name));
-        if (name)
+        if (output->rx_found)
+        {
+            output_air_bind_send_packet(output, output->rx_legacy);
+            output->next_bind_offer = now + AIR_BIND_PACKET_INTERVAL_MS * 1000;
+        }
+        else if (now >= output->next_legacy_offer)
+        {
+            output_air_bind_send_packet(output, true);
+            output->next_legacy_offer = now + MILLIS_TO_MICROS(AIR_BIND_PACKET_INTERVAL_MS);
+            output->next_bind_offer = now + LEGACY_RESPONSE_WINDOW_US;
+        }
+        else
         {
-            strlcpy(bind_packet.name, name, sizeof(bind_packet.name));
+            output_air_bind_send_hello(output);
+            output->next_bind_offer = now + AIR_BIND_HELLO_INTERVAL_MS * 1000;
         }
-        air_bind_packet_prepare(&bind_packet);
-        LOG_I(TAG, "Sending bind packet");
-        air_radio_send(radio, &bind_packet, sizeof(bind_packet));
-        output->next_bind_offer = now + AIR_BIND_PACKET_INTERVAL_MS * 1000;
     }
     else
     {
@@ -64,16 +177,9 @@ static bool output_air_bind_update(void *data, rc_data_t *rc_data, bool update_r
         }
         else if (output->is_listening && air_radio_is_rx_done(radio))
         {
-            air_bind_packet_t *bind_resp = &output->bind_resp;
-            if (air_radio_read(radio, bind_resp, sizeof(*bind_resp)) == sizeof(*bind_resp) &&
-                air_bind_packet_validate(bind_resp) && bind_resp->key == output->binding_key)
-            {
-                // Got a response from the RX. It might be informing that the RX
-                // is awaiting confirmation from the user or confirming the bind.
-                LOG_I(TAG, "Got bind response (accepted: %s)", bind_resp->role == AIR_ROLE_RX ? "Y" : "N");
-                output->bind_packet_expires = now + MILLIS_TO_MICROS(AIR_BIND_PACKET_EXPIRATION_MS);
-                output->has_bind_response = true;
-            }
+            output_air_bind_recv(output, now);
+            air_radio_sleep(radio);
+            air_radio_start_rx(radio);
         }
     }
     return false;
@@ -16,6 +16,13 @@ typedef struct output_air_bind_s
     air_bind_packet_t bind_resp;
     bool has_bind_response;
     time_micros_t bind_packet_expires;
+    int hello_band_index;         // Band for the next hello, while no RX has answered
+    bool rx_found;                // An RX answered a hello, send full bind packets in air_config.band
+    time_micros_t rx_found_until; // Go back to sending hellos after this time without responses
+    bool legacy;                  // Radio is using the legacy bind format, for the last packet sent
+    bool rx_legacy;               // The RX answered a legacy bind packet, keep using that format
+    time_micros_t next_legacy_offer;
+    time_micros_t started_at;
 } output_air_bind_t;
 
 void output_air_bind_init(output_air_bind_t *output_air_bind, air_addr_t addr, air_config_t *air_config);
\ No newline at end of file
@@ -0,0 +1,220 @@
+#include "target.h"
+
+#if defined(USE_MULTI_RX)
+
+#include <string.h>
+
+#include <hal/log.h>
+
+#include "air/air_radio.h"
+
+#include "config/config.h"
+
+#include "util/macros.h"
+
+#include "output_air_multi.h"
+
+#define OUTPUT_AIR_MULTI_STATS_INTERVAL SECS_TO_MICROS(10)
+
+static const char *TAG = "Output.Air.Multi";
+
+static air_mode_e output_air_multi_longest_mode(output_air_multi_t *output, output_air_t *rx)
+{
+    air_mode_mask_t common;
+    if (!air_io_is_bound(&rx->air) ||
+        !air_modes_intersect(&common, rx->air.pairing_info.modes, output->air_config.modes))
+    {
+        return AIR_MODE_INVALID;
+    }
+    return air_mode_longest(common);
+}
+
+static const char *output_air_multi_rx_name(output_air_t *rx, char *buf, size_t size)
+{
+    air_addr_t addr;
+    if (!air_io_get_bound_addr(&rx->air, &addr))
+    {
+        return "?";
+    }
+    if (!config_get_air_name(buf, size, &addr))
+    {
+        air_addr_format(&addr, buf, size);
+    }
+    return buf;
+}
+
+static void output_air_multi_copy_channels(rc_data_t *dst, const rc_data_t *src, time_micros_t now)
+{
+    dst->channels_num = src->channels_num;
+    dst->ready = src->ready;
+    dst->failsafe.input = src->failsafe.input;
+    for (unsigned ii = 0; ii < src->channels_num; ii++)
+    {
+        if (dst->channels[ii].value != src->channels[ii].value)
+        {
+            rc_data_update_channel(dst, ii, src->channels[ii].value, now);
+        }
+    }
+}
+
+static void output_air_multi_log_stats(output_air_multi_t *output, time_micros_t now)
+{
+    char name[AIR_MAX_NAME_LENGTH + 1];
+    float secs = (now - output->stats_since) / 1e6f;
+    for (unsigned ii = 0; ii < output->count; ii++)
+    {
+        output_air_t *rx = output->rxs[ii];
+        LOG_I(TAG, "RX %u (%s): %.1f Hz uplink, %.1f Hz downlink%s", ii,
+              output_air_multi_rx_name(rx, name, sizeof(name)),
+              output->stats[ii].uplink / secs, output->stats[ii].downlink / secs,
+              failsafe_is_active(&rx->output.failsafe) ? ", failsafe" : "");
+        output->stats[ii].uplink = 0;
+        output->stats[ii].downlink = 0;
+    }
+    output->stats_since = now;
+}
+
+static void output_air_multi_update_stats(output_air_multi_t *output, time_micros_t now)
+{
+    for (unsigned ii = 0; ii < output->count; ii++)
+    {
+        output_air_t *rx = output->rxs[ii];
+        if (rx->seq != output->stats[ii].last_seq)
+        {
+            output->stats[ii].last_seq = rx->seq;
+            output->stats[ii].uplink++;
+        }
+        if (rx->last_downlink_packet_at != output->stats[ii].last_downlink_at)
+        {
+            output->stats[ii].last_downlink_at = rx->last_downlink_packet_at;
+            output->stats[ii].downlink++;
+        }
+    }
+    if (now - output->stats_since >= OUTPUT_AIR_MULTI_STATS_INTERVAL)
+    {
+        output_air_multi_log_stats(output, now);
+    }
+}
+
+static bool output_air_multi_open(void *output, void *config)
+{
+    output_air_multi_t *output_multi = output;
+    rc_data_t *data = output_multi->output.rc_data;
+    output_air_t *primary = output_multi->rxs[0];
+    char name[AIR_MAX_NAME_LENGTH + 1];
+
+    air_mode_e mode = output_air_multi_longest_mode(output_multi, primary);
+    if (!air_mode_is_valid(mode))
+    {
+        LOG_W(TAG, "Could not determine the mode for the primary RX");
+        return false;
+    }
+    // Open the RXs that can share the frame, restricted to its mode so
+    // they never switch to another one.
+    unsigned count = 0;
+    for (unsigned ii = 0; ii < output_multi->count; ii++)
+    {
+        output_air_t *rx = output_multi->rxs[ii];
+        air_mode_e rx_mode = output_air_multi_longest_mode(output_multi, rx);
+        if (rx_mode != mode)
+        {
+            LOG_W(TAG, "Skipping RX %s, its longest mode %d doesn't match %d",
+                  output_air_multi_rx_name(rx, name, sizeof(name)), rx_mode, mode);
+            continue;
+        }
+        rx->air_config.modes = (air_supported_modes_e)(AIR_SUPPORTED_MODES_FIXED_1 + mode - AIR_MODE_1);
+        rc_data_t *rx_data = rx == primary ? data : &output_multi->secondary_data[rx - output_multi->secondary];
+        if (!output_open(rx_data, &rx->output, config))
+        {
+            LOG_W(TAG, "Could not open RX %s", output_air_multi_rx_name(rx, name, sizeof(name)));
+            if (rx == primary)
+            {
+                return false;
+            }
+            continue;
+        }
+        output_multi->rxs[count++] = rx;
+    }
+    output_multi->count = count;
+    air_radio_t *radio = output_multi->air_config.radio;
+    time_micros_t cycle_time = air_radio_cycle_time(radio, mode);
+    if (count > 1)
+    {
+        time_micros_t start = time_micros_now() + cycle_time;
+        for (unsigned ii = 0; ii < count; ii++)
+        {
+            output_air_start_tdma(output_multi->rxs[ii], count, start + ii * cycle_time, &output_multi->radio_owner);
+        }
+    }
+    LOG_I(TAG, "Open with %u RXs in mode %d, %u Hz per RX", count, mode,
+          (unsigned)(1000000 / (cycle_time * count)));
+    failsafe_set_max_interval(&output_multi->output.failsafe, air_radio_tx_failsafe_interval(radio, mode));
+    output_multi->radio_owner = NULL;
+    output_multi->primary_downlink_at = 0;
+    memset(output_multi->stats, 0, sizeof(output_multi->stats));
+    output_multi->stats_since = time_micros_now();
+    return true;
+}
+
+static bool output_air_multi_update(void *output, rc_data_t *data, bool update_rc, time_micros_t now)
+{
+    output_air_multi_t *output_multi = output;
+    for (unsigned ii = 0; ii < output_multi->count; ii++)
+    {
+        output_air_t *rx = output_multi->rxs[ii];
+        if (rx->output.rc_data != data)
+        {
+            output_air_multi_copy_channels(rx->output.rc_data, data, now);
+        }
+        output_update(&rx->output, update_rc, now);
+    }
+    output_air_t *primary = output_multi->rxs[0];
+    if (primary->last_downlink_packet_at != output_multi->primary_downlink_at)
+    {
+        output_multi->primary_downlink_at = primary->last_downlink_packet_at;
+        failsafe_reset_interval(&output_multi->output.failsafe, now);
+    }
+    output_air_multi_update_stats(output_multi, now);
+    // Tell the output layer to not mess with the channel dirty states
+    return false;
+}
+
+static void output_air_multi_close(void *output, void *config)
+{
+    output_air_multi_t *output_multi = output;
+    for (unsigned ii = 0; ii < output_multi->count; ii++)
+    {
+        output_close(&output_multi->rxs[ii]->output, config);
+    }
+    output_multi->radio_owner = NULL;
+    LOG_I(TAG, "Close");
+}
+
+void output_air_multi_init(output_air_multi_t *output, output_air_t *primary, const air_pairing_t *pairings, unsigned count,
+                           air_addr_t addr, air_config_t *air_config, rmp_t *rmp)
+{
+    output->air_config = *air_config;
+    output->output.flags = OUTPUT_FLAG_REMOTE;
+    output->output.vtable = (output_vtable_t){
+        .open = output_air_multi_open,
+        .update = output_air_multi_update,
+        .close = output_air_multi_close,
+    };
+    output->rxs[0] = primary;
+    output->count = 1;
+    output->secondary_count = MIN(count, ARRAY_COUNT(output->secondary));
+    for (unsigned ii = 0; ii < output->secondary_count; ii++)
+    {
+        air_pairing_t pairing;
+        air_pairing_cpy(&pairing, &pairings[ii]);
+        rc_data_t *data = &output->secondary_data[ii];
+        rc_data_reset_input(data);
+        data->rmp = rmp;
+        output_air_t *rx = &output->secondary[ii];
+        output_air_init(rx, addr, air_config, rmp);
+        air_io_bind(&rx->air, &pairing);
+        output->rxs[output->count++] = rx;
+    }
+}
+
+#endif
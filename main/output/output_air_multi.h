@@ -0,0 +1,64 @@
+#pragma once
+
+#include "air/air.h"
+#include "air/air_config.h"
+
+#include "output/output.h"
+#include "output/output_air.h"
+
+#include "rc/rc_data.h"
+
+#include "util/time.h"
+
+typedef struct rmp_s rmp_t;
+
+// Maximum number of RXs driven at the same time, including the
+// primary one. Each RX gets one slot in every frame, so its
+// update rate is divided by the number of RXs.
+#define OUTPUT_AIR_MULTI_MAX_RX 3
+
+// Drives several paired RXs from a single radio. Each RX uses its own
+// output_air_t (with its own key, hop sequence, sequence numbers,
+// telemetry stream and failsafe) and transmits in its own slot of a
+// TDMA frame. Since the RXs don't know about the frame, all of them
+// must use the same mode and stay there, so only RXs whose longest
+// mode (the one they use after boot and in failsafe) matches the
+// primary one are included. RXs see the slots for other RXs as lost
+// packets and keep hopping, which keeps them in sync.
+//
+// Since the seq of each RX advances once per slot, its stream sees a
+// seq step equal to the number of RXs. RX firmware that doesn't learn
+// the step (see input_air_stream_seq()) still gets the 4 channels in
+// every packet, but not the aux channels nor the uplink telemetry.
+//
+// The primary RX provides the telemetry shown on the TX and its
+// failsafe is the one reported by this output.
+//
+// Only available when USE_MULTI_RX is defined.
+typedef struct output_air_multi_s
+{
+    output_t output;
+    air_config_t air_config;
+    output_air_t *rxs[OUTPUT_AIR_MULTI_MAX_RX];
+    unsigned count;
+    output_air_t *radio_owner;
+    time_micros_t primary_downlink_at;
+    // Storage for the non primary RXs, which need their own copy
+    // of the RC data to track the acks independently.
+    output_air_t secondary[OUTPUT_AIR_MULTI_MAX_RX - 1];
+    rc_data_t secondary_data[OUTPUT_AIR_MULTI_MAX_RX - 1];
+    unsigned secondary_count;
+    struct
+    {
+        unsigned last_seq;
+        time_micros_t last_downlink_at;
+        unsigned uplink;
+        unsigned downlink;
+    } stats[OUTPUT_AIR_MULTI_MAX_RX];
+    time_micros_t stats_since;
+} output_air_multi_t;
+
+// primary must have been initialized and bound. pairings contains
+// the other RXs to drive, up to OUTPUT_AIR_MULTI_MAX_RX - 1.
+void output_air_multi_init(output_air_multi_t *output, output_air_t *primary, const air_pairing_t *pairings, unsigned count,
+                           air_addr_t addr, air_config_t *air_config, rmp_t *rmp);
@@ -0,0 +1,37 @@
+#include <hal/log.h>
+
+#include "air/air_survey.h"
+
+#include "output_air_survey.h"
+
+static const char *TAG = "Output.Air.Survey";
+
+static bool output_air_survey_open(void *data, void *config)
+{
+    LOG_I(TAG, "Open");
+    output_air_survey_t *output = data;
+    air_survey_start(output->air_config.radio, output->air_config.band);
+    return true;
+}
+
+static bool output_air_survey_update(void *data, rc_data_t *rc_data, bool update_rc, time_micros_t now)
+{
+    air_survey_update(now);
+    return false;
+}
+
+static void output_air_survey_close(void *data, void *config)
+{
+    air_survey_stop();
+    LOG_I(TAG, "Close");
+}
+
+void output_air_survey_init(output_air_survey_t *output, air_config_t *air_config)
+{
+    output->air_config = *air_config;
+    output->output.vtable = (output_vtable_t){
+        .open = output_air_survey_open,
+        .update = output_air_survey_update,
+        .close = output_air_survey_close,
+    };
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "air/air_config.h"
+
+#include "output/output.h"
+
+typedef struct output_air_survey_s
+{
+    output_t output;
+    air_config_t air_config;
+} output_air_survey_t;
+
+void output_air_survey_init(output_air_survey_t *output, air_config_t *air_config);
@@ -1,3 +1,4 @@
+#include <assert.h>
 #include <math.h>
 #include <string.h>
 
@@ -101,13 +102,12 @@ static bool output_crsf_open(void *output, void *config)
     LOG_I(TAG, "Open");
     output_crsf_t *output_crsf = output;
 
-    bool half_duplex = config_crsf->tx == config_crsf->rx;
-
     serial_port_config_t serial_config = {
         .baud_rate = CRSF_RX_BAUDRATE,
         .tx = config_crsf->tx,
         .rx = config_crsf->rx,
-        .tx_buffer_size = half_duplex ? 0 : CRSF_SERIAL_BUFFER_SIZE,
+        // No TX buffer, so RC frames go straight to the UART FIFO
+        .tx_buffer_size = 0,
         .rx_buffer_size = CRSF_SERIAL_BUFFER_SIZE,
         .parity = SERIAL_PARITY_DISABLE,
         .stop_bits = SERIAL_STOP_BITS_1,
@@ -123,6 +123,40 @@ static bool output_crsf_open(void *output, void *config)
     return true;
 }
 
+static size_t output_crsf_encode_rc(void *output, rc_data_t *data, void *buf, size_t size)
+{
+#define CH_TO_CRFS(ch) channel_to_crsf_value(data->channels[ch].value)
+    crsf_frame_t frame = {
+        .header = {
+            .device_addr = CRSF_ADDRESS_BROADCAST,
+            .frame_size = CRSF_FRAME_SIZE(sizeof(crsf_channels_t)),
+            .type = CRSF_FRAMETYPE_RC_CHANNELS_PACKED,
+        },
+        .channels = {
+            .ch0 = CH_TO_CRFS(0),
+            .ch1 = CH_TO_CRFS(1),
+            .ch2 = CH_TO_CRFS(2),
+            .ch3 = CH_TO_CRFS(3),
+            .ch4 = CH_TO_CRFS(4),
+            .ch5 = CH_TO_CRFS(5),
+            .ch6 = CH_TO_CRFS(6),
+            .ch7 = CH_TO_CRFS(7),
+            .ch8 = CH_TO_CRFS(8),
+            .ch9 = CH_TO_CRFS(9),
+            .ch10 = CH_TO_CRFS(10),
+            .ch11 = CH_TO_CRFS(11),
+            .ch12 = CH_TO_CRFS(12),
+            .ch13 = CH_TO_CRFS(13),
+            .ch14 = CH_TO_CRFS(14),
+            .ch15 = CH_TO_CRFS(15),
+        },
+    };
+    size_t frame_size = crsf_frame_encode(&frame);
+    assert(frame_size <= size);
+    memcpy(buf, &frame, frame_size);
+    return frame_size;
+}
+
 static bool output_crsf_update(void *output, rc_data_t *data, bool update_rc, time_micros_t now)
 {
     output_crsf_t *output_crsf = output;
@@ -130,33 +164,9 @@ static bool output_crsf_update(void *output, rc_data_t *data, bool update_rc, ti
 
     if (update_rc)
     {
-#define CH_TO_CRFS(ch) channel_to_crsf_value(data->channels[ch].value)
-        crsf_frame_t frame = {
-            .header = {
-                .device_addr = CRSF_ADDRESS_BROADCAST,
-                .frame_size = CRSF_FRAME_SIZE(sizeof(crsf_channels_t)),
-                .type = CRSF_FRAMETYPE_RC_CHANNELS_PACKED,
-            },
-            .channels = {
-                .ch0 = CH_TO_CRFS(0),
-                .ch1 = CH_TO_CRFS(1),
-                .ch2 = CH_TO_CRFS(2),
-                .ch3 = CH_TO_CRFS(3),
-                .ch4 = CH_TO_CRFS(4),
-                .ch5 = CH_TO_CRFS(5),
-                .ch6 = CH_TO_CRFS(6),
-                .ch7 = CH_TO_CRFS(7),
-                .ch8 = CH_TO_CRFS(8),
-                .ch9 = CH_TO_CRFS(9),
-                .ch10 = CH_TO_CRFS(10),
-                .ch11 = CH_TO_CRFS(11),
-                .ch12 = CH_TO_CRFS(12),
-                .ch13 = CH_TO_CRFS(13),
-                .ch14 = CH_TO_CRFS(14),
-                .ch15 = CH_TO_CRFS(15),
-            },
-        };
-        crsf_port_write(&output_crsf->crsf, &frame);
+        size_t size;
+        const void *frame = output_get_rc_frame(&output_crsf->output, &size);
+        serial_port_write(output_crsf->output.serial_port, frame, size);
     }
     if (output_crsf->next_ping < now)
     {
@@ -201,5 +211,6 @@ void output_crsf_init(output_crsf_t *output)
         .open = output_crsf_open,
         .update = output_crsf_update,
         .close = output_crsf_close,
+        .encode_rc = output_crsf_encode_rc,
     };
 }
@@ -69,7 +69,11 @@ static uint8_t fport_checksum(const uint8_t *data, size_t size)
     return fport_checksum_from_sum(sum);
 }
 
-static int fport_write_byte(output_fport_t *output, uint8_t b, uint16_t *sum)
+// Worst case size for an FPort frame with the given payload size, with
+// every byte in length, type, payload and checksum escaped.
+#define FPORT_ENCODED_FRAME_SIZE_MAX(size) (2 + ((size) + 3) * 2)
+
+static size_t fport_encode_byte(uint8_t *buf, uint8_t b, uint16_t *sum)
 {
     if (sum)
     {
@@ -78,40 +82,34 @@ static int fport_write_byte(output_fport_t *output, uint8_t b, uint16_t *sum)
 
     if (b == FPORT_FRAME_MARKER || b == FPORT_ESCAPE_CHAR)
     {
-        uint8_t buf[] = {
-            FPORT_ESCAPE_CHAR,
-            b ^ FPORT_ESCAPE_MASK,
-        };
-        serial_port_write(output->output.serial_port, buf, sizeof(buf));
+        buf[0] = FPORT_ESCAPE_CHAR;
+        buf[1] = b ^ FPORT_ESCAPE_MASK;
         return 2;
     }
 
-    serial_port_write(output->output.serial_port, &b, 1);
+    buf[0] = b;
     return 1;
 }
 
-static int fport_write_payload(output_fport_t *output, uint8_t type, const void *data, size_t size)
+static size_t fport_encode_payload(uint8_t *buf, uint8_t type, const void *data, size_t size)
 {
-    int count = 0;
+    size_t count = 0;
     uint16_t sum = 0;
-    uint8_t marker = FPORT_FRAME_MARKER;
 
-    serial_port_write(output->output.serial_port, &marker, 1);
-    count++;
+    buf[count++] = FPORT_FRAME_MARKER;
 
-    count += fport_write_byte(output, size + 1, &sum);
-    count += fport_write_byte(output, type, &sum);
+    count += fport_encode_byte(&buf[count], size + 1, &sum);
+    count += fport_encode_byte(&buf[count], type, &sum);
 
     const uint8_t *ptr = data;
     for (size_t ii = 0; ii < size; ii++, ptr++)
     {
-        count += fport_write_byte(output, *ptr, &sum);
+        count += fport_encode_byte(&buf[count], *ptr, &sum);
     }
 
-    count += fport_write_byte(output, fport_checksum_from_sum(sum), NULL);
+    count += fport_encode_byte(&buf[count], fport_checksum_from_sum(sum), NULL);
 
-    serial_port_write(output->output.serial_port, &marker, 1);
-    count++;
+    buf[count++] = FPORT_FRAME_MARKER;
 
     return count;
 }
@@ -125,7 +123,8 @@ static bool output_fport_open(void *output, void *config)
         .baud_rate = FPORT_BAUDRATE,
         .tx = cfg->tx,
         .rx = cfg->rx,
-        .tx_buffer_size = FPORT_SERIAL_BUFFER_SIZE,
+        // No TX buffer, so RC frames go straight to the UART FIFO
+        .tx_buffer_size = 0,
         .rx_buffer_size = FPORT_SERIAL_BUFFER_SIZE,
         .parity = SERIAL_PARITY_DISABLE,
         .stop_bits = SERIAL_STOP_BITS_1,
@@ -196,6 +195,31 @@ static void output_fport_receive(output_fport_t *output_fport)
     output_fport->buf_pos = 0;
 }
 
+static size_t output_fport_encode_rc(void *output, rc_data_t *data, void *buf, size_t size)
+{
+    _Static_assert(FPORT_ENCODED_FRAME_SIZE_MAX(sizeof(fport_control_data_t)) +
+                           FPORT_ENCODED_FRAME_SIZE_MAX(sizeof(smartport_payload_t)) <=
+                       OUTPUT_RC_FRAME_SIZE_MAX,
+                   "OUTPUT_RC_FRAME_SIZE_MAX is too small");
+    uint8_t *ptr = buf;
+    size_t count = 0;
+
+    // Control frame
+    fport_control_data_t control = {
+        // RSSI is directly used as a % value, so we can pass the LQ as is
+        .rssi = MAX(TELEMETRY_GET_DOWNLINK_I8(data, TELEMETRY_ID_RX_LINK_QUALITY), 0),
+    };
+    sbus_encode_data(&control.sbus, data, failsafe_is_active(data->failsafe.input));
+    count += fport_encode_payload(&ptr[count], FPORT_FRAME_TYPE_CONTROL, &control, sizeof(control));
+
+    // Request telemetry. Doesn't matter what we write here since the FC
+    // just checks for FPORT_FRAME_TYPE_TELEMETRY_REQUEST
+    smartport_payload_t telemetry = {0};
+    count += fport_encode_payload(&ptr[count], FPORT_FRAME_TYPE_TELEMETRY_REQUEST, &telemetry, sizeof(telemetry));
+
+    return count;
+}
+
 static bool output_fport_update(void *output, rc_data_t *data, bool update_rc, time_micros_t now)
 {
     // TODO: The half duplex nature of FPort means that we won't update the telemetry
@@ -208,22 +232,11 @@ static bool output_fport_update(void *output, rc_data_t *data, bool update_rc, t
     if (update_rc)
     {
         output_fport_receive(output_fport);
-        serial_port_begin_write(output_fport->output.serial_port);
-
-        // Write the control frame
-        fport_control_data_t control = {
-            // RSSI is directly used as a % value, so we can pass the LQ as is
-            .rssi = MAX(TELEMETRY_GET_DOWNLINK_I8(data, TELEMETRY_ID_RX_LINK_QUALITY), 0),
-        };
-        sbus_encode_data(&control.sbus, data, failsafe_is_active(data->failsafe.input));
-        fport_write_payload(output_fport, FPORT_FRAME_TYPE_CONTROL, &control, sizeof(control));
-
-        // Request telemetry. Doesn't matter what we write here since the FC
-        // just checks for FPORT_FRAME_TYPE_TELEMETRY_REQUEST
-        smartport_payload_t telemetry = {0};
-        fport_write_payload(output_fport, FPORT_FRAME_TYPE_TELEMETRY_REQUEST, &telemetry, sizeof(telemetry));
-
-        serial_port_end_write(output_fport->output.serial_port);
+        // Control and telemetry request frames are encoded together,
+        // so they're sent with a single write.
+        size_t size;
+        const void *frame = output_get_rc_frame(&output_fport->output, &size);
+        serial_port_write(output_fport->output.serial_port, frame, size);
     }
 
     return true;
@@ -242,5 +255,6 @@ void output_fport_init(output_fport_t *output)
         .open = output_fport_open,
         .update = output_fport_update,
         .close = output_fport_close,
+        .encode_rc = output_fport_encode_rc,
     };
 }
@@ -27,6 +27,8 @@ static const char *TAG = "MSP.Output";
 #define MSP_POLL_SLOW(code) ((output_msp_poll_t){code, MSP_POLL_INTERVAL_SLOW, 0})
 #define MSP_POLL_NORMAL(code) ((output_msp_poll_t){code, MSP_POLL_INTERVAL_NORMAL, 0})
 #define MSP_POLL_FAST(code) ((output_msp_poll_t){code, MSP_POLL_INTERVAL_FAST, 0})
+// If the FC doesn't answer a batch by then, assume it doesn't support it
+#define MSP_MULTIPLE_TIMEOUT MILLIS_TO_MICROS(1000)
 
 typedef struct msp_channels_payload_s
 {
@@ -144,7 +146,7 @@ static uint32_t output_msp_acc_to_telemetry(int16_t acc)
     return acc * (100 / 512.0f);
 }
 
-static void output_msp_message_callback(msp_conn_t *conn, uint16_t cmd, const void *payload, int size, void *arg)
+static void output_msp_handle_message(uint16_t cmd, const void *payload, int size, void *arg)
 {
     switch (cmd)
     {
@@ -265,6 +267,45 @@ static void output_msp_message_callback(msp_conn_t *conn, uint16_t cmd, const vo
     }
 }
 
+static void output_msp_handle_poll_response(output_msp_t *output, uint16_t cmd, const void *payload, int size)
+{
+    output_msp_poll_t *poll = output_msp_poll_find(output->polls, OUTPUT_MSP_POLL_COUNT, cmd);
+    output_msp_poll_response_begin(&output->output);
+    output_msp_handle_message(cmd, payload, size, output);
+    if (poll)
+    {
+        output_msp_poll_response_end(&output->output, poll, false);
+    }
+}
+
+static void output_msp_message_callback(msp_conn_t *conn, uint16_t cmd, const void *payload, int size, void *arg)
+{
+    output_msp_t *output = arg;
+    if (cmd == MSP_MULTIPLE_MSP)
+    {
+        // Response contains, for each requested command, an uint8_t with
+        // the payload size followed by the payload itself.
+        const uint8_t *ptr = payload;
+        const uint8_t *end = ptr + size;
+        for (unsigned ii = 0; ii < output->batch.count && ptr < end; ii++)
+        {
+            uint8_t len = *ptr++;
+            if (ptr + len > end)
+            {
+                break;
+            }
+            if (len > 0)
+            {
+                output_msp_handle_poll_response(output, output->batch.cmds[ii], ptr, len);
+            }
+            ptr += len;
+        }
+        output->batch.count = 0;
+        return;
+    }
+    output_msp_handle_poll_response(output, cmd, payload, size);
+}
+
 static bool output_msp_open(void *output, void *config)
 {
     output_msp_t *output_msp = output;
@@ -331,20 +372,59 @@ static bool output_msp_update(void *output, rc_data_t *data, bool update_rc, tim
         }
     }
     // Check if we need to poll for any telemetry
+    if (output_msp->batch.count > 0 && output_msp->batch.sent_at + MSP_MULTIPLE_TIMEOUT < now)
+    {
+        LOG_W(TAG, "No response to MSP_MULTIPLE_MSP, disabling batched polls");
+        output_msp->batch.unsupported = true;
+        output_msp->batch.count = 0;
+    }
+    // When the FC supports it, due polls are sent together in a single
+    // request to save time on the UART, which might be half duplex and
+    // shared with the RC data.
+    bool can_batch = !output_msp->batch.unsupported && output_msp->batch.count == 0 &&
+                     output_msp_fc_supports_multiple(output);
+    output_msp_poll_t *due[OUTPUT_MSP_POLL_COUNT];
+    unsigned due_count = 0;
     for (int ii = 0; ii < OUTPUT_MSP_POLL_COUNT; ii++)
     {
-        if (output_msp->polls[ii].interval == MSP_POLL_INTERVAL_NONE)
+        output_msp_poll_t *poll = &output_msp->polls[ii];
+        if (!output_msp_poll_is_due(output, poll, now))
         {
             continue;
         }
-        if (output_msp->polls[ii].next_poll < now)
+        if (can_batch && poll->cmd <= UINT8_MAX)
+        {
+            due[due_count++] = poll;
+        }
+        else if (MSP_SEND_REQ(output, poll->cmd) > 0)
+        {
+            output_msp_poll_sent(poll, now);
+        }
+    }
+    if (due_count == 1)
+    {
+        if (MSP_SEND_REQ(output, due[0]->cmd) > 0)
+        {
+            output_msp_poll_sent(due[0], now);
+        }
+    }
+    else if (due_count > 1)
+    {
+        for (unsigned ii = 0; ii < due_count; ii++)
+        {
+            output_msp->batch.cmds[ii] = due[ii]->cmd;
+        }
+        if (msp_conn_send(OUTPUT_MSP_CONN_GET(output), MSP_MULTIPLE_MSP, output_msp->batch.cmds, due_count, output_msp_message_callback, output) > 0)
         {
-            if (MSP_SEND_REQ(output, output_msp->polls[ii].cmd) > 0)
+            output_msp->batch.count = due_count;
+            output_msp->batch.sent_at = now;
+            for (unsigned ii = 0; ii < due_count; ii++)
             {
-                output_msp->polls[ii].next_poll = now + output_msp->polls[ii].interval;
+                output_msp_poll_sent(due[ii], now);
             }
         }
     }
+    output_msp_polls_log_stats(output_msp->polls, OUTPUT_MSP_POLL_COUNT, &output_msp->poll_stats_since, now);
     return updated;
 }
 
@@ -392,6 +472,9 @@ void output_msp_init(output_msp_t *output)
     ARRAY_ASSERT_COUNT(polls, OUTPUT_MSP_POLL_COUNT, "invalid OUTPUT_MSP_POLL_COUNT");
     memcpy(output->polls, polls, sizeof(polls));
 
+    output->poll_stats_since = 0;
+    output->batch.unsupported = false;
+    output->batch.count = 0;
     // Assume false at first, since it's the default value
     output->multiwii_current_meter_output = false;
 }
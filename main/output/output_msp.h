@@ -21,6 +21,14 @@ typedef struct output_msp_s
     output_t output;
     msp_serial_t msp_serial;
     output_msp_poll_t polls[OUTPUT_MSP_POLL_COUNT];
+    time_micros_t poll_stats_since;
+    struct
+    {
+        bool unsupported;                    // FC didn't answer a batch, don't try again
+        uint8_t cmds[OUTPUT_MSP_POLL_COUNT]; // Commands in the batch in flight
+        unsigned count;                      // Number of commands in the batch in flight
+        time_micros_t sent_at;
+    } batch;
     bool multiwii_current_meter_output;
 } output_msp_t;
 
@@ -14,6 +14,11 @@ static void output_none_close(void *output, void *config)
 {
 }
 
+static time_micros_t output_none_next_update_at(void *output, time_micros_t now)
+{
+    return TIME_MICROS_MAX;
+}
+
 void output_none_init(output_none_t *output)
 {
     output->output.flags = OUTPUT_FLAG_LOCAL;
@@ -21,5 +26,6 @@ void output_none_init(output_none_t *output)
         .open = output_none_open,
         .update = output_none_update,
         .close = output_none_close,
+        .next_update_at = output_none_next_update_at,
     };
 }
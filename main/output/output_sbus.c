@@ -42,6 +42,7 @@ static bool output_sbus_open(void *output, void *config)
     };
 
     output_sbus->sport_serial_port = serial_port_open(&sport_port_config);
+    output_sbus->sport_stats_since = 0;
 
     io_t smartport_io = SERIAL_IO(output_sbus->sport_serial_port);
     smartport_master_init(&output_sbus->sport_master, &smartport_io);
@@ -51,22 +52,30 @@ static bool output_sbus_open(void *output, void *config)
     return true;
 }
 
+static size_t output_sbus_encode_rc(void *output, rc_data_t *data, void *buf, size_t size)
+{
+    _Static_assert(sizeof(sbus_payload_t) <= OUTPUT_RC_FRAME_SIZE_MAX, "OUTPUT_RC_FRAME_SIZE_MAX is too small");
+    sbus_payload_t *payload = buf;
+    payload->start_byte = SBUS_START_BYTE;
+    payload->end_byte = SBUS_END_BYTE;
+    sbus_encode_data(&payload->data, data, failsafe_is_active(data->failsafe.input));
+    return sizeof(*payload);
+}
+
 static bool output_sbus_update_sbus(void *output, rc_data_t *data)
 {
     output_sbus_t *output_sbus = output;
-    sbus_payload_t payload = {
-        .start_byte = SBUS_START_BYTE,
-        .end_byte = SBUS_END_BYTE,
-    };
-    sbus_encode_data(&payload.data, data, failsafe_is_active(data->failsafe.input));
-    int n = serial_port_write(output_sbus->output.serial_port, &payload, sizeof(payload));
-    return n == sizeof(payload);
+    size_t size;
+    const void *frame = output_get_rc_frame(&output_sbus->output, &size);
+    int n = serial_port_write(output_sbus->output.serial_port, frame, size);
+    return n == (int)size;
 }
 
-static bool output_sbus_update_sport(void *output, rc_data_t *data)
+static bool output_sbus_update_sport(void *output, rc_data_t *data, time_micros_t now)
 {
     output_sbus_t *output_sbus = output;
     smartport_master_update(&output_sbus->sport_master);
+    output_serial_log_stats(output_sbus->sport_serial_port, &output_sbus->sport_stats_since, now);
     return true;
 }
 
@@ -79,10 +88,17 @@ static bool output_sbus_update(void *output, rc_data_t *data, bool update_rc, ti
             return false;
         }
     }
-    output_sbus_update_sport(output, data);
+    output_sbus_update_sport(output, data, now);
     return true;
 }
 
+static time_micros_t output_sbus_next_update_at(void *output, time_micros_t now)
+{
+    output_sbus_t *output_sbus = output;
+    // SBUS frames are scheduled by output_next_update_at()
+    return smartport_master_next_update_at(&output_sbus->sport_master, now);
+}
+
 static void output_sbus_close(void *output, void *config)
 {
     output_sbus_t *output_sbus = output;
@@ -97,5 +113,7 @@ void output_sbus_init(output_sbus_t *output)
         .open = output_sbus_open,
         .update = output_sbus_update,
         .close = output_sbus_close,
+        .encode_rc = output_sbus_encode_rc,
+        .next_update_at = output_sbus_next_update_at,
     };
 }
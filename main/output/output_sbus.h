@@ -19,6 +19,7 @@ typedef struct output_sbus_s
     output_t output;
     serial_port_t *sport_serial_port;
     smartport_master_t sport_master;
+    time_micros_t sport_stats_since;
 } output_sbus_t;
 
 void output_sbus_init(output_sbus_t *output);
@@ -3,12 +3,52 @@
 
 #include <hal/log.h>
 
+#include "target.h"
+
+#include "platform/coex.h"
+
 #include "rmp/rmp.h"
 
 #include "p2p.h"
 
+// Worst case air time for the 802.11 LR mode (250kbps), including
+// the preamble.
+#define P2P_TX_TIME_US(size) (500 + (size)*32)
+
+#define P2P_MEASURE_INTERVAL SECS_TO_TICKS(1)
+#define P2P_SURVEY_INTERVAL SECS_TO_TICKS(30)
+#define P2P_SURVEY_DWELL MILLIS_TO_TICKS(200)
+// The TX announces its channel to the RX at this interval, while
+// the RX requests it at the same interval until it gets it.
+#define P2P_ANNOUNCE_INTERVAL SECS_TO_TICKS(10)
+// Time between the TX announcing a new channel and switching to it,
+// so the announcement has time to reach the RX.
+#define P2P_SWITCH_DELAY MILLIS_TO_TICKS(500)
+// Channel score is utilization + 2 * loss. Move to another channel
+// when the current one reaches P2P_CONGESTED_SCORE and there's one
+// which is better by at least P2P_MIGRATE_MARGIN.
+#define P2P_CONGESTED_SCORE 40
+#define P2P_MIGRATE_MARGIN 15
+#define P2P_STATS_SMOOTHING 4
+#define P2P_DEFAULT_CHANNEL_IDX 0
+
 static const char *TAG = "p2p";
 
+// Non overlapping channels available everywhere
+static const uint8_t p2p_channels[P2P_CHANNEL_COUNT] = {1, 6, 11};
+
+typedef enum
+{
+    P2P_RMP_CODE_REQ_CHANNEL = 1,
+    P2P_RMP_CODE_CHANNEL,
+} p2p_rmp_code_e;
+
+typedef struct p2p_rmp_channel_msg_s
+{
+    uint8_t code; // from p2p_rmp_code_e
+    uint8_t channel;
+} PACKED p2p_rmp_channel_msg_t;
+
 typedef struct p2p_rmp_hdr_s
 {
     air_addr_t src;
@@ -115,7 +155,9 @@ static bool p2p_rmp_send(rmp_t *rmp, rmp_msg_t *msg, void *user_data)
     p2p_rmp_msg_t p2p_msg;
     p2p_t *p2p = user_data;
 
-    if (!p2p->internal.started)
+    // While surveying we're on another channel, make RMP
+    // fall back to the RC link for unicast messages.
+    if (!p2p->internal.started || p2p->internal.survey_idx >= 0)
     {
         return false;
     }
@@ -125,15 +167,178 @@ static bool p2p_rmp_send(rmp_t *rmp, rmp_msg_t *msg, void *user_data)
     {
         return false;
     }
+#if defined(USE_COEX)
+    coex_wait_for_quiet_window(P2P_TX_TIME_US(p2p_msg_size));
+#endif
     p2p_hal_broadcast(&p2p->internal.hal, &p2p_msg, p2p_msg_size);
     return true;
 }
 
+static int p2p_channel_score(const p2p_channel_stats_t *stats)
+{
+    return stats->utilization + 2 * stats->loss;
+}
+
+static int p2p_channel_index(uint8_t channel)
+{
+    for (int ii = 0; ii < P2P_CHANNEL_COUNT; ii++)
+    {
+        if (p2p_channels[ii] == channel)
+        {
+            return ii;
+        }
+    }
+    return -1;
+}
+
+static void p2p_set_hal_channel(p2p_t *p2p, int idx, time_ticks_t now)
+{
+    p2p_hal_set_channel(&p2p->internal.hal, p2p_channels[idx]);
+    p2p->internal.measure_since = now;
+}
+
+static void p2p_switch_channel(p2p_t *p2p, int idx, time_ticks_t now)
+{
+    LOG_I(TAG, "Switching to channel %u", p2p_channels[idx]);
+    p2p->internal.channel_idx = idx;
+    p2p->internal.survey_idx = -1;
+    p2p_set_hal_channel(p2p, idx, now);
+}
+
+static void p2p_send_channel(p2p_t *p2p, const air_addr_t *dst, int idx)
+{
+    p2p_rmp_channel_msg_t msg = {
+        .code = P2P_RMP_CODE_CHANNEL,
+        .channel = p2p_channels[idx],
+    };
+    rmp_send(p2p->internal.rmp, p2p->internal.port, dst, RMP_PORT_P2P, &msg, sizeof(msg));
+}
+
+static void p2p_measure_channel(p2p_t *p2p, int idx, time_ticks_t now)
+{
+    p2p_hal_channel_stats_t hal_stats;
+    p2p_hal_read_stats(&p2p->internal.hal, &hal_stats);
+    time_ticks_t elapsed = now - p2p->internal.measure_since;
+    unsigned elapsed_us = MILLIS_TO_MICROS(TICKS_TO_MILLIS(elapsed));
+    unsigned utilization = elapsed_us > 0 ? MIN(hal_stats.busy_us * 100 / elapsed_us, 100) : 0;
+    unsigned total = hal_stats.frames + hal_stats.bad_frames;
+    unsigned loss = total > 0 ? hal_stats.bad_frames * 100 / total : 0;
+
+    p2p_channel_stats_t *stats = &p2p->internal.channels[idx];
+    if (stats->measured_at == 0)
+    {
+        stats->utilization = utilization;
+        stats->loss = loss;
+    }
+    else
+    {
+        stats->utilization = (stats->utilization * (P2P_STATS_SMOOTHING - 1) + utilization) / P2P_STATS_SMOOTHING;
+        stats->loss = (stats->loss * (P2P_STATS_SMOOTHING - 1) + loss) / P2P_STATS_SMOOTHING;
+    }
+    stats->frames += hal_stats.frames;
+    stats->p2p_frames += hal_stats.p2p_frames;
+    stats->measured_at = now;
+    p2p->internal.measure_since = now;
+    LOG_D(TAG, "Channel %u: %u frames (%u P2P), %u%% used, %u%% loss", stats->channel,
+          hal_stats.frames, hal_stats.p2p_frames, stats->utilization, stats->loss);
+}
+
+static void p2p_check_congestion(p2p_t *p2p, const air_addr_t *pair_addr, time_ticks_t now)
+{
+    const p2p_channel_stats_t *current = &p2p->internal.channels[p2p->internal.channel_idx];
+    int current_score = p2p_channel_score(current);
+    if (current_score < P2P_CONGESTED_SCORE || p2p->internal.switch_at != 0)
+    {
+        return;
+    }
+    int best = -1;
+    int best_score = current_score - P2P_MIGRATE_MARGIN;
+    for (int ii = 0; ii < P2P_CHANNEL_COUNT; ii++)
+    {
+        const p2p_channel_stats_t *stats = &p2p->internal.channels[ii];
+        if (ii != p2p->internal.channel_idx && stats->measured_at != 0 && p2p_channel_score(stats) < best_score)
+        {
+            best = ii;
+            best_score = p2p_channel_score(stats);
+        }
+    }
+    if (best >= 0)
+    {
+        LOG_I(TAG, "Channel %u congested (%u%% used, %u%% loss), moving to %u",
+              current->channel, current->utilization, current->loss, p2p_channels[best]);
+        p2p->internal.switch_idx = best;
+        p2p->internal.switch_at = now + P2P_SWITCH_DELAY;
+        p2p_send_channel(p2p, pair_addr, best);
+    }
+}
+
+static void p2p_start_survey(p2p_t *p2p, time_ticks_t now)
+{
+    // Measure the channel we haven't measured for the longest time
+    int idx = -1;
+    for (int ii = 0; ii < P2P_CHANNEL_COUNT; ii++)
+    {
+        if (ii != p2p->internal.channel_idx &&
+            (idx < 0 || p2p->internal.channels[ii].measured_at < p2p->internal.channels[idx].measured_at))
+        {
+            idx = ii;
+        }
+    }
+    // Keep the data measured so far in the current channel
+    p2p_measure_channel(p2p, p2p->internal.channel_idx, now);
+    p2p->internal.survey_idx = idx;
+    p2p_set_hal_channel(p2p, idx, now);
+}
+
+static void p2p_rmp_port_handler(rmp_t *rmp, rmp_req_t *req, void *user_data)
+{
+    p2p_t *p2p = user_data;
+    const p2p_rmp_channel_msg_t *msg = req->msg->payload;
+    air_pairing_t pairing;
+    // Only accept messages from the device we're paired with
+    if (!msg || req->msg->payload_size < 1 || !req->is_authenticated ||
+        !rmp_get_pairing(rmp, &pairing) || !air_addr_equals(&pairing.addr, &req->msg->src))
+    {
+        return;
+    }
+    switch ((p2p_rmp_code_e)msg->code)
+    {
+    case P2P_RMP_CODE_REQ_CHANNEL:
+        if (rmp_get_role(rmp) == AIR_ROLE_TX)
+        {
+            p2p_send_channel(p2p, &req->msg->src, p2p->internal.channel_idx);
+        }
+        break;
+    case P2P_RMP_CODE_CHANNEL:
+    {
+        int idx = p2p_channel_index(msg->channel);
+        if (req->msg->payload_size != sizeof(*msg) || idx < 0 || rmp_get_role(rmp) == AIR_ROLE_TX)
+        {
+            break;
+        }
+        p2p->internal.synced = true;
+        if (idx != p2p->internal.channel_idx)
+        {
+            p2p_switch_channel(p2p, idx, time_ticks_now());
+        }
+        break;
+    }
+    }
+}
+
 void p2p_init(p2p_t *p2p, rmp_t *rmp)
 {
     memset(p2p, 0, sizeof(*p2p));
     p2p->internal.rmp = rmp;
+    for (int ii = 0; ii < P2P_CHANNEL_COUNT; ii++)
+    {
+        p2p->internal.channels[ii].channel = p2p_channels[ii];
+    }
+    p2p->internal.channel_idx = P2P_DEFAULT_CHANNEL_IDX;
+    p2p->internal.survey_idx = -1;
     p2p_hal_init(&p2p->internal.hal, p2p_hal_callback, p2p);
+    p2p_hal_set_channel(&p2p->internal.hal, p2p_channels[P2P_DEFAULT_CHANNEL_IDX]);
+    p2p->internal.port = rmp_open_port(rmp, RMP_PORT_P2P, p2p_rmp_port_handler, p2p);
     rmp_set_transport(rmp, RMP_TRANSPORT_P2P, p2p_rmp_send, p2p);
 }
 
@@ -142,6 +347,8 @@ void p2p_start(p2p_t *p2p)
     if (!p2p->internal.started)
     {
         p2p_hal_start(&p2p->internal.hal);
+        p2p->internal.measure_since = time_ticks_now();
+        p2p->internal.next_survey = p2p->internal.measure_since + P2P_SURVEY_INTERVAL;
         p2p->internal.started = true;
     }
 }
@@ -157,5 +364,91 @@ void p2p_stop(p2p_t *p2p)
 
 void p2p_update(p2p_t *p2p)
 {
-    // Nothing to do here for now, the current HW is totally async
+    if (!p2p->internal.started)
+    {
+        return;
+    }
+    time_ticks_t now = time_ticks_now();
+    air_pairing_t pairing;
+    bool paired = rmp_get_pairing(p2p->internal.rmp, &pairing);
+    bool is_tx = paired && rmp_get_role(p2p->internal.rmp) == AIR_ROLE_TX;
+
+    if (p2p->internal.survey_idx >= 0)
+    {
+        if (now - p2p->internal.measure_since >= P2P_SURVEY_DWELL)
+        {
+            p2p_measure_channel(p2p, p2p->internal.survey_idx, now);
+            p2p->internal.survey_idx = -1;
+            p2p_set_hal_channel(p2p, p2p->internal.channel_idx, now);
+            if (is_tx)
+            {
+                p2p_check_congestion(p2p, &pairing.addr, now);
+            }
+        }
+        return;
+    }
+
+    if (now - p2p->internal.measure_since >= P2P_MEASURE_INTERVAL)
+    {
+        p2p_measure_channel(p2p, p2p->internal.channel_idx, now);
+        if (is_tx)
+        {
+            p2p_check_congestion(p2p, &pairing.addr, now);
+        }
+    }
+
+    if (!paired)
+    {
+        // Go back to the default channel, so other devices can see us
+        p2p->internal.synced = false;
+        p2p->internal.switch_at = 0;
+        if (p2p->internal.channel_idx != P2P_DEFAULT_CHANNEL_IDX)
+        {
+            p2p_switch_channel(p2p, P2P_DEFAULT_CHANNEL_IDX, now);
+        }
+        return;
+    }
+
+    if (is_tx)
+    {
+        if (p2p->internal.switch_at != 0 && now >= p2p->internal.switch_at)
+        {
+            p2p->internal.switch_at = 0;
+            p2p_switch_channel(p2p, p2p->internal.switch_idx, now);
+        }
+        else if (p2p->internal.switch_at == 0 && now >= p2p->internal.next_survey)
+        {
+            p2p_start_survey(p2p, now);
+            p2p->internal.next_survey = now + P2P_SURVEY_INTERVAL;
+            return;
+        }
+        if (now >= p2p->internal.next_announce)
+        {
+            p2p_send_channel(p2p, &pairing.addr, p2p->internal.channel_idx);
+            p2p->internal.next_announce = now + P2P_ANNOUNCE_INTERVAL;
+        }
+    }
+    else if (!p2p->internal.synced && now >= p2p->internal.next_announce)
+    {
+        p2p_rmp_channel_msg_t req = {
+            .code = P2P_RMP_CODE_REQ_CHANNEL,
+        };
+        rmp_send(p2p->internal.rmp, p2p->internal.port, &pairing.addr, RMP_PORT_P2P, &req, 1);
+        p2p->internal.next_announce = now + P2P_ANNOUNCE_INTERVAL;
+    }
+}
+
+int p2p_get_channel(p2p_t *p2p)
+{
+    return p2p_channels[p2p->internal.channel_idx];
+}
+
+bool p2p_get_channel_stats(p2p_t *p2p, int idx, p2p_channel_stats_t *stats)
+{
+    if (idx < 0 || idx >= P2P_CHANNEL_COUNT)
+    {
+        return false;
+    }
+    *stats = p2p->internal.channels[idx];
+    return true;
 }
\ No newline at end of file
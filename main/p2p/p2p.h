@@ -1,12 +1,33 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include <hal/p2p.h>
 
+#include "util/time.h"
+
+#define P2P_CHANNEL_COUNT 3
+
 typedef struct rmp_s rmp_t;
 typedef struct rmp_msg_s rmp_msg_t;
+typedef struct rmp_port_s rmp_port_t;
+
+typedef struct p2p_channel_stats_s
+{
+    uint8_t channel;          // WiFi channel number
+    uint8_t utilization;      // Estimated % of the air time in use, smoothed
+    uint8_t loss;             // % of the frames received with errors, smoothed
+    unsigned frames;          // Total frames seen in this channel
+    unsigned p2p_frames;      // Total P2P frames seen in this channel
+    time_ticks_t measured_at; // Last time the channel was measured, 0 if never
+} p2p_channel_stats_t;
 
+// When paired, the TX picks the P2P channel from the candidates, based
+// on their utilization and loss. Its paired RX follows it. The TX
+// periodically listens for a short time on the other channels to
+// measure them. Unpaired devices stay on the default channel, so they
+// can discover each other.
 typedef struct p2p_s
 {
     struct
@@ -14,10 +35,24 @@ typedef struct p2p_s
         p2p_hal_t hal;
         bool started;
         rmp_t *rmp;
+        const rmp_port_t *port;
+        p2p_channel_stats_t channels[P2P_CHANNEL_COUNT];
+        uint8_t channel_idx;    // Index into channels for the agreed channel
+        int8_t survey_idx;      // Index into channels while surveying, -1 otherwise
+        bool synced;            // Wether we've received the channel from our TX
+        time_ticks_t measure_since;
+        time_ticks_t next_survey;
+        time_ticks_t next_announce;
+        time_ticks_t switch_at; // Channel change scheduled by the TX, 0 if none
+        uint8_t switch_idx;
     } internal;
 } p2p_t;
 
 void p2p_init(p2p_t *p2p, rmp_t *rmp);
 void p2p_start(p2p_t *p2p);
 void p2p_stop(p2p_t *p2p);
-void p2p_update(p2p_t *p2p);
\ No newline at end of file
+// Measures the channels and handles the channel changes. Must be
+// called periodically (at least every few hundred ms).
+void p2p_update(p2p_t *p2p);
+int p2p_get_channel(p2p_t *p2p);
+bool p2p_get_channel_stats(p2p_t *p2p, int idx, p2p_channel_stats_t *stats);
@@ -0,0 +1,530 @@
+#if defined(USE_BENCHMARK)
+
+#include <stdint.h>
+#include <string.h>
+
+#include <hal/log.h>
+
+#include <os/os.h>
+
+#if defined(STM32)
+#include <libopencm3/cm3/dwt.h>
+#else
+#include <xtensa/hal.h>
+#endif
+
+#include "air/air_stream.h"
+
+#include "io/io.h"
+#include "io/storage.h"
+
+#include "msp/msp_serial.h"
+
+#include "protocols/crsf.h"
+#include "protocols/ibus.h"
+#include "protocols/sbus.h"
+#include "protocols/smartport.h"
+
+#include "rc/rc_data.h"
+
+#include "target/buffer_profile.h"
+
+#include "util/crc.h"
+#include "util/fec.h"
+#include "util/macros.h"
+#include "util/ringbuffer.h"
+#include "util/time.h"
+#include "util/uvarint.h"
+
+#include "benchmark.h"
+
+static const char *TAG = "Benchmark";
+
+// Maximum slowdown over the baseline before a benchmark is reported
+// as a regression. Can be overridden at build time.
+#if !defined(BENCHMARK_TOLERANCE_PERCENT)
+#define BENCHMARK_TOLERANCE_PERCENT 10
+#endif
+
+// Each benchmark runs for at least this long. Time is measured with the
+// CPU cycle counter, since on STM32 the benchmarks run before the
+// scheduler has started and the tick based clock doesn't advance yet.
+#define BENCHMARK_DURATION_CYCLES (configCPU_CLOCK_HZ / 5)
+// Upper bound, in case the cycle counter is not running
+#define BENCHMARK_MAX_FRAMES (1 << 20)
+#define BENCHMARK_BATCH_SIZE 16
+#define BENCHMARK_PAYLOAD_SIZE 64
+
+typedef struct benchmark_s
+{
+    const char *name;
+    void (*setup)(void);
+    void (*run)(void); // Processes a single frame
+    size_t frame_size; // In bytes
+} benchmark_t;
+
+// In-memory io_t. Reads always return the whole buffer, writes are
+// stored so the encoders can produce the input for the decoders.
+typedef struct benchmark_io_s
+{
+    uint8_t buf[MSP_MAX_PAYLOAD_SIZE];
+    size_t size;
+} benchmark_io_t;
+
+static uint8_t payload[BENCHMARK_PAYLOAD_SIZE];
+static uint8_t output[FEC_ENCODED_SIZE(BENCHMARK_PAYLOAD_SIZE)];
+static volatile unsigned sink;
+static benchmark_io_t bench_io;
+
+static int benchmark_io_read(void *data, void *buf, size_t size, time_ticks_t timeout)
+{
+    benchmark_io_t *io = data;
+    size_t n = MIN(size, io->size);
+    memcpy(buf, io->buf, n);
+    return n;
+}
+
+static int benchmark_io_write(void *data, const void *buf, size_t size)
+{
+    benchmark_io_t *io = data;
+    size_t n = MIN(size, sizeof(io->buf));
+    memcpy(io->buf, buf, n);
+    io->size = n;
+    return n;
+}
+
+static io_flags_t benchmark_io_flags(void *data)
+{
+    return 0;
+}
+
+static io_t benchmark_io(void)
+{
+    return IO_MAKE(benchmark_io_read, benchmark_io_write, benchmark_io_flags, &bench_io);
+}
+
+static void benchmark_setup_payload(void)
+{
+    for (int ii = 0; ii < ARRAY_COUNT(payload); ii++)
+    {
+        payload[ii] = ii * 37;
+    }
+}
+
+// util/
+
+static void benchmark_crc_dvb_s2(void)
+{
+    sink = crc8_dvb_s2_bytes(payload, sizeof(payload));
+}
+
+static void benchmark_crc_xor(void)
+{
+    sink = crc_xor_bytes(payload, sizeof(payload));
+}
+
+static void benchmark_fec_encode(void)
+{
+    sink = fec_encode(payload, sizeof(payload), output, sizeof(output));
+}
+
+static void benchmark_fec_decode_setup(void)
+{
+    benchmark_setup_payload();
+    fec_encode(payload, sizeof(payload), output, sizeof(output));
+}
+
+static void benchmark_fec_decode(void)
+{
+    sink = fec_decode(output, sizeof(output), payload, sizeof(payload));
+}
+
+static void benchmark_uvarint(void)
+{
+    // Encode and decode 16 values, from 1 to 5 bytes long
+    uint8_t buf[5];
+    uint32_t v;
+    for (int ii = 0; ii < 16; ii++)
+    {
+        int n = uvarint_encode32(buf, sizeof(buf), 1u << (ii * 2));
+        uvarint_decode32(&v, buf, n);
+        sink += v;
+    }
+}
+
+static RING_BUFFER_DECLARE_VAR(ring, rb, uint8_t, BENCHMARK_PAYLOAD_SIZE)
+
+static void benchmark_ring_buffer_setup(void)
+{
+    benchmark_setup_payload();
+    RING_BUFFER_INIT(&ring.rb, uint8_t, BENCHMARK_PAYLOAD_SIZE);
+}
+
+static void benchmark_ring_buffer(void)
+{
+    uint8_t c;
+    for (int ii = 0; ii < ARRAY_COUNT(payload); ii++)
+    {
+        ring_buffer_push(&ring.rb, &payload[ii]);
+    }
+    while (ring_buffer_pop(&ring.rb, &c))
+    {
+        sink += c;
+    }
+}
+
+// air/
+
+static air_stream_t stream;
+
+static void benchmark_air_stream_setup(void)
+{
+    benchmark_setup_payload();
+    // Include some bytes that require stuffing
+    payload[10] = AIR_DATA_START_STOP;
+    payload[20] = AIR_DATA_START_STOP;
+    air_stream_init(&stream, NULL, NULL, NULL, NULL);
+}
+
+static void benchmark_air_stream(void)
+{
+    uint8_t c;
+    air_stream_feed_output_cmd(&stream, AIR_CMD_MSP, payload, sizeof(payload));
+    while (air_stream_pop_output(&stream, &c))
+    {
+        sink += c;
+    }
+}
+
+// Biggest MSP payload allowed by the buffer profile
+static uint8_t max_payload[MSP_MAX_PAYLOAD_SIZE];
+
+static void benchmark_air_stream_max_setup(void)
+{
+    for (int ii = 0; ii < ARRAY_COUNT(max_payload); ii++)
+    {
+        max_payload[ii] = ii * 31;
+    }
+    air_stream_init(&stream, NULL, NULL, NULL, NULL);
+}
+
+static void benchmark_air_stream_max(void)
+{
+    uint8_t c;
+    air_stream_feed_output_cmd(&stream, AIR_CMD_MSP, max_payload, sizeof(max_payload));
+    while (air_stream_pop_output(&stream, &c))
+    {
+        sink += c;
+    }
+}
+
+// protocols/
+
+static rc_data_t rc_data;
+static sbus_data_t sbus_data;
+
+static void benchmark_sbus_setup(void)
+{
+    for (int ii = 0; ii < RC_CHANNELS_NUM; ii++)
+    {
+        rc_data.channels[ii].value = RC_CHANNEL_MIN_VALUE + ii * 100;
+    }
+    rc_data.channels_num = RC_CHANNELS_NUM;
+}
+
+static void benchmark_sbus_encode(void)
+{
+    sbus_encode_data(&sbus_data, &rc_data, false);
+    sink += sbus_data.flags;
+}
+
+static crsf_port_t crsf_port;
+static uint8_t crsf_encoded[CRSF_FRAME_SIZE_MAX];
+static size_t crsf_encoded_size;
+
+static void benchmark_crsf_frame_callback(void *data, crsf_frame_t *frame)
+{
+    sink += frame->header.type;
+}
+
+static void benchmark_crsf_setup(void)
+{
+    io_t io = benchmark_io();
+    crsf_frame_t frame = {
+        .header.device_addr = CRSF_ADDRESS_FLIGHT_CONTROLLER,
+        .header.frame_size = sizeof(crsf_channels_t) + 2,
+        .header.type = CRSF_FRAMETYPE_RC_CHANNELS_PACKED,
+    };
+    crsf_port_init(&crsf_port, &io, benchmark_crsf_frame_callback, NULL);
+    crsf_port_write(&crsf_port, &frame);
+    memcpy(crsf_encoded, bench_io.buf, bench_io.size);
+    crsf_encoded_size = bench_io.size;
+}
+
+static void benchmark_crsf_decode(void)
+{
+    for (size_t ii = 0; ii < crsf_encoded_size; ii++)
+    {
+        crsf_port_push(&crsf_port, crsf_encoded[ii]);
+    }
+    crsf_port_decode(&crsf_port);
+}
+
+static void benchmark_crsf_resync(void)
+{
+    // Garbage with a valid address, followed by a valid frame
+    static const uint8_t noise[] = {CRSF_ADDRESS_FLIGHT_CONTROLLER, 0x10, 0x16, 0xaa, 0x55, 0x00};
+    for (size_t ii = 0; ii < sizeof(noise); ii++)
+    {
+        crsf_port_push(&crsf_port, noise[ii]);
+    }
+    benchmark_crsf_decode();
+}
+
+static ibus_port_t ibus_port;
+static ibus_frame_t ibus_frame;
+
+static void benchmark_ibus_frame_callback(void *data, ibus_frame_t *frame)
+{
+    sink += frame->payload.ch[0];
+}
+
+static void benchmark_ibus_setup(void)
+{
+    io_t io = benchmark_io();
+    ibus_port_init(&ibus_port, &io, benchmark_ibus_frame_callback, NULL);
+    ibus_frame.payload.pack_len = sizeof(ibus_frame);
+    ibus_frame.payload.pack_type = IBUS_FRAMETYPE_RC_CHANNELS;
+    uint16_t sum = 0;
+    for (int ii = 0; ii < ARRAY_COUNT(ibus_frame.payload.ch); ii++)
+    {
+        ibus_frame.payload.ch[ii] = IBUS_CHANNEL_VALUE_MID;
+    }
+    for (size_t ii = 0; ii < sizeof(ibus_frame) - 2; ii++)
+    {
+        sum += ibus_frame.bytes[ii];
+    }
+    ibus_frame.payload.checksum = 0xffff - sum;
+}
+
+static void benchmark_ibus_decode(void)
+{
+    memcpy(ibus_port.buf, ibus_frame.bytes, sizeof(ibus_frame));
+    ibus_port.buf_pos = sizeof(ibus_frame);
+    ibus_port_decode(&ibus_port);
+}
+
+static msp_serial_t msp_serial;
+
+static void benchmark_msp_setup(void)
+{
+    io_t io = benchmark_io();
+    benchmark_setup_payload();
+    msp_serial_init(&msp_serial, &io);
+}
+
+static void benchmark_msp(uint16_t cmd)
+{
+    msp_direction_e direction;
+    uint16_t rcmd;
+    msp_transport_write(MSP_TRANSPORT(&msp_serial), MSP_DIRECTION_TO_MWC, cmd, payload, sizeof(payload));
+    msp_transport_read(MSP_TRANSPORT(&msp_serial), &direction, &rcmd, output, sizeof(output));
+    sink += rcmd;
+}
+
+static void benchmark_msp_v1(void)
+{
+    benchmark_msp(MSP_RAW_GPS);
+}
+
+static void benchmark_msp_v2(void)
+{
+    // Codes > 254 use MSPv2
+    benchmark_msp(0x1000);
+}
+
+static smartport_master_t smartport;
+static uint8_t smartport_encoded[sizeof(smartport_payload_t) * 2 + 1];
+static size_t smartport_encoded_size;
+
+static int benchmark_smartport_read(void *data, void *buf, size_t size, time_ticks_t timeout)
+{
+    size_t n = MIN(size, smartport_encoded_size);
+    memcpy(buf, smartport_encoded, n);
+    return n;
+}
+
+static int benchmark_smartport_write(void *data, const void *buf, size_t size)
+{
+    // Discard the polls
+    return size;
+}
+
+static void benchmark_smartport_telemetry(void *data, telemetry_downlink_id_e id, telemetry_val_t *val)
+{
+    sink += val->u8;
+}
+
+static void benchmark_smartport_setup(void)
+{
+    io_t io = IO_MAKE(benchmark_smartport_read, benchmark_smartport_write, benchmark_io_flags, NULL);
+    smartport_master_init(&smartport, &io);
+    smartport.telemetry_found = benchmark_smartport_telemetry;
+    // Altitude, with both bytes that require stuffing in the data
+    smartport_payload_t payload = {
+        .frame_id = 0x10,
+        .value_id = 0x0100,
+        .data = SMARTPORT_START_STOP | (SMARTPORT_BYTE_STUFF << 16),
+    };
+    const uint8_t *p = (const uint8_t *)&payload;
+    uint16_t checksum = 0;
+    smartport_encoded_size = 0;
+    for (size_t ii = 0; ii < sizeof(payload); ii++)
+    {
+        uint8_t c = p[ii];
+        checksum += c;
+        if (c == SMARTPORT_START_STOP || c == SMARTPORT_BYTE_STUFF)
+        {
+            smartport_encoded[smartport_encoded_size++] = SMARTPORT_BYTE_STUFF;
+            c ^= SMARTPORT_XOR;
+        }
+        smartport_encoded[smartport_encoded_size++] = c;
+    }
+    smartport_encoded[smartport_encoded_size++] = 0xff - ((checksum & 0xff) + (checksum >> 8));
+}
+
+static void benchmark_smartport_decode(void)
+{
+    // Reads and unstuffs a payload, then sends the next poll
+    smartport_master_update(&smartport);
+}
+
+static const benchmark_t benchmarks[] = {
+    {"crc8_dvb_s2", benchmark_setup_payload, benchmark_crc_dvb_s2, BENCHMARK_PAYLOAD_SIZE},
+    {"crc_xor", benchmark_setup_payload, benchmark_crc_xor, BENCHMARK_PAYLOAD_SIZE},
+    {"fec_encode", benchmark_setup_payload, benchmark_fec_encode, BENCHMARK_PAYLOAD_SIZE},
+    {"fec_decode", benchmark_fec_decode_setup, benchmark_fec_decode, FEC_ENCODED_SIZE(BENCHMARK_PAYLOAD_SIZE)},
+    {"uvarint", NULL, benchmark_uvarint, 16 * 3},
+    {"ring_buffer", benchmark_ring_buffer_setup, benchmark_ring_buffer, BENCHMARK_PAYLOAD_SIZE},
+    {"air_stream", benchmark_air_stream_setup, benchmark_air_stream, BENCHMARK_PAYLOAD_SIZE},
+    {"air_stream_max", benchmark_air_stream_max_setup, benchmark_air_stream_max, MSP_MAX_PAYLOAD_SIZE},
+    {"sbus_encode", benchmark_sbus_setup, benchmark_sbus_encode, sizeof(sbus_data_t)},
+    {"crsf_decode", benchmark_crsf_setup, benchmark_crsf_decode, sizeof(crsf_channels_t) + 4},
+    {"crsf_resync", benchmark_crsf_setup, benchmark_crsf_resync, sizeof(crsf_channels_t) + 4 + 6},
+    {"ibus_decode", benchmark_ibus_setup, benchmark_ibus_decode, sizeof(ibus_frame_t)},
+    {"msp_v1", benchmark_msp_setup, benchmark_msp_v1, BENCHMARK_PAYLOAD_SIZE + MSP_V1_PROTOCOL_BYTES},
+    {"msp_v2", benchmark_msp_setup, benchmark_msp_v2, BENCHMARK_PAYLOAD_SIZE + MSP_V2_PROTOCOL_BYTES},
+    // Payload, checksum and the 2 stuffed bytes
+    {"smartport_decode", benchmark_smartport_setup, benchmark_smartport_decode, sizeof(smartport_payload_t) + 3},
+};
+
+// Baselines are recorded in the flash on the first run on each device
+// (or when building with BENCHMARK_RECORD defined) and compared against
+// on the following ones. They're in cycles/byte, which doesn't depend
+// on the CPU frequency.
+typedef struct benchmark_baselines_s
+{
+    float cycles_per_byte[ARRAY_COUNT(benchmarks)];
+} benchmark_baselines_t;
+
+static const char benchmark_baselines_key[] = "base";
+
+static bool benchmark_cycles_init(void)
+{
+#if defined(STM32)
+    return dwt_enable_cycle_counter();
+#else
+    return true;
+#endif
+}
+
+static uint32_t benchmark_cycles_now(void)
+{
+#if defined(STM32)
+    return dwt_read_cycle_counter();
+#else
+    return xthal_get_ccount();
+#endif
+}
+
+bool benchmark_run(void)
+{
+    // Must outlive this function, the storage worker might commit it later
+    static storage_t storage;
+    unsigned regressions = 0;
+    benchmark_baselines_t baselines;
+    benchmark_baselines_t results;
+
+    if (!benchmark_cycles_init())
+    {
+        LOG_W(TAG, "No cycle counter, can't run benchmarks");
+        return true;
+    }
+    storage_init(&storage, STORAGE_NS_BENCHMARK);
+    bool has_baselines = storage_get_sized_blob(&storage, benchmark_baselines_key, sizeof(benchmark_baselines_key) - 1,
+                                                &baselines, sizeof(baselines));
+#if defined(BENCHMARK_RECORD)
+    has_baselines = false;
+#endif
+    LOG_I(TAG, "Running %d benchmarks, tolerance %d%%, buffer profile %s", ARRAY_COUNT(benchmarks),
+          BENCHMARK_TOLERANCE_PERCENT, BUFFER_PROFILE_NAME);
+    for (int ii = 0; ii < ARRAY_COUNT(benchmarks); ii++)
+    {
+        const benchmark_t *b = &benchmarks[ii];
+        if (b->setup)
+        {
+            b->setup();
+        }
+        // Warm up caches
+        b->run();
+        unsigned frames = 0;
+        uint32_t start = benchmark_cycles_now();
+        uint32_t elapsed;
+        do
+        {
+            for (int jj = 0; jj < BENCHMARK_BATCH_SIZE; jj++)
+            {
+                b->run();
+            }
+            frames += BENCHMARK_BATCH_SIZE;
+            elapsed = benchmark_cycles_now() - start;
+        } while (elapsed < BENCHMARK_DURATION_CYCLES && frames < BENCHMARK_MAX_FRAMES);
+
+        float cycles_per_frame = (float)elapsed / frames;
+        float cycles_per_byte = cycles_per_frame / b->frame_size;
+        // At the nominal CPU frequency
+        float ns_per_byte = cycles_per_byte * (1e9f / configCPU_CLOCK_HZ);
+        results.cycles_per_byte[ii] = cycles_per_byte;
+        if (has_baselines && baselines.cycles_per_byte[ii] > 0)
+        {
+            float baseline = baselines.cycles_per_byte[ii];
+            float delta = ((cycles_per_byte - baseline) * 100) / baseline;
+            if (delta > BENCHMARK_TOLERANCE_PERCENT)
+            {
+                LOG_W(TAG, "%s: %.2f ns/byte, %u cycles/frame, %+.1f%% over baseline (REGRESSION)",
+                      b->name, ns_per_byte, (unsigned)cycles_per_frame, delta);
+                regressions++;
+            }
+            else
+            {
+                LOG_I(TAG, "%s: %.2f ns/byte, %u cycles/frame, %+.1f%% over baseline",
+                      b->name, ns_per_byte, (unsigned)cycles_per_frame, delta);
+            }
+        }
+        else
+        {
+            LOG_I(TAG, "%s: %.2f ns/byte, %u cycles/frame", b->name, ns_per_byte, (unsigned)cycles_per_frame);
+        }
+    }
+    if (!has_baselines)
+    {
+        storage_set_blob(&storage, benchmark_baselines_key, sizeof(benchmark_baselines_key) - 1, &results, sizeof(results));
+        storage_commit(&storage);
+        LOG_I(TAG, "Benchmarks finished, results recorded as baselines");
+        return true;
+    }
+    LOG_I(TAG, "Benchmarks finished, %u regressions", regressions);
+    return regressions == 0;
+}
+
+#endif
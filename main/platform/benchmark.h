@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdbool.h>
+
+// Runs the microbenchmarks for the per-byte primitives used by the
+// protocols (CRCs, FEC, varints, framing, etc...) and logs ns/byte and
+// cycles/frame for each one of them, comparing them against the baselines
+// stored in the flash. The first run on a device records the baselines
+// (also forced by defining BENCHMARK_RECORD). Returns false if any
+// benchmark is slower than its baseline by more than
+// BENCHMARK_TOLERANCE_PERCENT.
+//
+// Only available when building with BENCHMARK=1.
+bool benchmark_run(void);
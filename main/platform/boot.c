@@ -0,0 +1,58 @@
+#include <hal/log.h>
+
+#include <os/os.h>
+
+#include "util/macros.h"
+
+#include "boot.h"
+
+static const char *TAG = "Boot";
+
+static time_micros_t boot_phase_times[BOOT_PHASE_COUNT];
+
+static const char *boot_phase_names[] = {
+    [BOOT_PHASE_HAL] = "HAL",
+    [BOOT_PHASE_CONFIG] = "Config",
+    [BOOT_PHASE_RC] = "RC",
+    [BOOT_PHASE_RADIO] = "Radio",
+    [BOOT_PHASE_FIRST_FRAME] = "First frame",
+    [BOOT_PHASE_DEFERRED] = "Deferred",
+    [BOOT_PHASE_UI] = "UI",
+};
+
+_Static_assert(ARRAY_COUNT(boot_phase_names) == BOOT_PHASE_COUNT, "missing boot phase names");
+
+void boot_phase_done(boot_phase_e phase)
+{
+    if (boot_phase_times[phase] == 0)
+    {
+        // Make sure a phase reached at t=0 is not seen as not reached
+        boot_phase_times[phase] = MAX(time_micros_now(), 1);
+        LOG_I(TAG, "%s ready at %ums", boot_phase_names[phase], (unsigned)(boot_phase_times[phase] / 1000));
+    }
+}
+
+bool boot_phase_is_done(boot_phase_e phase)
+{
+    return boot_phase_times[phase] > 0;
+}
+
+time_micros_t boot_phase_get_time(boot_phase_e phase)
+{
+    return boot_phase_times[phase];
+}
+
+const char *boot_phase_get_name(boot_phase_e phase)
+{
+    return boot_phase_names[phase];
+}
+
+void boot_wait_for_deferred_init(void)
+{
+    const time_micros_t timeout = MILLIS_TO_MICROS(BOOT_DEFERRED_INIT_TIMEOUT_MS);
+    while (!boot_phase_is_done(BOOT_PHASE_FIRST_FRAME) && time_micros_now() < timeout)
+    {
+        vTaskDelay(MILLIS_TO_TICKS(10));
+    }
+    boot_phase_done(BOOT_PHASE_DEFERRED);
+}
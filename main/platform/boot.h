@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "util/time.h"
+
+// Boot phases, in the order they're normally reached. The radio and the
+// RC path are brought up first, while the screen, P2P and Bluetooth are
+// initialized once the link is live (or after BOOT_DEFERRED_INIT_TIMEOUT_MS
+// if it doesn't come up), so the time to the first RC frame after a
+// reset is as short as possible.
+// The boot times are sent over RMP as an array indexed by phase, so
+// new phases must be appended at the end (before BOOT_PHASE_COUNT)
+// and existing ones must never be reordered or removed.
+typedef enum
+{
+    BOOT_PHASE_HAL,         // HAL initialized
+    BOOT_PHASE_CONFIG,      // Config and settings loaded
+    BOOT_PHASE_RC,          // RMP and RC initialized, RC task started
+    BOOT_PHASE_RADIO,       // Radio initialized by the RC task
+    BOOT_PHASE_FIRST_FRAME, // First valid RC frame written to the output
+    BOOT_PHASE_DEFERRED,    // Deferred initialization started
+    BOOT_PHASE_UI,          // Screen initialized by the UI task
+    BOOT_PHASE_COUNT,
+} boot_phase_e;
+
+#define BOOT_DEFERRED_INIT_TIMEOUT_MS 1000
+
+// Records the time since power on for the given phase. Only the
+// first call for each phase is recorded.
+void boot_phase_done(boot_phase_e phase);
+bool boot_phase_is_done(boot_phase_e phase);
+// Returns the time since power on when the phase was reached, or
+// 0 if it hasn't been reached yet.
+time_micros_t boot_phase_get_time(boot_phase_e phase);
+const char *boot_phase_get_name(boot_phase_e phase);
+// Blocks until the first RC frame has been written to the output
+// or BOOT_DEFERRED_INIT_TIMEOUT_MS have passed since power on.
+// Used by the tasks which initialize non critical subsystems.
+void boot_wait_for_deferred_init(void);
@@ -0,0 +1,152 @@
+#include "target.h"
+
+#if defined(USE_COEX)
+
+#include <string.h>
+
+#include <hal/log.h>
+
+#include <os/os.h>
+
+#include "util/macros.h"
+
+#include "coex.h"
+
+// Margin to leave before an air slot
+#define COEX_GUARD_US 500
+// Time after an air slot starts while the RC task is busy
+// preparing and sending the frame.
+#define COEX_SLOT_BUSY_US 1000
+// Right after the busy period is the longest quiet window we can get.
+// Bursts longer than the time between slots are started there.
+#define COEX_SLOT_QUIET_US 2000
+// Never defer a burst for longer than this, in case
+// the air slots are too close to each other.
+#define COEX_MAX_DEFER_US 20000
+#define COEX_STATS_INTERVAL SECS_TO_TICKS(10)
+
+static const char *TAG = "Coex";
+
+// Times are stored as the low 32 bits of time_micros_t, so they can
+// be read atomically from the other core. Differences are still
+// correct as long as they're shorter than ~35 minutes.
+static struct
+{
+    bool enabled;
+    TaskHandle_t rc_task;
+    uint32_t next_slot_at;
+    uint32_t last_slot_at;
+    coex_stats_t stats[2]; // Indexed by enabled
+    time_ticks_t next_stats_log;
+} coex = {
+    .enabled = true,
+};
+
+void coex_air_slot_scheduled(time_micros_t at)
+{
+    if (UNLIKELY(!coex.rc_task))
+    {
+        coex.rc_task = xTaskGetCurrentTaskHandle();
+    }
+    __atomic_store_n(&coex.next_slot_at, (uint32_t)at, __ATOMIC_RELEASE);
+}
+
+void coex_air_slot_started(time_micros_t scheduled, time_micros_t now)
+{
+    __atomic_store_n(&coex.last_slot_at, (uint32_t)now, __ATOMIC_RELEASE);
+    if (scheduled == 0 || now < scheduled)
+    {
+        return;
+    }
+    coex_stats_t *stats = &coex.stats[coex.enabled];
+    unsigned jitter = now - scheduled;
+    stats->slots++;
+    stats->jitter_sum_us += jitter;
+    stats->max_jitter_us = MAX(stats->max_jitter_us, jitter);
+}
+
+static bool coex_is_quiet(uint32_t now, time_micros_t duration)
+{
+    uint32_t since_last = now - __atomic_load_n(&coex.last_slot_at, __ATOMIC_ACQUIRE);
+    int32_t until_next = __atomic_load_n(&coex.next_slot_at, __ATOMIC_ACQUIRE) - now;
+    if (since_last < COEX_SLOT_BUSY_US && until_next > 0)
+    {
+        // Slot in progress
+        return false;
+    }
+    if (until_next <= 0)
+    {
+        // Either the slot is due but the RC task hasn't started it
+        // yet, or the link is not running and the times are stale.
+        return -until_next > COEX_MAX_DEFER_US;
+    }
+    return until_next > (int32_t)(duration + COEX_GUARD_US) ||
+           since_last < COEX_SLOT_BUSY_US + COEX_SLOT_QUIET_US;
+}
+
+void coex_wait_for_quiet_window(time_micros_t duration)
+{
+    if (!coex.enabled || xTaskGetCurrentTaskHandle() == coex.rc_task)
+    {
+        return;
+    }
+    time_micros_t started = time_micros_now();
+    time_micros_t now = started;
+    while (!coex_is_quiet(now, duration) && now - started < COEX_MAX_DEFER_US)
+    {
+        vTaskDelay(1);
+        now = time_micros_now();
+    }
+    if (now > started)
+    {
+        coex_stats_t *stats = &coex.stats[true];
+        unsigned deferred = now - started;
+        stats->deferred++;
+        stats->max_deferred_us = MAX(stats->max_deferred_us, deferred);
+    }
+}
+
+void coex_set_enabled(bool enabled)
+{
+    if (enabled != coex.enabled)
+    {
+        coex.enabled = enabled;
+        // Start a new measurement for the new state
+        memset(&coex.stats[enabled], 0, sizeof(coex.stats[enabled]));
+        LOG_I(TAG, "Scheduler %s", enabled ? "enabled" : "disabled");
+    }
+}
+
+bool coex_is_enabled(void)
+{
+    return coex.enabled;
+}
+
+void coex_get_stats(bool enabled, coex_stats_t *stats)
+{
+    *stats = coex.stats[enabled ? 1 : 0];
+}
+
+static void coex_log_stats(bool enabled)
+{
+    const coex_stats_t *stats = &coex.stats[enabled];
+    if (stats->slots > 0)
+    {
+        LOG_I(TAG, "%s: %u slots, jitter avg %uus, max %uus, %u deferred (max %uus)",
+              enabled ? "Enabled" : "Disabled", stats->slots, (unsigned)(stats->jitter_sum_us / stats->slots),
+              stats->max_jitter_us, stats->deferred, stats->max_deferred_us);
+    }
+}
+
+void coex_update(void)
+{
+    time_ticks_t now = time_ticks_now();
+    if (now >= coex.next_stats_log)
+    {
+        coex_log_stats(false);
+        coex_log_stats(true);
+        coex.next_stats_log = now + COEX_STATS_INTERVAL;
+    }
+}
+
+#endif
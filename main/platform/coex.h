@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "util/time.h"
+
+// Coexistence scheduler between the LoRa air slots and the 2.4GHz
+// subsystems (Bluetooth and P2P) running on the other core. The RC
+// side reports when its air slots are scheduled and when they actually
+// start, while Bluetooth and P2P call coex_wait_for_quiet_window()
+// before generating bursts of activity, so their interrupts and bus
+// traffic don't delay the slots.
+//
+// Only available when USE_COEX is defined.
+
+typedef struct coex_stats_s
+{
+    unsigned slots;           // Air slots started
+    uint64_t jitter_sum_us;   // Sum of the slot start delays
+    unsigned max_jitter_us;   // Maximum slot start delay
+    unsigned deferred;        // Bursts deferred to a quiet window
+    unsigned max_deferred_us; // Maximum time a burst was deferred
+} coex_stats_t;
+
+// Called from the RC task when the next air slot has been scheduled
+void coex_air_slot_scheduled(time_micros_t at);
+// Called from the RC task when an air slot starts, to measure the jitter
+void coex_air_slot_started(time_micros_t scheduled, time_micros_t now);
+
+// Blocks until there's a window of at least duration before the next
+// air slot, up to a maximum time. Returns immediately when the
+// scheduler is disabled or when called from the RC task.
+void coex_wait_for_quiet_window(time_micros_t duration);
+
+// Stats are tracked separately for each state, so the effect of
+// the scheduler can be measured by toggling it.
+void coex_set_enabled(bool enabled);
+bool coex_is_enabled(void);
+void coex_get_stats(bool enabled, coex_stats_t *stats);
+// Logs the stats periodically
+void coex_update(void);
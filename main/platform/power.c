@@ -0,0 +1,135 @@
+#include <assert.h>
+
+#include <hal/log.h>
+
+#if defined(USE_POWER_MANAGEMENT)
+#include <esp32/pm.h>
+#include <esp_pm.h>
+#endif
+
+#include "target.h"
+
+#include "util/macros.h"
+
+#include "power.h"
+
+#if defined(ESP32)
+// Figures from the ESP32 datasheet with the WiFi and BT modems off.
+// Scaled state assumes 80MHz and the cores waiting for interrupts most
+// of the time.
+#define POWER_STATE_MAX_CURRENT_MA 44
+#define POWER_STATE_SCALED_CURRENT_MA 20
+#elif defined(STM32)
+// STM32F1 at 72MHz, peripheral clocks enabled. There's no frequency
+// scaling, so the scaled state only saves the current while the core
+// is sleeping in the idle task.
+#define POWER_STATE_MAX_CURRENT_MA 36
+#define POWER_STATE_SCALED_CURRENT_MA 24
+#endif
+
+#if defined(USE_POWER_MANAGEMENT)
+#if !defined(CONFIG_PM_ENABLE)
+#error USE_POWER_MANAGEMENT requires CONFIG_PM_ENABLE
+#endif
+// Keep the APB at 80MHz, otherwise the UART and SPI clocks would
+// change when scaling down.
+#define POWER_MIN_FREQ_MHZ 80
+
+static const char *TAG = "Power";
+
+static const char *power_lock_names[] = {
+    [POWER_LOCK_RADIO] = "radio",
+    [POWER_LOCK_SERIAL] = "serial",
+};
+
+_Static_assert(ARRAY_COUNT(power_lock_names) == POWER_LOCK_COUNT, "missing power lock names");
+#endif
+
+static struct
+{
+    unsigned held; // Acquisitions not released yet, across all locks
+    time_micros_t state_since;
+    time_micros_t residency_us[POWER_STATE_COUNT];
+#if defined(USE_POWER_MANAGEMENT)
+    esp_pm_lock_handle_t pm_locks[POWER_LOCK_COUNT];
+#endif
+} power;
+
+static void power_state_changed(power_state_e prev)
+{
+    // Transitions can race between tasks holding different locks,
+    // which makes the residency approximate. It's only used for
+    // estimations, so that's fine.
+    time_micros_t now = time_micros_now();
+    power.residency_us[prev] += now - power.state_since;
+    power.state_since = now;
+}
+
+void power_init(void)
+{
+#if defined(USE_POWER_MANAGEMENT)
+    esp_pm_config_esp32_t config = {
+        .max_freq_mhz = CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = POWER_MIN_FREQ_MHZ,
+        .light_sleep_enable = false,
+    };
+    ESP_ERROR_CHECK(esp_pm_configure(&config));
+    for (int ii = 0; ii < POWER_LOCK_COUNT; ii++)
+    {
+        ESP_ERROR_CHECK(esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, power_lock_names[ii], &power.pm_locks[ii]));
+    }
+    LOG_I(TAG, "Frequency scaling enabled (%d-%dMHz)", POWER_MIN_FREQ_MHZ, CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ);
+#endif
+    power.state_since = time_micros_now();
+}
+
+void power_lock_acquire(power_lock_e lock)
+{
+#if defined(USE_POWER_MANAGEMENT)
+    // esp_pm locks are reference counted too
+    ESP_ERROR_CHECK(esp_pm_lock_acquire(power.pm_locks[lock]));
+#else
+    UNUSED(lock);
+#endif
+    if (__atomic_fetch_add(&power.held, 1, __ATOMIC_SEQ_CST) == 0)
+    {
+        power_state_changed(POWER_STATE_SCALED);
+    }
+}
+
+void power_lock_release(power_lock_e lock)
+{
+#if defined(USE_POWER_MANAGEMENT)
+    ESP_ERROR_CHECK(esp_pm_lock_release(power.pm_locks[lock]));
+#else
+    UNUSED(lock);
+#endif
+    unsigned prev = __atomic_fetch_sub(&power.held, 1, __ATOMIC_SEQ_CST);
+    assert(prev > 0 && "unbalanced power_lock_release()");
+    if (prev == 1)
+    {
+        power_state_changed(POWER_STATE_MAX);
+    }
+}
+
+void power_get_stats(power_stats_t *stats)
+{
+    power_state_e state = __atomic_load_n(&power.held, __ATOMIC_SEQ_CST) ? POWER_STATE_MAX : POWER_STATE_SCALED;
+    time_micros_t total = 0;
+    for (int ii = 0; ii < POWER_STATE_COUNT; ii++)
+    {
+        stats->residency_us[ii] = power.residency_us[ii];
+    }
+    // Include the time since the last transition
+    stats->residency_us[state] += time_micros_now() - power.state_since;
+    stats->state_current_ma[POWER_STATE_MAX] = POWER_STATE_MAX_CURRENT_MA;
+    stats->state_current_ma[POWER_STATE_SCALED] = POWER_STATE_SCALED_CURRENT_MA;
+
+    uint64_t charge = 0;
+    for (int ii = 0; ii < POWER_STATE_COUNT; ii++)
+    {
+        total += stats->residency_us[ii];
+        charge += stats->residency_us[ii] * stats->state_current_ma[ii];
+    }
+    stats->current_ma = total > 0 ? charge / total : POWER_STATE_MAX_CURRENT_MA;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "util/time.h"
+
+// Locks that keep the CPU at its maximum frequency while held. When
+// no locks are held the CPU is allowed to scale down and idle until
+// the next interrupt. Locks are reference counted, so several users
+// (e.g. serial ports) can hold the same lock at the same time. Each
+// power_lock_acquire() must be balanced by a power_lock_release().
+typedef enum
+{
+    POWER_LOCK_RADIO,  // RC task running, released while it waits for the next radio window
+    POWER_LOCK_SERIAL, // Serial write in progress, held once per port
+    POWER_LOCK_COUNT,
+} power_lock_e;
+
+typedef enum
+{
+    POWER_STATE_MAX,    // At least one lock held, CPU at max frequency
+    POWER_STATE_SCALED, // No locks held, CPU scaled down or idle
+    POWER_STATE_COUNT,
+} power_state_e;
+
+typedef struct power_stats_s
+{
+    time_micros_t residency_us[POWER_STATE_COUNT]; // Time spent in each state
+    unsigned state_current_ma[POWER_STATE_COUNT];  // Estimated MCU current in each state
+    unsigned current_ma;                           // Estimated average MCU current
+} power_stats_t;
+
+void power_init(void);
+void power_lock_acquire(power_lock_e lock);
+void power_lock_release(power_lock_e lock);
+// Returns the time spent in each state since power_init()
+// and the estimated average current draw of the MCU (radio
+// and other peripherals are not included).
+void power_get_stats(power_stats_t *stats);
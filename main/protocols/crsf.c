@@ -72,93 +72,188 @@ void crsf_port_init(crsf_port_t *port, io_t *io, crsf_frame_f frame_callback, vo
     port->io = *io;
     port->frame_callback = frame_callback;
     port->callback_data = callback_data;
-    port->buf_pos = 0;
+    port->head = 0;
+    port->tail = 0;
+    port->discarding = 0;
+    memset(&port->stats, 0, sizeof(port->stats));
 }
 
-int crsf_port_write(crsf_port_t *port, crsf_frame_t *frame)
+size_t crsf_frame_encode(crsf_frame_t *frame)
 {
     uint8_t data_size = crsf_frame_payload_size(frame);
     uint8_t *buf = (void *)frame;
     buf[sizeof(crsf_header_t) + data_size] = crsf_frame_crc(frame);
-    return io_write(&port->io, buf, sizeof(crsf_header_t) + data_size + 1);
+    return sizeof(crsf_header_t) + data_size + 1;
+}
+
+int crsf_port_write(crsf_port_t *port, crsf_frame_t *frame)
+{
+    size_t size = crsf_frame_encode(frame);
+    return io_write(&port->io, frame, size);
 }
 
 bool crsf_port_read(crsf_port_t *port)
 {
-    int rem = sizeof(port->buf) - port->buf_pos;
-    int n = io_read(&port->io, &port->buf[port->buf_pos], rem, 0);
+    unsigned pos = port->tail & (CRSF_PORT_BUF_SIZE - 1);
+    // Read up to the end of the first half, we'll read the
+    // rest after wrapping around in the next call.
+    unsigned rem = MIN(CRSF_PORT_BUF_SIZE - (port->tail - port->head), CRSF_PORT_BUF_SIZE - pos);
+    if (rem == 0)
+    {
+        return crsf_port_decode(port);
+    }
+    int n = io_read(&port->io, &port->buf[pos], rem, 0);
     if (n <= 0)
     {
         return false;
     }
-    port->buf_pos += n;
+    memcpy(&port->buf[pos + CRSF_PORT_BUF_SIZE], &port->buf[pos], n);
+    port->tail += n;
     return crsf_port_decode(port);
 }
 
 bool crsf_port_push(crsf_port_t *port, uint8_t c)
 {
-    if (port->buf_pos < sizeof(port->buf))
+    unsigned tail = port->tail;
+    if (tail - port->head < CRSF_PORT_BUF_SIZE)
+    {
+        unsigned pos = tail & (CRSF_PORT_BUF_SIZE - 1);
+        port->buf[pos] = c;
+        port->buf[pos + CRSF_PORT_BUF_SIZE] = c;
+        port->tail = tail + 1;
+        return true;
+    }
+    return false;
+}
+
+static bool crsf_addr_is_valid(uint8_t addr)
+{
+    switch ((crsf_addr_e)addr)
     {
-        port->buf[port->buf_pos++] = c;
+    case CRSF_ADDRESS_BROADCAST:
+    case CRSF_ADDRESS_USB:
+    case CRSF_ADDRESS_TBS_CORE_PNP_PRO:
+    case CRSF_ADDRESS_RESERVED1:
+    case CRSF_ADDRESS_CURRENT_SENSOR:
+    case CRSF_ADDRESS_GPS:
+    case CRSF_ADDRESS_TBS_BLACKBOX:
+    case CRSF_ADDRESS_FLIGHT_CONTROLLER:
+    case CRSF_ADDRESS_RESERVED2:
+    case CRSF_ADDRESS_RACE_TAG:
+    case CRSF_ADDRESS_RADIO_TRANSMITTER:
+    case CRSF_ADDRESS_CRSF_RECEIVER:
+    case CRSF_ADDRESS_CRSF_TRANSMITTER:
         return true;
     }
     return false;
 }
 
+// Checks if the available bytes at ptr could be the start of a frame,
+// using the address, length and type (if available). Note that this
+// doesn't need the whole frame to be available.
+static bool crsf_port_is_plausible_frame(const uint8_t *ptr, unsigned size)
+{
+    if (!crsf_addr_is_valid(ptr[0]))
+    {
+        return false;
+    }
+    if (size < 2)
+    {
+        return true;
+    }
+    // frame_size must include at least the type and the crc
+    uint8_t frame_size = ptr[1];
+    if (frame_size < 2 || frame_size + CRSF_FRAME_NOT_COUNTED_BYTES > CRSF_FRAME_SIZE_MAX)
+    {
+        return false;
+    }
+    if (size < 3)
+    {
+        return true;
+    }
+    uint8_t type = ptr[2];
+    if (type == 0 || type > CRSF_FRAMETYPE_EXT_MAX)
+    {
+        return false;
+    }
+    // Extended frames carry the destination and origin too
+    return type < CRSF_FRAMETYPE_EXT_MIN || frame_size >= 4;
+}
+
+static void crsf_port_discard(crsf_port_t *port, unsigned count)
+{
+    if (port->discarding == 0)
+    {
+        port->stats.resyncs++;
+    }
+    port->discarding += count;
+    port->stats.discarded += count;
+    port->head += count;
+}
+
 bool crsf_port_decode(crsf_port_t *port)
 {
-    int start = 0;
-    int end = port->buf_pos;
     bool found = false;
-    while (end - start >= 2)
+    unsigned avail;
+    while ((avail = port->tail - port->head) > 0)
     {
-        int frame_length = port->buf[start + 1];
-        int total_frame_size = frame_length + CRSF_FRAME_NOT_COUNTED_BYTES;
-        if (end - start < total_frame_size)
+        uint8_t *ptr = &port->buf[port->head & (CRSF_PORT_BUF_SIZE - 1)];
+        if (!crsf_port_is_plausible_frame(ptr, avail))
         {
-            // No more complete frames to decode
-            break;
+            // Not a frame start, skip a single byte so we can resync
+            // as soon as the next frame starts.
+            crsf_port_discard(port, 1);
+            continue;
         }
-        //LOG_I(TAG, "Got frame of size %u", total_frame_size);
-        // We have a complete frame. Check checksum
-        crsf_frame_t *frame = (crsf_frame_t *)&port->buf[start];
-        uint8_t received_crc = port->buf[start + total_frame_size - 1];
-        uint8_t expected_crc = crsf_frame_crc(frame);
-        if (received_crc == expected_crc)
+        if (avail < 2)
         {
-            found = true;
-            port->frame_callback(port->callback_data, frame);
+            break;
         }
-        else
+        unsigned total_frame_size = ptr[1] + CRSF_FRAME_NOT_COUNTED_BYTES;
+        if (avail < total_frame_size)
         {
-            LOG_W(TAG, "CRC error in frame with size %d: expected 0x%02x but got 0x%02x", total_frame_size, expected_crc, received_crc);
-            LOG_BUFFER_W(TAG, frame, total_frame_size);
+            // No more complete frames to decode
+            break;
         }
-        start += total_frame_size;
-    }
-    if (start > 0)
-    {
-        if ((unsigned)start > port->buf_pos)
+        // We have a complete frame. Check checksum
+        crsf_frame_t *frame = (crsf_frame_t *)ptr;
+        uint8_t received_crc = ptr[total_frame_size - 1];
+        uint8_t expected_crc = crsf_frame_crc(frame);
+        if (received_crc != expected_crc)
         {
-            LOG_E(TAG, "Error %d > %d", start, (int)port->buf_pos);
+            // Don't trust the length we got, since it might be corrupted
+            // too. Skip just the first byte and look for the next frame
+            // start inside this one. Only log the first error, since
+            // while resyncing every byte might produce another one.
+            if (port->discarding == 0)
+            {
+                LOG_W(TAG, "CRC error in frame with size %u: expected 0x%02x but got 0x%02x", total_frame_size, expected_crc, received_crc);
+                LOG_BUFFER_W(TAG, frame, total_frame_size);
+            }
+            port->stats.crc_errors++;
+            crsf_port_discard(port, 1);
+            continue;
         }
-        assert(start <= port->buf_pos);
-        if ((unsigned)start != port->buf_pos)
+        if (port->discarding > 0)
         {
-            // Move remaining data to the front
-            memmove(port->buf, &port->buf[start], end - start);
+            LOG_W(TAG, "Resynced after discarding %u bytes, %u resyncs so far", port->discarding, port->stats.resyncs);
+            port->discarding = 0;
         }
-        port->buf_pos -= start;
+        found = true;
+        port->stats.frames++;
+        port->frame_callback(port->callback_data, frame);
+        port->head += total_frame_size;
     }
     return found;
 }
 
 bool crsf_port_has_buffered_data(crsf_port_t *port)
 {
-    return port->buf_pos > 0 && port->buf_pos < sizeof(port->buf);
+    unsigned count = port->tail - port->head;
+    return count > 0 && count < CRSF_PORT_BUF_SIZE;
 }
 
 void crsf_port_reset(crsf_port_t *port)
 {
-    port->buf_pos = 0;
+    port->head = port->tail;
 }
@@ -64,6 +64,9 @@ typedef enum
     CRSF_FRAMETYPE_MSP_WRITE = 0x7C, // write with 8 byte chunked binary (OpenTX outbound telemetry buffer limit)
 } crsf_frame_type_e;
 
+#define CRSF_FRAMETYPE_EXT_MIN 0x28
+#define CRSF_FRAMETYPE_EXT_MAX 0x96
+
 typedef enum
 {
     CRSF_ADDRESS_BROADCAST = 0x00,
@@ -298,6 +301,8 @@ const char *crsf_frame_str(crsf_frame_t *frame);
 void crsf_frame_put_str(crsf_frame_t *frame, const char *s);
 uint8_t crsf_frame_payload_size(crsf_frame_t *frame);
 uint8_t crsf_frame_total_size(crsf_frame_t *frame);
+// Stores the CRC at the end of the frame and returns its total size
+size_t crsf_frame_encode(crsf_frame_t *frame);
 uint8_t crsf_ext_frame_payload_size(crsf_ext_frame_t *frame);
 inline crsf_ext_frame_t *crsf_frame_to_ext(crsf_frame_t *frame) { return (crsf_ext_frame_t *)frame; }
 inline crsf_frame_t *crsf_ext_frame_to_frame(crsf_ext_frame_t *frame) { return (crsf_frame_t *)frame; }
@@ -308,13 +313,35 @@ inline unsigned channel_to_crsf_value(unsigned val) { return val; }
 
 typedef void (*crsf_frame_f)(void *data, crsf_frame_t *frame);
 
+// Must be a power of 2 and big enough to hold a full frame
+#define CRSF_PORT_BUF_SIZE 64
+_Static_assert(CRSF_PORT_BUF_SIZE >= CRSF_FRAME_SIZE_MAX, "CRSF_PORT_BUF_SIZE is too small");
+_Static_assert((CRSF_PORT_BUF_SIZE & (CRSF_PORT_BUF_SIZE - 1)) == 0, "CRSF_PORT_BUF_SIZE must be a power of 2");
+
+typedef struct crsf_port_stats_s
+{
+    unsigned frames;     // Frames with a valid CRC
+    unsigned crc_errors; // Complete frames with an invalid CRC
+    unsigned resyncs;    // Number of times the decoder lost sync
+    unsigned discarded;  // Total bytes discarded while resyncing
+} crsf_port_stats_t;
+
 typedef struct crsf_port_s
 {
     io_t io;
     crsf_frame_f frame_callback;
     void *callback_data;
-    uint8_t buf[CRSF_FRAME_SIZE_MAX];
-    unsigned buf_pos;
+    // Ring buffer. Each byte is stored twice, at pos and at
+    // pos + CRSF_PORT_BUF_SIZE, so any frame starting in the first
+    // half can be passed to the callback in place without copying it.
+    uint8_t buf[CRSF_PORT_BUF_SIZE * 2];
+    // head and tail are free running. tail is only written by the
+    // producer (crsf_port_push() or crsf_port_read()) while head is
+    // only written by the decoder, so bytes can be pushed from an ISR.
+    volatile unsigned head;
+    volatile unsigned tail;
+    unsigned discarding; // Bytes discarded since we lost sync
+    crsf_port_stats_t stats;
 } crsf_port_t;
 
 void crsf_port_init(crsf_port_t *port, io_t *io, crsf_frame_f frame_callback, void *callback_data);
@@ -399,8 +399,16 @@ void smartport_master_update(smartport_master_t *sp)
     time_ticks_t now = time_ticks_now();
     smartport_msp_req_chunk_t chunk;
     size_t chunk_size;
-    // If we found a payload, go into send mode again
-    if (smartport_master_read_payload(sp) || sp->next_poll < now)
+    // If we found a payload, go into send mode again. Otherwise, poll
+    // when the interval expires unless the line is still in use, since
+    // we'd collide with a late response from the sensor.
+    if (smartport_master_read_payload(sp))
+    {
+        // Right after a response the line is usually still busy, so
+        // keep the poll pending until it's free instead of dropping it.
+        sp->next_poll = now;
+    }
+    if (sp->next_poll <= now && !io_is_busy(&sp->io))
     {
         smartport_payload_frame_init(&sp->frame);
         // Check if we have some queued S.port payloads to send
@@ -417,6 +425,17 @@ void smartport_master_update(smartport_master_t *sp)
     }
 }
 
+time_micros_t smartport_master_next_update_at(smartport_master_t *sp, time_micros_t now)
+{
+    time_ticks_t ticks = time_ticks_now();
+    if (sp->next_poll <= ticks)
+    {
+        return now;
+    }
+    time_millis_t ms = TICKS_TO_MILLIS(sp->next_poll - ticks);
+    return now + MILLIS_TO_MICROS(ms);
+}
+
 bool smartport_master_decode_payload(smartport_master_t *sp, const smartport_payload_t *payload)
 {
     switch (payload->frame_id)
@@ -66,6 +66,9 @@ typedef struct smartport_master_s
 
 void smartport_master_init(smartport_master_t *sp, io_t *io);
 void smartport_master_update(smartport_master_t *sp);
+// Returns the time by which smartport_master_update() must be called
+// again to send the next poll.
+time_micros_t smartport_master_next_update_at(smartport_master_t *sp, time_micros_t now);
 smartport_payload_t *smartport_master_get_last_payload(smartport_master_t *sp);
 
 // Used by FPort
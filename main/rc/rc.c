@@ -12,6 +12,7 @@
 #include "io/gpio.h"
 #include "io/pwm.h"
 
+#include "platform/boot.h"
 #include "platform/dispatch.h"
 #include "platform/system.h"
 
@@ -169,6 +170,20 @@ static bool rc_should_enable_power_test(rc_t *rc)
     return settings_get_key_u8(SETTING_KEY_RF_POWER_TEST);
 }
 
+static bool rc_should_enable_survey(rc_t *rc)
+{
+    return settings_get_key_u8(SETTING_KEY_DIAGNOSTICS_SPECTRUM_SURVEY);
+}
+
+static bool rc_is_multi_rx_active(rc_t *rc)
+{
+#if defined(USE_MULTI_RX)
+    return rc->output == &rc->air_multi.output;
+#else
+    return false;
+#endif
+}
+
 static air_io_t *rc_get_air_io(rc_t *rc)
 {
     switch (rc_get_mode(rc))
@@ -351,7 +366,7 @@ static void rc_reconfigure_input(rc_t *rc)
         break;
     case RC_MODE_RX:
     {
-        if (rc_should_enable_power_test(rc))
+        if (rc_should_enable_power_test(rc) || rc_should_enable_survey(rc))
         {
             // Use no input
             break;
@@ -394,6 +409,12 @@ static void rc_reconfigure_input(rc_t *rc)
     {
         rc->data.failsafe.input = &rc->input->failsafe;
         input_open(&rc->data, rc->input, rc->input_config);
+        if (rc_get_mode(rc) == RC_MODE_TX)
+        {
+            // Ignore handset noise, so auxiliary channels only use
+            // uplink bandwidth when they're actually moved.
+            rc_data_enable_input_filter(&rc->data);
+        }
         msp_conn_t *input_msp = msp_io_get_conn(&rc->input->msp);
         if (input_msp)
         {
@@ -423,6 +444,9 @@ static void rc_reconfigure_output(rc_t *rc)
         rc->output_config = NULL;
     }
     memset(&rc->outputs, 0, sizeof(rc->outputs));
+#if defined(USE_MULTI_RX)
+    memset(&rc->air_multi, 0, sizeof(rc->air_multi));
+#endif
     air_pairing_t pairing;
     air_config_t air_config;
     switch (rc_get_mode(rc))
@@ -439,6 +463,13 @@ static void rc_reconfigure_output(rc_t *rc)
             break;
         }
 
+        if (rc_should_enable_survey(rc))
+        {
+            output_air_survey_init(&rc->outputs.air_survey, &air_config);
+            rc->output = (output_t *)&rc->outputs.air_survey;
+            break;
+        }
+
         if (rc->state.bind_active)
         {
             output_air_bind_init(&rc->outputs.air_bind, config_get_addr(), &air_config);
@@ -453,6 +484,18 @@ static void rc_reconfigure_output(rc_t *rc)
         {
             air_io_bind(&rc->outputs.air.air, &pairing);
             rmp_set_pairing(rc->rmp, &pairing);
+#if defined(USE_MULTI_RX)
+            air_pairing_t pairings[OUTPUT_AIR_MULTI_MAX_RX];
+            int count = MIN(settings_get_key_u8(SETTING_KEY_TX_MULTI_RX) + 1, (int)ARRAY_COUNT(pairings));
+            count = config_get_recent_paired_rxs(pairings, count);
+            if (count > 1)
+            {
+                // pairings[0] is the same RX bound to outputs.air
+                output_air_multi_init(&rc->air_multi, &rc->outputs.air, &pairings[1], count - 1,
+                                      config_get_addr(), &air_config, rc->rmp);
+                rc->output = (output_t *)&rc->air_multi;
+            }
+#endif
         }
         rc->output_config = &output_config.air;
 
@@ -468,6 +511,14 @@ static void rc_reconfigure_output(rc_t *rc)
             break;
         }
 
+        if (rc_should_enable_survey(rc))
+        {
+            rc_get_air_config(rc, &air_config);
+            output_air_survey_init(&rc->outputs.air_survey, &air_config);
+            rc->output = (output_t *)&rc->outputs.air_survey;
+            break;
+        }
+
         switch (config_get_output_type())
         {
         case RX_OUTPUT_MSP:
@@ -844,7 +895,7 @@ static void rc_setting_changed(const setting_t *setting, void *user_data)
         rc_send_air_config_to_pair(rc);
         rc_invalidate_air(rc);
     }
-    else if (SETTING_IS(setting, SETTING_KEY_RF_POWER_TEST))
+    else if (SETTING_IS(setting, SETTING_KEY_RF_POWER_TEST) || SETTING_IS(setting, SETTING_KEY_DIAGNOSTICS_SPECTRUM_SURVEY))
     {
         if (rc_get_mode(rc) == RC_MODE_RX)
         {
@@ -896,6 +947,13 @@ static void rc_setting_changed(const setting_t *setting, void *user_data)
                 }
                 break;
             }
+#if defined(USE_MULTI_RX)
+            if (SETTING_IS(setting, SETTING_KEY_TX_MULTI_RX))
+            {
+                rc_invalidate_output(rc);
+                break;
+            }
+#endif
             if (SETTING_IS_FROM_FOLDER(setting, SETTING_KEY_TX) &&
                 !SETTING_IS(setting, SETTING_KEY_TX_PILOT_NAME))
             {
@@ -1198,7 +1256,12 @@ void rc_connect_msp_input(rc_t *rc, msp_conn_t *msp)
 int rc_get_alternative_pairings(rc_t *rc, air_pairing_t *pairings, size_t size)
 {
     // Don't return any alternatives while a bind is in progress
-    if (rc_is_binding(rc) || rc_should_enable_power_test(rc))
+    if (rc_is_binding(rc) || rc_should_enable_power_test(rc) || rc_should_enable_survey(rc))
+    {
+        return 0;
+    }
+    // The other RXs we're driving would show up as alternatives
+    if (rc_is_multi_rx_active(rc))
     {
         return 0;
     }
@@ -1389,7 +1452,13 @@ void rc_update(rc_t *rc)
     // needs to process another data.
     if (LIKELY(rc_should_update_output(rc)))
     {
-        rc->state.dirty &= !output_update(rc->output, input_new_data, now);
+        bool output_updated = output_update(rc->output, input_new_data, now);
+        rc->state.dirty &= !output_updated;
+        if (UNLIKELY(output_updated && input_new_data && !boot_phase_is_done(BOOT_PHASE_FIRST_FRAME)) &&
+            !rc_is_failsafe_active(rc, NULL))
+        {
+            boot_phase_done(BOOT_PHASE_FIRST_FRAME);
+        }
     }
 
 #if defined(CONFIG_RAVEN_USE_PWM_OUTPUTS)
@@ -1433,3 +1502,21 @@ void rc_update(rc_t *rc)
 
     rc_rssi_update(rc);
 }
+
+time_micros_t rc_next_update_at(rc_t *rc, time_micros_t now)
+{
+    // Requesting the pair air config is retried every 500ms, which
+    // is covered by the maximum time the RC task waits.
+    if (rc->state.invalidate_input || rc->state.invalidate_output ||
+        rc->state.bind_requested != rc->state.bind_active || rc->state.bind_active ||
+        rc->state.tx_rf_power >= 0)
+    {
+        return now;
+    }
+    time_micros_t next = input_next_update_at(rc->input, now);
+    if (rc_should_update_output(rc))
+    {
+        next = MIN(next, output_next_update_at(rc->output, now));
+    }
+    return next;
+}
@@ -15,7 +15,9 @@
 
 #include "output/output_air.h"
 #include "output/output_air_bind.h"
+#include "output/output_air_multi.h"
 #include "output/output_air_rf_power_test.h"
+#include "output/output_air_survey.h"
 #include "output/output_crsf.h"
 #include "output/output_fport.h"
 #include "output/output_msp.h"
@@ -26,6 +28,8 @@
 #include "rc/rc_data.h"
 #include "rc/rc_rmp.h"
 
+#include "target/buffer_profile.h"
+
 typedef struct air_bind_packet_s air_bind_packet_t;
 typedef struct air_freq_table_s air_freq_table_t;
 typedef struct air_radio_s air_radio_t;
@@ -67,12 +71,18 @@ typedef struct rc_s
         output_air_t air;
         output_air_bind_t air_bind;
         output_air_rf_power_test_t air_power_test;
+        output_air_survey_t air_survey;
         output_crsf_t crsf;
         output_fport_t fport;
         output_msp_t msp;
         output_none_t none;
         output_sbus_t sbus;
     } outputs;
+#if defined(USE_MULTI_RX)
+    // Wraps outputs.air (which drives the primary RX) when
+    // controlling multiple RXs, so it can't be in the union.
+    output_air_multi_t air_multi;
+#endif
 
     void *input_config;
     input_t *input;
@@ -97,9 +107,9 @@ typedef struct rc_s
         // RMP messages handled by rc_t
         rc_rmp_t rc_rmp;
         // MSP/RMP Transport fields
-        rc_rmp_msp_port_t rmp_msp_port[3];  // Used for sending MSP requests
-        const rmp_port_t *msp_recv_port;    // Used for receiving MSP requests
-        rc_rmp_resp_ctx_t msp_resp_ctx[30]; // Used for keeping data to handlea sync MSP responses via RMP
+        rc_rmp_msp_port_t rmp_msp_port[3];                            // Used for sending MSP requests
+        const rmp_port_t *msp_recv_port;                              // Used for receiving MSP requests
+        rc_rmp_resp_ctx_t msp_resp_ctx[BUFFER_RC_MSP_RESP_CTX_COUNT]; // Used for keeping data to handlea sync MSP responses via RMP
     } state;
 } rc_t;
 
@@ -132,4 +142,8 @@ void rc_dismiss_alternative_pairings(rc_t *rc);
 void rc_invalidate_input(rc_t *rc);
 void rc_invalidate_output(rc_t *rc);
 
-void rc_update(rc_t *rc);
\ No newline at end of file
+void rc_update(rc_t *rc);
+// Returns the time by which rc_update() must be called again, assuming
+// radio interrupts wake up the caller earlier (see air_radio_wait_for_irq()).
+// Returns now if the input or the output need to be updated continuously.
+time_micros_t rc_next_update_at(rc_t *rc, time_micros_t now);
\ No newline at end of file
@@ -1,3 +1,4 @@
+#include <stdlib.h>
 #include <string.h>
 
 #include "rc_data.h"
@@ -37,6 +38,7 @@ void rc_data_reset_input(rc_data_t *data)
     }
     data->channels_num = RC_CHANNELS_NUM;
     data->ready = false;
+    memset(&data->filter, 0, sizeof(data->filter));
 #ifdef SETUP_FAKE_TELEMETRY
     time_ticks_t now = time_ticks_now();
     TELEMETRY_SET_I8(data, TELEMETRY_ID_TX_RSSI_ANT1, 73, now);
@@ -96,6 +98,45 @@ void rc_data_reset_output(rc_data_t *data)
 #endif
 }
 
+void rc_data_enable_input_filter(rc_data_t *data)
+{
+    // Sticks are sent in every frame, so filtering them doesn't save
+    // any bandwidth and would only reduce resolution.
+    for (int ii = 4; ii < RC_CHANNELS_NUM; ii++)
+    {
+        data->filter.deadband[ii] = RC_CHANNEL_AUX_DEADBAND;
+    }
+    data->filter.switch_tolerance = RC_CHANNEL_SWITCH_TOLERANCE;
+    data->filter.suppressed = 0;
+}
+
+static unsigned rc_data_filter_channel_value(rc_data_t *data, unsigned ch, unsigned value)
+{
+    unsigned deadband = data->filter.deadband[ch];
+    if (deadband == 0)
+    {
+        return value;
+    }
+    static const unsigned switch_values[] = {RC_CHANNEL_MIN_VALUE, RC_CHANNEL_CENTER_VALUE, RC_CHANNEL_MAX_VALUE};
+    for (int ii = 0; ii < ARRAY_COUNT(switch_values); ii++)
+    {
+        if (abs((int)value - (int)switch_values[ii]) <= data->filter.switch_tolerance)
+        {
+            return switch_values[ii];
+        }
+    }
+    control_channel_t *channel = &data->channels[ch];
+    if (data_state_has_value(&channel->data_state) && abs((int)value - (int)channel->value) < deadband)
+    {
+        if (value != channel->value)
+        {
+            data->filter.suppressed++;
+        }
+        return channel->value;
+    }
+    return value;
+}
+
 void rc_data_update_channel(rc_data_t *data, unsigned ch, unsigned value, time_micros_t now)
 {
     if (ch >= data->channels_num)
@@ -107,6 +148,7 @@ void rc_data_update_channel(rc_data_t *data, unsigned ch, unsigned value, time_m
     control_channel_t *channel = &data->channels[ch];
     value = value < RC_CHANNEL_MAX_VALUE ? value : RC_CHANNEL_MAX_VALUE;
     value = value > RC_CHANNEL_MIN_VALUE ? value : RC_CHANNEL_MIN_VALUE;
+    value = rc_data_filter_channel_value(data, ch, value);
     bool changed = channel->value != value;
     channel->value = value;
     data_state_update(&channel->data_state, changed, now);
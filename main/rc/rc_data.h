@@ -40,6 +40,15 @@
 
 #define RC_CHANNEL_VALUE_FROM_PERCENTAGE(p) (RC_CHANNEL_MIN_VALUE + ((RC_CHANNEL_MAX_VALUE - RC_CHANNEL_MIN_VALUE) * p) / 100)
 
+// Handset ADCs usually produce +-1-2 units of noise. Updates to auxiliary
+// channels smaller than this are ignored when the input filter is enabled.
+// This is slightly more than one step with AIR_CHANNEL_BITS, so no resolution
+// is lost over the air.
+#define RC_CHANNEL_AUX_DEADBAND 4
+// Values closer than this to min, center or max are snapped to them when the
+// input filter is enabled, so switches can use the 2-bit air encoding.
+#define RC_CHANNEL_SWITCH_TOLERANCE 10
+
 typedef struct control_channel_s
 {
     // Each channel has 1024 possible values. Value of 0
@@ -74,6 +83,14 @@ typedef struct rc_data_s
         const failsafe_t *input;
         const failsafe_t *output;
     } failsafe;
+    // Change detection for channels coming from a handset, disabled
+    // by default. See rc_data_enable_input_filter().
+    struct
+    {
+        uint8_t deadband[RC_CHANNELS_NUM];
+        uint8_t switch_tolerance;
+        unsigned suppressed; // Updates ignored due to the deadband
+    } filter;
     telemetry_t telemetry_uplink[TELEMETRY_UPLINK_COUNT];
     telemetry_t telemetry_downlink[TELEMETRY_DOWNLINK_COUNT];
     // Provided here so inputs and outputs can both use
@@ -84,6 +101,9 @@ typedef struct rc_data_s
 void rc_data_reset_input(rc_data_t *data);
 void rc_data_reset_output(rc_data_t *data);
 
+// Enables per-channel deadbands and switch position snapping for the
+// auxiliary channels. Must be called after the input has been opened.
+void rc_data_enable_input_filter(rc_data_t *data);
 void rc_data_update_channel(rc_data_t *data, unsigned ch, unsigned value, time_micros_t now);
 uint16_t rc_data_get_channel_value(const rc_data_t *data, unsigned ch);
 bool rc_data_is_ready(rc_data_t *data);
@@ -3,6 +3,8 @@
 
 #include "config/config.h"
 
+#include "platform/boot.h"
+
 #include "util/time.h"
 
 #include "rmp.h"
@@ -12,13 +14,23 @@ static const char *TAG = "RMP";
 #define RMP_P2P_PING_INTERVAL MILLIS_TO_TICKS(500)
 #define RMP_DEVICE_INFO_INTERVAL SECS_TO_TICKS(30)
 #define RMP_P2P_PEER_EXPIRATION_INTERVAL MILLIS_TO_TICKS(3000)
+#define RMP_PEERS_UPDATE_INTERVAL MILLIS_TO_TICKS(250)
+#define RMP_TASK_UPDATE_INTERVAL MILLIS_TO_TICKS(20)
 
 #define RMP_TRANSPORT_LOOPBACK 0xFF
 
+typedef enum
+{
+    RMP_QUEUED_MSG_FREE = 0,
+    RMP_QUEUED_MSG_BUSY,
+} rmp_queued_msg_state_e;
+
 typedef enum
 {
     RMP_DEVICE_CODE_REQ_INFO = 1,
     RMP_DEVICE_CODE_INFO,
+    RMP_DEVICE_CODE_REQ_BOOT_TIMES,
+    RMP_DEVICE_CODE_BOOT_TIMES,
 } rmp_device_code_e;
 
 typedef struct rmp_device_info_s
@@ -33,6 +45,7 @@ typedef struct rmp_device_frame_s
     uint8_t code; // from rmp_device_code_e
     union {
         rmp_device_info_t device_info;
+        uint32_t boot_times_ms[BOOT_PHASE_COUNT]; // 0 for phases not done yet
     };
 } PACKED rmp_device_frame_t;
 
@@ -44,6 +57,8 @@ typedef struct rmp_resp_data_s
     uint8_t dst_port;
 } rmp_resp_data_t;
 
+static void rmp_dispatch_message(rmp_t *rmp, rmp_msg_t *msg, rmp_transport_type_e source);
+
 static rmp_peer_t *rmp_get_peer(rmp_t *rmp, const air_addr_t *addr)
 {
     for (int ii = 0; ii < RMP_MAX_PEERS; ii++)
@@ -191,6 +206,7 @@ static void rmp_update_peers(rmp_t *rmp, time_ticks_t now)
 {
     rmp_remove_stale_peers(rmp, now);
     rmp_update_peers_info(rmp, now);
+    rmp->internal.next_peers_update = now + RMP_PEERS_UPDATE_INTERVAL;
 }
 
 static void rmp_send_device_info(rmp_t *rmp, const air_addr_t *dst)
@@ -209,10 +225,39 @@ static void rmp_send_device_info(rmp_t *rmp, const air_addr_t *dst)
     rmp_send(rmp, NULL, dst, RMP_PORT_DEVICE, &frame, frame_size);
 }
 
+static void rmp_send_boot_times(rmp_t *rmp, const air_addr_t *dst)
+{
+    rmp_device_frame_t frame = {
+        .code = RMP_DEVICE_CODE_BOOT_TIMES,
+    };
+    for (int ii = 0; ii < BOOT_PHASE_COUNT; ii++)
+    {
+        frame.boot_times_ms[ii] = boot_phase_get_time(ii) / 1000;
+    }
+    rmp_send(rmp, NULL, dst, RMP_PORT_DEVICE, &frame, 1 + sizeof(frame.boot_times_ms));
+}
+
+static void rmp_log_stats(rmp_t *rmp)
+{
+    const rmp_stats_t *stats = &rmp->internal.stats;
+    if (stats->queued > 0)
+    {
+        LOG_D(TAG, "Dispatched %u queued messages (avg latency %uus, max %uus), max handler time %uus",
+              stats->queued, (unsigned)(stats->latency_sum_us / stats->queued), (unsigned)stats->max_latency_us,
+              (unsigned)stats->max_processing_us);
+    }
+    unsigned dropped = __atomic_load_n(&stats->dropped, __ATOMIC_RELAXED);
+    if (dropped > 0)
+    {
+        LOG_W(TAG, "Dropped %u messages", dropped);
+    }
+}
+
 static void rmp_broadcast_device_info(rmp_t *rmp, time_ticks_t now)
 {
     rmp_send_device_info(rmp, AIR_ADDR_BROADCAST);
     rmp->internal.next_device_info = now + RMP_DEVICE_INFO_INTERVAL;
+    rmp_log_stats(rmp);
 }
 
 static void rmp_device_handler(rmp_t *rmp, rmp_req_t *req, void *user_data)
@@ -220,7 +265,7 @@ static void rmp_device_handler(rmp_t *rmp, rmp_req_t *req, void *user_data)
     UNUSED(user_data);
 
     rmp_peer_t *peer = rmp_get_peer(rmp, &req->msg->src);
-    if (!peer)
+    if (!peer || req->msg->payload_size < 1)
     {
         return;
     }
@@ -254,6 +299,20 @@ static void rmp_device_handler(rmp_t *rmp, rmp_req_t *req, void *user_data)
         peer->last_info_req = 0;
         rmp_update_peer_authentication(rmp, peer);
         break;
+    case RMP_DEVICE_CODE_REQ_BOOT_TIMES:
+        rmp_send_boot_times(rmp, &req->msg->src);
+        break;
+    case RMP_DEVICE_CODE_BOOT_TIMES:
+    {
+        // Peers running older or newer firmware might send fewer or
+        // more phases, only log the ones present in both.
+        size_t count = MIN((req->msg->payload_size - 1) / sizeof(frame->boot_times_ms[0]), (size_t)BOOT_PHASE_COUNT);
+        for (size_t ii = 0; ii < count; ii++)
+        {
+            LOG_I(TAG, "%s %s: %ums", peer->name, boot_phase_get_name(ii), (unsigned)frame->boot_times_ms[ii]);
+        }
+        break;
+    }
     }
 }
 
@@ -285,6 +344,22 @@ static bool rmp_send_rc(rmp_t *rmp, rmp_msg_t *msg, time_ticks_t now)
     return false;
 }
 
+static bool rmp_send_serial(rmp_t *rmp, rmp_msg_t *msg)
+{
+    rmp_transport_t transport = rmp->internal.transports[RMP_TRANSPORT_SERIAL];
+    if (transport.send)
+    {
+        return transport.send(rmp, msg, transport.user_data);
+    }
+    return false;
+}
+
+static bool rmp_is_serial_peer(rmp_t *rmp, const air_addr_t *addr)
+{
+    rmp_peer_t *peer = rmp_get_peer(rmp, addr);
+    return peer && (peer->flags & RMP_PEER_FLAG_SERIAL);
+}
+
 #if defined(USE_P2P)
 static void rmp_send_p2p_ping(rmp_t *rmp, time_ticks_t now)
 {
@@ -295,17 +370,46 @@ static void rmp_send_p2p_ping(rmp_t *rmp, time_ticks_t now)
 }
 #endif
 
+static time_ticks_t rmp_next_periodic_task(rmp_t *rmp)
+{
+    time_ticks_t next = MIN(rmp->internal.next_device_info, rmp->internal.next_peers_update);
+    next = MIN(next, rmp->internal.next_task_update);
+#if defined(USE_P2P)
+    next = MIN(next, rmp->internal.next_p2p_ping);
+#endif
+    return next;
+}
+
+static void rmp_dispatch_queued_message(rmp_t *rmp, rmp_queued_msg_t *queued)
+{
+    time_micros_t latency = time_micros_now() - queued->queued_at;
+    rmp->internal.stats.queued++;
+    rmp->internal.stats.latency_sum_us += latency;
+    if (latency > rmp->internal.stats.max_latency_us)
+    {
+        rmp->internal.stats.max_latency_us = latency;
+    }
+    rmp_dispatch_message(rmp, &queued->msg, queued->source);
+    __atomic_store_n(&queued->state, RMP_QUEUED_MSG_FREE, __ATOMIC_RELEASE);
+}
+
 void rmp_init(rmp_t *rmp, air_addr_t *addr)
 {
     memset(rmp, 0, sizeof(*rmp));
     air_addr_cpy(&rmp->internal.addr, addr);
     rmp->internal.device_port = rmp_open_port(rmp, RMP_PORT_DEVICE, rmp_device_handler, NULL);
+    rmp->internal.queue = xQueueCreate(RMP_QUEUE_SIZE, sizeof(uint8_t));
+    if (!rmp->internal.queue)
+    {
+        LOG_F(TAG, "Could not create message queue");
+    }
 }
 
 void rmp_update(rmp_t *rmp)
 {
     time_ticks_t now = time_ticks_now();
 
+    rmp->internal.next_task_update = now + RMP_TASK_UPDATE_INTERVAL;
     if (rmp->internal.next_device_info < now)
     {
         rmp_broadcast_device_info(rmp, now);
@@ -316,7 +420,27 @@ void rmp_update(rmp_t *rmp)
         rmp_send_p2p_ping(rmp, now);
     }
 #endif
-    rmp_update_peers(rmp, now);
+    if (rmp->internal.next_peers_update <= now)
+    {
+        rmp_update_peers(rmp, now);
+    }
+
+    time_ticks_t next = rmp_next_periodic_task(rmp);
+    // Periodic tasks run when now > next, so wait one more tick
+    time_ticks_t wait = next >= now ? next - now + 1 : 0;
+    uint8_t idx;
+    while (xQueueReceive(rmp->internal.queue, &idx, wait) == pdTRUE)
+    {
+        rmp_dispatch_queued_message(rmp, &rmp->internal.queued[idx]);
+        // Dispatch any other queued messages, but don't block
+        // again before checking the periodic tasks.
+        wait = 0;
+    }
+}
+
+void rmp_get_stats(rmp_t *rmp, rmp_stats_t *stats)
+{
+    *stats = rmp->internal.stats;
 }
 
 void rmp_set_name(rmp_t *rmp, const char *name)
@@ -351,6 +475,11 @@ void rmp_set_role(rmp_t *rmp, air_role_e role)
     rmp->internal.role = role;
 }
 
+air_role_e rmp_get_role(rmp_t *rmp)
+{
+    return rmp->internal.role;
+}
+
 void rmp_set_pairing(rmp_t *rmp, air_pairing_t *pairing)
 {
     if (pairing)
@@ -363,6 +492,16 @@ void rmp_set_pairing(rmp_t *rmp, air_pairing_t *pairing)
     }
 }
 
+bool rmp_get_pairing(rmp_t *rmp, air_pairing_t *pairing)
+{
+    if (!air_addr_is_valid(&rmp->internal.pairing.addr))
+    {
+        return false;
+    }
+    *pairing = rmp->internal.pairing;
+    return true;
+}
+
 bool rmp_can_authenticate_peer(rmp_t *rmp, const air_addr_t *addr)
 {
     if (air_addr_equals(&rmp->internal.addr, addr))
@@ -370,7 +509,7 @@ bool rmp_can_authenticate_peer(rmp_t *rmp, const air_addr_t *addr)
         return true;
     }
     rmp_peer_t *peer = rmp_get_peer(rmp, addr);
-    if (peer && (peer->flags & RMP_PEER_FLAG_CAN_AUTHENTICATE))
+    if (peer && (peer->flags & (RMP_PEER_FLAG_CAN_AUTHENTICATE | RMP_PEER_FLAG_SERIAL)))
     {
         return true;
     }
@@ -498,7 +637,7 @@ bool rmp_send_flags(rmp_t *rmp, const rmp_port_t *port, const air_addr_t *dst, i
     // Check if it's a loopback message
     if (air_addr_equals(&rmp->internal.addr, dst))
     {
-        rmp_process_message(rmp, &msg, RMP_TRANSPORT_LOOPBACK);
+        rmp_dispatch_message(rmp, &msg, RMP_TRANSPORT_LOOPBACK);
         return true;
     }
     time_ticks_t now = time_ticks_now();
@@ -508,7 +647,7 @@ bool rmp_send_flags(rmp_t *rmp, const rmp_port_t *port, const air_addr_t *dst, i
         if (flags & RMP_SEND_FLAG_BROADCAST_SELF)
         {
             // Send via loopback too
-            rmp_process_message(rmp, &msg, RMP_TRANSPORT_LOOPBACK);
+            rmp_dispatch_message(rmp, &msg, RMP_TRANSPORT_LOOPBACK);
         }
         if (rmp_should_broadcast_via_rc(flags))
         {
@@ -517,6 +656,11 @@ bool rmp_send_flags(rmp_t *rmp, const rmp_port_t *port, const air_addr_t *dst, i
 #if defined(USE_P2P)
         rmp_send_p2p(rmp, &msg, now);
 #endif
+        rmp_send_serial(rmp, &msg);
+        return true;
+    }
+    if (rmp_is_serial_peer(rmp, dst) && rmp_send_serial(rmp, &msg))
+    {
         return true;
     }
     // Not a broadcast message. Check if we should sign it.
@@ -543,7 +687,7 @@ void rmp_set_transport(rmp_t *rmp, rmp_transport_type_e type, rmp_transport_send
     rmp->internal.transports[type].user_data = user_data;
 }
 
-void rmp_process_message(rmp_t *rmp, rmp_msg_t *msg, rmp_transport_type_e source)
+static void rmp_dispatch_message(rmp_t *rmp, rmp_msg_t *msg, rmp_transport_type_e source)
 {
     char addr_buf[AIR_ADDR_STRING_BUFFER_SIZE];
     air_addr_format(&msg->src, addr_buf, sizeof(addr_buf));
@@ -604,6 +748,10 @@ void rmp_process_message(rmp_t *rmp, rmp_msg_t *msg, rmp_transport_type_e source
         // Update last seen time
         peer->last_seen = time_ticks_now();
     }
+    else if (source == RMP_TRANSPORT_SERIAL)
+    {
+        peer->flags |= RMP_PEER_FLAG_SERIAL;
+    }
     LOG_D(TAG, "Got message from port %u to port %u (signed: %c)", msg->src_port, msg->dst_port, msg->has_signature ? 'Y' : 'N');
     if (msg->dst_port == 0)
     {
@@ -623,13 +771,52 @@ void rmp_process_message(rmp_t *rmp, rmp_msg_t *msg, rmp_transport_type_e source
             };
             rmp_req_t req = {
                 // Signature has been previously verified
-                .is_authenticated = is_loopback || msg->has_signature,
+                // Serial peers have physical access to the device
+                .is_authenticated = is_loopback || msg->has_signature || source == RMP_TRANSPORT_SERIAL,
                 .msg = msg,
                 .resp = rmp_send_response,
                 .resp_data = &resp_data,
             };
+            time_micros_t start = time_micros_now();
             rmp->internal.ports[ii].handler(rmp, &req, rmp->internal.ports[ii].user_data);
+            time_micros_t elapsed = time_micros_now() - start;
+            if (elapsed > rmp->internal.stats.max_processing_us)
+            {
+                rmp->internal.stats.max_processing_us = elapsed;
+            }
             break;
         }
     }
 }
+
+void rmp_process_message(rmp_t *rmp, rmp_msg_t *msg, rmp_transport_type_e source)
+{
+    // Messages are never dispatched from the transport, since that
+    // would run the handlers concurrently with the RMP task and out
+    // of order.
+    if (msg->payload_size <= RMP_QUEUE_PAYLOAD_SIZE)
+    {
+        for (int ii = 0; ii < RMP_QUEUE_SIZE; ii++)
+        {
+            rmp_queued_msg_t *queued = &rmp->internal.queued[ii];
+            uint8_t expected = RMP_QUEUED_MSG_FREE;
+            if (!__atomic_compare_exchange_n(&queued->state, &expected, RMP_QUEUED_MSG_BUSY, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            {
+                continue;
+            }
+            queued->source = source;
+            queued->queued_at = time_micros_now();
+            queued->msg = *msg;
+            if (msg->payload_size > 0)
+            {
+                memcpy(queued->payload, msg->payload, msg->payload_size);
+                queued->msg.payload = queued->payload;
+            }
+            uint8_t idx = ii;
+            // The queue has a slot for each entry in queued, so this can't fail
+            xQueueSend(rmp->internal.queue, &idx, 0);
+            return;
+        }
+    }
+    __atomic_add_fetch(&rmp->internal.stats.dropped, 1, __ATOMIC_RELAXED);
+}
@@ -2,22 +2,38 @@
 
 #include <stdbool.h>
 
+#include <os/os.h>
+
 #include "air/air.h"
 
+#include "target/buffer_profile.h"
+
 #include "util/time.h"
 
 #ifndef RMP_MAX_PEERS
-#define RMP_MAX_PEERS 64
+#define RMP_MAX_PEERS BUFFER_RMP_MAX_PEERS
 #endif
 #ifndef RMP_MAX_PORTS
 #define RMP_MAX_PORTS 8
 #endif
+// Biggest payload any transport can deliver. Serial frames carry up
+// to RMP_SERIAL_MAX_PAYLOAD_SIZE bytes, rmp_air_encode() uses a 512 byte
+// buffer and P2P packets are limited to 250 bytes by ESP-NOW.
+#define RMP_MAX_PAYLOAD_SIZE 512
+// Messages received from the transports are queued and processed in
+// order by the RMP task. Messages received while the queue is full are
+// dropped and counted in rmp_stats_t.dropped.
+#ifndef RMP_QUEUE_SIZE
+#define RMP_QUEUE_SIZE BUFFER_RMP_QUEUE_SIZE
+#endif
+#define RMP_QUEUE_PAYLOAD_SIZE RMP_MAX_PAYLOAD_SIZE
 
 #define RMP_SIGNATURE_SIZE 4
 
 enum
 {
     RMP_PORT_DEVICE = 0x22,
+    RMP_PORT_P2P = 0x23,
     RMP_PORT_MSP = 0x21,
     RMP_PORT_SETTINGS = 0x42,
     RMP_PORT_RC = 0x43,
@@ -37,6 +53,7 @@ typedef enum
 {
     RMP_TRANSPORT_P2P = 0,
     RMP_TRANSPORT_RC,
+    RMP_TRANSPORT_SERIAL,
     RMP_TRANSPORT_COUNT,
 } rmp_transport_type_e;
 
@@ -45,6 +62,7 @@ typedef bool (*rmp_transport_send_f)(rmp_t *rmp, rmp_msg_t *msg, void *user_data
 typedef enum
 {
     RMP_PEER_FLAG_CAN_AUTHENTICATE = 1 << 0, // We have some means to authenticate this peer
+    RMP_PEER_FLAG_SERIAL = 1 << 1,           // Connected via the serial transport, trusted since it's wired
 } rmp_peer_flag_e;
 
 typedef struct rmp_peer_s
@@ -94,6 +112,24 @@ typedef struct rmp_transport_s
     void *user_data;
 } rmp_transport_t;
 
+typedef struct rmp_queued_msg_s
+{
+    uint8_t state;                           // From rmp_queued_msg_state_e in rmp.c, accessed atomically
+    rmp_transport_type_e source;             // Transport the message was received from
+    time_micros_t queued_at;                 // Used for measuring the dispatch latency
+    rmp_msg_t msg;                           // msg.payload points to payload
+    uint8_t payload[RMP_QUEUE_PAYLOAD_SIZE]; // Copy of the message payload
+} rmp_queued_msg_t;
+
+typedef struct rmp_stats_s
+{
+    unsigned queued;                 // Messages processed by the RMP task
+    unsigned dropped;                // Messages dropped because the queue was full or they were too big
+    time_micros_t latency_sum_us;    // Sum of the dispatch latencies, for calculating the average
+    time_micros_t max_latency_us;    // Worst case time between a message being queued and dispatched
+    time_micros_t max_processing_us; // Worst case time spent in a port handler
+} rmp_stats_t;
+
 typedef struct rmp_s
 {
     struct
@@ -104,21 +140,36 @@ typedef struct rmp_s
         air_pairing_t pairing;
         time_ticks_t next_p2p_ping;
         time_ticks_t next_device_info;
+        time_ticks_t next_peers_update;
+        time_ticks_t next_task_update;
         const rmp_port_t *device_port;
         rmp_peer_t peers[RMP_MAX_PEERS];
         rmp_port_t ports[RMP_MAX_PORTS];
         rmp_transport_t transports[RMP_TRANSPORT_COUNT];
+        rmp_queued_msg_t queued[RMP_QUEUE_SIZE];
+        QueueHandle_t queue; // Indexes into queued
+        rmp_stats_t stats;
     } internal;
 } rmp_t;
 
 void rmp_init(rmp_t *rmp, air_addr_t *addr);
+// Dispatches the queued messages and runs the periodic tasks (pings,
+// device info, peer expiration). Blocks until a message is queued or
+// a periodic task is due, so it should be called in a loop from the
+// RMP task. It returns at least every RMP_TASK_UPDATE_INTERVAL, so
+// the other updates run by the RMP task (settings notifications, P2P,
+// coex) don't wait for the next periodic RMP task.
 void rmp_update(rmp_t *rmp);
+void rmp_get_stats(rmp_t *rmp, rmp_stats_t *stats);
 // The data won't be copied, its the responsability of the caller to keep
 // name alive (this is used to grab the up-to-date data from the telemetry)
 void rmp_set_name(rmp_t *rmp, const char *name);
 int rmp_get_name(rmp_t *rmp, char *name, size_t size);
 void rmp_set_role(rmp_t *rmp, air_role_e role);
+air_role_e rmp_get_role(rmp_t *rmp);
 void rmp_set_pairing(rmp_t *rmp, air_pairing_t *pairing);
+// Returns false if we're not paired
+bool rmp_get_pairing(rmp_t *rmp, air_pairing_t *pairing);
 bool rmp_can_authenticate_peer(rmp_t *rmp, const air_addr_t *addr);
 bool rmp_has_p2p_peer(rmp_t *rmp, const air_addr_t *addr);
 void rmp_get_p2p_counts(rmp_t *rmp, int *tx_count, int *rx_count, bool *has_pairing_as_peer);
@@ -132,4 +183,6 @@ bool rmp_send_loopback(rmp_t *rmp, const rmp_port_t *port, int dst_port, const v
 
 // Transports
 void rmp_set_transport(rmp_t *rmp, rmp_transport_type_e type, rmp_transport_send_f send, void *user_data);
+// Called by the transports when they receive a message. The message
+// is copied, so the transport can reuse its buffers after this returns.
 void rmp_process_message(rmp_t *rmp, rmp_msg_t *msg, rmp_transport_type_e source);
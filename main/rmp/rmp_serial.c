@@ -0,0 +1,306 @@
+#include <string.h>
+
+#include "util/crc.h"
+#include "util/macros.h"
+
+#include "rmp_serial.h"
+
+// Maximum time a frame waits in the TX buffer for more frames to batch
+#define RMP_SERIAL_TX_MAX_DELAY MILLIS_TO_TICKS(2)
+// Write right away once this many bytes are queued
+#define RMP_SERIAL_TX_FLUSH_SIZE 512
+// ACKs are also sent periodically, so the host can detect the device
+// and recover from a lost one.
+#define RMP_SERIAL_ACK_INTERVAL MILLIS_TO_TICKS(500)
+
+_Static_assert(RMP_SERIAL_MAX_PAYLOAD_SIZE <= RMP_MAX_PAYLOAD_SIZE, "RMP queue can't hold serial payloads");
+
+// Note that we can't log anything here, since the logs might be
+// going through this transport.
+
+typedef enum
+{
+    RMP_SERIAL_MSG_FLAG_SIGNED = 1 << 0,
+} rmp_serial_msg_flags_e;
+
+static bool rmp_serial_queue_frame(rmp_serial_t *s, rmp_serial_frame_e type, const void *header, size_t header_size, const void *body, size_t body_size)
+{
+    size_t size = header_size + body_size;
+    size_t frame_size = RMP_SERIAL_FRAME_OVERHEAD + size;
+    bool queued = false;
+    mutex_lock(&s->tx.mutex);
+    if (s->tx.pos + frame_size <= sizeof(s->tx.bufs[0]))
+    {
+        uint8_t *p = &s->tx.bufs[s->tx.active][s->tx.pos];
+        p[0] = RMP_SERIAL_SYNC_BYTE;
+        p[1] = type;
+        p[2] = size & 0xFF;
+        p[3] = size >> 8;
+        if (header_size > 0)
+        {
+            memcpy(&p[4], header, header_size);
+        }
+        if (body_size > 0)
+        {
+            memcpy(&p[4 + header_size], body, body_size);
+        }
+        p[4 + size] = crc8_dvb_s2_bytes(&p[1], 3 + size);
+        if (s->tx.pos == 0)
+        {
+            s->tx.first_queued_at = time_ticks_now();
+        }
+        s->tx.pos += frame_size;
+        s->stats.frames_out++;
+        queued = true;
+    }
+    mutex_unlock(&s->tx.mutex);
+    return queued;
+}
+
+static bool rmp_serial_send(rmp_t *rmp, rmp_msg_t *msg, void *user_data)
+{
+    UNUSED(rmp);
+
+    rmp_serial_t *s = user_data;
+    if (msg->payload_size > RMP_SERIAL_MAX_PAYLOAD_SIZE)
+    {
+        return false;
+    }
+    uint8_t header[RMP_SERIAL_MSG_HEADER_SIZE];
+    size_t pos = 0;
+    memcpy(&header[pos], &msg->src, AIR_ADDR_LENGTH);
+    pos += AIR_ADDR_LENGTH;
+    header[pos++] = msg->src_port;
+    memcpy(&header[pos], &msg->dst, AIR_ADDR_LENGTH);
+    pos += AIR_ADDR_LENGTH;
+    header[pos++] = msg->dst_port;
+    header[pos++] = msg->has_signature ? RMP_SERIAL_MSG_FLAG_SIGNED : 0;
+    if (msg->has_signature)
+    {
+        memcpy(&header[pos], msg->signature, RMP_SIGNATURE_SIZE);
+        pos += RMP_SIGNATURE_SIZE;
+    }
+    if (!rmp_serial_queue_frame(s, RMP_SERIAL_FRAME_MSG, header, pos, msg->payload, msg->payload_size))
+    {
+        s->stats.rejected++;
+        return false;
+    }
+    return true;
+}
+
+static void rmp_serial_decode_msg(rmp_serial_t *s, const uint8_t *body, size_t size)
+{
+    rmp_msg_t msg;
+    size_t pos = 0;
+    if (size < RMP_SERIAL_MSG_HEADER_SIZE - RMP_SIGNATURE_SIZE)
+    {
+        return;
+    }
+    memcpy(&msg.src, &body[pos], AIR_ADDR_LENGTH);
+    pos += AIR_ADDR_LENGTH;
+    msg.src_port = body[pos++];
+    memcpy(&msg.dst, &body[pos], AIR_ADDR_LENGTH);
+    pos += AIR_ADDR_LENGTH;
+    msg.dst_port = body[pos++];
+    uint8_t flags = body[pos++];
+    msg.has_signature = flags & RMP_SERIAL_MSG_FLAG_SIGNED;
+    if (msg.has_signature)
+    {
+        if (size < pos + RMP_SIGNATURE_SIZE)
+        {
+            return;
+        }
+        memcpy(msg.signature, &body[pos], RMP_SIGNATURE_SIZE);
+        pos += RMP_SIGNATURE_SIZE;
+    }
+    msg.payload = size > pos ? &body[pos] : NULL;
+    msg.payload_size = size - pos;
+    rmp_process_message(s->rmp, &msg, RMP_TRANSPORT_SERIAL);
+}
+
+static void rmp_serial_decode_frame(rmp_serial_t *s)
+{
+    const uint8_t *frame = s->rx.buf;
+    size_t body_size = s->rx.size - RMP_SERIAL_FRAME_OVERHEAD;
+    if (crc8_dvb_s2_bytes(&frame[1], 3 + body_size) != frame[4 + body_size])
+    {
+        s->stats.crc_errors++;
+        return;
+    }
+    s->stats.frames_in++;
+    switch ((rmp_serial_frame_e)frame[1])
+    {
+    case RMP_SERIAL_FRAME_MSG:
+        rmp_serial_decode_msg(s, &frame[4], body_size);
+        break;
+    // Only sent by the device
+    case RMP_SERIAL_FRAME_LOG:
+    case RMP_SERIAL_FRAME_ACK:
+    case RMP_SERIAL_FRAME_TELEMETRY:
+        break;
+    }
+}
+
+static void rmp_serial_feed(rmp_serial_t *s, const uint8_t *data, size_t size)
+{
+    for (size_t ii = 0; ii < size; ii++)
+    {
+        uint8_t c = data[ii];
+        if (s->rx.pos == 0 && c != RMP_SERIAL_SYNC_BYTE)
+        {
+            // Out of sync
+            continue;
+        }
+        s->rx.buf[s->rx.pos++] = c;
+        if (s->rx.pos == 4)
+        {
+            unsigned body_size = s->rx.buf[2] | (s->rx.buf[3] << 8);
+            if (body_size > sizeof(s->rx.buf) - RMP_SERIAL_FRAME_OVERHEAD)
+            {
+                s->stats.crc_errors++;
+                s->rx.pos = 0;
+                continue;
+            }
+            s->rx.size = RMP_SERIAL_FRAME_OVERHEAD + body_size;
+        }
+        if (s->rx.size > 0 && s->rx.pos == s->rx.size)
+        {
+            rmp_serial_decode_frame(s);
+            s->rx.pos = 0;
+            s->rx.size = 0;
+        }
+    }
+    s->rx.consumed += size;
+    s->stats.bytes_in += size;
+}
+
+static void rmp_serial_send_ack(rmp_serial_t *s, time_ticks_t now)
+{
+    rmp_serial_ack_t ack = {
+        .consumed = s->rx.consumed,
+        .window = RMP_SERIAL_RX_WINDOW,
+    };
+    if (rmp_serial_queue_frame(s, RMP_SERIAL_FRAME_ACK, &ack, sizeof(ack), NULL, 0))
+    {
+        s->rx.acked = ack.consumed;
+        s->next_ack = now + RMP_SERIAL_ACK_INTERVAL;
+    }
+}
+
+static void rmp_serial_send_telemetry(rmp_serial_t *s)
+{
+    uint8_t body[RMP_SERIAL_MAX_PAYLOAD_SIZE];
+    size_t size = 0;
+    // Values are marked as sent only once their frame has been queued
+    time_micros_t updated[TELEMETRY_COUNT];
+    int count = telemetry_get_id_count();
+    for (int ii = 0; ii < count; ii++)
+    {
+        int id = telemetry_get_id_at(ii);
+        const telemetry_t *val = rc_data_get_telemetry(s->telemetry.data, id);
+        updated[ii] = data_state_get_last_update(&val->data_state);
+        if (updated[ii] == s->telemetry.sent[ii])
+        {
+            continue;
+        }
+        size_t val_size = telemetry_get_data_size(id);
+        if (val_size == 0)
+        {
+            val_size = strnlen(val->val.s, TELEMETRY_STRING_MAX_SIZE);
+        }
+        if (size + 3 + val_size > sizeof(body))
+        {
+            // Sent in the next frame
+            updated[ii] = s->telemetry.sent[ii];
+            continue;
+        }
+        body[size++] = id;
+        body[size++] = telemetry_get_type(id);
+        body[size++] = val_size;
+        memcpy(&body[size], &val->val, val_size);
+        size += val_size;
+    }
+    if (size > 0 && rmp_serial_queue_frame(s, RMP_SERIAL_FRAME_TELEMETRY, NULL, 0, body, size))
+    {
+        for (int ii = 0; ii < count; ii++)
+        {
+            if (s->telemetry.sent[ii] != updated[ii])
+            {
+                s->telemetry.sent[ii] = updated[ii];
+                s->stats.telemetry++;
+            }
+        }
+    }
+}
+
+static void rmp_serial_flush(rmp_serial_t *s, time_ticks_t now)
+{
+    mutex_lock(&s->tx.mutex);
+    unsigned size = s->tx.pos;
+    if (size == 0 || (size < RMP_SERIAL_TX_FLUSH_SIZE && now < s->tx.first_queued_at + RMP_SERIAL_TX_MAX_DELAY))
+    {
+        mutex_unlock(&s->tx.mutex);
+        return;
+    }
+    // Only this function swaps the buffers, so nobody else touches
+    // this one until we're done writing it.
+    const uint8_t *buf = s->tx.bufs[s->tx.active];
+    s->tx.active ^= 1;
+    s->tx.pos = 0;
+    mutex_unlock(&s->tx.mutex);
+    io_write(&s->io, buf, size);
+    s->stats.bytes_out += size;
+}
+
+void rmp_serial_init(rmp_serial_t *s, rmp_t *rmp, io_t *io)
+{
+    memset(s, 0, sizeof(*s));
+    s->rmp = rmp;
+    s->io = *io;
+    mutex_open(&s->tx.mutex);
+    rmp_set_transport(rmp, RMP_TRANSPORT_SERIAL, rmp_serial_send, s);
+}
+
+void rmp_serial_update(rmp_serial_t *s)
+{
+    uint8_t buf[256];
+    int n = io_read(&s->io, buf, sizeof(buf), 1);
+    if (n > 0)
+    {
+        rmp_serial_feed(s, buf, n);
+    }
+    time_ticks_t now = time_ticks_now();
+    uint32_t unacked = s->rx.consumed - s->rx.acked;
+    // ACK as soon as the input goes idle, so the host can keep
+    // the window full, or when a quarter of it has been consumed.
+    if (unacked >= RMP_SERIAL_RX_WINDOW / 4 || (n <= 0 && unacked > 0) || now >= s->next_ack)
+    {
+        rmp_serial_send_ack(s, now);
+    }
+    if (s->telemetry.data)
+    {
+        rmp_serial_send_telemetry(s);
+    }
+    rmp_serial_flush(s, now);
+}
+
+void rmp_serial_log(rmp_serial_t *s, const char *line, size_t size)
+{
+    size = MIN(size, RMP_SERIAL_MAX_PAYLOAD_SIZE);
+    if (!rmp_serial_queue_frame(s, RMP_SERIAL_FRAME_LOG, NULL, 0, line, size))
+    {
+        s->stats.dropped++;
+    }
+}
+
+void rmp_serial_set_telemetry(rmp_serial_t *s, rc_data_t *data)
+{
+    // Start by sending all the values that have been received
+    memset(s->telemetry.sent, 0, sizeof(s->telemetry.sent));
+    s->telemetry.data = data;
+}
+
+void rmp_serial_get_stats(rmp_serial_t *s, rmp_serial_stats_t *stats)
+{
+    *stats = s->stats;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <hal/mutex.h>
+
+#include "air/air.h"
+
+#include "io/io.h"
+
+#include "rc/rc_data.h"
+
+#include "rmp/rmp.h"
+
+#include "util/time.h"
+
+// RMP over a serial port (UART or USB-CDC), for host tools. Every frame
+// starts with RMP_SERIAL_SYNC_BYTE, followed by its type, the body size
+// (u16-le), the body and a crc8_dvb_s2 of everything after the sync
+// byte. See rmp_serial_tool.py for the host side.
+//
+// Flow control: the device sends RMP_SERIAL_FRAME_ACK frames with the
+// number of bytes consumed so far and the size of its RX window. The
+// host must never have more than a window worth of unacknowledged bytes
+// in flight. In the other direction frames are batched and written by
+// rmp_serial_update(). If the TX buffer is full, messages are rejected
+// and log lines dropped. Telemetry values that don't fit are retried
+// in the next update.
+
+#define RMP_SERIAL_SYNC_BYTE 'R'
+#define RMP_SERIAL_MAX_PAYLOAD_SIZE 512
+// src addr + port, dst addr + port, flags and signature
+#define RMP_SERIAL_MSG_HEADER_SIZE (AIR_ADDR_LENGTH * 2 + 2 + 1 + RMP_SIGNATURE_SIZE)
+#define RMP_SERIAL_FRAME_OVERHEAD 5
+#define RMP_SERIAL_MAX_FRAME_SIZE (RMP_SERIAL_FRAME_OVERHEAD + RMP_SERIAL_MSG_HEADER_SIZE + RMP_SERIAL_MAX_PAYLOAD_SIZE)
+#define RMP_SERIAL_RX_WINDOW 4096
+#define RMP_SERIAL_TX_BUFFER_SIZE 4096
+#define RMP_SERIAL_BAUD_RATE 921600
+
+typedef enum
+{
+    RMP_SERIAL_FRAME_MSG = 0, // An RMP message, in both directions
+    RMP_SERIAL_FRAME_LOG,     // A log line, from the device
+    RMP_SERIAL_FRAME_ACK,     // Flow control, from the device
+    // Telemetry values updated since the previous frame, from the device.
+    // Each one is encoded as its ID, its telemetry_type_e, its size (u8)
+    // and its value.
+    RMP_SERIAL_FRAME_TELEMETRY,
+} rmp_serial_frame_e;
+
+typedef struct rmp_serial_ack_s
+{
+    uint32_t consumed; // Bytes received since the transport was started
+    uint16_t window;   // Maximum bytes in flight
+} PACKED rmp_serial_ack_t;
+
+typedef struct rmp_serial_stats_s
+{
+    unsigned frames_in;
+    unsigned frames_out;
+    unsigned bytes_in;
+    unsigned bytes_out;
+    unsigned crc_errors;
+    unsigned rejected;  // Messages that didn't fit in the TX buffer
+    unsigned dropped;   // Log lines that didn't fit in the TX buffer
+    unsigned telemetry; // Telemetry values sent
+} rmp_serial_stats_t;
+
+typedef struct rmp_serial_s
+{
+    rmp_t *rmp;
+    io_t io;
+    struct
+    {
+        uint8_t buf[RMP_SERIAL_MAX_FRAME_SIZE];
+        unsigned pos;
+        unsigned size; // Expected frame size, zero while reading the header
+        uint32_t consumed;
+        uint32_t acked;
+    } rx;
+    struct
+    {
+        mutex_t mutex;
+        // Frames are queued in one buffer while the other one is written,
+        // so the mutex is never held during a write.
+        uint8_t bufs[2][RMP_SERIAL_TX_BUFFER_SIZE];
+        unsigned active;
+        unsigned pos;
+        time_ticks_t first_queued_at; // When the oldest unwritten frame was queued
+    } tx;
+    time_ticks_t next_ack;
+    struct
+    {
+        rc_data_t *data;
+        // data_state last_update of each value when it was last sent,
+        // indexed like telemetry_get_id_at()
+        time_micros_t sent[TELEMETRY_COUNT];
+    } telemetry;
+    rmp_serial_stats_t stats;
+} rmp_serial_t;
+
+void rmp_serial_init(rmp_serial_t *s, rmp_t *rmp, io_t *io);
+// Must be called in a loop from a dedicated task. It blocks for at
+// most 1 tick waiting for data.
+void rmp_serial_update(rmp_serial_t *s);
+// Can be called from any task, it only waits for other tasks queueing frames
+void rmp_serial_log(rmp_serial_t *s, const char *line, size_t size);
+// Streams every telemetry value in data to the host each time it's
+// updated, not only when it changes. Pass NULL to stop streaming.
+void rmp_serial_set_telemetry(rmp_serial_t *s, rc_data_t *data);
+void rmp_serial_get_stats(rmp_serial_t *s, rmp_serial_stats_t *stats);
@@ -0,0 +1,429 @@
+#!/usr/bin/env python
+
+# Host side of rmp_serial.c. Talks RMP to a device with the Serial RMP
+# developer setting enabled, over the console port.
+#
+#   logs      prints the device logs
+#   telemetry prints every telemetry value as the device updates it
+#   settings  dumps a settings folder using the settings RMP port
+#   bench     measures the throughput of the framing and flow control
+#             against an emulated device over a pty pair, rate limited
+#             to the configured baud rate
+#
+# The framing and ACK logic here mirror rmp_serial.c, keep them in sync.
+
+from __future__ import print_function
+from __future__ import division
+
+import argparse
+import os
+import random
+import struct
+import sys
+import threading
+import time
+
+try:
+    import queue
+except ImportError:
+    import Queue as queue
+
+SYNC_BYTE = ord('R')
+FRAME_MSG = 0
+FRAME_LOG = 1
+FRAME_ACK = 2
+FRAME_TELEMETRY = 3
+FRAME_OVERHEAD = 5
+MAX_PAYLOAD_SIZE = 512
+ADDR_LENGTH = 6
+SIGNATURE_SIZE = 4
+MSG_HEADER_SIZE = ADDR_LENGTH * 2 + 2 + 1 + SIGNATURE_SIZE
+MAX_FRAME_SIZE = FRAME_OVERHEAD + MSG_HEADER_SIZE + MAX_PAYLOAD_SIZE
+RX_WINDOW = 4096
+TX_BUFFER_SIZE = 4096
+TX_FLUSH_SIZE = 512
+TX_MAX_DELAY = 0.002
+ACK_INTERVAL = 0.5
+BAUD_RATE = 921600
+
+BROADCAST_ADDR = b'\xff' * ADDR_LENGTH
+
+RMP_PORT_SETTINGS = 0x42
+SETTINGS_RMP_HELO = 0
+SETTINGS_RMP_EHLO = 1
+SETTINGS_RMP_READ_REQ = 2
+SETTINGS_RMP_READ = 3
+
+SETTING_TYPE_U8 = 0
+SETTING_TYPE_STRING = 6
+SETTING_TYPE_FOLDER = 7
+
+def crc8_dvb_s2(data, crc=0):
+    for b in bytearray(data):
+        crc ^= b
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0xD5) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+def encode_frame(frame_type, body):
+    hdr = struct.pack('<BH', frame_type, len(body))
+    return bytes(bytearray([SYNC_BYTE])) + hdr + body + bytes(bytearray([crc8_dvb_s2(hdr + body)]))
+
+class Msg(object):
+    def __init__(self, src, src_port, dst, dst_port, payload, signature=None):
+        self.src = src
+        self.src_port = src_port
+        self.dst = dst
+        self.dst_port = dst_port
+        self.payload = payload
+        self.signature = signature
+
+    def encode(self):
+        flags = 1 if self.signature else 0
+        body = self.src + struct.pack('<B', self.src_port) + self.dst + struct.pack('<BB', self.dst_port, flags)
+        if self.signature:
+            body += self.signature
+        return body + self.payload
+
+    @classmethod
+    def decode(cls, body):
+        if len(body) < MSG_HEADER_SIZE - SIGNATURE_SIZE:
+            return None
+        pos = 0
+        src = body[pos:pos + ADDR_LENGTH]
+        pos += ADDR_LENGTH
+        src_port = bytearray(body)[pos]
+        pos += 1
+        dst = body[pos:pos + ADDR_LENGTH]
+        pos += ADDR_LENGTH
+        dst_port, flags = struct.unpack('<BB', body[pos:pos + 2])
+        pos += 2
+        signature = None
+        if flags & 1:
+            if len(body) < pos + SIGNATURE_SIZE:
+                return None
+            signature = body[pos:pos + SIGNATURE_SIZE]
+            pos += SIGNATURE_SIZE
+        return cls(src, src_port, dst, dst_port, body[pos:], signature)
+
+class FrameParser(object):
+    def __init__(self):
+        self.buf = bytearray()
+        self.size = 0
+        self.crc_errors = 0
+
+    def feed(self, data):
+        frames = []
+        for c in bytearray(data):
+            if not self.buf and c != SYNC_BYTE:
+                continue
+            self.buf.append(c)
+            if len(self.buf) == 4:
+                body_size = self.buf[2] | (self.buf[3] << 8)
+                if body_size > MAX_FRAME_SIZE - FRAME_OVERHEAD:
+                    self.crc_errors += 1
+                    self.buf = bytearray()
+                    continue
+                self.size = FRAME_OVERHEAD + body_size
+            if self.size and len(self.buf) == self.size:
+                if crc8_dvb_s2(bytes(self.buf[1:-1])) == self.buf[-1]:
+                    frames.append((self.buf[1], bytes(self.buf[4:-1])))
+                else:
+                    self.crc_errors += 1
+                self.buf = bytearray()
+                self.size = 0
+        return frames
+
+class Link(object):
+    """Host end of the transport. Never has more than the window
+    advertised by the device in flight."""
+
+    def __init__(self, read, write, on_log=None, on_telemetry=None):
+        self.read = read
+        self.write = write
+        self.on_log = on_log
+        self.on_telemetry = on_telemetry
+        self.parser = FrameParser()
+        self.sent = 0
+        self.consumed = None
+        self.window = 0
+        self.msgs = []
+        self.stalls = 0
+
+    def poll(self, timeout):
+        data = self.read(timeout)
+        if not data:
+            return
+        for frame_type, body in self.parser.feed(data):
+            if frame_type == FRAME_ACK and len(body) == 6:
+                consumed, self.window = struct.unpack('<IH', body)
+                if self.consumed is None:
+                    # First ACK, start counting from what the device saw
+                    self.sent = consumed
+                self.consumed = consumed
+            elif frame_type == FRAME_LOG:
+                if self.on_log:
+                    line = body.decode('utf-8', 'replace')
+                    self.on_log(line if line.endswith('\n') else line + '\n')
+            elif frame_type == FRAME_TELEMETRY:
+                if self.on_telemetry:
+                    for id, value in parse_telemetry(body):
+                        self.on_telemetry(id, value)
+            elif frame_type == FRAME_MSG:
+                msg = Msg.decode(body)
+                if msg:
+                    self.msgs.append(msg)
+
+    def wait_for_device(self, timeout):
+        deadline = time.time() + timeout
+        while self.consumed is None:
+            if time.time() > deadline:
+                raise RuntimeError('no ACK from the device, is Serial RMP enabled?')
+            self.poll(0.05)
+
+    def in_flight(self):
+        return (self.sent - self.consumed) & 0xFFFFFFFF
+
+    def send(self, msg):
+        frame = encode_frame(FRAME_MSG, msg.encode())
+        stalled = False
+        while self.in_flight() + len(frame) > self.window:
+            stalled = True
+            self.poll(0.01)
+        if stalled:
+            self.stalls += 1
+        self.write(frame)
+        self.sent += len(frame)
+
+    def recv(self, timeout, match=lambda msg: True):
+        deadline = time.time() + timeout
+        while True:
+            for ii, msg in enumerate(self.msgs):
+                if match(msg):
+                    return self.msgs.pop(ii)
+            remaining = deadline - time.time()
+            if remaining <= 0:
+                return None
+            self.poll(min(remaining, 0.05))
+
+# telemetry_type_e to struct formats, strings are decoded separately
+TELEMETRY_FORMATS = {1: '<B', 2: '<b', 3: '<H', 4: '<h', 5: '<I', 6: '<i'}
+
+def parse_telemetry(body):
+    body = bytearray(body)
+    pos = 0
+    while pos + 3 <= len(body):
+        id, typ, size = body[pos], body[pos + 1], body[pos + 2]
+        value = bytes(body[pos + 3:pos + 3 + size])
+        if typ in TELEMETRY_FORMATS and len(value) == struct.calcsize(TELEMETRY_FORMATS[typ]):
+            value = struct.unpack(TELEMETRY_FORMATS[typ], value)[0]
+        else:
+            value = value.decode('utf-8', 'replace')
+        yield id, value
+        pos += 3 + size
+
+def open_serial(path, baud_rate):
+    import serial
+    port = serial.Serial(path, baud_rate, timeout=0)
+
+    def read(timeout):
+        port.timeout = timeout
+        return port.read(max(port.in_waiting, 1))
+
+    return read, port.write
+
+def cmd_logs(args):
+    read, write = open_serial(args.port, args.baud_rate)
+    link = Link(read, write, on_log=sys.stdout.write)
+    while True:
+        link.poll(0.1)
+
+def cmd_telemetry(args):
+    read, write = open_serial(args.port, args.baud_rate)
+
+    def on_telemetry(id, value):
+        print('%.3f 0x%02x %s' % (time.time(), id, value))
+
+    link = Link(read, write, on_telemetry=on_telemetry)
+    while True:
+        link.poll(0.1)
+
+def settings_request(link, addr, code, payload):
+    msg = Msg(addr, 0x80, BROADCAST_ADDR, RMP_PORT_SETTINGS, struct.pack('<B', code) + payload)
+    link.send(msg)
+    expected = code + 1
+    return link.recv(1.0, lambda m: m.dst == addr and m.payload[:1] == struct.pack('<B', expected))
+
+def parse_setting(payload):
+    _, _, _, index, parent, setting_type, _ = struct.unpack('<BHBHiBB', payload[:12])
+    data = payload[12:]
+    if setting_type == SETTING_TYPE_U8:
+        value = bytearray(data)[0]
+        name = data[4:]
+    elif setting_type == SETTING_TYPE_STRING:
+        end = data.index(b'\0')
+        value = data[:end].decode('utf-8', 'replace')
+        name = data[end + 2:]
+    elif setting_type == SETTING_TYPE_FOLDER:
+        value = struct.unpack('<H', data[:2])[0]
+        name = data[2:]
+    else:
+        value = None
+        name = b''
+    name = name[:name.index(b'\0')] if b'\0' in name else name
+    return index, parent, value, name.decode('utf-8', 'replace')
+
+def cmd_settings(args):
+    read, write = open_serial(args.port, args.baud_rate)
+    link = Link(read, write)
+    link.wait_for_device(2)
+    addr = bytes(bytearray(random.getrandbits(8) for _ in range(ADDR_LENGTH)))
+    view = struct.pack('<BHB', 0, args.folder, 1)
+    ehlo = settings_request(link, addr, SETTINGS_RMP_HELO, view)
+    if ehlo is None:
+        raise RuntimeError('no EHLO from the device')
+    count = struct.unpack('<H', ehlo.payload[6:8])[0]
+    for ii in range(count):
+        resp = settings_request(link, addr, SETTINGS_RMP_READ_REQ, view + struct.pack('<H', ii))
+        if resp is None:
+            print('%3d: timeout' % ii)
+            continue
+        index, parent, value, name = parse_setting(resp.payload[1:])
+        print('%3d %3d %-32s %s' % (index, parent, name, value))
+
+class DeviceEmulator(object):
+    """Device side of the transport, following rmp_serial_update(). Echoes
+    back every message. Like the UART, each direction runs at most at
+    the baud rate and writes go through a driver buffer, so the loop
+    doesn't wait for them to be sent."""
+
+    def __init__(self, fd, baud_rate):
+        self.fd = fd
+        self.byte_time = 10 / baud_rate
+        self.driver_tx = queue.Queue(maxsize=TX_BUFFER_SIZE // TX_FLUSH_SIZE)
+        self.parser = FrameParser()
+        self.consumed = 0
+        self.acked = 0
+        self.next_ack = 0
+        self.tx = bytearray()
+        self.first_queued_at = 0
+        self.rejected = 0
+        self.running = True
+
+    def queue(self, frame_type, body):
+        frame = encode_frame(frame_type, body)
+        if len(self.tx) + len(frame) > TX_BUFFER_SIZE:
+            return False
+        if not self.tx:
+            self.first_queued_at = time.time()
+        self.tx += frame
+        return True
+
+    def update(self):
+        import select
+        r, _, _ = select.select([self.fd], [], [], 0.001)
+        n = 0
+        if r:
+            data = os.read(self.fd, 256)
+            n = len(data)
+            # Bytes can't arrive faster than the line rate
+            time.sleep(n * self.byte_time)
+            for frame_type, body in self.parser.feed(data):
+                msg = Msg.decode(body) if frame_type == FRAME_MSG else None
+                if msg and not self.queue(FRAME_MSG, Msg(msg.dst, msg.dst_port, msg.src, msg.src_port, msg.payload).encode()):
+                    self.rejected += 1
+            self.consumed += n
+        now = time.time()
+        unacked = self.consumed - self.acked
+        if unacked >= RX_WINDOW // 4 or (n == 0 and unacked > 0) or now >= self.next_ack:
+            if self.queue(FRAME_ACK, struct.pack('<IH', self.consumed & 0xFFFFFFFF, RX_WINDOW)):
+                self.acked = self.consumed
+                self.next_ack = now + ACK_INTERVAL
+        if self.tx and (len(self.tx) >= TX_FLUSH_SIZE or now >= self.first_queued_at + TX_MAX_DELAY):
+            data, self.tx = bytes(self.tx), bytearray()
+            self.driver_tx.put(data)
+
+    def write_loop(self):
+        while True:
+            data = self.driver_tx.get()
+            os.write(self.fd, data)
+            time.sleep(len(data) * self.byte_time)
+
+    def run(self):
+        writer = threading.Thread(target=self.write_loop)
+        writer.daemon = True
+        writer.start()
+        while self.running:
+            self.update()
+
+def cmd_bench(args):
+    import pty
+    import select
+    import tty
+    master, slave = pty.openpty()
+    tty.setraw(master)
+    tty.setraw(slave)
+    device = DeviceEmulator(slave, args.baud_rate)
+    thread = threading.Thread(target=device.run)
+    thread.daemon = True
+    thread.start()
+
+    def read(timeout):
+        r, _, _ = select.select([master], [], [], timeout)
+        return os.read(master, 4096) if r else b''
+
+    def write(data):
+        while data:
+            data = data[os.write(master, data):]
+
+    link = Link(read, write)
+    link.wait_for_device(2)
+    addr = b'\x01' * ADDR_LENGTH
+    payload = bytes(bytearray(random.getrandbits(8) for _ in range(args.payload_size)))
+    received = 0
+    start = time.time()
+    sent = 0
+    while time.time() - start < args.duration:
+        link.send(Msg(addr, 0x80, BROADCAST_ADDR, 0x81, payload))
+        sent += 1
+        link.poll(0)
+        while link.msgs:
+            link.msgs.pop()
+            received += 1
+    deadline = time.time() + 1
+    while received < sent - device.rejected and time.time() < deadline:
+        link.poll(0.01)
+        while link.msgs:
+            link.msgs.pop()
+            received += 1
+    elapsed = time.time() - start
+    device.running = False
+    frame_size = FRAME_OVERHEAD + MSG_HEADER_SIZE - SIGNATURE_SIZE + args.payload_size
+    line_rate = args.baud_rate / 10
+    print('payload %d bytes, %d sent, %d echoed, %d rejected, %d stalls, %d crc errors' % (
+        args.payload_size, sent, received, device.rejected, link.stalls,
+        link.parser.crc_errors + device.parser.crc_errors))
+    print('uplink %.1f KB/s payload (%.1f KB/s on the wire, %.0f%% of %.1f KB/s)' % (
+        sent * args.payload_size / elapsed / 1024, sent * frame_size / elapsed / 1024,
+        sent * frame_size / elapsed / line_rate * 100, line_rate / 1024))
+    print('downlink %.1f KB/s payload' % (received * args.payload_size / elapsed / 1024))
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--port', help='Serial port connected to the device console')
+    parser.add_argument('--baud-rate', type=int, default=BAUD_RATE)
+    sub = parser.add_subparsers(dest='cmd')
+    sub.add_parser('logs')
+    sub.add_parser('telemetry')
+    settings = sub.add_parser('settings')
+    settings.add_argument('--folder', type=int, default=0, help='Folder ID to dump')
+    bench = sub.add_parser('bench')
+    bench.add_argument('--payload-size', type=int, default=128)
+    bench.add_argument('--duration', type=float, default=5)
+    args = parser.parse_args()
+    if args.cmd in ('logs', 'telemetry', 'settings') and not args.port:
+        parser.error('--port is required')
+    {'logs': cmd_logs, 'telemetry': cmd_telemetry, 'settings': cmd_settings, 'bench': cmd_bench}.get(args.cmd, lambda _: parser.print_help())(args)
+
+if __name__ == '__main__':
+    main()
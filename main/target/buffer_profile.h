@@ -0,0 +1,47 @@
+#pragma once
+
+// Buffer profiles trade MSP throughput and the number of tracked RMP
+// peers for RAM. They're selected at build time with
+// BUFFER_PROFILE=<minimal|standard|configurator> (see the top level
+// Makefile). Use make ram-report to see the resulting RAM usage.
+//
+// - minimal: for targets with very little RAM. MSP payloads are limited
+// to 256 bytes, which is enough for telemetry but might truncate
+// some configurator requests.
+// - standard: the default for all targets.
+// - configurator: allows bigger MSP payloads, so configurators can
+// transfer e.g. blackbox or OSD data in fewer round trips. Some MSP
+// buffers are allocated in the stack, so this profile is not available
+// on targets with small task stacks.
+#define BUFFER_PROFILE_MINIMAL 0
+#define BUFFER_PROFILE_STANDARD 1
+#define BUFFER_PROFILE_CONFIGURATOR 2
+
+#if !defined(BUFFER_PROFILE)
+#define BUFFER_PROFILE BUFFER_PROFILE_STANDARD
+#endif
+
+#if BUFFER_PROFILE == BUFFER_PROFILE_MINIMAL
+#define BUFFER_PROFILE_NAME "minimal"
+#define BUFFER_MSP_MAX_PAYLOAD_SIZE 256
+#define BUFFER_RMP_MAX_PEERS 16
+#define BUFFER_RMP_QUEUE_SIZE 2
+#define BUFFER_RC_MSP_RESP_CTX_COUNT 8
+#elif BUFFER_PROFILE == BUFFER_PROFILE_STANDARD
+#define BUFFER_PROFILE_NAME "standard"
+#define BUFFER_MSP_MAX_PAYLOAD_SIZE 512
+#define BUFFER_RMP_MAX_PEERS 64
+#define BUFFER_RMP_QUEUE_SIZE 4
+#define BUFFER_RC_MSP_RESP_CTX_COUNT 30
+#elif BUFFER_PROFILE == BUFFER_PROFILE_CONFIGURATOR
+#define BUFFER_PROFILE_NAME "configurator"
+#define BUFFER_MSP_MAX_PAYLOAD_SIZE 1024
+#define BUFFER_RMP_MAX_PEERS 64
+#define BUFFER_RMP_QUEUE_SIZE 8
+#define BUFFER_RC_MSP_RESP_CTX_COUNT 30
+#if defined(STM32)
+#error The configurator buffer profile is not supported on STM32
+#endif
+#else
+#error Invalid BUFFER_PROFILE
+#endif
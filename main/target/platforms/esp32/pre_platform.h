@@ -6,6 +6,11 @@
 #define USE_OTA
 #define USE_DEVELOPER_MENU
 #define USE_IDF_WMONITOR
+#define USE_STORAGE_WORKER
+#define USE_POWER_MANAGEMENT
+#define USE_COEX
+#define USE_MULTI_RX
+#define USE_RMP_SERIAL
 
 #define RC_TASK_STACK_SIZE 4096 // We need a bigger stack on ESP32 because of the SPI libraries
 #define RMP_TASK_STACK_SIZE 4096
@@ -8,6 +8,8 @@
 
 #include "io/serial.h"
 
+#include "platform/power.h"
+
 #include "util/macros.h"
 
 #include "target.h"
@@ -27,6 +29,12 @@ typedef struct serial_port_s
     uint8_t buf[128];
     unsigned buf_pos;
     mutex_t mutex;
+    // Half duplex timing
+    unsigned byte_time_us;
+    volatile time_micros_t tx_done_at;
+    volatile time_micros_t last_rx_at;
+    volatile bool awaiting_response;
+    serial_half_duplex_stats_t stats;
 } serial_port_t;
 
 // We support 2 UART ports at maximum, ignoring UART0 since
@@ -36,6 +44,9 @@ static serial_port_t ports[] = {
     {.port_num = UART_NUM_2, .dev = &UART2, .tx_sig = U2TXD_OUT_IDX, .rx_sig = U2RXD_IN_IDX, .open = false, .in_write = false},
 };
 
+// Only opened via serial_port_open_console()
+static serial_port_t console_port = {.port_num = UART_NUM_0, .dev = &UART0, .tx_sig = U0TXD_OUT_IDX, .rx_sig = U0RXD_IN_IDX, .open = false, .in_write = false};
+
 static void serial_half_duplex_enable_rx(serial_port_t *port)
 {
     // Disable TX interrupts
@@ -58,8 +69,39 @@ static void serial_half_duplex_enable_rx(serial_port_t *port)
     port->dev->int_ena.rxfifo_full = 1;
 }
 
+static void serial_port_update_byte_time(serial_port_t *port, uint32_t baudrate)
+{
+    // Start bit + 8 data bits + parity + stop bits
+    unsigned bits = 1 + 8;
+    if (port->config.parity != SERIAL_PARITY_DISABLE)
+    {
+        bits++;
+    }
+    bits += port->config.stop_bits == SERIAL_STOP_BITS_2 ? 2 : 1;
+    port->byte_time_us = (bits * MICROS_PER_SEC + baudrate - 1) / baudrate;
+}
+
+// Returns true iff the other end is sending data. We consider it
+// active while the UART is receiving a byte or if the last byte
+// was received less than 2 byte times ago, since the sender might
+// be between bytes of the same frame.
+static bool serial_half_duplex_rx_is_active(const serial_port_t *port)
+{
+    if (port->dev->status.st_urx_out != 0)
+    {
+        return true;
+    }
+    return port->last_rx_at > 0 && time_micros_now() < port->last_rx_at + port->byte_time_us * 2;
+}
+
 static void serial_half_duplex_enable_tx(serial_port_t *port)
 {
+    if (serial_half_duplex_rx_is_active(port))
+    {
+        port->stats.collisions++;
+    }
+    port->awaiting_response = false;
+
     // Disable RX interrupts
     port->dev->int_ena.rxfifo_full = 0;
     port->dev->int_clr.rxfifo_full = 1;
@@ -82,11 +124,35 @@ static void serial_isr(void *arg)
     serial_port_t *port = arg;
     if (port->dev->int_st.tx_done)
     {
+        // Last bit is out, switch to RX right away so we don't
+        // miss the start of the response.
+        time_micros_t now = time_micros_now();
         port->dev->int_clr.tx_done = 1;
         serial_half_duplex_enable_rx(port);
+        port->tx_done_at = now;
+        port->awaiting_response = true;
+        port->stats.turnarounds++;
+        // This only covers the pin switch. The interrupt latency
+        // isn't included, since the UART doesn't timestamp the end
+        // of the transmission.
+        port->stats.rx_enable_us = time_micros_now() - now;
+        if (port->stats.rx_enable_us > port->stats.max_rx_enable_us)
+        {
+            port->stats.max_rx_enable_us = port->stats.rx_enable_us;
+        }
     }
     else if (port->dev->int_st.rxfifo_full)
     {
+        time_micros_t now = time_micros_now();
+        if (port->awaiting_response)
+        {
+            // The interrupt fires once the 1st byte has been received
+            // completely, so discount its transmission time.
+            time_micros_t elapsed = now - port->tx_done_at;
+            port->stats.response_us = elapsed > port->byte_time_us ? elapsed - port->byte_time_us : 0;
+            port->awaiting_response = false;
+        }
+        port->last_rx_at = now;
         uint32_t cnt = port->dev->status.rxfifo_cnt;
         while (cnt--)
         {
@@ -188,6 +254,11 @@ void serial_port_do_open(serial_port_t *port)
         // since timing is very likely critical.
         port->dev->idle_conf.tx_idle_num = 0;
     }
+    serial_port_update_byte_time(port, port->config.baud_rate);
+    port->tx_done_at = 0;
+    port->last_rx_at = 0;
+    port->awaiting_response = false;
+    memset(&port->stats, 0, sizeof(port->stats));
     port->open = true;
     port->in_write = false;
 }
@@ -211,6 +282,18 @@ serial_port_t *serial_port_open(const serial_port_config_t *config)
     return port;
 }
 
+serial_port_t *serial_port_open_console(const serial_port_config_t *config)
+{
+    assert(!console_port.open);
+    mutex_open(&console_port.mutex);
+    console_port.config = *config;
+    // Pins connected to the USB-UART bridge
+    console_port.config.tx = GPIO_NUM_1;
+    console_port.config.rx = GPIO_NUM_3;
+    serial_port_do_open(&console_port);
+    return &console_port;
+}
+
 int serial_port_read(serial_port_t *port, void *buf, size_t size, time_ticks_t timeout)
 {
     if (port->uses_driver)
@@ -238,6 +321,7 @@ bool serial_port_begin_write(serial_port_t *port)
             // Half duplex mode, switch to TX mode
             serial_half_duplex_enable_tx(port);
         }
+        power_lock_acquire(POWER_LOCK_SERIAL);
         port->in_write = true;
         return true;
     }
@@ -252,29 +336,49 @@ bool serial_port_end_write(serial_port_t *port)
         {
             port->dev->int_ena.tx_done = 1;
         }
+        power_lock_release(POWER_LOCK_SERIAL);
         port->in_write = false;
         return true;
     }
     return false;
 }
 
+static void serial_port_fill_fifo(serial_port_t *port, const void *buf, size_t size)
+{
+    const uint8_t *ptr = buf;
+    for (unsigned ii = 0; ii < size; ii++)
+    {
+        WRITE_PERI_REG(UART_FIFO_AHB_REG(port->port_num), ptr[ii]);
+    }
+}
+
 int serial_port_write(serial_port_t *port, const void *buf, size_t size)
 {
     bool began_write = serial_port_begin_write(port);
     int n;
     if (port->uses_driver)
     {
-        n = uart_write_bytes(port->port_num, buf, size);
+        // When the driver has no TX buffer, it writes directly to the FIFO.
+        // If the whole write fits in the FIFO, do it ourselves to avoid the
+        // locking and task switching in the driver, so the first byte
+        // goes out as soon as possible.
+        if (port->config.tx_buffer_size == 0 && UART_FIFO_LEN - port->dev->status.txfifo_cnt >= size)
+        {
+            serial_port_fill_fifo(port, buf, size);
+            n = size;
+        }
+        else
+        {
+            n = uart_write_bytes(port->port_num, buf, size);
+        }
     }
     else
     {
+        // Half duplex. The switch back to RX is done from the ISR as
+        // soon as the UART signals that the last bit has been sent.
         port->dev->int_clr.tx_done = 1;
         port->dev->int_ena.tx_done = 0;
-        const uint8_t *ptr = buf;
-        for (unsigned ii = 0; ii < size; ii++)
-        {
-            WRITE_PERI_REG(UART_FIFO_AHB_REG(port->port_num), ptr[ii]);
-        }
+        serial_port_fill_fifo(port, buf, size);
         n = size;
     }
     if (began_write)
@@ -287,6 +391,7 @@ int serial_port_write(serial_port_t *port, const void *buf, size_t size)
 bool serial_port_set_baudrate(serial_port_t *port, uint32_t baudrate)
 {
     ESP_ERROR_CHECK(uart_set_baudrate(port->port_num, baudrate));
+    serial_port_update_byte_time(port, baudrate);
     return true;
 }
 
@@ -309,6 +414,11 @@ void serial_port_close(serial_port_t *port)
         ESP_ERROR_CHECK(esp_intr_free(port->isr_handle));
     }
     mutex_close(&port->mutex);
+    if (port->in_write)
+    {
+        power_lock_release(POWER_LOCK_SERIAL);
+        port->in_write = false;
+    }
     port->open = false;
 }
 
@@ -347,3 +457,22 @@ void serial_port_set_half_duplex_mode(serial_port_t *port, serial_half_duplex_mo
         }
     }
 }
+
+bool serial_port_is_busy(const serial_port_t *port)
+{
+    if (!serial_port_is_half_duplex(port))
+    {
+        return false;
+    }
+    if (port->in_write || port->dev->int_ena.tx_done == 1)
+    {
+        // Still sending
+        return true;
+    }
+    return serial_half_duplex_rx_is_active(port);
+}
+
+void serial_port_get_half_duplex_stats(const serial_port_t *port, serial_half_duplex_stats_t *stats)
+{
+    *stats = port->stats;
+}
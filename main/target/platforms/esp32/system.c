@@ -5,6 +5,8 @@
 
 #include "target.h"
 
+#include "io/storage.h"
+
 #define BUTTON_SYSTEM_GPIO BUTTON_ENTER_GPIO
 
 float system_temperature(void)
@@ -20,6 +22,8 @@ bool system_awake_from_deep_sleep(void)
 
 void system_reboot(void)
 {
+    // Make sure any queued settings are written before rebooting
+    storage_flush();
     esp_restart();
 }
 
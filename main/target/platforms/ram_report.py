@@ -0,0 +1,115 @@
+#!/usr/bin/env python
+
+from __future__ import print_function
+from __future__ import division
+
+import argparse
+import re
+import subprocess
+
+# nm symbol types for initialized (d) and zero initialized (b) data
+RAM_SYMBOL_TYPES = {
+    'd': 'data',
+    'b': 'bss',
+}
+
+DEFINE_RE = re.compile(r'^#define\s+(\w+)\s+(.*)$')
+IDENTIFIER_RE = re.compile(r'[A-Za-z_]\w*')
+# Casts like (size_t) or (unsigned short)
+CAST_RE = re.compile(r'\(\s*(?:unsigned|signed|short|int|long|char|size_t|uint\d+_t|int\d+_t|\s)+\)')
+
+def read_symbols(nm, elf):
+    output = subprocess.check_output([nm, '-S', '--size-sort', elf])
+    symbols = []
+    for line in output.decode('utf-8').splitlines():
+        fields = line.split()
+        if len(fields) != 4:
+            continue
+        size = int(fields[1], 16)
+        kind = RAM_SYMBOL_TYPES.get(fields[2].lower())
+        if kind is None or size == 0:
+            continue
+        symbols.append(dict(name=fields[3], size=size, kind=kind))
+    symbols.sort(key=lambda s: s['size'], reverse=True)
+    return symbols
+
+def read_defines(filename):
+    defines = {}
+    with open(filename) as f:
+        for line in f:
+            m = DEFINE_RE.match(line.strip())
+            if m:
+                defines[m.group(1)] = m.group(2).strip()
+    return defines
+
+def eval_define(defines, name, depth=0):
+    value = defines.get(name)
+    if value is None or depth > 8:
+        return None
+    value = CAST_RE.sub('', value)
+    def replace(m):
+        ident = m.group(0)
+        v = eval_define(defines, ident, depth + 1)
+        if v is None:
+            raise ValueError('can\'t evaluate %s' % ident)
+        return str(v)
+    try:
+        expr = IDENTIFIER_RE.sub(replace, value)
+        return int(eval(expr, {'__builtins__': {}}))
+    except Exception:
+        return None
+
+def print_symbols(symbols, count):
+    print('Largest RAM symbols:')
+    for sym in symbols[:count]:
+        print('  %8d %-4s %s' % (sym['size'], sym['kind'], sym['name']))
+    print()
+
+def print_totals(symbols):
+    totals = {}
+    for sym in symbols:
+        totals[sym['kind']] = totals.get(sym['kind'], 0) + sym['size']
+    for kind in sorted(totals.keys()):
+        print('%-8s %8d bytes' % (kind, totals[kind]))
+    print('%-8s %8d bytes' % ('total', sum(totals.values())))
+    print()
+
+def print_defines(defines, stack_unit):
+    profile = defines.get('BUFFER_PROFILE_NAME')
+    if profile:
+        print('Buffer profile: %s' % profile.strip('"'))
+        for name in sorted(defines.keys()):
+            if name.startswith('BUFFER_') and not name.startswith('BUFFER_PROFILE'):
+                print('  %-32s %s' % (name, eval_define(defines, name)))
+        print()
+    heap_size = eval_define(defines, 'configTOTAL_HEAP_SIZE')
+    if heap_size is not None:
+        print('FreeRTOS heap: %d bytes (task stacks are allocated from it)' % heap_size)
+    print('Task stacks:')
+    for name in sorted(defines.keys()):
+        if name.endswith('_TASK_STACK_SIZE'):
+            size = eval_define(defines, name)
+            if size is None:
+                print('  %-32s %s (unknown)' % (name, defines[name]))
+            else:
+                print('  %-32s %8d bytes' % (name, size * stack_unit))
+    print()
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--nm')
+    parser.add_argument('--elf')
+    parser.add_argument('--defines')
+    parser.add_argument('--stack-unit', type=int, default=1,
+                        help='Size in bytes of the unit used for the task stack sizes')
+    parser.add_argument('--count', type=int, default=30,
+                        help='Number of symbols to print')
+    args = parser.parse_args()
+    symbols = read_symbols(args.nm, args.elf)
+    print_symbols(symbols, args.count)
+    if args.defines:
+        print_defines(read_defines(args.defines), args.stack_unit)
+    print_totals(symbols)
+
+if __name__ == '__main__':
+    main()
@@ -1,6 +1,10 @@
 // Needed for SPI bus defines
 #include <libopencm3/stm32/spi.h>
 
+// wldb compacts from whatever write finds its log full, so we force
+// the compaction while idle instead. See hal_storage_compact_step().
+#define USE_STORAGE_IDLE_COMPACTION
+
 #define RC_TASK_STACK_SIZE 512
 #define RMP_TASK_STACK_SIZE 128
 #define UI_TASK_STACK_SIZE configMINIMAL_STACK_SIZE
\ No newline at end of file
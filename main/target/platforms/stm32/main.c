@@ -75,6 +75,12 @@ void vApplicationStackOverflowHook(TaskHandle_t pxTask, char *pcTaskName)
         ;
 }
 
+void vApplicationIdleHook(void)
+{
+    // Sleep until the next interrupt (at most one tick)
+    __asm__ volatile("wfi");
+}
+
 void vApplicationMallocFailedHook(void)
 {
     printf("malloc() failed\n");
@@ -1,8 +1,10 @@
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 #include <libopencm3/cm3/nvic.h>
 
+#include <libopencm3/stm32/dma.h>
 #include <libopencm3/stm32/gpio.h>
 #include <libopencm3/stm32/rcc.h>
 #include <libopencm3/stm32/usart.h>
@@ -13,6 +15,11 @@
 
 #include "util/macros.h"
 
+// Writes up to this size are copied and sent via DMA, so the caller
+// doesn't have to wait for the data to be transmitted. Bigger writes
+// fall back to blocking mode.
+#define SERIAL_TX_DMA_BUF_SIZE 96
+
 typedef struct serial_port_data_s
 {
     enum rcc_periph_clken gpio_rcc;
@@ -20,6 +27,7 @@ typedef struct serial_port_data_s
     hal_gpio_t tx;
     hal_gpio_t rx;
     uint8_t irqn;
+    uint8_t tx_dma_channel;
 } serial_port_data_t;
 
 typedef struct serial_port_s
@@ -28,6 +36,9 @@ typedef struct serial_port_s
     bool is_open;
     serial_byte_callback_f byte_callback;
     void *byte_callback_data;
+    uint8_t tx_dma_channel;
+    uint8_t tx_buf[SERIAL_TX_DMA_BUF_SIZE];
+    serial_half_duplex_stats_t stats;
 } serial_port_t;
 
 static serial_port_t ports[] = {
@@ -37,9 +48,9 @@ static serial_port_t ports[] = {
 };
 
 static const serial_port_data_t port_data[] = {
-    {RCC_GPIOA, RCC_USART1, HAL_GPIO_PA(9), HAL_GPIO_PA(10), NVIC_USART1_IRQ},  // USART1
-    {RCC_GPIOA, RCC_USART2, HAL_GPIO_PA(2), HAL_GPIO_PA(3), NVIC_USART2_IRQ},   // USART2
-    {RCC_GPIOB, RCC_USART3, HAL_GPIO_PB(10), HAL_GPIO_PB(11), NVIC_USART3_IRQ}, // USART3
+    {RCC_GPIOA, RCC_USART1, HAL_GPIO_PA(9), HAL_GPIO_PA(10), NVIC_USART1_IRQ, DMA_CHANNEL4},  // USART1
+    {RCC_GPIOA, RCC_USART2, HAL_GPIO_PA(2), HAL_GPIO_PA(3), NVIC_USART2_IRQ, DMA_CHANNEL7},   // USART2
+    {RCC_GPIOB, RCC_USART3, HAL_GPIO_PB(10), HAL_GPIO_PB(11), NVIC_USART3_IRQ, DMA_CHANNEL2}, // USART3
 };
 
 typedef enum
@@ -50,6 +61,42 @@ typedef enum
     SERIAL_PORT_OPEN_RX_ONLY,
 } serial_port_open_mode_e;
 
+static bool serial_port_tx_dma_is_busy(const serial_port_t *port)
+{
+    return (DMA_CCR(DMA1, port->tx_dma_channel) & DMA_CCR_EN) && DMA_CNDTR(DMA1, port->tx_dma_channel) > 0;
+}
+
+static void serial_port_tx_dma_wait(serial_port_t *port)
+{
+    while (serial_port_tx_dma_is_busy(port))
+    {
+    }
+}
+
+// Waits until all pending data has been shifted out
+static void serial_port_tx_flush(serial_port_t *port)
+{
+    serial_port_tx_dma_wait(port);
+    while (!usart_get_flag(port->usart, USART_SR_TC))
+    {
+    }
+}
+
+static void serial_port_tx_dma_init(serial_port_t *port)
+{
+    uint8_t ch = port->tx_dma_channel;
+    rcc_periph_clock_enable(RCC_DMA1);
+    dma_channel_reset(DMA1, ch);
+    dma_set_peripheral_address(DMA1, ch, (uint32_t)&USART_DR(port->usart));
+    dma_set_memory_address(DMA1, ch, (uint32_t)port->tx_buf);
+    dma_set_read_from_memory(DMA1, ch);
+    dma_enable_memory_increment_mode(DMA1, ch);
+    dma_set_peripheral_size(DMA1, ch, DMA_CCR_PSIZE_8BIT);
+    dma_set_memory_size(DMA1, ch, DMA_CCR_MSIZE_8BIT);
+    dma_set_priority(DMA1, ch, DMA_CCR_PL_VERY_HIGH);
+    usart_enable_tx_dma(port->usart);
+}
+
 static void serial_port_set_half_duplex(serial_port_t *port, bool enabled)
 {
     uint32_t usart = port->usart;
@@ -188,6 +235,13 @@ serial_port_t *serial_port_open(const serial_port_config_t *config)
 
     port->byte_callback = config->byte_callback;
     port->byte_callback_data = config->byte_callback_data;
+    port->tx_dma_channel = p->tx_dma_channel;
+    memset(&port->stats, 0, sizeof(port->stats));
+
+    if (open_mode != SERIAL_PORT_OPEN_RX_ONLY)
+    {
+        serial_port_tx_dma_init(port);
+    }
 
     port->is_open = true;
 
@@ -236,6 +290,30 @@ bool serial_port_end_write(serial_port_t *port)
 
 int serial_port_write(serial_port_t *port, const void *buf, size_t size)
 {
+    if (serial_port_is_half_duplex(port))
+    {
+        // Direction is switched by the USART itself as soon as the
+        // transmission is complete, so there's no RX enable time to
+        // measure. We can only detect collisions with a received
+        // byte that hasn't been read yet.
+        if (usart_get_flag(port->usart, USART_SR_RXNE))
+        {
+            port->stats.collisions++;
+        }
+        port->stats.turnarounds++;
+    }
+    // Wait for the previous transfer, otherwise we'd overwrite
+    // its buffer or send the bytes out of order.
+    serial_port_tx_dma_wait(port);
+    if (size <= sizeof(port->tx_buf))
+    {
+        uint8_t ch = port->tx_dma_channel;
+        memcpy(port->tx_buf, buf, size);
+        dma_disable_channel(DMA1, ch);
+        dma_set_number_of_data(DMA1, ch, size);
+        dma_enable_channel(DMA1, ch);
+        return size;
+    }
     const uint8_t *ptr = buf;
     for (size_t ii = 0; ii < size; ii++, ptr++)
     {
@@ -246,6 +324,7 @@ int serial_port_write(serial_port_t *port, const void *buf, size_t size)
 
 bool serial_port_set_baudrate(serial_port_t *port, uint32_t baudrate)
 {
+    serial_port_tx_flush(port);
     usart_set_baudrate(port->usart, baudrate);
     return true;
 }
@@ -260,6 +339,9 @@ bool serial_port_set_inverted(serial_port_t *port, bool inverted)
 
 void serial_port_close(serial_port_t *port)
 {
+    serial_port_tx_flush(port);
+    dma_disable_channel(DMA1, port->tx_dma_channel);
+    usart_disable_tx_dma(port->usart);
     usart_disable(port->usart);
     port->is_open = false;
 }
@@ -282,6 +364,20 @@ void serial_port_set_half_duplex_mode(serial_port_t *port, serial_half_duplex_mo
     // STM32 automatically makes the USART_TX pin an input when it's not sending
 }
 
+bool serial_port_is_busy(const serial_port_t *port)
+{
+    if (!serial_port_is_half_duplex(port))
+    {
+        return false;
+    }
+    return serial_port_tx_dma_is_busy(port) || !usart_get_flag(port->usart, USART_SR_TC);
+}
+
+void serial_port_get_half_duplex_stats(const serial_port_t *port, serial_half_duplex_stats_t *stats)
+{
+    *stats = port->stats;
+}
+
 static void usart_isr(serial_port_t *port)
 {
     /* Check if we were called because of RXNE. */
@@ -28,6 +28,10 @@ static const char *TAG = "menu";
 #define SETTINGS_REQUEST_BROADCAST_INTERVAL MILLIS_TO_TICKS(500)
 #define SETTINGS_DEVICE_EXPIRATION MILLIS_TO_TICKS(2000)
 #define SETTINGS_REMOTE_REFRESH_INTERVAL MILLIS_TO_TICKS(500)
+// Used when subscribed to the folder. Notifications might be lost, so
+// we still refresh the settings now and then.
+#define SETTINGS_REMOTE_SUBSCRIBED_REFRESH_INTERVAL MILLIS_TO_TICKS(10000)
+#define SETTINGS_REMOTE_SUBSCRIPTION_RENEW_INTERVAL MILLIS_TO_TICKS(SETTINGS_RMP_SUBSCRIPTION_LEASE_MS / 3)
 
 #define MENU_TITLE_CMD_SUFFIX "\xAC"
 
@@ -95,6 +99,12 @@ typedef struct settings_remote_s
 {
     time_ticks_t next_broadcast;
     settings_device_t devices[5];
+    // Subscription to the remote folder being displayed
+    struct
+    {
+        time_ticks_t renew_at;   // Time to send the next subscription request
+        time_ticks_t expires_at; // Zero until the device accepts it
+    } subscription;
 } settings_remote_t;
 
 static rc_t *rc;
@@ -105,6 +115,7 @@ static settings_remote_t remotes;
 _Static_assert(ARRAY_COUNT(remotes.devices) <= MAX_DYN_MENU_ENTRIES - 2, "increase MAX_DYN_MENU_ENTRIES");
 
 static const char *menu_back_title(void *data, char *buf, uint16_t bufsize);
+static void menu_remote_subscription_reset(void);
 static bool menu_back_action(void *data, const button_event_t *ev);
 static const char *menu_local_setting_title(void *data, char *buf, uint16_t bufsize);
 static bool menu_local_setting_action(void *data, const button_event_t *ev);
@@ -169,6 +180,7 @@ static bool menu_back_action(void *data, const button_event_t *ev)
                     // Clear the dyn entries. menu_update() will repopulate them.
                     dyn_entries[0] = MENU_BACK_ENTRY;
                     dyn_entries[1] = MENU_END;
+                    menu_remote_subscription_reset();
                     break;
                 }
             }
@@ -317,6 +329,12 @@ static bool menu_is_displaying_device_folder(const rmp_msg_t *msg, const setting
     case SETTINGS_RMP_READ:
         folder_id = settings_msg->setting.view.folder_id;
         break;
+    case SETTINGS_RMP_SUBSCRIBE:
+        folder_id = settings_msg->subscribe.view.folder_id;
+        break;
+    case SETTINGS_RMP_NOTIFY:
+        folder_id = settings_msg->notify.view.folder_id;
+        break;
     default:
         return false;
     }
@@ -340,9 +358,66 @@ static void menu_device_enter_folder(int device_index, folder_id_e folder)
     dyn_entries[0] = MENU_BACK_ENTRY;
     dyn_entries[1] = MENU_END;
     menu->entries = dyn_entries;
+    menu_remote_subscription_reset();
     menu_enter(menu);
 }
 
+static void menu_remote_subscription_reset(void)
+{
+    remotes.subscription.renew_at = 0;
+    remotes.subscription.expires_at = 0;
+}
+
+static time_ticks_t menu_remote_setting_refresh_interval(const settings_rmp_setting_t *setting)
+{
+    if (remotes.subscription.expires_at > time_ticks_now() && !(setting->flags & SETTING_FLAG_DYNAMIC))
+    {
+        // We get notified when it changes
+        return SETTINGS_REMOTE_SUBSCRIBED_REFRESH_INTERVAL;
+    }
+    return SETTINGS_REMOTE_REFRESH_INTERVAL;
+}
+
+static int menu_remote_folder_entry_count(void)
+{
+    int count = 0;
+    while (!MENU_ENTRY_IS_BACK(&dyn_entries[count]))
+    {
+        count++;
+    }
+    return count;
+}
+
+static void menu_remote_folder_notified(const settings_rmp_notify_t *notify)
+{
+    if (!notify->is_visible)
+    {
+        menu_back_action(NULL, NULL);
+        return;
+    }
+    int count = menu_remote_folder_entry_count();
+    if (count == 0)
+    {
+        // Not loaded yet
+        return;
+    }
+    if (count != MIN(notify->settings_count, MAX_DYN_MENU_ENTRIES - 2))
+    {
+        // Reload the folder
+        dyn_entries[0] = MENU_BACK_ENTRY;
+        dyn_entries[1] = MENU_END;
+        return;
+    }
+    for (int ii = 0; ii < count; ii++)
+    {
+        if (notify->changed & (1u << MIN(ii, SETTINGS_RMP_NOTIFY_MAX_INDEX)))
+        {
+            // Request it in the next menu_update()
+            dyn_remote_settings[ii].next_update = 0;
+        }
+    }
+}
+
 static void menu_rmp_device_update(const rmp_msg_t *msg, const settings_rmp_msg_t *settings_msg)
 {
     // First, check if the device exists and update it
@@ -424,7 +499,7 @@ static void menu_rmp_port_handler(rmp_t *rmp, rmp_req_t *req, void *user_data)
             {
                 menu_remote_setting_t *remote_setting = &dyn_remote_settings[msg->setting.setting_index];
                 memmove(&remote_setting->setting, &msg->setting, sizeof(msg->setting));
-                remote_setting->next_update = time_ticks_now() + SETTINGS_REMOTE_REFRESH_INTERVAL;
+                remote_setting->next_update = time_ticks_now() + menu_remote_setting_refresh_interval(&msg->setting);
                 dyn_entries[msg->setting.setting_index].data = &remote_setting->setting;
             }
         }
@@ -436,10 +511,23 @@ static void menu_rmp_port_handler(rmp_t *rmp, rmp_req_t *req, void *user_data)
         dyn_entries[0] = MENU_BACK_ENTRY;
         dyn_entries[1] = MENU_END;
         break;
+    case SETTINGS_RMP_SUBSCRIBE:
+        if (menu_is_displaying_device_folder(req->msg, msg))
+        {
+            remotes.subscription.expires_at = time_ticks_now() + MILLIS_TO_TICKS(msg->subscribe.lease_ms);
+        }
+        break;
+    case SETTINGS_RMP_NOTIFY:
+        if (menu_is_displaying_device_folder(req->msg, msg))
+        {
+            menu_remote_folder_notified(&msg->notify);
+        }
+        break;
     // Requests, not handled here
     case SETTINGS_RMP_HELO:
     case SETTINGS_RMP_READ_REQ:
     case SETTINGS_RMP_WRITE_REQ:
+    case SETTINGS_RMP_SUBSCRIBE_REQ:
         break;
     }
 }
@@ -796,6 +884,18 @@ void menu_update(void)
     {
         // Displaying a remote folder. Check if we need to update it the folder or
         // any of their items.
+        settings_device_t *dev = &remotes.devices[active_menu->data2];
+        if (now >= remotes.subscription.renew_at)
+        {
+            // Devices without support for subscriptions ignore this, then
+            // we keep polling all the settings.
+            req.code = SETTINGS_RMP_SUBSCRIBE_REQ;
+            req.subscribe_req.view.id = SETTINGS_VIEW_REMOTE;
+            req.subscribe_req.view.folder_id = active_menu->data1;
+            req.subscribe_req.view.recursive = false;
+            rmp_send(rc->rmp, rmp_port, &dev->addr, RMP_PORT_SETTINGS, &req, settings_rmp_msg_size(&req));
+            remotes.subscription.renew_at = now + SETTINGS_REMOTE_SUBSCRIPTION_RENEW_INTERVAL;
+        }
         if (MENU_ENTRY_IS_BACK(&dyn_entries[0]))
         {
             // No count yet. Query it.
@@ -803,7 +903,6 @@ void menu_update(void)
             req.helo.view.id = SETTINGS_VIEW_REMOTE;
             req.helo.view.folder_id = active_menu->data1;
             req.helo.view.recursive = false;
-            settings_device_t *dev = &remotes.devices[active_menu->data2];
             rmp_send(rc->rmp, rmp_port, &dev->addr, RMP_PORT_SETTINGS, &req, settings_rmp_msg_size(&req));
         }
         else
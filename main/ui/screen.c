@@ -8,9 +8,13 @@
 #include <u8g2.h>
 
 #include "air/air.h"
+#include "air/air_survey.h"
+
+#include "config/settings.h"
 
 #include "ota/ota.h"
 
+#include "platform/power.h"
 #include "platform/system.h"
 
 #include "rc/rc.h"
@@ -222,6 +226,11 @@ bool screen_handle_button_event(screen_t *screen, bool before_menu, const button
 {
     if (screen->internal.secondary_mode != SCREEN_SECONDARY_MODE_NONE)
     {
+        if (screen->internal.secondary_mode == SCREEN_SECONDARY_MODE_SPECTRUM)
+        {
+            // Leaving the spectrum view stops the survey
+            setting_set_bool(settings_get_key(SETTING_KEY_DIAGNOSTICS_SPECTRUM_SURVEY), false);
+        }
         screen->internal.secondary_mode = SCREEN_SECONDARY_MODE_NONE;
         return true;
     }
@@ -1218,6 +1227,65 @@ static void screen_draw_debug_info(screen_t *s)
 
     snprintf(buf, SCREEN_DRAW_BUF_SIZE, "%.02f C", system_temperature());
     screen_draw_label_value(s, "Core Temp:", buf, SCREEN_W(s), y, 3);
+    y += 16;
+
+    power_stats_t power_stats;
+    power_get_stats(&power_stats);
+    time_micros_t total = power_stats.residency_us[POWER_STATE_MAX] + power_stats.residency_us[POWER_STATE_SCALED];
+    unsigned max_pct = total > 0 ? power_stats.residency_us[POWER_STATE_MAX] * 100 / total : 100;
+    snprintf(buf, SCREEN_DRAW_BUF_SIZE, "%umA (%u%% max)", power_stats.current_ma, max_pct);
+    screen_draw_label_value(s, "Est. MCU:", buf, SCREEN_W(s), y, 3);
+}
+
+#define SPECTRUM_MIN_DBM -130
+#define SPECTRUM_MAX_DBM -50
+
+static uint16_t screen_spectrum_y(int dbm, uint16_t top, uint16_t bottom)
+{
+    dbm = CONSTRAIN(dbm, SPECTRUM_MIN_DBM, SPECTRUM_MAX_DBM);
+    return bottom - (bottom - top) * (dbm - SPECTRUM_MIN_DBM) / (SPECTRUM_MAX_DBM - SPECTRUM_MIN_DBM);
+}
+
+static void screen_draw_spectrum(screen_t *s)
+{
+    char *buf = SCREEN_BUF(s);
+    u8g2_SetDrawColor(&u8g2, 1);
+    u8g2_SetFontPosTop(&u8g2);
+
+    unsigned sweeps = air_survey_get_sweep_count();
+    if (sweeps == 0)
+    {
+        u8g2_SetFont(&u8g2, u8g2_font_profont15_tf);
+        screen_draw_label_value(s, NULL, "Surveying...", s->internal.w, 0, 0);
+        return;
+    }
+
+    u8g2_SetFont(&u8g2, u8g2_font_micro_tr);
+    unsigned long first_freq;
+    unsigned long last_freq;
+    air_survey_get_step(0, &first_freq, NULL);
+    air_survey_get_step(AIR_SURVEY_STEP_COUNT - 1, &last_freq, NULL);
+    snprintf(buf, SCREEN_DRAW_BUF_SIZE, "%.02f-%.02f %u %ums", first_freq / 1e6f, last_freq / 1e6f,
+             sweeps, (unsigned)(air_survey_get_sweep_time() / 1000));
+    u8g2_DrawStr(&u8g2, 0, 0, buf);
+
+    // Average noise is drawn as bars, peaks as single pixels
+    uint16_t top = 8;
+    uint16_t bottom = SCREEN_H(s) - 1;
+    air_survey_step_t step;
+    for (unsigned ii = 0; ii < AIR_SURVEY_STEP_COUNT; ii++)
+    {
+        air_survey_get_step(ii, NULL, &step);
+        uint16_t x0 = ii * SCREEN_W(s) / AIR_SURVEY_STEP_COUNT;
+        uint16_t x1 = MAX((ii + 1) * SCREEN_W(s) / AIR_SURVEY_STEP_COUNT, x0 + 1);
+        uint16_t avg_y = screen_spectrum_y(step.avg_x16 / 16, top, bottom);
+        uint16_t peak_y = screen_spectrum_y(step.peak, top, bottom);
+        for (uint16_t x = x0; x < x1; x++)
+        {
+            u8g2_DrawVLine(&u8g2, x, avg_y, bottom - avg_y + 1);
+            u8g2_DrawPixel(&u8g2, x, peak_y);
+        }
+    }
 }
 
 static void screen_draw(screen_t *screen)
@@ -1319,6 +1387,9 @@ static void screen_draw(screen_t *screen)
         case SCREEN_SECONDARY_MODE_DEBUG_INFO:
             screen_draw_debug_info(screen);
             break;
+        case SCREEN_SECONDARY_MODE_SPECTRUM:
+            screen_draw_spectrum(screen);
+            break;
         }
     }
 }
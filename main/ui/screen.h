@@ -22,6 +22,7 @@ typedef enum
     SCREEN_SECONDARY_MODE_NONE,
     SCREEN_SECONDARY_MODE_FREQUENCIES,
     SCREEN_SECONDARY_MODE_DEBUG_INFO,
+    SCREEN_SECONDARY_MODE_SPECTRUM,
 } screen_secondary_mode_e;
 
 typedef enum
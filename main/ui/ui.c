@@ -148,6 +148,11 @@ static void ui_settings_handler(const setting_t *setting, void *user_data)
     {
         screen_enter_secondary_mode(&ui->internal.screen, SCREEN_SECONDARY_MODE_DEBUG_INFO);
     }
+
+    if (SETTING_IS(setting, SETTING_KEY_DIAGNOSTICS_SPECTRUM_SURVEY) && setting_get_bool(setting))
+    {
+        screen_enter_secondary_mode(&ui->internal.screen, SCREEN_SECONDARY_MODE_SPECTRUM);
+    }
 #endif
 }
 
@@ -173,24 +178,12 @@ static void ui_update_beeper(ui_t *ui)
 void ui_init(ui_t *ui, ui_config_t *cfg, rc_t *rc)
 {
     led_init();
-    button_callback_f button_callback = ui_handle_noscreen_button_event;
-#ifdef USE_SCREEN
-    if (screen_init(&ui->internal.screen, &cfg->screen, rc))
-    {
-        button_callback = ui_handle_screen_button_event;
-    }
-#endif
-
-    for (unsigned ii = 0; ii < ARRAY_COUNT(ui->internal.buttons); ii++)
-    {
-        ui->internal.buttons[ii].user_data = ui;
-        ui->internal.buttons[ii].callback = button_callback;
-    }
-
+    ui->internal.cfg = *cfg;
     ui->internal.rc = rc;
     for (unsigned ii = 0; ii < ARRAY_COUNT(ui->internal.buttons); ii++)
     {
         ui->internal.buttons[ii].user_data = ui;
+        ui->internal.buttons[ii].callback = ui_handle_noscreen_button_event;
         ui->internal.buttons[ii].id = ii;
         ui->internal.buttons[ii].cfg = cfg->buttons[ii];
         button_init(&ui->internal.buttons[ii]);
@@ -202,10 +195,19 @@ void ui_init(ui_t *ui, ui_config_t *cfg, rc_t *rc)
 #endif
 
     system_add_flag(SYSTEM_FLAG_BUTTON);
+    settings_add_listener(ui_settings_handler, ui);
+}
+
+void ui_screen_init(ui_t *ui)
+{
 #ifdef USE_SCREEN
-    if (screen_is_available(&ui->internal.screen))
+    if (screen_init(&ui->internal.screen, &ui->internal.cfg.screen, ui->internal.rc))
     {
         LOG_I(TAG, "Screen detected");
+        for (unsigned ii = 0; ii < ARRAY_COUNT(ui->internal.buttons); ii++)
+        {
+            ui->internal.buttons[ii].callback = ui_handle_screen_button_event;
+        }
         system_add_flag(SYSTEM_FLAG_SCREEN);
 #if defined(SCREEN_FIXED_ORIENTATION)
         screen_orientation_e screen_orientation = SCREEN_ORIENTATION_DEFAULT;
@@ -220,9 +222,10 @@ void ui_init(ui_t *ui, ui_config_t *cfg, rc_t *rc)
     {
         LOG_I(TAG, "No screen detected");
     }
-    menu_init(rc);
+    menu_init(ui->internal.rc);
+#else
+    UNUSED(ui);
 #endif
-    settings_add_listener(ui_settings_handler, ui);
 }
 
 bool ui_screen_is_available(const ui_t *ui)
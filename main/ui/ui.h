@@ -61,7 +61,13 @@ typedef struct ui_s
     } internal;
 } ui_t;
 
+// Initializes the LEDs, buttons and beeper. It's fast, so it runs
+// before the RC task is started.
 void ui_init(ui_t *ui, ui_config_t *cfg, rc_t *rc);
+// Probes and initializes the screen, if any. It's slow, so it runs
+// from the UI task once the RC link is up. Buttons behave as if there
+// was no screen until it's called.
+void ui_screen_init(ui_t *ui);
 bool ui_screen_is_available(const ui_t *ui);
 void ui_screen_splash(ui_t *ui);
 bool ui_is_animating(const ui_t *ui);